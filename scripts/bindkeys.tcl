@@ -13,3 +13,6 @@ bindkey set R {tool set rect}
 #bindkey set S {tool set select}
 bindkey set Esc {tool set select}
 bindkey set Shift+R {tool set rect}
+bindkey set Ctrl+Z {edit undo}
+bindkey set Ctrl+Shift+Z {edit redo}
+bindkey set Ctrl+Y {edit redo}
@@ -29,10 +29,11 @@ EditorSession* EditorSessionController::effectiveSession() {
     return activeSession();
 }
 
-int EditorSessionController::createSession(LayoutEditorWindow* window) {
+int EditorSessionController::createSession(LayoutEditorWindow* window, std::shared_ptr<LayoutDocument> document) {
     EditorSession session;
     session.id = m_nextEditorId++;
     session.window = window;
+    session.document = std::move(document);
 
     const int editorId = session.id;
     m_sessions.insert(editorId, session);
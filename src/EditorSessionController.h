@@ -3,13 +3,18 @@
 #include <QHash>
 #include <QString>
 #include <QVector>
+#include <memory>
 
 #include "LayerManager.h"
+#include "LayoutDocument.h"
 #include "LayoutEditorWindow.h"
 
 struct EditorSession {
     int id{0};
     LayoutEditorWindow* window{nullptr};
+    // Shared by every session viewing the same layout; the rest of the
+    // session is per-editor view state.
+    std::shared_ptr<LayoutDocument> document;
     QVector<LayerDefinition> layers;
     QString activeLayerName;
     QString activeLayerType;
@@ -35,7 +40,7 @@ public:
     const EditorSession* activeSession() const;
     EditorSession* effectiveSession();
 
-    int createSession(LayoutEditorWindow* window);
+    int createSession(LayoutEditorWindow* window, std::shared_ptr<LayoutDocument> document);
     void removeSession(int editorId);
     void setActiveEditor(int editorId);
 
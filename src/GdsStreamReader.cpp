@@ -0,0 +1,671 @@
+#include "GdsStreamReader.h"
+
+#include "LayoutFileLoader.h"
+#include "LayoutSceneModel.h"
+
+#include <QFile>
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+
+namespace {
+
+// GDSII record types used by the reader; everything else is skipped.
+enum GdsRecordType : quint8 {
+    kRecordHeader = 0x00,
+    kRecordBgnLib = 0x01,
+    kRecordLibName = 0x02,
+    kRecordUnits = 0x03,
+    kRecordEndLib = 0x04,
+    kRecordBgnStr = 0x05,
+    kRecordStrName = 0x06,
+    kRecordEndStr = 0x07,
+    kRecordBoundary = 0x08,
+    kRecordPath = 0x09,
+    kRecordSref = 0x0A,
+    kRecordAref = 0x0B,
+    kRecordText = 0x0C,
+    kRecordLayer = 0x0D,
+    kRecordDataType = 0x0E,
+    kRecordWidth = 0x0F,
+    kRecordXy = 0x10,
+    kRecordEndEl = 0x11,
+    kRecordSname = 0x12,
+    kRecordColRow = 0x13,
+    kRecordNode = 0x15,
+    kRecordStrans = 0x1A,
+    kRecordMag = 0x1B,
+    kRecordAngle = 0x1C,
+    kRecordPathType = 0x21,
+    kRecordBox = 0x2D,
+    kRecordBoxType = 0x2E,
+    kRecordBgnExtn = 0x30,
+    kRecordEndExtn = 0x31
+};
+
+constexpr quint16 kStransReflect = 0x8000;
+
+struct GdsRecord {
+    quint8 type{0};
+    const uchar* data{nullptr};
+    int dataLength{0};
+    qint64 offset{0};
+};
+
+inline quint16 readU16(const uchar* p) {
+    return static_cast<quint16>((static_cast<quint16>(p[0]) << 8) | p[1]);
+}
+
+inline qint16 readI16(const uchar* p) {
+    return static_cast<qint16>(readU16(p));
+}
+
+inline qint32 readI32(const uchar* p) {
+    return static_cast<qint32>((static_cast<quint32>(p[0]) << 24)
+                               | (static_cast<quint32>(p[1]) << 16)
+                               | (static_cast<quint32>(p[2]) << 8)
+                               | static_cast<quint32>(p[3]));
+}
+
+// GDSII 8-byte real: sign bit, excess-64 base-16 exponent, 56-bit mantissa.
+double readReal8(const uchar* p) {
+    quint64 mantissa = 0;
+    for (int i = 1; i < 8; ++i) {
+        mantissa = (mantissa << 8) | p[i];
+    }
+
+    const int exponent = static_cast<int>(p[0] & 0x7f) - 64;
+    const double value = std::ldexp(static_cast<double>(mantissa), (exponent * 4) - 56);
+    return (p[0] & 0x80) ? -value : value;
+}
+
+QString readString(const GdsRecord& record) {
+    int length = record.dataLength;
+    while (length > 0 && record.data[length - 1] == 0) {
+        --length;
+    }
+    return QString::fromLatin1(reinterpret_cast<const char*>(record.data), length);
+}
+
+// Forward-only view over GDSII records in a mapped byte range.
+class GdsRecordCursor {
+public:
+    GdsRecordCursor(const uchar* begin, const uchar* end, const qint64 baseOffset)
+        : m_position(begin), m_begin(begin), m_end(end), m_baseOffset(baseOffset) {}
+
+    // Returns false at the end of the range or on a malformed header; error
+    // is only set in the latter case.
+    bool next(GdsRecord& outRecord, QString& error) {
+        if (m_end - m_position < 4) {
+            if (m_position != m_end) {
+                error = QString("truncated record at offset %1").arg(offset());
+            }
+            return false;
+        }
+
+        const quint16 length = readU16(m_position);
+        if (length == 0) {
+            // Some writers pad the file tail with zero bytes.
+            m_position = m_end;
+            return false;
+        }
+        if (length < 4 || (length & 1) || length > m_end - m_position) {
+            error = QString("invalid record length %1 at offset %2").arg(length).arg(offset());
+            return false;
+        }
+
+        outRecord.type = m_position[2];
+        outRecord.data = m_position + 4;
+        outRecord.dataLength = length - 4;
+        outRecord.offset = offset();
+        m_position += length;
+        return true;
+    }
+
+    qint64 offset() const {
+        return m_baseOffset + (m_position - m_begin);
+    }
+
+    const uchar* position() const {
+        return m_position;
+    }
+
+private:
+    const uchar* m_position;
+    const uchar* m_begin;
+    const uchar* m_end;
+    qint64 m_baseOffset;
+};
+
+// Accumulates the records of one element between its header and ENDEL.
+struct ElementState {
+    quint8 kind{0};
+    quint32 layer{0};
+    quint32 dataType{0};
+    qint64 width{0};
+    int pathType{0};
+    qint64 beginExtension{0};
+    qint64 endExtension{0};
+    QString masterName;
+    quint16 strans{0};
+    double magnification{1.0};
+    double angleDegrees{0.0};
+    int columns{1};
+    int rows{1};
+    QVector<WorldPoint> points;
+
+    void reset(const quint8 elementKind) {
+        kind = elementKind;
+        layer = 0;
+        dataType = 0;
+        width = 0;
+        pathType = 0;
+        beginExtension = 0;
+        endExtension = 0;
+        masterName.clear();
+        strans = 0;
+        magnification = 1.0;
+        angleDegrees = 0.0;
+        columns = 1;
+        rows = 1;
+        points.clear();
+    }
+};
+
+bool readXy(const GdsRecord& record, QVector<WorldPoint>& outPoints, QString& error) {
+    if (record.dataLength % 8 != 0) {
+        error = QString("malformed XY record at offset %1").arg(record.offset);
+        return false;
+    }
+
+    const int count = record.dataLength / 8;
+    outPoints.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const uchar* p = record.data + (i * 8);
+        outPoints[i] = WorldPoint{readI32(p), readI32(p + 4)};
+    }
+    return true;
+}
+
+std::shared_ptr<LayoutObjectModel> makeBoundaryObject(ElementState& element) {
+    QVector<WorldPoint>& points = element.points;
+    if (points.size() > 1 && points.front().x == points.back().x && points.front().y == points.back().y) {
+        points.removeLast();
+    }
+    if (points.size() < 3) {
+        return nullptr;
+    }
+
+    if (points.size() == 4) {
+        const bool horizontalFirst = points[0].y == points[1].y && points[1].x == points[2].x
+                                     && points[2].y == points[3].y && points[3].x == points[0].x;
+        const bool verticalFirst = points[0].x == points[1].x && points[1].y == points[2].y
+                                   && points[2].x == points[3].x && points[3].y == points[0].y;
+        if (horizontalFirst || verticalFirst) {
+            const DrawnRectangle rectangle{element.layer, element.dataType,
+                                           points[0].x, points[0].y, points[2].x, points[2].y};
+            return std::make_shared<RectangleObjectModel>(rectangle);
+        }
+    }
+
+    return std::make_shared<PolygonObjectModel>(element.layer, element.dataType, std::move(points));
+}
+
+void pathExtensions(const ElementState& element, qint64& outBeginExtension, qint64& outEndExtension) {
+    const qint64 halfWidth = std::abs(element.width) / 2;
+    outBeginExtension = 0;
+    outEndExtension = 0;
+    switch (element.pathType) {
+    case 1: // Round ends, approximated as square.
+    case 2:
+        outBeginExtension = halfWidth;
+        outEndExtension = halfWidth;
+        break;
+    case 4:
+        outBeginExtension = element.beginExtension;
+        outEndExtension = element.endExtension;
+        break;
+    default:
+        break;
+    }
+}
+
+std::shared_ptr<LayoutObjectModel> makePathObject(ElementState& element) {
+    if (element.points.size() < 2) {
+        return nullptr;
+    }
+
+    qint64 beginExtension = 0;
+    qint64 endExtension = 0;
+    pathExtensions(element, beginExtension, endExtension);
+    return std::make_shared<PathObjectModel>(element.layer, element.dataType, std::move(element.points),
+                                             element.width, beginExtension, endExtension);
+}
+
+// Bounds of the boundary or path that makeBoundaryObject / makePathObject
+// would build, computed from the raw points so the measure pass creates no
+// objects (and uses up no object IDs). False when no shape would be built.
+bool measureShape(const ElementState& element, LayoutObjectModel::Bounds& outBounds) {
+    const QVector<WorldPoint>& points = element.points;
+    const bool boundary = element.kind == kRecordBoundary || element.kind == kRecordBox;
+    int pointCount = points.size();
+    if (boundary && pointCount > 1 && points.front().x == points.back().x && points.front().y == points.back().y) {
+        --pointCount;
+    }
+    if (pointCount < (boundary ? 3 : 2)) {
+        return false;
+    }
+
+    outBounds.minX = outBounds.maxX = points[0].x;
+    outBounds.minY = outBounds.maxY = points[0].y;
+    for (int i = 1; i < pointCount; ++i) {
+        outBounds.minX = std::min(outBounds.minX, points[i].x);
+        outBounds.minY = std::min(outBounds.minY, points[i].y);
+        outBounds.maxX = std::max(outBounds.maxX, points[i].x);
+        outBounds.maxY = std::max(outBounds.maxY, points[i].y);
+    }
+
+    if (!boundary) {
+        // Same conservative margin as PathObjectModel.
+        qint64 beginExtension = 0;
+        qint64 endExtension = 0;
+        pathExtensions(element, beginExtension, endExtension);
+        const qint64 margin = std::abs(element.width) / 2 + std::max<qint64>(0, std::max(beginExtension, endExtension));
+        outBounds.minX -= margin;
+        outBounds.minY -= margin;
+        outBounds.maxX += margin;
+        outBounds.maxY += margin;
+    }
+    return true;
+}
+
+bool makeLayoutPendingPlacement(const ElementState& element, LayoutPendingPlacement& outInstance, QString& error) {
+    const int expectedPoints = element.kind == kRecordAref ? 3 : 1;
+    if (element.masterName.isEmpty() || element.points.size() < expectedPoints) {
+        error = QString("incomplete %1 element").arg(element.kind == kRecordAref ? "AREF" : "SREF");
+        return false;
+    }
+
+    outInstance.masterName = element.masterName;
+    outInstance.transform.originX = element.points[0].x;
+    outInstance.transform.originY = element.points[0].y;
+    outInstance.transform.magnification = element.magnification;
+    outInstance.transform.angleDegrees = element.angleDegrees;
+    outInstance.transform.mirrorX = (element.strans & kStransReflect) != 0;
+
+    if (element.kind == kRecordAref) {
+        if (element.columns <= 0 || element.rows <= 0) {
+            error = "AREF with empty COLROW";
+            return false;
+        }
+
+        // Points 2 and 3 are the displacements after all columns / rows.
+        outInstance.columns = element.columns;
+        outInstance.rows = element.rows;
+        outInstance.columnStep = WorldPoint{(element.points[1].x - element.points[0].x) / element.columns,
+                                            (element.points[1].y - element.points[0].y) / element.columns};
+        outInstance.rowStep = WorldPoint{(element.points[2].x - element.points[0].x) / element.rows,
+                                         (element.points[2].y - element.points[0].y) / element.rows};
+    }
+    return true;
+}
+
+// Decodes one structure body. The cursor must be positioned just after
+// BGNSTR; on success it is left just after the matching ENDSTR. Shapes go to
+// outShapes; without it only their count and bounds go into outCell,
+// measured from the raw points.
+bool decodeStructure(GdsRecordCursor& cursor,
+                     LayoutDecodedCell& outCell,
+                     QVector<std::shared_ptr<LayoutObjectModel>>* outShapes,
+                     QString& error) {
+    outCell.node = std::make_shared<LayoutSceneNode>();
+    ElementState element;
+    bool inElement = false;
+
+    GdsRecord record;
+    while (cursor.next(record, error)) {
+        switch (record.type) {
+        case kRecordStrName:
+            outCell.node->setName(readString(record));
+            break;
+        case kRecordEndStr:
+            return true;
+        case kRecordBoundary:
+        case kRecordPath:
+        case kRecordSref:
+        case kRecordAref:
+        case kRecordText:
+        case kRecordNode:
+        case kRecordBox:
+            element.reset(record.type);
+            inElement = true;
+            break;
+        case kRecordLayer:
+            if (record.dataLength >= 2) {
+                element.layer = readU16(record.data);
+            }
+            break;
+        case kRecordDataType:
+        case kRecordBoxType:
+            if (record.dataLength >= 2) {
+                element.dataType = readU16(record.data);
+            }
+            break;
+        case kRecordWidth:
+            if (record.dataLength >= 4) {
+                element.width = readI32(record.data);
+            }
+            break;
+        case kRecordPathType:
+            if (record.dataLength >= 2) {
+                element.pathType = readI16(record.data);
+            }
+            break;
+        case kRecordBgnExtn:
+            if (record.dataLength >= 4) {
+                element.beginExtension = readI32(record.data);
+            }
+            break;
+        case kRecordEndExtn:
+            if (record.dataLength >= 4) {
+                element.endExtension = readI32(record.data);
+            }
+            break;
+        case kRecordSname:
+            element.masterName = readString(record);
+            break;
+        case kRecordStrans:
+            if (record.dataLength >= 2) {
+                element.strans = readU16(record.data);
+            }
+            break;
+        case kRecordMag:
+            if (record.dataLength >= 8) {
+                element.magnification = readReal8(record.data);
+            }
+            break;
+        case kRecordAngle:
+            if (record.dataLength >= 8) {
+                element.angleDegrees = readReal8(record.data);
+            }
+            break;
+        case kRecordColRow:
+            if (record.dataLength >= 4) {
+                element.columns = readI16(record.data);
+                element.rows = readI16(record.data + 2);
+            }
+            break;
+        case kRecordXy:
+            if (inElement && !readXy(record, element.points, error)) {
+                return false;
+            }
+            break;
+        case kRecordEndEl: {
+            if (!inElement) {
+                break;
+            }
+            inElement = false;
+
+            const bool shape = element.kind == kRecordBoundary || element.kind == kRecordBox
+                               || element.kind == kRecordPath;
+            if (shape && outShapes) {
+                std::shared_ptr<LayoutObjectModel> object = element.kind == kRecordPath ? makePathObject(element)
+                                                                                         : makeBoundaryObject(element);
+                if (object) {
+                    outShapes->push_back(std::move(object));
+                }
+                break;
+            }
+
+            if (shape) {
+                LayoutObjectModel::Bounds bounds;
+                if (!measureShape(element, bounds)) {
+                    break;
+                }
+                if (!outCell.hasShapeBounds) {
+                    outCell.shapeBounds = bounds;
+                    outCell.hasShapeBounds = true;
+                } else {
+                    outCell.shapeBounds.minX = std::min(outCell.shapeBounds.minX, bounds.minX);
+                    outCell.shapeBounds.minY = std::min(outCell.shapeBounds.minY, bounds.minY);
+                    outCell.shapeBounds.maxX = std::max(outCell.shapeBounds.maxX, bounds.maxX);
+                    outCell.shapeBounds.maxY = std::max(outCell.shapeBounds.maxY, bounds.maxY);
+                }
+                ++outCell.shapeCount;
+            } else if (element.kind == kRecordSref || element.kind == kRecordAref) {
+                LayoutPendingPlacement instance;
+                if (!makeLayoutPendingPlacement(element, instance, error)) {
+                    error = QString("%1 at offset %2").arg(error).arg(record.offset);
+                    return false;
+                }
+                outCell.placements.push_back(std::move(instance));
+            } else {
+                ++outCell.skippedElements;
+            }
+            break;
+        }
+        default:
+            // Properties, ELFLAGS, PLEX, text attributes: not represented.
+            break;
+        }
+    }
+
+    if (error.isEmpty()) {
+        error = QString("structure '%1' is missing ENDSTR").arg(outCell.node->name());
+    }
+    return false;
+}
+
+// Byte range of one structure body, from just after BGNSTR through ENDSTR.
+struct CellRange {
+    const uchar* begin{nullptr};
+    const uchar* end{nullptr};
+    qint64 offset{0};
+};
+
+// Phase 1: walks record headers only, capturing library metadata and the
+// byte range of every structure. Element records are skipped unread.
+bool scanLibrary(GdsRecordCursor& cursor,
+                 const QString& filePath,
+                 LayoutLoadResult& outResult,
+                 QVector<CellRange>& outRanges,
+                 QString& error) {
+    bool sawHeader = false;
+    GdsRecord record;
+    while (cursor.next(record, error)) {
+        if (!sawHeader && record.type != kRecordHeader) {
+            break;
+        }
+
+        switch (record.type) {
+        case kRecordHeader:
+            sawHeader = true;
+            break;
+        case kRecordLibName:
+            outResult.libraryName = readString(record);
+            break;
+        case kRecordUnits:
+            if (record.dataLength >= 16) {
+                outResult.userUnitsPerDatabaseUnit = readReal8(record.data);
+                outResult.metersPerDatabaseUnit = readReal8(record.data + 8);
+            }
+            break;
+        case kRecordBgnStr: {
+            CellRange range;
+            range.begin = cursor.position();
+            range.offset = cursor.offset();
+            bool sawEndStr = false;
+            while (!sawEndStr && cursor.next(record, error)) {
+                sawEndStr = record.type == kRecordEndStr;
+            }
+            if (!sawEndStr) {
+                if (error.isEmpty()) {
+                    error = QString("structure at offset %1 is missing ENDSTR").arg(range.offset);
+                }
+                return false;
+            }
+
+            range.end = cursor.position();
+            outRanges.push_back(range);
+            break;
+        }
+        case kRecordEndLib:
+            return true;
+        default:
+            break;
+        }
+    }
+
+    if (error.isEmpty()) {
+        error = sawHeader ? QString("%1 is missing ENDLIB").arg(filePath)
+                          : QString("%1 is not a GDSII stream").arg(filePath);
+    }
+    return false;
+}
+
+// Re-decodes cells of a lazily opened file on demand. Owns the mapping the
+// cell ranges point into.
+class GdsLazyCellSource final : public LayoutLazyCellSource {
+public:
+    GdsLazyCellSource(std::unique_ptr<QFile> file, QVector<CellRange> ranges)
+        : m_file(std::move(file)), m_ranges(std::move(ranges)) {}
+
+    bool loadCell(const int cellIndex,
+                  const QVector<std::shared_ptr<const LayoutSceneNode>>& masters,
+                  QVector<std::shared_ptr<LayoutObjectModel>>& outObjects,
+                  QString& error) override {
+        const CellRange& range = m_ranges[cellIndex];
+        GdsRecordCursor cursor(range.begin, range.end, range.offset);
+        LayoutDecodedCell cell;
+        if (!decodeStructure(cursor, cell, &outObjects, error)) {
+            return false;
+        }
+
+        QHash<QString, std::shared_ptr<const LayoutSceneNode>> masterByName;
+        masterByName.reserve(masters.size());
+        for (const std::shared_ptr<const LayoutSceneNode>& master : masters) {
+            masterByName.insert(master->name(), master);
+        }
+
+        for (const LayoutPendingPlacement& placement : cell.placements) {
+            const auto master = masterByName.constFind(placement.masterName);
+            if (master == masterByName.cend()) {
+                error = QString("cell '%1' places unknown cell '%2'").arg(cell.node->name(), placement.masterName);
+                return false;
+            }
+            outObjects.push_back(std::make_shared<InstanceObjectModel>(master.value(),
+                                                                       placement.transform,
+                                                                       placement.columns,
+                                                                       placement.rows,
+                                                                       placement.columnStep,
+                                                                       placement.rowStep));
+        }
+        return true;
+    }
+
+private:
+    std::unique_ptr<QFile> m_file;
+    QVector<CellRange> m_ranges;
+};
+
+// Phase 2: decodes every range into its own scene node on the load worker
+// pool. Cells are handed out largest-first so one huge cell does not end up
+// queued behind many small ones. outErrors[i] is set for failed cells. With
+// measureOnly the shapes are measured and dropped (lazy directory pass).
+void decodeCells(const QVector<CellRange>& ranges,
+                 const bool measureOnly,
+                 QVector<LayoutDecodedCell>& outCells,
+                 QVector<QString>& outErrors) {
+    outCells.resize(ranges.size());
+    outErrors.resize(ranges.size());
+
+    QVector<int> schedule(ranges.size());
+    for (int i = 0; i < schedule.size(); ++i) {
+        schedule[i] = i;
+    }
+    std::stable_sort(schedule.begin(), schedule.end(), [&ranges](int a, int b) {
+        return (ranges[a].end - ranges[a].begin) > (ranges[b].end - ranges[b].begin);
+    });
+
+    // Raw pointers so workers never touch the containers' shared state.
+    const CellRange* rangeData = ranges.constData();
+    const int* scheduleData = schedule.constData();
+    LayoutDecodedCell* cellData = outCells.data();
+    QString* errorData = outErrors.data();
+    LayoutFileLoader::runParallel(ranges.size(), [&](const int slot) {
+        const int cellIndex = scheduleData[slot];
+        const CellRange& range = rangeData[cellIndex];
+        GdsRecordCursor cursor(range.begin, range.end, range.offset);
+        LayoutDecodedCell& cell = cellData[cellIndex];
+        if (measureOnly) {
+            return decodeStructure(cursor, cell, nullptr, errorData[cellIndex]);
+        }
+
+        QVector<std::shared_ptr<LayoutObjectModel>> shapes;
+        if (!decodeStructure(cursor, cell, &shapes, errorData[cellIndex])) {
+            return false;
+        }
+        cell.node->addObjects(std::move(shapes));
+        return true;
+    });
+}
+
+}
+
+namespace GdsStreamReader {
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, const bool lazyCells) {
+    outResult = LayoutLoadResult();
+    outResult.formatName = "GDSII";
+
+    // Heap-allocated so a lazy load can hand the mapping to its cell source.
+    auto file = std::make_unique<QFile>(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file->errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file->size();
+    if (fileSize < 4) {
+        error = QString("%1 is not a GDSII stream").arg(filePath);
+        return false;
+    }
+
+    const uchar* mapped = file->map(0, fileSize);
+    if (!mapped) {
+        error = QString("cannot map %1: %2").arg(filePath, file->errorString());
+        return false;
+    }
+
+    GdsRecordCursor cursor(mapped, mapped + fileSize, 0);
+    QVector<CellRange> ranges;
+    if (!scanLibrary(cursor, filePath, outResult, ranges, error)) {
+        return false;
+    }
+
+    QVector<LayoutDecodedCell> cells;
+    QVector<QString> cellErrors;
+    decodeCells(ranges, lazyCells, cells, cellErrors);
+
+    // Errors are reported in file order, independent of which worker hit
+    // them first.
+    for (const QString& cellError : cellErrors) {
+        if (!cellError.isEmpty()) {
+            error = cellError;
+            return false;
+        }
+    }
+
+    // Phase 3: placements need every master, so linking runs after all
+    // workers have joined.
+    if (lazyCells) {
+        auto source = std::make_shared<GdsLazyCellSource>(std::move(file), ranges);
+        return LayoutFileLoader::linkCells(cells, outResult, error, source);
+    }
+    return LayoutFileLoader::linkCells(cells, outResult, error);
+}
+
+}
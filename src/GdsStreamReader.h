@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+
+struct LayoutLoadResult;
+
+// GdsStreamReader loads GDSII stream files straight into scene nodes.
+//
+// The file is memory-mapped and loaded in three phases: a structural scan
+// records each structure's (BGNSTR..ENDSTR) byte range, a worker pool decodes
+// the ranges in parallel into one LayoutSceneNode per cell, and SREF/AREF
+// placements are linked into InstanceObjectModel objects once every master
+// is ready (GDSII allows forward references). Elements become scene objects
+// as soon as their ENDEL is seen, so no intermediate document is built.
+// The worker pool and link step are shared with OasisStreamReader through
+// LayoutFileLoader.
+//
+// Mapping:
+//  - BOUNDARY / BOX -> RectangleObjectModel when axis-aligned, else PolygonObjectModel
+//  - PATH           -> PathObjectModel
+//  - SREF / AREF    -> InstanceObjectModel
+//  - TEXT / NODE    -> skipped (counted in LayoutLoadResult::skippedElementCount)
+//
+// GDS layer/datatype numbers are used directly as layerNameId/layerTypeId,
+// matching the `<name_id>/<type_id>` column of the layers file. Coordinates
+// stay in database units.
+//
+// With lazyCells the decode phase only measures each cell (bounds, object
+// count) and discards its geometry. Cells become lazy nodes that re-decode
+// their byte range on first access; the file stays mapped while any of them
+// is alive.
+namespace GdsStreamReader {
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, bool lazyCells = false);
+
+}
@@ -0,0 +1,496 @@
+#include "GdsStreamWriter.h"
+
+#include "LayoutFileLoader.h"
+#include "LayoutSceneModel.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Record header words (type << 8 | data type) used by the writer.
+enum GdsRecordHeader : quint16 {
+    kHeader = 0x0002,
+    kBgnLib = 0x0102,
+    kLibName = 0x0206,
+    kUnits = 0x0305,
+    kEndLib = 0x0400,
+    kBgnStr = 0x0502,
+    kStrName = 0x0606,
+    kEndStr = 0x0700,
+    kBoundary = 0x0800,
+    kPath = 0x0900,
+    kSref = 0x0A00,
+    kAref = 0x0B00,
+    kLayer = 0x0D02,
+    kDataType = 0x0E02,
+    kWidth = 0x0F03,
+    kXy = 0x1003,
+    kEndEl = 0x1100,
+    kSname = 0x1206,
+    kColRow = 0x1302,
+    kStrans = 0x1A01,
+    kMag = 0x1B05,
+    kAngle = 0x1C05,
+    kPathType = 0x2102,
+    kBgnExtn = 0x3003,
+    kEndExtn = 0x3103
+};
+
+constexpr quint16 kStreamVersion = 600;
+constexpr quint16 kStransReflect = 0x8000;
+// Largest XY record: (65535 - 4) / 8 points.
+constexpr int kMaxXyPoints = 8191;
+constexpr int kObjectsPerChunk = 4096;
+// Chunks encoded per batch; bounds the output held in memory at once.
+constexpr int kChunksPerBatch = 64;
+
+void appendU16(QByteArray& out, const quint16 value) {
+    out.append(static_cast<char>(value >> 8));
+    out.append(static_cast<char>(value & 0xff));
+}
+
+void appendI32(QByteArray& out, const qint32 value) {
+    const quint32 bits = static_cast<quint32>(value);
+    out.append(static_cast<char>(bits >> 24));
+    out.append(static_cast<char>((bits >> 16) & 0xff));
+    out.append(static_cast<char>((bits >> 8) & 0xff));
+    out.append(static_cast<char>(bits & 0xff));
+}
+
+// GDSII 8-byte real: sign bit, excess-64 base-16 exponent, 56-bit mantissa.
+void appendReal8(QByteArray& out, double value) {
+    quint8 exponentByte = 0;
+    quint64 mantissa = 0;
+    if (value != 0.0) {
+        const bool negative = value < 0.0;
+        value = std::abs(value);
+        int exponent = 64;
+        while (value >= 1.0 && exponent < 127) {
+            value /= 16.0;
+            ++exponent;
+        }
+        while (value < 1.0 / 16.0 && exponent > 0) {
+            value *= 16.0;
+            --exponent;
+        }
+
+        mantissa = static_cast<quint64>(std::llround(std::ldexp(value, 56)));
+        if (mantissa >> 56) {
+            mantissa >>= 4;
+            ++exponent;
+        }
+        exponentByte = static_cast<quint8>((negative ? 0x80 : 0x00) | (exponent & 0x7f));
+    }
+
+    out.append(static_cast<char>(exponentByte));
+    for (int shift = 48; shift >= 0; shift -= 8) {
+        out.append(static_cast<char>((mantissa >> shift) & 0xff));
+    }
+}
+
+void appendRecordHeader(QByteArray& out, const quint16 header, const int dataLength) {
+    appendU16(out, static_cast<quint16>(dataLength + 4));
+    appendU16(out, header);
+}
+
+void appendEmptyRecord(QByteArray& out, const quint16 header) {
+    appendRecordHeader(out, header, 0);
+}
+
+void appendU16Record(QByteArray& out, const quint16 header, const quint16 value) {
+    appendRecordHeader(out, header, 2);
+    appendU16(out, value);
+}
+
+void appendI32Record(QByteArray& out, const quint16 header, const qint32 value) {
+    appendRecordHeader(out, header, 4);
+    appendI32(out, value);
+}
+
+void appendReal8Record(QByteArray& out, const quint16 header, const double value) {
+    appendRecordHeader(out, header, 8);
+    appendReal8(out, value);
+}
+
+// Strings are padded with NUL to an even length.
+void appendStringRecord(QByteArray& out, const quint16 header, const QByteArray& text) {
+    const int paddedLength = text.size() + (text.size() & 1);
+    appendRecordHeader(out, header, paddedLength);
+    out.append(text);
+    if (paddedLength != text.size()) {
+        out.append('\0');
+    }
+}
+
+// BGNLIB/BGNSTR carry modification and access times, six words each.
+void appendTimestampRecord(QByteArray& out, const quint16 header, const QDateTime& now) {
+    appendRecordHeader(out, header, 24);
+    for (int copy = 0; copy < 2; ++copy) {
+        appendU16(out, static_cast<quint16>(now.date().year()));
+        appendU16(out, static_cast<quint16>(now.date().month()));
+        appendU16(out, static_cast<quint16>(now.date().day()));
+        appendU16(out, static_cast<quint16>(now.time().hour()));
+        appendU16(out, static_cast<quint16>(now.time().minute()));
+        appendU16(out, static_cast<quint16>(now.time().second()));
+    }
+}
+
+bool fitsInt32(const qint64 value) {
+    return value >= std::numeric_limits<qint32>::min() && value <= std::numeric_limits<qint32>::max();
+}
+
+// Writes an XY record; closePolygon repeats the first point at the end.
+bool appendXyRecord(QByteArray& out, const QVector<WorldPoint>& points, const bool closePolygon, QString& error) {
+    const int pointCount = points.size() + (closePolygon ? 1 : 0);
+    if (pointCount > kMaxXyPoints) {
+        error = QString("element with %1 points exceeds the GDSII limit of %2").arg(pointCount).arg(kMaxXyPoints);
+        return false;
+    }
+
+    appendRecordHeader(out, kXy, pointCount * 8);
+    for (int i = 0; i < pointCount; ++i) {
+        const WorldPoint& point = points[i % points.size()];
+        if (!fitsInt32(point.x) || !fitsInt32(point.y)) {
+            error = QString("coordinate (%1, %2) does not fit GDSII's 32-bit range").arg(point.x).arg(point.y);
+            return false;
+        }
+        appendI32(out, static_cast<qint32>(point.x));
+        appendI32(out, static_cast<qint32>(point.y));
+    }
+    return true;
+}
+
+bool appendLayerRecords(QByteArray& out, const LayoutObjectModel& object, QString& error) {
+    quint32 layerNameId = 0;
+    quint32 layerTypeId = 0;
+    object.tryGetLayer(layerNameId, layerTypeId);
+    if (layerNameId > 0xffff || layerTypeId > 0xffff) {
+        error = QString("layer %1/%2 does not fit GDSII's 16-bit layer numbers").arg(layerNameId).arg(layerTypeId);
+        return false;
+    }
+
+    appendU16Record(out, kLayer, static_cast<quint16>(layerNameId));
+    appendU16Record(out, kDataType, static_cast<quint16>(layerTypeId));
+    return true;
+}
+
+bool appendBoundary(QByteArray& out, const LayoutObjectModel& object, const QVector<WorldPoint>& vertices, QString& error) {
+    appendEmptyRecord(out, kBoundary);
+    if (!appendLayerRecords(out, object, error) || !appendXyRecord(out, vertices, true, error)) {
+        return false;
+    }
+    appendEmptyRecord(out, kEndEl);
+    return true;
+}
+
+bool appendPath(QByteArray& out, const PathObjectModel& path, QString& error) {
+    if (!fitsInt32(path.width()) || !fitsInt32(path.beginExtension()) || !fitsInt32(path.endExtension())) {
+        error = QString("path width or extension does not fit GDSII's 32-bit range");
+        return false;
+    }
+
+    appendEmptyRecord(out, kPath);
+    if (!appendLayerRecords(out, path, error)) {
+        return false;
+    }
+
+    const qint64 halfWidth = path.width() / 2;
+    if (path.beginExtension() == 0 && path.endExtension() == 0) {
+        appendU16Record(out, kPathType, 0);
+    } else if (path.beginExtension() == halfWidth && path.endExtension() == halfWidth) {
+        appendU16Record(out, kPathType, 2);
+    } else {
+        appendU16Record(out, kPathType, 4);
+    }
+    appendI32Record(out, kWidth, static_cast<qint32>(path.width()));
+    if (path.beginExtension() != 0 || path.endExtension() != 0) {
+        if (path.beginExtension() != halfWidth || path.endExtension() != halfWidth) {
+            appendI32Record(out, kBgnExtn, static_cast<qint32>(path.beginExtension()));
+            appendI32Record(out, kEndExtn, static_cast<qint32>(path.endExtension()));
+        }
+    }
+    if (!appendXyRecord(out, path.points(), false, error)) {
+        return false;
+    }
+    appendEmptyRecord(out, kEndEl);
+    return true;
+}
+
+bool appendInstance(QByteArray& out, const InstanceObjectModel& instance, const QByteArray& masterName, QString& error) {
+    const bool isArray = instance.columns() != 1 || instance.rows() != 1;
+    if (isArray && (instance.columns() > 0x7fff || instance.rows() > 0x7fff)) {
+        error = QString("array of %1 x %2 exceeds GDSII's 16-bit COLROW")
+                    .arg(instance.columns())
+                    .arg(instance.rows());
+        return false;
+    }
+
+    const LayoutTransform& transform = instance.transform();
+    appendEmptyRecord(out, isArray ? kAref : kSref);
+    appendStringRecord(out, kSname, masterName);
+    if (transform.mirrorX || transform.magnification != 1.0 || transform.angleDegrees != 0.0) {
+        appendU16Record(out, kStrans, transform.mirrorX ? kStransReflect : 0);
+        if (transform.magnification != 1.0) {
+            appendReal8Record(out, kMag, transform.magnification);
+        }
+        if (transform.angleDegrees != 0.0) {
+            appendReal8Record(out, kAngle, transform.angleDegrees);
+        }
+    }
+
+    QVector<WorldPoint> points{WorldPoint{transform.originX, transform.originY}};
+    if (isArray) {
+        appendRecordHeader(out, kColRow, 4);
+        appendU16(out, static_cast<quint16>(instance.columns()));
+        appendU16(out, static_cast<quint16>(instance.rows()));
+        // Displacements after all columns / all rows.
+        points.push_back(WorldPoint{transform.originX + instance.columns() * instance.columnStep().x,
+                                    transform.originY + instance.columns() * instance.columnStep().y});
+        points.push_back(WorldPoint{transform.originX + instance.rows() * instance.rowStep().x,
+                                    transform.originY + instance.rows() * instance.rowStep().y});
+    }
+    if (!appendXyRecord(out, points, false, error)) {
+        return false;
+    }
+    appendEmptyRecord(out, kEndEl);
+    return true;
+}
+
+// One cell as it will be written. objects is captured on the calling thread
+// so workers never touch the scene nodes (lazy cells load on access); the
+// save holds a query scope so no lazy cell is evicted meanwhile.
+struct CellEntry {
+    const LayoutSceneNode* node{nullptr};
+    const LayoutObjectList* objects{nullptr};
+    QByteArray name;
+};
+
+// A slice of one cell's objects; the first and last chunk of a cell also
+// carry its BGNSTR/STRNAME and ENDSTR.
+struct CellChunk {
+    int cellIndex{0};
+    int firstObject{0};
+    int objectCount{0};
+    bool first{false};
+    bool last{false};
+};
+
+class GdsCellCollector {
+public:
+    explicit GdsCellCollector(const QString& topCellName) : m_topCellName(topCellName) {}
+
+    void collect(const LayoutSceneNode& root);
+
+    const std::vector<CellEntry>& cells() const { return m_cells; }
+    const QHash<const LayoutSceneNode*, int>& cellIndexByNode() const { return m_cellIndexByNode; }
+
+private:
+    void visit(const LayoutSceneNode& node, bool isRoot);
+    QByteArray uniqueName(const QString& name);
+
+    QString m_topCellName;
+    std::vector<CellEntry> m_cells;
+    QHash<const LayoutSceneNode*, int> m_cellIndexByNode;
+    QSet<QByteArray> m_usedNames;
+};
+
+void GdsCellCollector::collect(const LayoutSceneNode& root) {
+    visit(root, true);
+}
+
+void GdsCellCollector::visit(const LayoutSceneNode& node, const bool isRoot) {
+    if (m_cellIndexByNode.contains(&node)) {
+        return;
+    }
+
+    // Reserve the slot so a shared master reached twice is written once.
+    m_cellIndexByNode.insert(&node, -1);
+    const LayoutObjectList& objects = node.objects();
+    for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+        if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(object.get())) {
+            if (instance->master()) {
+                visit(*instance->master(), false);
+            }
+        }
+    }
+
+    CellEntry entry;
+    entry.node = &node;
+    entry.objects = &objects;
+    entry.name = uniqueName(isRoot && node.name().isEmpty() ? m_topCellName : node.name());
+    m_cellIndexByNode[&node] = static_cast<int>(m_cells.size());
+    m_cells.push_back(entry);
+}
+
+QByteArray GdsCellCollector::uniqueName(const QString& name) {
+    const QByteArray base = (name.isEmpty() ? QString("CELL") : name).toUtf8();
+    QByteArray candidate = base;
+    for (int suffix = 1; m_usedNames.contains(candidate); ++suffix) {
+        candidate = base + "_" + QByteArray::number(suffix);
+    }
+    m_usedNames.insert(candidate);
+    return candidate;
+}
+
+bool encodeChunk(const CellChunk& chunk,
+                 const std::vector<CellEntry>& cells,
+                 const QHash<const LayoutSceneNode*, int>& cellIndexByNode,
+                 const QDateTime& now,
+                 QByteArray& out,
+                 QString& error) {
+    const CellEntry& cell = cells[chunk.cellIndex];
+    if (chunk.first) {
+        appendTimestampRecord(out, kBgnStr, now);
+        appendStringRecord(out, kStrName, cell.name);
+    }
+
+    for (int i = chunk.firstObject; i < chunk.firstObject + chunk.objectCount; ++i) {
+        const LayoutObjectModel* object = (*cell.objects)[i].get();
+        bool ok = true;
+        if (!object) {
+            continue;
+        } else if (const DrawnRectangle* rectangle = object->asRectangle()) {
+            const QVector<WorldPoint> corners{WorldPoint{rectangle->x1, rectangle->y1},
+                                              WorldPoint{rectangle->x2, rectangle->y1},
+                                              WorldPoint{rectangle->x2, rectangle->y2},
+                                              WorldPoint{rectangle->x1, rectangle->y2}};
+            ok = appendBoundary(out, *object, corners, error);
+        } else if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(object)) {
+            ok = appendBoundary(out, *object, polygon->vertices(), error);
+        } else if (const auto* path = dynamic_cast<const PathObjectModel*>(object)) {
+            ok = appendPath(out, *path, error);
+        } else if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(object)) {
+            const int masterIndex = cellIndexByNode.value(instance->master(), -1);
+            if (masterIndex < 0) {
+                error = "instance without a master";
+                ok = false;
+            } else {
+                ok = appendInstance(out, *instance, cells[masterIndex].name, error);
+            }
+        } else {
+            error = "object kind has no GDSII equivalent";
+            ok = false;
+        }
+
+        if (!ok) {
+            error = QString("cell '%1': %2").arg(QString::fromUtf8(cell.name), error);
+            return false;
+        }
+    }
+
+    if (chunk.last) {
+        appendEmptyRecord(out, kEndStr);
+    }
+    return true;
+}
+
+}
+
+namespace GdsStreamWriter {
+
+bool saveFile(const LayoutSceneNode& root,
+              const QString& filePath,
+              const LibraryInfo& library,
+              qint64& outObjectCount,
+              QString& error) {
+    LayoutSceneNode::QueryScope scope;
+    GdsCellCollector collector(library.topCellName);
+    collector.collect(root);
+    const std::vector<CellEntry>& cells = collector.cells();
+
+    std::vector<CellChunk> chunks;
+    qint64 objectCount = 0;
+    for (int cellIndex = 0; cellIndex < static_cast<int>(cells.size()); ++cellIndex) {
+        const int cellObjects = cells[cellIndex].objects->size();
+        objectCount += cellObjects;
+        int firstObject = 0;
+        do {
+            CellChunk chunk;
+            chunk.cellIndex = cellIndex;
+            chunk.firstObject = firstObject;
+            chunk.objectCount = std::min(kObjectsPerChunk, cellObjects - firstObject);
+            chunk.first = firstObject == 0;
+            firstObject += chunk.objectCount;
+            chunk.last = firstObject == cellObjects;
+            chunks.push_back(chunk);
+        } while (firstObject < cellObjects);
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    const QDateTime now = QDateTime::currentDateTime();
+    QByteArray header;
+    appendU16Record(header, kHeader, kStreamVersion);
+    appendTimestampRecord(header, kBgnLib, now);
+    appendStringRecord(header, kLibName, library.libraryName.toUtf8());
+    appendRecordHeader(header, kUnits, 16);
+    appendReal8(header, library.userUnitsPerDatabaseUnit);
+    appendReal8(header, library.metersPerDatabaseUnit);
+
+    const auto writeBuffer = [&file, &filePath, &error](const QByteArray& buffer) {
+        if (file.write(buffer.constData(), buffer.size()) != buffer.size()) {
+            error = QString("cannot write %1: %2").arg(filePath, file.errorString());
+            return false;
+        }
+        return true;
+    };
+    if (!writeBuffer(header)) {
+        file.cancelWriting();
+        return false;
+    }
+
+    const QHash<const LayoutSceneNode*, int>& cellIndexByNode = collector.cellIndexByNode();
+    std::vector<QByteArray> buffers(kChunksPerBatch);
+    std::vector<QString> chunkErrors(kChunksPerBatch);
+    for (size_t batchStart = 0; batchStart < chunks.size(); batchStart += kChunksPerBatch) {
+        const int batchSize = static_cast<int>(std::min<size_t>(kChunksPerBatch, chunks.size() - batchStart));
+        for (int i = 0; i < batchSize; ++i) {
+            buffers[i].clear();
+            chunkErrors[i].clear();
+        }
+        LayoutFileLoader::runParallel(batchSize, [&](const int i) {
+            return encodeChunk(chunks[batchStart + i], cells, cellIndexByNode, now, buffers[i], chunkErrors[i]);
+        });
+
+        // Buffers go out in chunk order, so the file layout does not depend
+        // on worker timing.
+        for (int i = 0; i < batchSize; ++i) {
+            if (!chunkErrors[i].isEmpty()) {
+                error = chunkErrors[i];
+                file.cancelWriting();
+                return false;
+            }
+            if (!writeBuffer(buffers[i])) {
+                file.cancelWriting();
+                return false;
+            }
+        }
+    }
+
+    QByteArray trailer;
+    appendEmptyRecord(trailer, kEndLib);
+    if (!writeBuffer(trailer)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        error = QString("cannot write %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    outObjectCount = objectCount;
+    return true;
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QString>
+
+class LayoutSceneNode;
+
+// GdsStreamWriter saves a cell hierarchy as a GDSII stream.
+//
+// Cells are collected bottom-up from the root through instance masters and
+// split into chunks of at most a few thousand objects. Chunks are encoded
+// in parallel on the LayoutFileLoader worker pool, a bounded batch at a
+// time, and each batch is written in order before the next one starts, so
+// the output is never held in memory as a whole.
+//
+// Mapping (the inverse of GdsStreamReader):
+//  - RectangleObjectModel / PolygonObjectModel -> BOUNDARY
+//  - PathObjectModel     -> PATH (type 0, 2 or 4 from its end extensions)
+//  - InstanceObjectModel -> SREF, or AREF for arrays
+//
+// GDSII limits (32-bit coordinates, 16-bit layers and array counts, 8191
+// points per XY record) are checked and reported as errors.
+namespace GdsStreamWriter {
+
+struct LibraryInfo {
+    QString libraryName{"LAYOUT2"};
+    // Name of the root cell when the root node itself has none.
+    QString topCellName{"TOP"};
+    double userUnitsPerDatabaseUnit{0.001};
+    double metersPerDatabaseUnit{1e-9};
+};
+
+// Cell names are made unique with a numeric suffix where needed.
+bool saveFile(const LayoutSceneNode& root,
+              const QString& filePath,
+              const LibraryInfo& library,
+              qint64& outObjectCount,
+              QString& error);
+
+}
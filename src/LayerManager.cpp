@@ -190,14 +190,24 @@ bool LayerManager::layerByNameAndType(const QString& layerName,
                                       const QString& layerType,
                                       LayerDefinition& layer,
                                       QString& error) const {
-    const int index = findLayerIndex(layerName, layerType);
-    if (index < 0) {
-        error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
-        return false;
+    return findLayer(m_layers, layerName, layerType, layer, error);
+}
+
+bool LayerManager::findLayer(const QVector<LayerDefinition>& layers,
+                             const QString& layerName,
+                             const QString& layerType,
+                             LayerDefinition& layer,
+                             QString& error) {
+    for (const LayerDefinition& candidate : layers) {
+        if (candidate.name.compare(layerName, Qt::CaseInsensitive) == 0
+            && candidate.type.compare(layerType, Qt::CaseInsensitive) == 0) {
+            layer = candidate;
+            return true;
+        }
     }
 
-    layer = m_layers[index];
-    return true;
+    error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
+    return false;
 }
 
 QString LayerManager::serializeLayers() const {
@@ -207,7 +217,7 @@ QString LayerManager::serializeLayers() const {
     for (int i = 0; i < m_layers.size(); ++i) {
         const LayerDefinition& layer = m_layers[i];
         const QString activeMark = i == m_activeLayerIndex ? "active" : "inactive";
-        out += QString("%1 {%2} %3/%4 %5 %6 %7 %8\n")
+        out += QString("%1 {%2} %3/%4 %5 %6 %7 %8 %9\n")
                    .arg(layer.name, layer.type)
                    .arg(layer.nameId)
                    .arg(layer.typeId)
@@ -62,6 +62,14 @@ public:
                             LayerDefinition& layer,
                             QString& error) const;
 
+    // Same lookup on a copy of the palette, for code that cannot reach the
+    // manager (e.g. background script threads).
+    static bool findLayer(const QVector<LayerDefinition>& layers,
+                          const QString& layerName,
+                          const QString& layerType,
+                          LayerDefinition& layer,
+                          QString& error);
+
     // Produces a textual snapshot used by Tcl `layer list`.
     QString serializeLayers() const;
 
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+#include <algorithm>
+#include <utility>
+
+// Copy-on-write containers behind LayoutSceneNode. Elements live in
+// implicitly shared blocks, so copying a container only copies the block
+// handles, and a later write to either copy duplicates just the blocks it
+// touches. Qt's reference counts are atomic: a copy can be read on another
+// thread while the original keeps changing.
+//
+// Lookups are const-only; every non-const member may detach a block, so
+// readers of a shared copy must stay on the const API.
+
+// Sequence stored in fixed-size chunks. Every chunk but the last is full,
+// so an index maps to its chunk with a shift.
+template <typename T>
+class LayoutChunkedVector {
+public:
+    static constexpr int kChunkShift = 12;
+    static constexpr int kChunkSize = 1 << kChunkShift;
+    static constexpr int kChunkMask = kChunkSize - 1;
+
+    class const_iterator {
+    public:
+        const_iterator(const LayoutChunkedVector* vector, const int index)
+            : m_vector(vector), m_index(index) {}
+
+        const T& operator*() const { return (*m_vector)[m_index]; }
+        const T* operator->() const { return &(*m_vector)[m_index]; }
+        const_iterator& operator++() {
+            ++m_index;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+
+    private:
+        const LayoutChunkedVector* m_vector{nullptr};
+        int m_index{0};
+    };
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    const T& operator[](const int index) const {
+        return m_chunks.at(index >> kChunkShift).at(index & kChunkMask);
+    }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    // Detaches the element's chunk.
+    T& mutableAt(const int index) { return m_chunks[index >> kChunkShift][index & kChunkMask]; }
+
+    void reserve(const int size) { m_chunks.reserve((size + kChunkMask) >> kChunkShift); }
+
+    void push_back(T value) {
+        if ((m_size & kChunkMask) == 0) {
+            m_chunks.push_back(QVector<T>());
+        }
+        m_chunks.last().push_back(std::move(value));
+        ++m_size;
+    }
+
+    void removeAt(const int index) {
+        for (int i = index; i + 1 < m_size; ++i) {
+            mutableAt(i) = std::move(mutableAt(i + 1));
+        }
+        truncate(m_size - 1);
+    }
+
+    // Drops the elements from size on; chunks past the new end are released
+    // without being detached.
+    void truncate(const int size) {
+        if (size >= m_size) {
+            return;
+        }
+        m_chunks.resize((size + kChunkMask) >> kChunkShift);
+        if ((size & kChunkMask) != 0) {
+            m_chunks.last().resize(size & kChunkMask);
+        }
+        m_size = size;
+    }
+
+    void clear() {
+        m_chunks.clear();
+        m_size = 0;
+    }
+
+    QVector<T> toVector() const {
+        QVector<T> out;
+        out.reserve(m_size);
+        for (const QVector<T>& chunk : m_chunks) {
+            out.append(chunk);
+        }
+        return out;
+    }
+
+private:
+    QVector<QVector<T>> m_chunks;
+    int m_size{0};
+};
+
+// Hash keyed by quint64, split into shards by ShardKey::of(key) and kept as
+// a vector of shards sorted by shard key. Keys that are close in the
+// caller's sense (consecutive object IDs, neighbouring tiles) should map to
+// the same shard so an edit detaches as little as possible.
+template <typename V, typename ShardKey>
+class LayoutShardedHash {
+public:
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    int shardCount() const { return m_shards.size(); }
+
+    const V* find(const quint64 key) const {
+        const int shardIndex = indexOfShard(ShardKey::of(key));
+        if (shardIndex < 0) {
+            return nullptr;
+        }
+        const QHash<quint64, V>& shard = m_shards.at(shardIndex).second;
+        const auto it = shard.constFind(key);
+        return it == shard.cend() ? nullptr : &it.value();
+    }
+
+    bool contains(const quint64 key) const { return find(key) != nullptr; }
+
+    // Visits every entry as visitor(key, value) until it returns false;
+    // returns false when stopped.
+    template <typename Visitor>
+    bool forEach(Visitor&& visitor) const {
+        for (const QPair<quint64, QHash<quint64, V>>& shard : m_shards) {
+            for (auto it = shard.second.cbegin(); it != shard.second.cend(); ++it) {
+                if (!visitor(it.key(), it.value())) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Entry for key, default-constructed when missing (as QHash::operator[]).
+    V& operator[](const quint64 key) {
+        QHash<quint64, V>& shard = shardFor(key);
+        const int sizeBefore = shard.size();
+        V& value = shard[key];
+        m_size += shard.size() - sizeBefore;
+        return value;
+    }
+
+    void insert(const quint64 key, V value) { (*this)[key] = std::move(value); }
+
+    // Detaches nothing when key is absent.
+    bool remove(const quint64 key) {
+        const int shardIndex = indexOfShard(ShardKey::of(key));
+        if (shardIndex < 0 || !m_shards.at(shardIndex).second.contains(key)) {
+            return false;
+        }
+        QHash<quint64, V>& shard = m_shards[shardIndex].second;
+        shard.remove(key);
+        --m_size;
+        if (shard.isEmpty()) {
+            m_shards.removeAt(shardIndex);
+        }
+        return true;
+    }
+
+    void clear() {
+        m_shards.clear();
+        m_size = 0;
+    }
+
+private:
+    int lowerBound(const quint64 shardKey) const {
+        const auto it = std::lower_bound(m_shards.cbegin(), m_shards.cend(), shardKey,
+                                         [](const QPair<quint64, QHash<quint64, V>>& shard, const quint64 value) {
+                                             return shard.first < value;
+                                         });
+        return static_cast<int>(it - m_shards.cbegin());
+    }
+
+    int indexOfShard(const quint64 shardKey) const {
+        const int index = lowerBound(shardKey);
+        return index < m_shards.size() && m_shards.at(index).first == shardKey ? index : -1;
+    }
+
+    QHash<quint64, V>& shardFor(const quint64 key) {
+        const quint64 shardKey = ShardKey::of(key);
+        const int index = lowerBound(shardKey);
+        if (index == m_shards.size() || m_shards.at(index).first != shardKey) {
+            m_shards.insert(index, qMakePair(shardKey, QHash<quint64, V>()));
+        }
+        return m_shards[index].second;
+    }
+
+    QVector<QPair<quint64, QHash<quint64, V>>> m_shards;
+    int m_size{0};
+};
+
+// Object IDs come from one counter, so objects added together fill the same
+// few shards.
+struct LayoutObjectIdShardKey {
+    static quint64 of(const quint64 objectId) { return objectId >> 10; }
+};
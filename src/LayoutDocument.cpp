@@ -0,0 +1,364 @@
+#include "LayoutDocument.h"
+
+#include "GdsStreamWriter.h"
+#include "LayoutEditJournal.h"
+#include "LayoutFileLoader.h"
+#include "LayoutSnapshot.h"
+#include "LayoutUndoStack.h"
+
+#include <QFileInfo>
+#include <algorithm>
+
+namespace {
+
+QVector<quint64> objectIdsOf(const QVector<std::shared_ptr<LayoutObjectModel>>& objects) {
+    QVector<quint64> objectIds;
+    objectIds.reserve(objects.size());
+    for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+        objectIds.push_back(object->objectId());
+    }
+    return objectIds;
+}
+
+void uniteBounds(const QVector<std::shared_ptr<LayoutObjectModel>>& objects,
+                 LayoutObjectModel::Bounds& bounds,
+                 bool& hasBounds) {
+    for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+        LayoutObjectModel::Bounds objectBounds;
+        if (!object->tryGetBounds(objectBounds)) {
+            continue;
+        }
+        if (!hasBounds) {
+            bounds = objectBounds;
+            hasBounds = true;
+            continue;
+        }
+        bounds.minX = std::min(bounds.minX, objectBounds.minX);
+        bounds.minY = std::min(bounds.minY, objectBounds.minY);
+        bounds.maxX = std::max(bounds.maxX, objectBounds.maxX);
+        bounds.maxY = std::max(bounds.maxY, objectBounds.maxY);
+    }
+}
+
+}
+
+LayoutDocument::LayoutDocument(QObject* parent)
+    : QObject(parent),
+      m_rootCell(std::make_unique<LayoutSceneNode>()),
+      m_undoStack(std::make_unique<LayoutUndoStack>()) {}
+
+LayoutDocument::~LayoutDocument() = default;
+
+const LayoutSceneNode* LayoutDocument::rootCell() const {
+    return m_rootCell.get();
+}
+
+void LayoutDocument::addObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects) {
+    if (objects.isEmpty()) {
+        return;
+    }
+
+    if (m_inTransaction) {
+        for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+            m_pendingAddedIds.insert(object->objectId());
+        }
+        m_pendingAdded += objects;
+        return;
+    }
+    applyEdit(std::move(objects), {});
+}
+
+int LayoutDocument::removeObjects(const QVector<quint64>& objectIds) {
+    if (objectIds.isEmpty()) {
+        return 0;
+    }
+
+    if (!m_inTransaction) {
+        return applyEdit({}, objectIds);
+    }
+
+    // Objects added in this transaction are simply not inserted; committed
+    // ones are removed at commit.
+    int removed = 0;
+    for (const quint64 objectId : objectIds) {
+        if (m_pendingAddedIds.remove(objectId)) {
+            ++removed;
+        } else if (!m_pendingRemovedIdSet.contains(objectId) && m_rootCell->findObjectById(objectId)) {
+            m_pendingRemovedIdSet.insert(objectId);
+            m_pendingRemovedIds.push_back(objectId);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+bool LayoutDocument::beginTransaction() {
+    if (m_inTransaction) {
+        return false;
+    }
+
+    m_inTransaction = true;
+    return true;
+}
+
+bool LayoutDocument::inTransaction() const {
+    return m_inTransaction;
+}
+
+LayoutDocument::TransactionCounts LayoutDocument::transactionCounts() const {
+    TransactionCounts counts;
+    counts.added = m_pendingAddedIds.size();
+    counts.removed = m_pendingRemovedIds.size();
+    return counts;
+}
+
+LayoutDocument::TransactionCounts LayoutDocument::commitTransaction() {
+    if (!m_inTransaction) {
+        return {};
+    }
+
+    QVector<std::shared_ptr<LayoutObjectModel>> added;
+    added.reserve(m_pendingAddedIds.size());
+    for (std::shared_ptr<LayoutObjectModel>& object : m_pendingAdded) {
+        if (m_pendingAddedIds.contains(object->objectId())) {
+            added.push_back(std::move(object));
+        }
+    }
+    const QVector<quint64> removedIds = std::move(m_pendingRemovedIds);
+    abortTransaction();
+
+    TransactionCounts counts;
+    counts.added = added.size();
+    counts.removed = applyEdit(std::move(added), removedIds);
+    return counts;
+}
+
+LayoutDocument::TransactionCounts LayoutDocument::abortTransaction() {
+    const TransactionCounts counts = transactionCounts();
+    m_inTransaction = false;
+    m_pendingAdded = {};
+    m_pendingAddedIds = {};
+    m_pendingRemovedIds = {};
+    m_pendingRemovedIdSet = {};
+    return counts;
+}
+
+int LayoutDocument::undoEdits(const int count) {
+    if (m_inTransaction) {
+        return 0;
+    }
+
+    int applied = 0;
+    QVector<std::shared_ptr<LayoutObjectModel>> added;
+    QVector<std::shared_ptr<LayoutObjectModel>> removed;
+    LayoutUndoStack::Change change;
+    while (applied < count && m_undoStack->undo(*m_rootCell, change)) {
+        journalEdit(change.added, change.removed);
+        added += change.added;
+        removed += change.removed;
+        ++applied;
+    }
+    if (applied > 0) {
+        notifyObjectsChanged(added, removed);
+        compactAutosaveIfDue();
+    }
+    return applied;
+}
+
+int LayoutDocument::redoEdits(const int count) {
+    if (m_inTransaction) {
+        return 0;
+    }
+
+    int applied = 0;
+    QVector<std::shared_ptr<LayoutObjectModel>> added;
+    QVector<std::shared_ptr<LayoutObjectModel>> removed;
+    LayoutUndoStack::Change change;
+    while (applied < count && m_undoStack->redo(*m_rootCell, change)) {
+        journalEdit(change.added, change.removed);
+        added += change.added;
+        removed += change.removed;
+        ++applied;
+    }
+    if (applied > 0) {
+        notifyObjectsChanged(added, removed);
+        compactAutosaveIfDue();
+    }
+    return applied;
+}
+
+LayoutUndoStack& LayoutDocument::undoStack() {
+    return *m_undoStack;
+}
+
+bool LayoutDocument::openLayout(const QString& filePath,
+                                const bool lazyCells,
+                                QString& outSummary,
+                                QString& error) {
+    LayoutLoadResult result;
+    if (!LayoutFileLoader::loadFile(filePath, result, error, lazyCells)) {
+        return false;
+    }
+
+    // The top cells' own objects are adopted by the new root so their
+    // shapes and placements stay individually selectable; deeper levels are
+    // shared through instance masters.
+    auto rootCell = std::make_unique<LayoutSceneNode>();
+    for (const std::shared_ptr<LayoutSceneNode>& topCell : result.topCells) {
+        rootCell->addObjects(topCell->objects().toVector());
+    }
+
+    m_libraryName = result.libraryName;
+    m_userUnitsPerDatabaseUnit = result.userUnitsPerDatabaseUnit;
+    m_metersPerDatabaseUnit = result.metersPerDatabaseUnit;
+    replaceRootCell(std::move(rootCell));
+
+    outSummary = QString("%1 %2: %3 cells, %4 objects, %5 top cells, %6 skipped elements")
+                     .arg(result.formatName)
+                     .arg(result.libraryName.isEmpty() ? filePath : result.libraryName)
+                     .arg(result.cellCount)
+                     .arg(result.objectCount)
+                     .arg(result.topCells.size())
+                     .arg(result.skippedElementCount);
+    if (result.lazyCells) {
+        outSummary += ", cells load on demand";
+    }
+    return true;
+}
+
+bool LayoutDocument::saveLayout(const QString& filePath, QString& outSummary, QString& error) const {
+    qint64 objectCount = 0;
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "gds" || suffix == "gds2" || suffix == "gdsii") {
+        GdsStreamWriter::LibraryInfo library;
+        if (!m_libraryName.isEmpty()) {
+            library.libraryName = m_libraryName;
+        }
+        library.userUnitsPerDatabaseUnit = m_userUnitsPerDatabaseUnit;
+        library.metersPerDatabaseUnit = m_metersPerDatabaseUnit;
+        if (!GdsStreamWriter::saveFile(*m_rootCell, filePath, library, objectCount, error)) {
+            return false;
+        }
+    } else if (!LayoutSnapshot::saveFile(*m_rootCell, filePath, objectCount, error)) {
+        return false;
+    }
+
+    outSummary = QString("saved %1 objects to %2").arg(objectCount).arg(filePath);
+    return true;
+}
+
+bool LayoutDocument::tryGetLayoutBounds(qint64& minX, qint64& minY, qint64& maxX, qint64& maxY) const {
+    LayoutObjectModel::Bounds bounds;
+    if (!m_rootCell->tryGetBounds(bounds)) {
+        return false;
+    }
+
+    minX = bounds.minX;
+    minY = bounds.minY;
+    maxX = bounds.maxX;
+    maxY = bounds.maxY;
+    return true;
+}
+
+bool LayoutDocument::startAutosave(const QString& basePath, QString& error) {
+    auto journal = std::make_unique<LayoutEditJournal>();
+    if (!journal->start(basePath, *m_rootCell, error)) {
+        return false;
+    }
+
+    m_journal = std::move(journal);
+    return true;
+}
+
+void LayoutDocument::stopAutosave() {
+    m_journal.reset();
+}
+
+const LayoutEditJournal* LayoutDocument::autosaveJournal() const {
+    return m_journal.get();
+}
+
+bool LayoutDocument::recoverLayout(const QString& basePath, QString& outSummary, QString& error) {
+    std::unique_ptr<LayoutSceneNode> rootCell;
+    LayoutEditJournal::RecoveryStats stats;
+    if (!LayoutEditJournal::recover(basePath, rootCell, stats, error)) {
+        return false;
+    }
+
+    replaceRootCell(std::move(rootCell));
+
+    outSummary = QString("recovered generation %1: %2 snapshot objects, %3 journal records, %4 added, %5 removed")
+                     .arg(stats.generation)
+                     .arg(stats.snapshotObjectCount)
+                     .arg(stats.recordCount)
+                     .arg(stats.addedObjectCount)
+                     .arg(stats.removedObjectCount);
+    if (stats.damagedTail) {
+        outSummary += ", damaged tail ignored";
+    }
+    return true;
+}
+
+void LayoutDocument::replaceRootCell(std::unique_ptr<LayoutSceneNode> rootCell) {
+    // Buffered edits refer to objects of the old root.
+    abortTransaction();
+    m_rootCell = std::move(rootCell);
+    m_undoStack->clear();
+    if (m_journal) {
+        // The journal's IDs refer to the old root; a failure is kept in its
+        // status.
+        m_journal->compact(m_rootCell->snapshot());
+    }
+    emit rootCellReplaced();
+}
+
+int LayoutDocument::applyEdit(QVector<std::shared_ptr<LayoutObjectModel>> added,
+                              const QVector<quint64>& removedObjectIds) {
+    // One batched removal keeps large deletions linear in the cell size.
+    QVector<std::shared_ptr<LayoutObjectModel>> removedObjects;
+    const int removed = removedObjectIds.isEmpty()
+                            ? 0
+                            : m_rootCell->removeObjectsByIds(removedObjectIds, &removedObjects);
+    if (added.isEmpty() && removed == 0) {
+        return 0;
+    }
+
+    if (!added.isEmpty()) {
+        m_rootCell->addObjects(added);
+    }
+    journalEdit(added, removedObjects);
+    notifyObjectsChanged(added, removedObjects);
+    m_undoStack->record(std::move(added), std::move(removedObjects));
+    compactAutosaveIfDue();
+    return removed;
+}
+
+void LayoutDocument::journalEdit(const QVector<std::shared_ptr<LayoutObjectModel>>& added,
+                                 const QVector<std::shared_ptr<LayoutObjectModel>>& removed) {
+    if (!m_journal) {
+        return;
+    }
+
+    m_journal->recordRemove(objectIdsOf(removed));
+    // An instance of a master the autosave snapshot lacks cannot be
+    // journaled; compact onto the root as it is now, which includes it.
+    if (!m_journal->recordAdd(added)) {
+        m_journal->compact(m_rootCell->snapshot());
+    }
+}
+
+void LayoutDocument::compactAutosaveIfDue() {
+    if (m_journal && m_journal->compactionDue()) {
+        // Written on the journal's thread; a failure is kept in its status.
+        m_journal->compact(m_rootCell->snapshot());
+    }
+}
+
+void LayoutDocument::notifyObjectsChanged(const QVector<std::shared_ptr<LayoutObjectModel>>& added,
+                                          const QVector<std::shared_ptr<LayoutObjectModel>>& removed) {
+    LayoutObjectModel::Bounds dirtyBounds;
+    bool hasDirtyBounds = false;
+    uniteBounds(added, dirtyBounds, hasDirtyBounds);
+    uniteBounds(removed, dirtyBounds, hasDirtyBounds);
+    emit objectsChanged(objectIdsOf(removed), dirtyBounds, hasDirtyBounds);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+#include "LayoutSceneModel.h"
+
+class LayoutEditJournal;
+class LayoutUndoStack;
+
+// LayoutDocument is one open layout: the root cell with its committed
+// geometry, the library name and units it was read with, its undo history
+// and its autosave journal.
+//
+// Several editor windows may view the same document. Each window keeps only
+// its own view state (pan/zoom, selection, hover, tool) and refreshes from
+// the signals below, so an edit made in one window reaches all of them.
+class LayoutDocument : public QObject {
+    Q_OBJECT
+public:
+    explicit LayoutDocument(QObject* parent = nullptr);
+    ~LayoutDocument() override;
+
+    const LayoutSceneNode* rootCell() const;
+
+    // Edits; each is one undo step and is journaled while autosave is on.
+    void addObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects);
+    // Returns the number of objects removed; unknown IDs are skipped.
+    int removeObjects(const QVector<quint64>& objectIds);
+
+    // Edit transaction: until commit, addObjects() and removeObjects() only
+    // buffer, and rootCell() and its queries keep showing the committed
+    // geometry. Commit applies the buffer as one bulk removal and one bulk
+    // insert: one undo step, one journal batch and one objectsChanged.
+    // Abort drops the buffer without touching the scene. Transactions do
+    // not nest; begin returns false while one is open.
+    struct TransactionCounts {
+        int added{0};
+        int removed{0};
+    };
+    bool beginTransaction();
+    bool inTransaction() const;
+    // Counts of the buffered edits (net of objects added and removed
+    // within the transaction).
+    TransactionCounts transactionCounts() const;
+    TransactionCounts commitTransaction();
+    TransactionCounts abortTransaction();
+
+    // Undo/redo up to count operations; each returns the number applied.
+    // Nothing is applied while a transaction is open.
+    int undoEdits(int count);
+    int redoEdits(int count);
+    LayoutUndoStack& undoStack();
+
+    // Replaces the geometry with the top cells of a GDSII, OASIS or .l2snap
+    // file; an open transaction is aborted. lazyCells defers decoding of placed cells until they are first
+    // queried (GDSII and .l2snap only).
+    // outSummary receives a one-line load report.
+    bool openLayout(const QString& filePath, bool lazyCells, QString& outSummary, QString& error);
+    // Writes the geometry, including every placed master: GDSII for
+    // .gds/.gds2/.gdsii paths, an .l2snap snapshot otherwise. GDSII output
+    // keeps the library name and units of the last opened file.
+    bool saveLayout(const QString& filePath, QString& outSummary, QString& error) const;
+    // Extent of all committed geometry; false when the document is empty.
+    bool tryGetLayoutBounds(qint64& minX, qint64& minY, qint64& maxX, qint64& maxY) const;
+
+    // Autosave: snapshots the geometry under basePath and journals every
+    // later edit (see LayoutEditJournal). Opening a layout re-baselines an
+    // active journal.
+    bool startAutosave(const QString& basePath, QString& error);
+    void stopAutosave();
+    // Null while autosave is off.
+    const LayoutEditJournal* autosaveJournal() const;
+    // Replaces the geometry with basePath's snapshot plus its replayed
+    // journal.
+    bool recoverLayout(const QString& basePath, QString& outSummary, QString& error);
+
+signals:
+    // Objects were added to or removed from the root cell. dirtyBounds is
+    // the union of their bounds (valid when hasDirtyBounds); views repaint
+    // only if it is on screen. removedObjectIds lists objects that no longer
+    // exist.
+    void objectsChanged(const QVector<quint64>& removedObjectIds,
+                        const LayoutObjectModel::Bounds& dirtyBounds,
+                        bool hasDirtyBounds);
+    // The root cell was replaced (open, recover); views drop every object
+    // reference and repaint.
+    void rootCellReplaced();
+
+private:
+    // Installs a freshly loaded root and re-baselines history and journal.
+    void replaceRootCell(std::unique_ptr<LayoutSceneNode> rootCell);
+    // Applies removal, then insertion, as one recorded edit; returns the
+    // number of objects removed.
+    int applyEdit(QVector<std::shared_ptr<LayoutObjectModel>> added, const QVector<quint64>& removedObjectIds);
+    // Records an applied edit in the autosave journal, compacting instead
+    // when the journal cannot reference an added instance's master.
+    void journalEdit(const QVector<std::shared_ptr<LayoutObjectModel>>& added,
+                     const QVector<std::shared_ptr<LayoutObjectModel>>& removed);
+    // Compacts the autosave journal once it has grown enough; called after
+    // every applied edit, undo and redo.
+    void compactAutosaveIfDue();
+    void notifyObjectsChanged(const QVector<std::shared_ptr<LayoutObjectModel>>& added,
+                              const QVector<std::shared_ptr<LayoutObjectModel>>& removed);
+
+    std::unique_ptr<LayoutSceneNode> m_rootCell;
+    QString m_libraryName;
+    double m_userUnitsPerDatabaseUnit{0.001};
+    double m_metersPerDatabaseUnit{1e-9};
+    std::unique_ptr<LayoutEditJournal> m_journal;
+    std::unique_ptr<LayoutUndoStack> m_undoStack;
+
+    // Open transaction: objects to add in order, the IDs among them still
+    // wanted, and committed objects to remove.
+    bool m_inTransaction{false};
+    QVector<std::shared_ptr<LayoutObjectModel>> m_pendingAdded;
+    QSet<quint64> m_pendingAddedIds;
+    QVector<quint64> m_pendingRemovedIds;
+    QSet<quint64> m_pendingRemovedIdSet;
+};
@@ -0,0 +1,774 @@
+#include "LayoutEditJournal.h"
+
+#include "LayoutFileLoader.h"
+#include "LayoutSceneModel.h"
+#include "LayoutSnapshot.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr char kJournalMagic[] = "L2JRNL\r\n";
+constexpr int kJournalMagicLength = sizeof(kJournalMagic) - 1;
+constexpr quint32 kFormatVersion = 1;
+// Written in host order, as in snapshots.
+constexpr quint32 kByteOrderMark = 0x01020304;
+
+// Compaction rewrites the whole design, so it waits until the records
+// outweigh half the snapshot (and this floor); total compaction work then
+// stays proportional to the volume of edits.
+constexpr qint64 kMinCompactionBytes = 16 * 1024 * 1024;
+
+// Master index of an instance whose master is not in the snapshot.
+constexpr quint32 kUnknownCell = ~0u;
+
+enum JournalRecordType : quint32 {
+    kRecordAdd = 1,
+    kRecordRemove = 2
+};
+
+enum JournalObjectKind : quint32 {
+    kKindRectangle = 1,
+    kKindPolygon = 2,
+    kKindPath = 3,
+    kKindInstance = 4
+};
+
+struct JournalHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint64 generation;
+    // Followed by this many object IDs, one per snapshot root object.
+    quint64 baseObjectCount;
+};
+
+struct JournalRecordHeader {
+    quint32 type;
+    // Objects (add) or object IDs (remove) in the payload.
+    quint32 count;
+    quint64 payloadBytes;
+    quint64 checksum;
+};
+
+// Leads every object of an add record; the kind's geometry follows.
+struct JournalObject {
+    quint64 objectId;
+    quint32 kind;
+    quint32 layerNameId;
+    quint32 layerTypeId;
+    // Polygon vertices or path points appended after the fixed part.
+    quint32 pointCount;
+};
+
+struct JournalRectangle {
+    qint64 x1;
+    qint64 y1;
+    qint64 x2;
+    qint64 y2;
+};
+
+struct JournalPath {
+    qint64 width;
+    qint64 beginExtension;
+    qint64 endExtension;
+};
+
+struct JournalInstance {
+    quint32 masterCell;
+    quint32 mirrorX;
+    qint32 columns;
+    qint32 rows;
+    qint64 originX;
+    qint64 originY;
+    double magnification;
+    double angleDegrees;
+    qint64 columnStepX;
+    qint64 columnStepY;
+    qint64 rowStepX;
+    qint64 rowStepY;
+};
+
+static_assert(sizeof(JournalHeader) == 32, "journal header layout");
+static_assert(sizeof(JournalRecordHeader) == 24, "journal record header layout");
+static_assert(sizeof(JournalObject) == 24, "journal object layout");
+static_assert(sizeof(JournalRectangle) == 32, "journal rectangle layout");
+static_assert(sizeof(JournalPath) == 24, "journal path layout");
+static_assert(sizeof(JournalInstance) == 80, "journal instance layout");
+static_assert(sizeof(WorldPoint) == 16, "points are copied as a block");
+
+QString journalPathFor(const QString& basePath) {
+    return basePath + ".l2journal";
+}
+
+QString snapshotPathFor(const QString& basePath, const quint64 generation) {
+    return QString("%1.%2.l2snap").arg(basePath).arg(generation);
+}
+
+// FNV-1a; enough to tell a torn append from a complete one.
+quint64 checksumOf(const char* data, const quint64 size) {
+    quint64 hash = 14695981039346656037ULL;
+    for (quint64 i = 0; i < size; ++i) {
+        hash ^= static_cast<uchar>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename Value>
+void appendValue(QByteArray& out, const Value& value) {
+    static_assert(std::is_trivially_copyable<Value>::value, "journal values are written as bytes");
+    out.append(reinterpret_cast<const char*>(&value), static_cast<int>(sizeof(Value)));
+}
+
+void appendPoints(QByteArray& out, const QVector<WorldPoint>& points) {
+    out.append(reinterpret_cast<const char*>(points.constData()),
+               static_cast<int>(points.size() * sizeof(WorldPoint)));
+}
+
+// Bounds-checked sequential reader over mapped journal bytes.
+class JournalCursor {
+public:
+    JournalCursor(const uchar* data, const quint64 size)
+        : m_data(data), m_size(size) {}
+
+    template <typename Value>
+    bool read(Value& out) {
+        if (sizeof(Value) > remaining()) {
+            return false;
+        }
+        std::memcpy(&out, m_data + m_offset, sizeof(Value));
+        m_offset += sizeof(Value);
+        return true;
+    }
+
+    bool readPoints(const quint32 count, QVector<WorldPoint>& out) {
+        const quint64 bytes = quint64(count) * sizeof(WorldPoint);
+        if (bytes > remaining()) {
+            return false;
+        }
+        out.resize(static_cast<int>(count));
+        std::memcpy(out.data(), m_data + m_offset, bytes);
+        m_offset += bytes;
+        return true;
+    }
+
+    const uchar* current() const { return m_data + m_offset; }
+    quint64 remaining() const { return m_size - m_offset; }
+    void skip(const quint64 bytes) { m_offset += bytes; }
+
+private:
+    const uchar* m_data{nullptr};
+    quint64 m_size{0};
+    quint64 m_offset{0};
+};
+
+// Numbers the masters reachable from node in depth-first, first-visit
+// order. A snapshot keeps paint order, so the live tree and its reloaded
+// copy are numbered alike.
+void numberCells(const LayoutSceneNode& node,
+                 QHash<const LayoutSceneNode*, quint32>& indexByNode,
+                 QVector<std::shared_ptr<const LayoutSceneNode>>* outMasters) {
+    for (const std::shared_ptr<LayoutObjectModel>& object : node.objects()) {
+        const auto* instance = dynamic_cast<const InstanceObjectModel*>(object.get());
+        if (!instance || indexByNode.contains(instance->master())) {
+            continue;
+        }
+
+        indexByNode.insert(instance->master(), static_cast<quint32>(indexByNode.size()));
+        if (outMasters) {
+            outMasters->push_back(instance->sharedMaster());
+        }
+        numberCells(*instance->master(), indexByNode, outMasters);
+    }
+}
+
+bool decodeObject(JournalCursor& cursor,
+                  const QVector<std::shared_ptr<const LayoutSceneNode>>& masters,
+                  quint64& outObjectId,
+                  std::shared_ptr<LayoutObjectModel>& outObject) {
+    JournalObject header{};
+    if (!cursor.read(header)) {
+        return false;
+    }
+
+    outObjectId = header.objectId;
+    if (header.kind == kKindRectangle) {
+        JournalRectangle record{};
+        if (!cursor.read(record)) {
+            return false;
+        }
+        outObject = std::make_shared<RectangleObjectModel>(DrawnRectangle{
+            header.layerNameId, header.layerTypeId, record.x1, record.y1, record.x2, record.y2});
+        return true;
+    }
+    if (header.kind == kKindPolygon) {
+        QVector<WorldPoint> vertices;
+        if (!cursor.readPoints(header.pointCount, vertices)) {
+            return false;
+        }
+        outObject = std::make_shared<PolygonObjectModel>(header.layerNameId, header.layerTypeId, std::move(vertices));
+        return true;
+    }
+    if (header.kind == kKindPath) {
+        JournalPath record{};
+        QVector<WorldPoint> points;
+        if (!cursor.read(record) || !cursor.readPoints(header.pointCount, points)) {
+            return false;
+        }
+        outObject = std::make_shared<PathObjectModel>(header.layerNameId,
+                                                      header.layerTypeId,
+                                                      std::move(points),
+                                                      record.width,
+                                                      record.beginExtension,
+                                                      record.endExtension);
+        return true;
+    }
+    if (header.kind == kKindInstance) {
+        JournalInstance record{};
+        if (!cursor.read(record) || record.masterCell >= static_cast<quint32>(masters.size())) {
+            return false;
+        }
+        LayoutTransform transform;
+        transform.originX = record.originX;
+        transform.originY = record.originY;
+        transform.magnification = record.magnification;
+        transform.angleDegrees = record.angleDegrees;
+        transform.mirrorX = record.mirrorX != 0;
+        outObject = std::make_shared<InstanceObjectModel>(masters[static_cast<int>(record.masterCell)],
+                                                          transform,
+                                                          record.columns,
+                                                          record.rows,
+                                                          WorldPoint{record.columnStepX, record.columnStepY},
+                                                          WorldPoint{record.rowStepX, record.rowStepY});
+        return true;
+    }
+    return false;
+}
+
+}
+
+LayoutEditJournal::LayoutEditJournal() = default;
+
+LayoutEditJournal::~LayoutEditJournal() {
+    stop();
+}
+
+bool LayoutEditJournal::start(const QString& basePath, const LayoutSceneNode& root, QString& error) {
+    stop();
+
+    // Continue the generation count of a journal already at basePath so its
+    // snapshot is replaced rather than reused.
+    m_basePath = basePath;
+    m_generation = 0;
+    QFile existing(journalPathFor(basePath));
+    if (existing.open(QIODevice::ReadOnly)) {
+        const QByteArray bytes = existing.read(sizeof(JournalHeader));
+        JournalHeader header{};
+        if (bytes.size() == int(sizeof(JournalHeader))) {
+            std::memcpy(&header, bytes.constData(), sizeof(JournalHeader));
+            if (std::memcmp(header.magic, kJournalMagic, kJournalMagicLength) == 0
+                && header.byteOrderMark == kByteOrderMark) {
+                m_generation = header.generation;
+            }
+        }
+        existing.close();
+    }
+
+    m_compactionForced = false;
+    m_queuedCompactions = 0;
+    if (!writeGeneration(root, error)) {
+        m_basePath.clear();
+        return false;
+    }
+
+    m_stopping = false;
+    m_writer = std::thread(&LayoutEditJournal::writerLoop, this);
+    return true;
+}
+
+void LayoutEditJournal::stop() {
+    if (!m_writer.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_writer.join();
+    m_file.reset();
+}
+
+bool LayoutEditJournal::isActive() const {
+    return m_writer.joinable();
+}
+
+bool LayoutEditJournal::recordAdd(const QVector<std::shared_ptr<LayoutObjectModel>>& objects) {
+    if (!isActive() || objects.isEmpty()) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_writeFailed) {
+            return true;
+        }
+
+        // A master the snapshot does not hold cannot be referenced on
+        // replay. While a compaction is queued the snapshot the record will
+        // follow is not numbered yet, so any instance is refused then too.
+        for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+            const auto* instance = dynamic_cast<const InstanceObjectModel*>(object.get());
+            if (instance && (m_queuedCompactions > 0 || !m_cellIndexByNode.contains(instance->master()))) {
+                return false;
+            }
+        }
+
+        PendingRecord record;
+        record.type = kRecordAdd;
+        record.objects = objects;
+        m_queue.push_back(std::move(record));
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void LayoutEditJournal::recordRemove(const QVector<quint64>& objectIds) {
+    if (!isActive() || objectIds.isEmpty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_writeFailed) {
+            return;
+        }
+        PendingRecord record;
+        record.type = kRecordRemove;
+        record.objectIds = objectIds;
+        m_queue.push_back(std::move(record));
+    }
+    m_wake.notify_one();
+}
+
+bool LayoutEditJournal::compactionDue() const {
+    if (!isActive()) {
+        return false;
+    }
+
+    // Queued records are not counted yet; they are at most one batch behind.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queuedCompactions > 0) {
+        return false;
+    }
+    return m_compactionForced || (!m_writeFailed && m_journalBytes >= m_compactionThreshold);
+}
+
+void LayoutEditJournal::compact(std::shared_ptr<const LayoutSceneNode> root) {
+    if (!isActive() || !root) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_queuedCompactions;
+        PendingRecord request;
+        request.compactionRoot = std::move(root);
+        m_queue.push_back(std::move(request));
+    }
+    m_wake.notify_one();
+}
+
+bool LayoutEditJournal::writeGeneration(const LayoutSceneNode& root, QString& error) {
+    m_file.reset();
+
+    const quint64 generation = m_generation + 1;
+    const QString snapshotPath = snapshotPathFor(m_basePath, generation);
+    const QString journalPath = journalPathFor(m_basePath);
+    // On failure the previous generation stays valid: keep appending to it
+    // and retry once the journal has grown by the minimum again.
+    const auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_lastError = error;
+            m_compactionThreshold = m_journalBytes + kMinCompactionBytes;
+            m_compactionForced = false;
+        }
+        QString reopenError;
+        if (m_generation > 0) {
+            openForAppend(reopenError);
+        }
+        return false;
+    };
+
+    // Keeps lazy masters loaded across the walks below.
+    LayoutSceneNode::QueryScope scope;
+    QHash<const LayoutSceneNode*, quint32> cellIndexByNode;
+    QVector<std::shared_ptr<const LayoutSceneNode>> masters;
+    numberCells(root, cellIndexByNode, &masters);
+
+    qint64 objectCount = 0;
+    if (!LayoutSnapshot::saveFile(root, snapshotPath, objectCount, error)) {
+        return fail();
+    }
+
+    JournalHeader header{};
+    std::memcpy(header.magic, kJournalMagic, kJournalMagicLength);
+    header.version = kFormatVersion;
+    header.byteOrderMark = kByteOrderMark;
+    header.generation = generation;
+    header.baseObjectCount = static_cast<quint64>(root.objectCount());
+
+    QByteArray bytes;
+    bytes.reserve(static_cast<int>(sizeof(JournalHeader) + header.baseObjectCount * sizeof(quint64)));
+    appendValue(bytes, header);
+    for (const std::shared_ptr<LayoutObjectModel>& object : root.objects()) {
+        appendValue(bytes, object->objectId());
+    }
+
+    // The new journal only becomes visible once complete; until then the
+    // old journal still names the old snapshot.
+    QSaveFile journal(journalPath);
+    if (!journal.open(QIODevice::WriteOnly)
+        || journal.write(bytes.constData(), bytes.size()) != bytes.size()
+        || !journal.commit()) {
+        error = QString("cannot write %1: %2").arg(journalPath, journal.errorString());
+        QFile::remove(snapshotPath);
+        return fail();
+    }
+
+    if (m_generation > 0) {
+        QFile::remove(snapshotPathFor(m_basePath, m_generation));
+    }
+
+    QFile snapshot(snapshotPath);
+    const qint64 snapshotBytes = snapshot.open(QIODevice::ReadOnly) ? snapshot.size() : 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_generation = generation;
+        m_cellIndexByNode = std::move(cellIndexByNode);
+        m_snapshotMasters = std::move(masters);
+        m_compactionForced = false;
+        m_journalBytes = bytes.size();
+        m_recordCount = 0;
+        m_compactionThreshold = bytes.size() + std::max(kMinCompactionBytes, snapshotBytes / 2);
+        m_writeFailed = false;
+        m_lastError.clear();
+    }
+    return openForAppend(error);
+}
+
+LayoutEditJournal::Status LayoutEditJournal::status() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Status status;
+    status.basePath = m_basePath;
+    status.generation = m_generation;
+    status.journalBytes = m_journalBytes;
+    status.recordCount = m_recordCount;
+    status.lastError = m_lastError;
+    return status;
+}
+
+bool LayoutEditJournal::openForAppend(QString& error) {
+    m_file = std::make_unique<QFile>(journalPathFor(m_basePath));
+    if (!m_file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        error = QString("cannot open %1: %2").arg(m_file->fileName(), m_file->errorString());
+        m_file.reset();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writeFailed = true;
+        m_lastError = error;
+        return false;
+    }
+    return true;
+}
+
+void LayoutEditJournal::writerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [this]() { return m_stopping || !m_queue.isEmpty(); });
+        if (m_queue.isEmpty()) {
+            return;
+        }
+
+        QVector<PendingRecord> batch;
+        batch.swap(m_queue);
+        lock.unlock();
+
+        // Everything queued so far goes out in one write, except that
+        // records queued before a compaction are appended to the old journal
+        // first, which stays current if the compaction fails. Of several
+        // queued compactions only the last is written; it holds every edit
+        // the earlier ones did.
+        int lastCompaction = -1;
+        for (int i = 0; i < batch.size(); ++i) {
+            if (batch[i].compactionRoot) {
+                lastCompaction = i;
+            }
+        }
+
+        QByteArray bytes;
+        qint64 recordCount = 0;
+        for (int i = 0; i < batch.size(); ++i) {
+            const PendingRecord& record = batch[i];
+            if (record.compactionRoot) {
+                if (i == lastCompaction) {
+                    appendToJournal(bytes, recordCount);
+                    QString error;
+                    writeGeneration(*record.compactionRoot, error);
+                }
+                std::lock_guard<std::mutex> guard(m_mutex);
+                --m_queuedCompactions;
+                continue;
+            }
+
+            if (!encodeRecord(record, bytes)) {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_compactionForced = true;
+            }
+            ++recordCount;
+        }
+        appendToJournal(bytes, recordCount);
+        batch.clear();
+
+        lock.lock();
+    }
+}
+
+void LayoutEditJournal::appendToJournal(QByteArray& bytes, qint64& recordCount) {
+    if (recordCount == 0) {
+        return;
+    }
+
+    const bool written = m_file
+                         && m_file->write(bytes.constData(), bytes.size()) == bytes.size()
+                         && m_file->flush();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (written) {
+        m_journalBytes += bytes.size();
+        m_recordCount += recordCount;
+    } else if (!m_writeFailed) {
+        m_writeFailed = true;
+        m_lastError = QString("cannot append to %1: %2")
+                          .arg(journalPathFor(m_basePath), m_file ? m_file->errorString() : QString());
+    }
+    bytes.clear();
+    recordCount = 0;
+}
+
+bool LayoutEditJournal::encodeRecord(const PendingRecord& record, QByteArray& out) const {
+    bool mastersKnown = true;
+    QByteArray payload;
+    quint32 count = 0;
+    if (record.type == kRecordRemove) {
+        payload.append(reinterpret_cast<const char*>(record.objectIds.constData()),
+                       static_cast<int>(record.objectIds.size() * sizeof(quint64)));
+        count = static_cast<quint32>(record.objectIds.size());
+    } else {
+        for (const std::shared_ptr<LayoutObjectModel>& object : record.objects) {
+            const LayoutObjectModel* model = object.get();
+            JournalObject header{};
+            header.objectId = model->objectId();
+            model->tryGetLayer(header.layerNameId, header.layerTypeId);
+            if (const DrawnRectangle* rectangle = model->asRectangle()) {
+                header.kind = kKindRectangle;
+                appendValue(payload, header);
+                appendValue(payload, JournalRectangle{rectangle->x1, rectangle->y1, rectangle->x2, rectangle->y2});
+            } else if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(model)) {
+                header.kind = kKindPolygon;
+                header.pointCount = static_cast<quint32>(polygon->vertices().size());
+                appendValue(payload, header);
+                appendPoints(payload, polygon->vertices());
+            } else if (const auto* path = dynamic_cast<const PathObjectModel*>(model)) {
+                header.kind = kKindPath;
+                header.pointCount = static_cast<quint32>(path->points().size());
+                appendValue(payload, header);
+                appendValue(payload, JournalPath{path->width(), path->beginExtension(), path->endExtension()});
+                appendPoints(payload, path->points());
+            } else if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(model)) {
+                const LayoutTransform& transform = instance->transform();
+                JournalInstance placement{};
+                placement.masterCell = m_cellIndexByNode.value(instance->master(), kUnknownCell);
+                mastersKnown = mastersKnown && placement.masterCell != kUnknownCell;
+                placement.mirrorX = transform.mirrorX ? 1 : 0;
+                placement.columns = instance->columns();
+                placement.rows = instance->rows();
+                placement.originX = transform.originX;
+                placement.originY = transform.originY;
+                placement.magnification = transform.magnification;
+                placement.angleDegrees = transform.angleDegrees;
+                placement.columnStepX = instance->columnStep().x;
+                placement.columnStepY = instance->columnStep().y;
+                placement.rowStepX = instance->rowStep().x;
+                placement.rowStepY = instance->rowStep().y;
+                header.kind = kKindInstance;
+                appendValue(payload, header);
+                appendValue(payload, placement);
+            } else {
+                continue;
+            }
+            ++count;
+        }
+    }
+
+    JournalRecordHeader header{};
+    header.type = record.type;
+    header.count = count;
+    header.payloadBytes = static_cast<quint64>(payload.size());
+    header.checksum = checksumOf(payload.constData(), header.payloadBytes);
+    appendValue(out, header);
+    out.append(payload);
+    return mastersKnown;
+}
+
+bool LayoutEditJournal::recover(const QString& basePath,
+                                std::unique_ptr<LayoutSceneNode>& outRoot,
+                                RecoveryStats& outStats,
+                                QString& error) {
+    outStats = RecoveryStats();
+    const QString journalPath = journalPathFor(basePath);
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("cannot open %1: %2").arg(journalPath, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const uchar* mapped = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+    if (!mapped) {
+        error = QString("cannot map %1: %2").arg(journalPath, file.errorString());
+        return false;
+    }
+
+    JournalCursor cursor(mapped, static_cast<quint64>(fileSize));
+    JournalHeader header{};
+    if (!cursor.read(header) || std::memcmp(header.magic, kJournalMagic, kJournalMagicLength) != 0) {
+        error = QString("%1: not an edit journal").arg(journalPath);
+        return false;
+    }
+    if (header.byteOrderMark != kByteOrderMark) {
+        error = QString("%1: journal was written with a different byte order").arg(journalPath);
+        return false;
+    }
+    if (header.version != kFormatVersion) {
+        error = QString("%1: unsupported journal version %2").arg(journalPath).arg(header.version);
+        return false;
+    }
+    if (header.baseObjectCount > cursor.remaining() / sizeof(quint64)) {
+        error = QString("%1: journal header is truncated").arg(journalPath);
+        return false;
+    }
+
+    LayoutLoadResult snapshot;
+    if (!LayoutSnapshot::loadFile(snapshotPathFor(basePath, header.generation), snapshot, error)) {
+        return false;
+    }
+    if (snapshot.topCells.size() != 1
+        || static_cast<quint64>(snapshot.topCells[0]->objectCount()) != header.baseObjectCount) {
+        error = QString("%1 does not match its snapshot").arg(journalPath);
+        return false;
+    }
+
+    const LayoutObjectList& baseObjects = snapshot.topCells[0]->objects();
+    std::vector<quint64> baseIds(header.baseObjectCount);
+    std::memcpy(baseIds.data(), cursor.current(), header.baseObjectCount * sizeof(quint64));
+    cursor.skip(header.baseObjectCount * sizeof(quint64));
+
+    QHash<const LayoutSceneNode*, quint32> cellIndexByNode;
+    QVector<std::shared_ptr<const LayoutSceneNode>> masters;
+    numberCells(*snapshot.topCells[0], cellIndexByNode, &masters);
+
+    // Records only update bookkeeping here; the scene is built once at the
+    // end, so objects added and removed again never reach the index.
+    QVector<std::shared_ptr<LayoutObjectModel>> added;
+    QHash<quint64, int> addedIndexById;
+    QHash<quint64, int> baseIndexById;
+    std::vector<bool> baseRemoved(baseIds.size(), false);
+    QVector<quint64> recordIds;
+    QVector<std::shared_ptr<LayoutObjectModel>> recordObjects;
+    while (cursor.remaining() > 0) {
+        JournalRecordHeader record{};
+        if (!cursor.read(record) || record.payloadBytes > cursor.remaining()
+            || checksumOf(reinterpret_cast<const char*>(cursor.current()), record.payloadBytes) != record.checksum) {
+            outStats.damagedTail = true;
+            break;
+        }
+
+        JournalCursor payload(cursor.current(), record.payloadBytes);
+        cursor.skip(record.payloadBytes);
+
+        recordIds.clear();
+        recordObjects.clear();
+        bool decoded = record.type == kRecordAdd || record.type == kRecordRemove;
+        for (quint32 i = 0; decoded && i < record.count; ++i) {
+            quint64 objectId = 0;
+            if (record.type == kRecordAdd) {
+                std::shared_ptr<LayoutObjectModel> object;
+                decoded = decodeObject(payload, masters, objectId, object);
+                recordObjects.push_back(std::move(object));
+            } else {
+                decoded = payload.read(objectId);
+            }
+            recordIds.push_back(objectId);
+        }
+        if (!decoded) {
+            outStats.damagedTail = true;
+            break;
+        }
+
+        for (int i = 0; i < recordIds.size(); ++i) {
+            const quint64 objectId = recordIds[i];
+            if (record.type == kRecordAdd) {
+                addedIndexById.insert(objectId, added.size());
+                added.push_back(std::move(recordObjects[i]));
+                continue;
+            }
+
+            const auto addedIt = addedIndexById.find(objectId);
+            if (addedIt != addedIndexById.end()) {
+                added[addedIt.value()].reset();
+                addedIndexById.erase(addedIt);
+                continue;
+            }
+            if (baseIndexById.isEmpty() && !baseIds.empty()) {
+                baseIndexById.reserve(static_cast<int>(baseIds.size()));
+                for (int j = 0; j < static_cast<int>(baseIds.size()); ++j) {
+                    baseIndexById.insert(baseIds[j], j);
+                }
+            }
+            const auto baseIt = baseIndexById.constFind(objectId);
+            if (baseIt != baseIndexById.cend() && !baseRemoved[baseIt.value()]) {
+                baseRemoved[baseIt.value()] = true;
+                ++outStats.removedObjectCount;
+            }
+        }
+        ++outStats.recordCount;
+    }
+
+    QVector<std::shared_ptr<LayoutObjectModel>> objects;
+    objects.reserve(baseObjects.size() - static_cast<int>(outStats.removedObjectCount) + addedIndexById.size());
+    for (int i = 0; i < baseObjects.size(); ++i) {
+        if (!baseRemoved[i]) {
+            objects.push_back(baseObjects[i]);
+        }
+    }
+    for (std::shared_ptr<LayoutObjectModel>& object : added) {
+        if (object) {
+            objects.push_back(std::move(object));
+        }
+    }
+
+    outRoot = std::make_unique<LayoutSceneNode>();
+    outRoot->addObjects(std::move(objects));
+    outStats.generation = header.generation;
+    outStats.snapshotObjectCount = static_cast<qint64>(header.baseObjectCount);
+    outStats.addedObjectCount = addedIndexById.size();
+    return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class QFile;
+class LayoutObjectModel;
+class LayoutSceneNode;
+
+// LayoutEditJournal autosaves an editor's root cell as a snapshot plus an
+// append-only journal of the edits made since, so a crash loses at most the
+// records still queued for the writer thread.
+//
+// Files for a base path B:
+//  - B.<generation>.l2snap  root cell at the last compaction (a regular .l2snap)
+//  - B.l2journal            header naming that generation and listing the
+//                           object IDs of the snapshot's root objects in paint
+//                           order, followed by add/remove records
+//
+// Add records carry the object ID, kind, layer and geometry; remove records
+// carry object IDs only. Instances refer to their master by its position in
+// a depth-first walk of the snapshot's hierarchy. Every record has its own
+// length and checksum; replay stops at the first damaged or incomplete one,
+// which is where a crash during an append leaves the file.
+//
+// Records are encoded and appended by a background thread; recordAdd() and
+// recordRemove() only queue them. Compaction writes a new snapshot, replaces
+// the journal with an empty one for the new generation, and only then
+// deletes the old snapshot, so the files on disk are consistent at every
+// step. compact() queues it too, with an immutable snapshot of the root cell
+// (LayoutSceneNode::snapshot()), so the editor keeps working while the
+// writer thread saves the design.
+//
+// All members are called from one thread (the editor's).
+class LayoutEditJournal {
+public:
+    struct Status {
+        QString basePath;
+        quint64 generation{0};
+        qint64 journalBytes{0};
+        qint64 recordCount{0};
+        QString lastError;
+    };
+
+    struct RecoveryStats {
+        quint64 generation{0};
+        qint64 snapshotObjectCount{0};
+        qint64 recordCount{0};
+        qint64 addedObjectCount{0};
+        qint64 removedObjectCount{0};
+        // Set when replay stopped at a damaged or incomplete record.
+        bool damagedTail{false};
+    };
+
+    LayoutEditJournal();
+    ~LayoutEditJournal();
+    LayoutEditJournal(const LayoutEditJournal&) = delete;
+    LayoutEditJournal& operator=(const LayoutEditJournal&) = delete;
+
+    // Compacts root into basePath's files (continuing the generation count
+    // of an existing journal there) and starts the writer thread.
+    bool start(const QString& basePath, const LayoutSceneNode& root, QString& error);
+    // Writes out queued records and stops the writer; the files stay behind.
+    void stop();
+    bool isActive() const;
+
+    // Queue edits of the root cell made since the last record. A failed
+    // append stops recording until the journal is restarted; the error is
+    // kept in status(). recordAdd queues nothing and returns false when an
+    // instance places a master the journal cannot reference (not in the
+    // snapshot, or a compaction is queued); the caller then compacts onto
+    // a root that includes the objects instead, so no record is ever lost
+    // on replay.
+    bool recordAdd(const QVector<std::shared_ptr<LayoutObjectModel>>& objects);
+    void recordRemove(const QVector<quint64>& objectIds);
+
+    // True once replaying the journal would cost a noticeable share of a
+    // full reload, or when a record placed a master missing from the
+    // snapshot (which recordAdd prevents); false while a compaction is
+    // queued.
+    bool compactionDue() const;
+    // Queues a compaction onto root, a snapshot of the root cell taken after
+    // the last recorded edit. Records queued later go to the new journal;
+    // failures are kept in status().
+    void compact(std::shared_ptr<const LayoutSceneNode> root);
+
+    Status status() const;
+
+    // Loads basePath's snapshot and replays its journal onto the root cell
+    // in one bulk update.
+    static bool recover(const QString& basePath,
+                        std::unique_ptr<LayoutSceneNode>& outRoot,
+                        RecoveryStats& outStats,
+                        QString& error);
+
+private:
+    struct PendingRecord {
+        quint32 type{0};
+        QVector<std::shared_ptr<LayoutObjectModel>> objects;
+        QVector<quint64> objectIds;
+        // Set for a compaction request instead of a record.
+        std::shared_ptr<const LayoutSceneNode> compactionRoot;
+    };
+
+    void writerLoop();
+    // Returns false when an instance's master is not in the snapshot.
+    bool encodeRecord(const PendingRecord& record, QByteArray& out) const;
+    void appendToJournal(QByteArray& bytes, qint64& recordCount);
+    // Writes root as the next generation and switches appends to its
+    // journal. Runs in start() and then only on the writer thread.
+    bool writeGeneration(const LayoutSceneNode& root, QString& error);
+    bool openForAppend(QString& error);
+
+    QString m_basePath;
+    // Only the thread writing generations changes these, under m_mutex.
+    quint64 m_generation{0};
+    // Depth-first cell order of the current snapshot, and its masters kept
+    // alive so the node addresses stay unique.
+    QHash<const LayoutSceneNode*, quint32> m_cellIndexByNode;
+    QVector<std::shared_ptr<const LayoutSceneNode>> m_snapshotMasters;
+    std::unique_ptr<QFile> m_file;
+    std::thread m_writer;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    QVector<PendingRecord> m_queue;
+    qint64 m_compactionThreshold{0};
+    bool m_compactionForced{false};
+    // Compactions queued and not yet written.
+    int m_queuedCompactions{0};
+    bool m_stopping{false};
+    bool m_writeFailed{false};
+    qint64 m_journalBytes{0};
+    qint64 m_recordCount{0};
+    QString m_lastError;
+};
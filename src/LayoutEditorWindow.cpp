@@ -1,5 +1,8 @@
 #include "LayoutEditorWindow.h"
+#include "LayoutDocument.h"
 #include "LayoutSceneModel.h"
+#include "LayoutSelectionSet.h"
+#include "PrimitiveRenderBackend.h"
 
 #include <QAbstractItemView>
 #include <QApplication>
@@ -13,7 +16,9 @@
 #include <QKeySequence>
 #include <QIcon>
 #include <QLabel>
+#include <QLineF>
 #include <QElapsedTimer>
+#include <QGuiApplication>
 #include <QMouseEvent>
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
@@ -22,17 +27,22 @@
 #include <QPainter>
 #include <QPixmap>
 #include <QPolygonF>
+#include <QRectF>
+#include <QScreen>
 #include <QSize>
 #include <QSizePolicy>
 #include <QSplitter>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QVector2D>
 #include <QWheelEvent>
 #include <QWidget>
+#include <QWindow>
 #include <QtGlobal>
 #include <QDebug>
 #include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <memory>
 
 namespace {
@@ -54,32 +64,6 @@ QPointF wheelEventPoint(const QWheelEvent* event) {
 #endif
 }
 
-QBrush patternBrushFor(QColor baseColor, const QString& pattern) {
-    bool ok = false;
-    const quint64 patternValue = static_cast<quint64>(pattern.toULongLong(&ok, 0));
-    if (!ok) {
-        return QBrush(baseColor, Qt::SolidPattern);
-    }
-
-    const int patternMag = 2;
-
-    QPixmap pixmap(8 * patternMag, 8 * patternMag);
-    pixmap.fill(Qt::transparent);
-    QPainter painter(&pixmap);
-    painter.setPen(baseColor);
-
-    for (int y = 0; y < (8 * patternMag); ++y) {
-        for (int x = 0; x < (8 * patternMag); ++x) {
-            const int bitIndex = ((y / patternMag) * 8) + (x / patternMag);
-            if ((patternValue >> bitIndex) & 0x1ULL) {
-                painter.drawPoint(x, y);
-            }
-        }
-    }
-
-    return QBrush(pixmap);
-}
-
 std::array<float, 8> patternRowsFor(const QString& pattern) {
     std::array<float, 8> rows{};
     bool ok = false;
@@ -97,96 +81,114 @@ std::array<float, 8> patternRowsFor(const QString& pattern) {
     return rows;
 }
 
-quint64 layerCodeKey(quint32 nameId, quint32 typeId) {
-    return (static_cast<quint64>(nameId) << 32) | static_cast<quint64>(typeId);
+double polygonCross(const QPointF& a, const QPointF& b, const QPointF& c) {
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
 }
 
-enum class CanvasRenderBackendType {
-    Raster,
-    OpenGL
-};
-
-CanvasRenderBackendType backendTypeFromEnv() {
-    const QByteArray backendName = qgetenv("LAYOUT2_RENDER_BACKEND").trimmed().toLower();
-    if (backendName == "raster") {
-        return CanvasRenderBackendType::Raster;
+// Emits triangle vertex indices for a simple polygon. Convex polygons (all
+// rectangles) take the fan fast path; concave ones, e.g. imported GDSII
+// boundaries, are ear-clipped.
+void triangulatePolygon(const QPolygonF& polygon, QVector<int>& outIndices) {
+    const int vertexCount = polygon.size();
+    if (vertexCount < 3) {
+        return;
     }
 
-    // Default to OpenGL unless explicitly overridden.
-    return CanvasRenderBackendType::OpenGL;
-}
+    double signedArea = 0.0;
+    bool hasPositiveTurn = false;
+    bool hasNegativeTurn = false;
+    for (int i = 0; i < vertexCount; ++i) {
+        const QPointF& a = polygon[i];
+        const QPointF& b = polygon[(i + 1) % vertexCount];
+        const QPointF& c = polygon[(i + 2) % vertexCount];
+        signedArea += (a.x() * b.y()) - (b.x() * a.y());
+        const double turn = polygonCross(a, b, c);
+        hasPositiveTurn = hasPositiveTurn || turn > 0.0;
+        hasNegativeTurn = hasNegativeTurn || turn < 0.0;
+    }
 
-class PrimitiveRenderBackend {
-public:
-    virtual ~PrimitiveRenderBackend() = default;
-
-    struct RenderItem {
-        QPolygonF polygon;
-        QColor fillColor;
-        QColor outlineColor;
-        QBrush patternBrush;
-        QString pattern;
-        bool selected{false};
-        bool preview{false};
-        bool tinyOnScreen{false};
-        int detailLevel{0};
-    };
-
-    virtual void beginFrame(QPainter& painter, const QColor& clearColor, const QSize& viewportSize) = 0;
-
-    virtual void drawPrimitives(QPainter& painter,
-                                const QVector<RenderItem>& items,
-                                const QSize& viewportSize) = 0;
-
-    virtual void endFrame(QPainter& painter, const QSize& viewportSize) = 0;
-};
+    if (!(hasPositiveTurn && hasNegativeTurn)) {
+        for (int i = 1; i < vertexCount - 1; ++i) {
+            outIndices.push_back(0);
+            outIndices.push_back(i);
+            outIndices.push_back(i + 1);
+        }
+        return;
+    }
 
-class RasterPrimitiveRenderBackend final : public PrimitiveRenderBackend {
-public:
-    void beginFrame(QPainter& painter, const QColor& clearColor, const QSize& viewportSize) override {
-        Q_UNUSED(viewportSize);
-        painter.fillRect(painter.viewport(), clearColor);
+    const double orientation = signedArea >= 0.0 ? 1.0 : -1.0;
+    QVector<int> remaining(vertexCount);
+    for (int i = 0; i < vertexCount; ++i) {
+        remaining[i] = i;
     }
 
-    void drawPrimitives(QPainter& painter,
-                        const QVector<RenderItem>& items,
-                        const QSize& viewportSize) override {
-        Q_UNUSED(viewportSize);
-        for (const RenderItem& item : items) {
-            if (item.detailLevel == 2 && item.tinyOnScreen && !item.selected) {
+    int cursor = 0;
+    int failedProbes = 0;
+    while (remaining.size() > 3) {
+        const int count = remaining.size();
+        const int prev = remaining[(cursor + count - 1) % count];
+        const int curr = remaining[cursor % count];
+        const int next = remaining[(cursor + 1) % count];
+        const QPointF& a = polygon[prev];
+        const QPointF& b = polygon[curr];
+        const QPointF& c = polygon[next];
+
+        bool isEar = polygonCross(a, b, c) * orientation > 0.0;
+        for (int k = 0; isEar && k < count; ++k) {
+            const int candidate = remaining[k];
+            if (candidate == prev || candidate == curr || candidate == next) {
                 continue;
             }
 
-            if (item.detailLevel == 0) {
-                painter.setPen(QPen(item.outlineColor, 1, item.preview ? Qt::DashLine : Qt::SolidLine));
-                painter.setBrush(item.patternBrush);
-            } else if (item.detailLevel == 1) {
-                painter.setPen(item.selected
-                                   ? QPen(item.outlineColor, 1, Qt::SolidLine)
-                                   : QPen(item.outlineColor, 0, Qt::NoPen));
-                painter.setBrush(QBrush(item.fillColor, Qt::SolidPattern));
-            } else {
-                painter.setPen(item.selected
-                                   ? QPen(item.outlineColor, 1, Qt::SolidLine)
-                                   : QPen(item.outlineColor, 0, Qt::NoPen));
-                QColor coarseFill = item.fillColor;
-                coarseFill.setAlpha(std::min(255, item.fillColor.alpha() + 50));
-                painter.setBrush(QBrush(coarseFill, Qt::SolidPattern));
-            }
+            const QPointF& p = polygon[candidate];
+            isEar = !(polygonCross(a, b, p) * orientation >= 0.0
+                      && polygonCross(b, c, p) * orientation >= 0.0
+                      && polygonCross(c, a, p) * orientation >= 0.0);
+        }
 
-            painter.drawPolygon(item.polygon);
+        if (isEar) {
+            outIndices.push_back(prev);
+            outIndices.push_back(curr);
+            outIndices.push_back(next);
+            remaining.remove(cursor % count);
+            cursor = (cursor + count - 2) % (count - 1);
+            failedProbes = 0;
+        } else {
+            cursor = (cursor + 1) % count;
+            if (++failedProbes >= count) {
+                break;
+            }
         }
     }
 
-    void endFrame(QPainter& painter, const QSize& viewportSize) override {
-        Q_UNUSED(painter);
-        Q_UNUSED(viewportSize);
+    // Degenerate input (self-intersections, collinear runs) falls back to a
+    // fan over whatever is left.
+    for (int i = 1; i + 1 < remaining.size(); ++i) {
+        outIndices.push_back(remaining[0]);
+        outIndices.push_back(remaining[i]);
+        outIndices.push_back(remaining[i + 1]);
     }
+}
+
+enum class CanvasRenderBackendType {
+    Raster,
+    OpenGL
 };
 
+CanvasRenderBackendType backendTypeFromEnv() {
+    const QByteArray backendName = qgetenv("LAYOUT2_RENDER_BACKEND").trimmed().toLower();
+    if (backendName == "raster") {
+        return CanvasRenderBackendType::Raster;
+    }
+
+    // Default to OpenGL unless explicitly overridden.
+    return CanvasRenderBackendType::OpenGL;
+}
+
 // OpenGL backend:
 // - detailed/simplified/coarse modes all submit geometry via GL,
-// - detailed mode applies layer stipple in fragment shader for parity.
+// - detailed mode applies layer stipple in fragment shader for parity,
+// - the grid is evaluated procedurally in a full-screen fragment pass.
 class OpenGLPrimitiveRenderBackend final : public PrimitiveRenderBackend {
 public:
     OpenGLPrimitiveRenderBackend()
@@ -198,6 +200,45 @@ public:
         Q_UNUSED(viewportSize);
     }
 
+    void drawGrid(QPainter& painter, const GridParams& grid, const QSize& viewportSize) override {
+        if (grid.stepPixels <= 0.0) {
+            return;
+        }
+
+        if (!initializeGlResources()) {
+            drawGridWithPainter(painter, grid, viewportSize);
+            return;
+        }
+
+        // One quad covers the viewport; the fragment shader decides per pixel
+        // whether it lies on a grid point or an axis, so cost is independent
+        // of grid density.
+        painter.beginNativePainting();
+        QOpenGLFunctions* gl = QOpenGLContext::currentContext()->functions();
+        gl->glDisable(GL_DEPTH_TEST);
+        gl->glDisable(GL_BLEND);
+
+        m_gridProgram.bind();
+        m_gridProgram.setUniformValue("uDevicePixelRatio", static_cast<float>(painter.device()->devicePixelRatioF()));
+        m_gridProgram.setUniformValue("uViewportHeight", static_cast<float>(viewportSize.height()));
+        m_gridProgram.setUniformValue("uGridStep", static_cast<float>(grid.stepPixels));
+        m_gridProgram.setUniformValue("uGridOffset",
+                                      QVector2D(static_cast<float>(grid.offsetX), static_cast<float>(grid.offsetY)));
+        m_gridProgram.setUniformValue("uOrigin",
+                                      QVector2D(static_cast<float>(std::floor(grid.originX)),
+                                                static_cast<float>(std::floor(grid.originY))));
+        m_gridProgram.setUniformValue("uColor", grid.color);
+
+        m_gridQuadBuffer.bind();
+        m_gridProgram.enableAttributeArray(0);
+        m_gridProgram.setAttributeBuffer(0, GL_FLOAT, 0, 2, 2 * static_cast<int>(sizeof(float)));
+        gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        m_gridProgram.disableAttributeArray(0);
+        m_gridQuadBuffer.release();
+        m_gridProgram.release();
+        painter.endNativePainting();
+    }
+
     void drawPrimitives(QPainter& painter,
                         const QVector<RenderItem>& items,
                         const QSize& viewportSize) override {
@@ -215,7 +256,7 @@ public:
             m_geometryDirty = true;
         }
 
-        if (m_cachedTriangleVertexData.isEmpty() && m_cachedLineVertexData.isEmpty() && m_cachedDetailedItems.isEmpty()) {
+        if (m_cachedTriangleVertexData.isEmpty() && m_cachedDetailedItems.isEmpty()) {
             return;
         }
 
@@ -235,7 +276,7 @@ public:
         m_program.setUniformValue("uUseStipple", 0.0f);
         m_vertexBuffer.bind();
         if (m_geometryDirty) {
-            uploadVertexData(m_cachedTriangleVertexData, m_cachedLineVertexData);
+            uploadVertexData(m_cachedTriangleVertexData);
             m_geometryDirty = false;
         }
 
@@ -246,12 +287,6 @@ public:
         if (triangleVertexCount > 0) {
             gl->glDrawArrays(GL_TRIANGLES, 0, triangleVertexCount);
         }
-
-        const int lineVertexCount = static_cast<int>(m_cachedLineVertexData.size() / 6);
-        if (lineVertexCount > 0) {
-            gl->glLineWidth(2.0f);
-            gl->glDrawArrays(GL_LINES, triangleVertexCount, lineVertexCount);
-        }
         m_vertexBuffer.release();
 
         drawDetailedItemsWithGl(gl, stride);
@@ -263,7 +298,6 @@ public:
 
         m_frameCounter += 1;
         m_trianglesSubmitted += (m_cachedTriangleVertexData.size() / 18);
-        m_linesSubmitted += (m_cachedLineVertexData.size() / 12);
         m_skippedTinyCount += m_cachedTinySkipped;
         m_detailedPainterCount += m_cachedDetailedPainterCount;
         if (!m_statsEnabled) {
@@ -286,6 +320,83 @@ public:
         }
     }
 
+    void drawOverlay(QPainter& painter,
+                     const QVector<OverlayItem>& items,
+                     const QSize& viewportSize) override {
+        if (items.isEmpty()) {
+            return;
+        }
+
+        if (!initializeGlResources()) {
+            drawOverlayWithPainter(painter, items);
+            return;
+        }
+
+        // Overlay vertices are rebuilt every frame into their own buffer; the
+        // cached geometry buffer is left untouched. Consecutive items sharing
+        // a line width are merged into a single draw call.
+        struct LineBatch {
+            int firstVertex{0};
+            int vertexCount{0};
+            int lineWidth{1};
+        };
+
+        m_overlayVertexData.clear();
+        QVector<LineBatch> batches;
+        for (const OverlayItem& item : items) {
+            const int firstVertex = static_cast<int>(m_overlayVertexData.size() / 6);
+            appendOverlaySegments(m_overlayVertexData, item);
+            const int vertexCount = static_cast<int>(m_overlayVertexData.size() / 6) - firstVertex;
+            if (vertexCount <= 0) {
+                continue;
+            }
+
+            if (!batches.isEmpty() && batches.back().lineWidth == item.lineWidth) {
+                batches.back().vertexCount += vertexCount;
+            } else {
+                batches.push_back(LineBatch{firstVertex, vertexCount, item.lineWidth});
+            }
+        }
+
+        if (batches.isEmpty()) {
+            return;
+        }
+
+        painter.beginNativePainting();
+        m_program.bind();
+        m_program.setUniformValue("uViewport", QVector2D(viewportSize.width(), viewportSize.height()));
+        m_program.setUniformValue("uUseStipple", 0.0f);
+
+        QOpenGLFunctions* gl = QOpenGLContext::currentContext()->functions();
+        gl->glDisable(GL_DEPTH_TEST);
+        gl->glEnable(GL_BLEND);
+        gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        constexpr int stride = 6 * static_cast<int>(sizeof(float));
+        m_overlayVertexBuffer.bind();
+        const int totalBytes = static_cast<int>(m_overlayVertexData.size() * static_cast<qsizetype>(sizeof(float)));
+        if (totalBytes > m_overlayCapacityBytes) {
+            m_overlayVertexBuffer.allocate(totalBytes);
+            m_overlayCapacityBytes = totalBytes;
+        }
+        m_overlayVertexBuffer.write(0, m_overlayVertexData.constData(), totalBytes);
+
+        m_program.enableAttributeArray(0);
+        m_program.enableAttributeArray(1);
+        m_program.setAttributeBuffer(0, GL_FLOAT, 0, 2, stride);
+        m_program.setAttributeBuffer(1, GL_FLOAT, 2 * static_cast<int>(sizeof(float)), 4, stride);
+        for (const LineBatch& batch : batches) {
+            gl->glLineWidth(static_cast<float>(batch.lineWidth));
+            gl->glDrawArrays(GL_LINES, batch.firstVertex, batch.vertexCount);
+            m_linesSubmitted += static_cast<quint64>(batch.vertexCount / 2);
+        }
+        m_program.disableAttributeArray(0);
+        m_program.disableAttributeArray(1);
+        m_overlayVertexBuffer.release();
+        m_program.release();
+        painter.endNativePainting();
+    }
+
     void endFrame(QPainter& painter, const QSize& viewportSize) override {
         Q_UNUSED(painter);
         Q_UNUSED(viewportSize);
@@ -307,23 +418,30 @@ private:
         out.push_back(a);
     }
 
-    static void appendOutlineSegments(QVector<float>& out,
-                                      const QPolygonF& polygon,
-                                      const QColor& color) {
-        const float r = color.redF();
-        const float g = color.greenF();
-        const float b = color.blueF();
-        const float a = color.alphaF();
-        const int vertexCount = polygon.size();
-        if (vertexCount < 2) {
-            return;
-        }
+    // Appends GL_LINES vertices for one overlay item. Dashed items are split
+    // into dash segments on the CPU (Qt::DashLine proportions: 4w on, 2w off).
+    static void appendOverlaySegments(QVector<float>& out, const OverlayItem& item) {
+        const float r = item.color.redF();
+        const float g = item.color.greenF();
+        const float b = item.color.blueF();
+        const float a = item.color.alphaF();
+
+        const double dashLength = 4.0 * std::max(1, item.lineWidth);
+        const double gapLength = 2.0 * std::max(1, item.lineWidth);
+        for (const QLineF& segment : item.segments) {
+            if (!item.dashed) {
+                appendVertex(out, segment.x1(), segment.y1(), r, g, b, a);
+                appendVertex(out, segment.x2(), segment.y2(), r, g, b, a);
+                continue;
+            }
 
-        for (int i = 0; i < vertexCount; ++i) {
-            const QPointF p1 = polygon[i];
-            const QPointF p2 = polygon[(i + 1) % vertexCount];
-            appendVertex(out, p1.x(), p1.y(), r, g, b, a);
-            appendVertex(out, p2.x(), p2.y(), r, g, b, a);
+            const double length = segment.length();
+            for (double start = 0.0; start < length; start += dashLength + gapLength) {
+                const QPointF p1 = segment.pointAt(start / length);
+                const QPointF p2 = segment.pointAt(std::min(length, start + dashLength) / length);
+                appendVertex(out, p1.x(), p1.y(), r, g, b, a);
+                appendVertex(out, p2.x(), p2.y(), r, g, b, a);
+            }
         }
     }
 
@@ -341,7 +459,6 @@ private:
             hash ^= static_cast<quint64>(qHash(item.pattern));
             hash *= 1099511628211ULL;
             hash ^= static_cast<quint64>((item.detailLevel & 0xff)
-                                         | ((item.selected ? 1 : 0) << 8)
                                          | ((item.preview ? 1 : 0) << 9));
             hash *= 1099511628211ULL;
             hash ^= static_cast<quint64>(static_cast<qint64>(bounds.x() * 16.0));
@@ -359,9 +476,7 @@ private:
 
     void rebuildCachedGeometry(const QVector<RenderItem>& items) {
         m_cachedTriangleVertexData.clear();
-        m_cachedLineVertexData.clear();
         m_cachedTriangleVertexData.reserve(items.size() * 36);
-        m_cachedLineVertexData.reserve(items.size() * 24);
         m_cachedTinySkipped = 0;
         m_cachedDetailedPainterCount = 0;
         m_cachedDetailedItems.clear();
@@ -370,7 +485,7 @@ private:
         styleBuckets.reserve(std::max(8, items.size() / 32));
 
         for (const RenderItem& item : items) {
-            if (item.tinyOnScreen && !item.selected) {
+            if (item.tinyOnScreen) {
                 ++m_cachedTinySkipped;
                 continue;
             }
@@ -383,13 +498,11 @@ private:
 
             QColor fillColor = item.fillColor;
             fillColor.setAlpha(item.preview ? 96 : 156);
-            if (item.selected) {
-                fillColor = fillColor.lighter(120);
-            }
 
             styleBuckets[fillColor.rgba()].push_back(&item);
         }
 
+        QVector<int> triangleIndices;
         for (auto it = styleBuckets.cbegin(); it != styleBuckets.cend(); ++it) {
             QColor fillColor = QColor::fromRgba(it.key());
             const float r = fillColor.redF();
@@ -403,25 +516,11 @@ private:
                 }
 
                 const RenderItem& item = *itemPtr;
-                const int vertexCount = item.polygon.size();
-                if (vertexCount < 3) {
-                    continue;
-                }
-
-                const QPointF origin = item.polygon[0];
-                for (int i = 1; i < vertexCount - 1; ++i) {
-                    const QPointF p1 = item.polygon[i];
-                    const QPointF p2 = item.polygon[i + 1];
-                    appendVertex(m_cachedTriangleVertexData,
-                                 origin.x(), origin.y(), r, g, b, a);
-                    appendVertex(m_cachedTriangleVertexData,
-                                 p1.x(), p1.y(), r, g, b, a);
-                    appendVertex(m_cachedTriangleVertexData,
-                                 p2.x(), p2.y(), r, g, b, a);
-                }
-
-                if (item.selected) {
-                    appendOutlineSegments(m_cachedLineVertexData, item.polygon, QColor("#ffffff"));
+                triangleIndices.clear();
+                triangulatePolygon(item.polygon, triangleIndices);
+                for (int index : triangleIndices) {
+                    const QPointF& p = item.polygon[index];
+                    appendVertex(m_cachedTriangleVertexData, p.x(), p.y(), r, g, b, a);
                 }
             }
         }
@@ -430,8 +529,9 @@ private:
     void appendPolygonTriangles(QVector<float>& out,
                                const QPolygonF& polygon,
                                const QColor& color) {
-        const int vertexCount = polygon.size();
-        if (vertexCount < 3) {
+        QVector<int> triangleIndices;
+        triangulatePolygon(polygon, triangleIndices);
+        if (triangleIndices.isEmpty()) {
             return;
         }
 
@@ -439,13 +539,9 @@ private:
         const float g = color.greenF();
         const float b = color.blueF();
         const float a = color.alphaF();
-        const QPointF origin = polygon[0];
-        for (int i = 1; i < vertexCount - 1; ++i) {
-            const QPointF p1 = polygon[i];
-            const QPointF p2 = polygon[i + 1];
-            appendVertex(out, origin.x(), origin.y(), r, g, b, a);
-            appendVertex(out, p1.x(), p1.y(), r, g, b, a);
-            appendVertex(out, p2.x(), p2.y(), r, g, b, a);
+        for (int index : triangleIndices) {
+            const QPointF& p = polygon[index];
+            appendVertex(out, p.x(), p.y(), r, g, b, a);
         }
     }
 
@@ -459,33 +555,16 @@ private:
         }
 
         QVector<float> triangleVertices;
-        QVector<float> lineVertices;
         for (const RenderItem& item : m_cachedDetailedItems) {
             triangleVertices.clear();
-            lineVertices.clear();
             appendPolygonTriangles(triangleVertices, item.polygon, item.fillColor);
-            if (item.selected) {
-                appendOutlineSegments(lineVertices, item.polygon, item.outlineColor);
-            }
-
-            const qsizetype totalFloats = triangleVertices.size() + lineVertices.size();
-            if (totalFloats <= 0) {
+            if (triangleVertices.isEmpty()) {
                 continue;
             }
 
-            const qsizetype totalBytes = totalFloats * static_cast<qsizetype>(sizeof(float));
+            const qsizetype totalBytes = triangleVertices.size() * static_cast<qsizetype>(sizeof(float));
             m_detailVertexBuffer.bind();
-            m_detailVertexBuffer.allocate(static_cast<int>(totalBytes));
-            qsizetype byteOffset = 0;
-            if (!triangleVertices.isEmpty()) {
-                const qsizetype bytes = triangleVertices.size() * static_cast<qsizetype>(sizeof(float));
-                m_detailVertexBuffer.write(byteOffset, triangleVertices.constData(), static_cast<int>(bytes));
-                byteOffset += bytes;
-            }
-            if (!lineVertices.isEmpty()) {
-                const qsizetype bytes = lineVertices.size() * static_cast<qsizetype>(sizeof(float));
-                m_detailVertexBuffer.write(byteOffset, lineVertices.constData(), static_cast<int>(bytes));
-            }
+            m_detailVertexBuffer.allocate(triangleVertices.constData(), static_cast<int>(totalBytes));
 
             m_program.setAttributeBuffer(0, GL_FLOAT, 0, 2, stride);
             m_program.setAttributeBuffer(1, GL_FLOAT, 2 * static_cast<int>(sizeof(float)), 4, stride);
@@ -495,16 +574,7 @@ private:
             m_program.setUniformValueArray("uPatternRows", rows.data(), 8, 1);
 
             const int triangleVertexCount = static_cast<int>(triangleVertices.size() / 6);
-            if (triangleVertexCount > 0) {
-                gl->glDrawArrays(GL_TRIANGLES, 0, triangleVertexCount);
-            }
-
-            const int lineVertexCount = static_cast<int>(lineVertices.size() / 6);
-            if (lineVertexCount > 0) {
-                m_program.setUniformValue("uUseStipple", 0.0f);
-                gl->glLineWidth(1.0f);
-                gl->glDrawArrays(GL_LINES, triangleVertexCount, lineVertexCount);
-            }
+            gl->glDrawArrays(GL_TRIANGLES, 0, triangleVertexCount);
 
             m_detailVertexBuffer.release();
         }
@@ -512,10 +582,8 @@ private:
         m_program.setUniformValue("uUseStipple", 0.0f);
     }
 
-    void uploadVertexData(const QVector<float>& triangleVertexData,
-                          const QVector<float>& lineVertexData) {
-        const qsizetype totalFloats = triangleVertexData.size() + lineVertexData.size();
-        const qsizetype totalBytes = totalFloats * static_cast<qsizetype>(sizeof(float));
+    void uploadVertexData(const QVector<float>& triangleVertexData) {
+        const qsizetype totalBytes = triangleVertexData.size() * static_cast<qsizetype>(sizeof(float));
         if (totalBytes <= 0) {
             return;
         }
@@ -525,17 +593,7 @@ private:
             m_vertexCapacityBytes = totalBytes;
         }
 
-        qsizetype byteOffset = 0;
-        if (!triangleVertexData.isEmpty()) {
-            const qsizetype triangleBytes = triangleVertexData.size() * static_cast<qsizetype>(sizeof(float));
-            m_vertexBuffer.write(byteOffset, triangleVertexData.constData(), static_cast<int>(triangleBytes));
-            byteOffset += triangleBytes;
-        }
-
-        if (!lineVertexData.isEmpty()) {
-            const qsizetype lineBytes = lineVertexData.size() * static_cast<qsizetype>(sizeof(float));
-            m_vertexBuffer.write(byteOffset, lineVertexData.constData(), static_cast<int>(lineBytes));
-        }
+        m_vertexBuffer.write(0, triangleVertexData.constData(), static_cast<int>(totalBytes));
     }
 
     void drawWithPainterFallback(QPainter& painter, const QVector<RenderItem>& items) {
@@ -615,20 +673,99 @@ private:
             return false;
         }
 
+        if (m_overlayVertexBuffer.isCreated()) {
+            m_overlayVertexBuffer.destroy();
+        }
+        if (!m_overlayVertexBuffer.create()) {
+            return false;
+        }
+        m_overlayCapacityBytes = 0;
+
+        if (!initializeGridResources()) {
+            return false;
+        }
+
         m_initialized = true;
         return true;
     }
 
+    bool initializeGridResources() {
+        const char* vertexShader = R"(
+            attribute vec2 aPosition;
+            void main() {
+                gl_Position = vec4(aPosition, 0.0, 1.0);
+            }
+        )";
+
+        // Grid points are at offset + k * step in top-left screen space. A
+        // pixel is lit when the next grid position at or after its left/top
+        // edge falls inside it, matching the painter path's pixel choice.
+        // The uniforms are in logical pixels and gl_FragCoord is in device
+        // pixels, so fragments are mapped back to the logical pixel they
+        // cover; on HiDPI screens a grid point fills the whole logical pixel.
+        const char* fragmentShader = R"(
+            uniform float uDevicePixelRatio;
+            uniform float uViewportHeight;
+            uniform float uGridStep;
+            uniform vec2 uGridOffset;
+            uniform vec2 uOrigin;
+            uniform vec4 uColor;
+            void main() {
+                vec2 pixel = floor(vec2(gl_FragCoord.x / uDevicePixelRatio,
+                                        uViewportHeight - gl_FragCoord.y / uDevicePixelRatio));
+                vec2 toNextPoint = mod(uGridOffset - pixel, uGridStep);
+                bool onPoint = toNextPoint.x < 1.0 && toNextPoint.y < 1.0;
+                bool onAxis = pixel.x == uOrigin.x || pixel.y == uOrigin.y;
+                if (!onPoint && !onAxis) {
+                    discard;
+                }
+                gl_FragColor = uColor;
+            }
+        )";
+
+        if (!m_gridProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader)
+            || !m_gridProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader)) {
+            return false;
+        }
+
+        m_gridProgram.bindAttributeLocation("aPosition", 0);
+        if (!m_gridProgram.link()) {
+            return false;
+        }
+
+        if (m_gridQuadBuffer.isCreated()) {
+            m_gridQuadBuffer.destroy();
+        }
+        if (!m_gridQuadBuffer.create()) {
+            return false;
+        }
+
+        static const float quad[] = {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            -1.0f, 1.0f,
+            1.0f, 1.0f
+        };
+        m_gridQuadBuffer.bind();
+        m_gridQuadBuffer.allocate(quad, static_cast<int>(sizeof(quad)));
+        m_gridQuadBuffer.release();
+        return true;
+    }
+
     bool m_initialized{false};
     QOpenGLShaderProgram m_program;
+    QOpenGLShaderProgram m_gridProgram;
+    QOpenGLBuffer m_gridQuadBuffer;
     QOpenGLBuffer m_vertexBuffer;
     QOpenGLBuffer m_detailVertexBuffer;
+    QOpenGLBuffer m_overlayVertexBuffer;
     qsizetype m_vertexCapacityBytes{0};
+    int m_overlayCapacityBytes{0};
+    QVector<float> m_overlayVertexData;
     bool m_geometryDirty{true};
     quint64 m_cachedGeometryHash{0};
     QSize m_cachedViewportSize;
     QVector<float> m_cachedTriangleVertexData;
-    QVector<float> m_cachedLineVertexData;
     QVector<RenderItem> m_cachedDetailedItems;
     quint64 m_cachedTinySkipped{0};
     quint64 m_cachedDetailedPainterCount{0};
@@ -681,6 +818,9 @@ public:
         } else {
             m_renderBackend = std::make_unique<RasterPrimitiveRenderBackend>();
         }
+
+        m_moveDispatchTimer.setSingleShot(true);
+        connect(&m_moveDispatchTimer, &QTimer::timeout, this, [this]() { dispatchPendingMove(); });
     }
 
     void setRootCell(const LayoutSceneNode* rootCell) {
@@ -704,9 +844,7 @@ public:
     }
 
     void setLayers(const QVector<LayerDefinition>& layers) {
-        m_layers = layers;
-        rebuildLayerLookup();
-        m_fillBrushCache.clear();
+        m_renderItemBuilder.setLayers(layers);
         validateSelection();
         validateHover();
         update();
@@ -716,22 +854,99 @@ public:
         m_activeTool = toolName;
         if (m_activeTool != "select") {
             m_hoveredObjectId = 0;
+            m_selectPressPending = false;
+            m_rubberBandActive = false;
         }
         update();
     }
 
+    qint64 selectionCount() const {
+        return m_selection.count();
+    }
+
+    QVector<quint64> selectedObjectIds() const {
+        QVector<quint64> objectIds;
+        m_selection.appendObjectIds(objectIds);
+        return objectIds;
+    }
+
+    qint64 clearSelection() {
+        const qint64 cleared = m_selection.count();
+        m_selection.clear();
+        m_cycleSelectedObjectId = 0;
+        update();
+        return cleared;
+    }
+
+    // Adds every selectable object matching the rect under mode. Returns the
+    // number of newly selected objects.
+    qint64 selectInRect(qint64 minX,
+                        qint64 minY,
+                        qint64 maxX,
+                        qint64 maxY,
+                        RegionQueryMode mode,
+                        bool additive) {
+        if (!additive) {
+            m_selection.clear();
+        }
+        m_cycleSelectedObjectId = 0;
+
+        qint64 added = 0;
+        if (m_rootCell) {
+            m_rootCell->queryRegion(
+                minX, minY, maxX, maxY, mode,
+                [this](quint32 layerNameId, quint32 layerTypeId) {
+                    return isSelectableLayer(layerNameId, layerTypeId);
+                },
+                [this, &added](const LayoutObjectModel& object) {
+                    if (isSelectableObject(object) && m_selection.insert(object.objectId())) {
+                        ++added;
+                    }
+                    return true;
+                });
+        }
+
+        update();
+        return added;
+    }
+
+    qint64 selectAll() {
+        constexpr qint64 worldLimit = std::numeric_limits<qint64>::max() / 4;
+        return selectInRect(-worldLimit, -worldLimit, worldLimit, worldLimit, RegionQueryMode::Touch, false);
+    }
+
+    // Drops references to objects that no longer exist in the scene.
+    void forgetObjects(const QVector<quint64>& objectIds) {
+        for (quint64 objectId : objectIds) {
+            m_selection.remove(objectId);
+            if (m_hoveredObjectId == objectId) {
+                m_hoveredObjectId = 0;
+            }
+            if (m_cycleSelectedObjectId == objectId) {
+                m_cycleSelectedObjectId = 0;
+            }
+        }
+    }
+
+    // The shared document changed. Removed objects are forgotten either
+    // way, but the canvas repaints only when the changed region is on screen,
+    // so edits elsewhere in the layout cost other views nothing.
+    void onObjectsChanged(const QVector<quint64>& removedObjectIds,
+                          const LayoutObjectModel::Bounds& dirtyBounds,
+                          bool hasDirtyBounds) {
+        forgetObjects(removedObjectIds);
+        if (hasDirtyBounds && isWorldRectVisible(dirtyBounds)) {
+            update();
+        }
+    }
+
 signals:
     void commandRequested(const QString& command, bool requestActivation);
-    void objectDeletionRequested(quint64 objectId);
+    void canvasEventRequested(const CanvasEventCommand& event, bool requestActivation);
+    void selectionDeletionRequested();
     void mouseWorldPositionChanged(qint64 worldX, qint64 worldY, bool insideCanvas);
 
 protected:
-    enum class RenderDetailLevel {
-        Detailed,
-        Simplified,
-        Coarse
-    };
-
     void paintGL() override {
         if (m_backendType == CanvasRenderBackendType::OpenGL) {
             if (QOpenGLContext* ctx = context()) {
@@ -749,29 +964,24 @@ protected:
         drawGrid(painter);
 
         // Draw committed geometry first from model-provided primitives.
-        const RenderDetailLevel detailLevel = currentDetailLevel();
         const QVector<SceneRenderPrimitive> primitives = flattenedRenderPrimitives();
-        const QVector<PrimitiveRenderBackend::RenderItem> renderItems =
-            buildRenderItems(primitives, detailLevel);
+        const QVector<PrimitiveRenderBackend::RenderItem> renderItems = m_renderItemBuilder.build(
+            primitives, m_zoom, m_panX, m_panY, RenderItemBuilder::detailLevelForZoom(m_zoom));
         m_renderBackend->drawPrimitives(painter, renderItems, size());
 
-        if (m_activeTool == "select" && m_hoveredObjectId != 0 && m_rootCell) {
-            QVector<WorldLineSegment> previewSegments;
-            if (m_rootCell->collectOutlineSegmentsByObjectId(m_hoveredObjectId, previewSegments)) {
-                drawHoverOutline(painter, previewSegments);
-            }
-        }
+        // Selection and hover are a separate overlay pass so that changing
+        // them never invalidates the backend's cached geometry.
+        m_renderBackend->drawOverlay(painter, buildOverlayItems(), size());
 
         m_renderBackend->endFrame(painter, size());
 
     }
 
     void keyPressEvent(QKeyEvent* event) override {
+        dispatchPendingMove();
         if ((event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace)
-            && m_selectedObjectId != 0) {
-            emit objectDeletionRequested(m_selectedObjectId);
-            m_selectedObjectId = 0;
-            update();
+            && !m_selection.isEmpty()) {
+            emit selectionDeletionRequested();
             event->accept();
             return;
         }
@@ -787,21 +997,23 @@ protected:
     }
 
     void mousePressEvent(QMouseEvent* event) override {
+        dispatchPendingMove();
         if (event->button() == Qt::LeftButton) {
             const QPointF world = screenToWorld(mouseEventPoint(event));
             const qint64 worldX = static_cast<qint64>(world.x());
             const qint64 worldY = static_cast<qint64>(world.y());
 
             if (m_activeTool == "select") {
-                handleSelectionClick(worldX, worldY);
+                // Click vs. rubber-band is decided on release.
+                m_selectPressPending = true;
+                m_rubberBandActive = false;
+                m_selectPressScreenPoint = mouseEventPoint(event);
+                m_rubberBandCurrentScreenPoint = m_selectPressScreenPoint;
                 event->accept();
                 return;
             }
 
-            emit commandRequested(QString("canvas press %1 %2 1")
-                                      .arg(worldX)
-                                      .arg(worldY),
-                                true);
+            emitCanvasEvent(CanvasEventCommand::Kind::CanvasPress, worldX, worldY, 1, true);
         }
 
         if (event->button() == Qt::MiddleButton) {
@@ -813,38 +1025,27 @@ protected:
     }
 
     void mouseMoveEvent(QMouseEvent* event) override {
-        // Move events carry current cursor position + left-button state.
-        const QPointF world = screenToWorld(mouseEventPoint(event));
-        const qint64 worldX = static_cast<qint64>(world.x());
-        const qint64 worldY = static_cast<qint64>(world.y());
-        emit mouseWorldPositionChanged(worldX, worldY, true);
-        const bool leftDown = event->buttons() & Qt::LeftButton;
-
-        if (m_activeTool == "select") {
-            m_hoveredObjectId = hoveredSelectableObjectIdAt(worldX, worldY);
-            update();
-        }
-
-        emit commandRequested(QString("canvas move %1 %2 %3")
-                                  .arg(worldX)
-                                  .arg(worldY)
-                                  .arg(leftDown ? 1 : 0),
-                            false);
-
-        // Middle-button drag emits view pan commands.
-        if (m_middlePanning && (event->buttons() & Qt::MiddleButton)) {
-            const QPointF delta = mouseEventPoint(event) - m_lastPanPoint;
-            m_lastPanPoint = mouseEventPoint(event);
-            emit commandRequested(QString("view pan %1 %2")
-                                      .arg(delta.x())
-                                      .arg(delta.y()),
-                                false);
+        // Moves are coalesced: only the latest position is dispatched, at
+        // most once per display frame. The first move after a quiet period
+        // goes out at once.
+        m_pendingMovePoint = mouseEventPoint(event);
+        m_pendingMoveButtons = event->buttons();
+        m_movePending = true;
+        if (!m_moveDispatchTimer.isActive()) {
+            const int interval = moveDispatchIntervalMs();
+            const qint64 sinceLastDispatch = m_lastMoveDispatch.isValid() ? m_lastMoveDispatch.elapsed() : interval;
+            if (sinceLastDispatch >= interval) {
+                dispatchPendingMove();
+            } else {
+                m_moveDispatchTimer.start(static_cast<int>(interval - sinceLastDispatch));
+            }
         }
 
         QOpenGLWidget::mouseMoveEvent(event);
     }
 
     void leaveEvent(QEvent* event) override {
+        dispatchPendingMove();
         emit mouseWorldPositionChanged(0, 0, false);
         if (m_hoveredObjectId != 0) {
             m_hoveredObjectId = 0;
@@ -854,12 +1055,39 @@ protected:
     }
 
     void mouseReleaseEvent(QMouseEvent* event) override {
+        dispatchPendingMove();
         if (event->button() == Qt::LeftButton) {
             const QPointF world = screenToWorld(mouseEventPoint(event));
-            emit commandRequested(QString("canvas release %1 %2 1")
-                                      .arg(static_cast<qint64>(world.x()))
-                                      .arg(static_cast<qint64>(world.y())),
-                                false);
+            if (m_activeTool == "select" && m_selectPressPending) {
+                const bool additive = event->modifiers() & Qt::ShiftModifier;
+                if (m_rubberBandActive) {
+                    // Route box selection through Tcl so it lands in the
+                    // transcript. Dragging rightwards selects enclosed objects
+                    // only; dragging leftwards also picks up crossing ones.
+                    const QPointF pressWorld = screenToWorld(m_selectPressScreenPoint);
+                    const bool enclosing = world.x() >= pressWorld.x();
+                    emit commandRequested(QString("select box %1 %2 %3 %4 %5%6")
+                                              .arg(static_cast<qint64>(pressWorld.x()))
+                                              .arg(static_cast<qint64>(pressWorld.y()))
+                                              .arg(static_cast<qint64>(world.x()))
+                                              .arg(static_cast<qint64>(world.y()))
+                                              .arg(enclosing ? "-inside" : "-touch")
+                                              .arg(additive ? " -add" : ""),
+                                        false);
+                } else {
+                    handleSelectionClick(static_cast<qint64>(world.x()),
+                                         static_cast<qint64>(world.y()),
+                                         additive);
+                }
+                m_selectPressPending = false;
+                m_rubberBandActive = false;
+                update();
+            }
+            emitCanvasEvent(CanvasEventCommand::Kind::CanvasRelease,
+                            static_cast<qint64>(world.x()),
+                            static_cast<qint64>(world.y()),
+                            1,
+                            false);
         }
 
         if (event->button() == Qt::MiddleButton) {
@@ -870,16 +1098,77 @@ protected:
     }
 
     void wheelEvent(QWheelEvent* event) override {
+        dispatchPendingMove();
         const QPointF pos = wheelEventPoint(event);
-        emit commandRequested(QString("view zoom %1 %2 %3")
-                                  .arg(event->angleDelta().y())
-                                  .arg(pos.x())
-                                  .arg(pos.y()),
-                            false);
+        emitCanvasEvent(CanvasEventCommand::Kind::ViewZoom, event->angleDelta().y(), pos.x(), pos.y(), false);
         event->accept();
     }
 
 private:
+    // Sends the latest coalesced move, if any: status position, select-tool
+    // hover and rubber band, canvas move and middle-drag pan. Press,
+    // release, wheel, key and leave events call it first, so Tcl sees every
+    // command in the order the user produced them.
+    void dispatchPendingMove() {
+        m_moveDispatchTimer.stop();
+        if (!m_movePending) {
+            return;
+        }
+        m_movePending = false;
+        m_lastMoveDispatch.start();
+
+        // Move events carry current cursor position + left-button state.
+        const QPointF world = screenToWorld(m_pendingMovePoint);
+        const qint64 worldX = static_cast<qint64>(world.x());
+        const qint64 worldY = static_cast<qint64>(world.y());
+        emit mouseWorldPositionChanged(worldX, worldY, true);
+        const bool leftDown = m_pendingMoveButtons & Qt::LeftButton;
+
+        if (m_activeTool == "select") {
+            if (m_selectPressPending && leftDown && !m_rubberBandActive) {
+                const QPointF dragDelta = m_pendingMovePoint - m_selectPressScreenPoint;
+                m_rubberBandActive = dragDelta.manhattanLength() > kRubberBandStartPixels;
+            }
+            if (m_rubberBandActive) {
+                m_rubberBandCurrentScreenPoint = m_pendingMovePoint;
+                m_hoveredObjectId = 0;
+            } else {
+                m_hoveredObjectId = hoveredSelectableObjectIdAt(worldX, worldY);
+            }
+            update();
+        }
+
+        emitCanvasEvent(CanvasEventCommand::Kind::CanvasMove, worldX, worldY, leftDown ? 1 : 0, false);
+
+        // Middle-button drag emits view pan commands; the delta spans every
+        // move coalesced since the last dispatch.
+        if (m_middlePanning && (m_pendingMoveButtons & Qt::MiddleButton)) {
+            const QPointF delta = m_pendingMovePoint - m_lastPanPoint;
+            m_lastPanPoint = m_pendingMovePoint;
+            emitCanvasEvent(CanvasEventCommand::Kind::ViewPan, delta.x(), delta.y(), 0.0, false);
+        }
+    }
+
+    int moveDispatchIntervalMs() const {
+        const QWindow* handle = window()->windowHandle();
+        const QScreen* screen = handle ? handle->screen() : QGuiApplication::primaryScreen();
+        const double refreshRate = screen && screen->refreshRate() > 0.0 ? screen->refreshRate() : 60.0;
+        return std::max(1, static_cast<int>(1000.0 / refreshRate));
+    }
+
+    void emitCanvasEvent(CanvasEventCommand::Kind kind,
+                         double first,
+                         double second,
+                         double third,
+                         bool requestActivation) {
+        CanvasEventCommand command;
+        command.kind = kind;
+        command.arguments[0] = first;
+        command.arguments[1] = second;
+        command.arguments[2] = third;
+        emit canvasEventRequested(command, requestActivation);
+    }
+
     // Converts world integer coordinates into screen-space doubles.
     QPointF worldToScreen(qint64 x, qint64 y) const {
         return QPointF((static_cast<double>(x) * m_zoom) + m_panX,
@@ -892,140 +1181,127 @@ private:
                        (m_panY - p.y()) / m_zoom);
     }
 
-    QVector<PrimitiveRenderBackend::RenderItem> buildRenderItems(
-        const QVector<SceneRenderPrimitive>& primitives,
-        const RenderDetailLevel detailLevel) {
-        QVector<PrimitiveRenderBackend::RenderItem> items;
-        items.reserve(primitives.size());
-
-        for (const SceneRenderPrimitive& primitive : primitives) {
-            const LayerDefinition* layer = layerForPrimitive(primitive);
-            if (!layer || !layer->visible || primitive.polygonVertices.isEmpty()) {
-                continue;
-            }
-
-            PrimitiveRenderBackend::RenderItem item;
-            item.polygon.reserve(primitive.polygonVertices.size());
-            for (const WorldPoint& vertex : primitive.polygonVertices) {
-                item.polygon.push_back(worldToScreen(vertex.x, vertex.y));
-            }
-
-            item.selected = primitive.objectId == m_selectedObjectId;
-            item.preview = primitive.preview;
-            item.detailLevel = detailLevel == RenderDetailLevel::Detailed
-                                   ? 0
-                                   : detailLevel == RenderDetailLevel::Simplified ? 1 : 2;
-            item.tinyOnScreen = item.polygon.boundingRect().width() < 1.0
-                                && item.polygon.boundingRect().height() < 1.0;
-
-            item.fillColor = layer->color;
-            if (item.selected) {
-                item.fillColor = item.fillColor.lighter(130);
-            }
-            item.fillColor.setAlpha(item.preview ? 90 : 140);
-
-            item.outlineColor = layer->color;
-            item.outlineColor.setAlpha(item.preview ? 180 : 220);
-            if (item.selected) {
-                item.outlineColor = QColor("#ffffff");
-                item.outlineColor.setAlpha(255);
-            }
-
-            item.pattern = layer->pattern;
-            item.patternBrush = brushForFillColor(item.fillColor, layer->pattern);
-            items.push_back(std::move(item));
+    bool appendObjectOverlay(quint64 objectId,
+                             const QColor& color,
+                             bool dashed,
+                             QVector<PrimitiveRenderBackend::OverlayItem>& outItems) const {
+        QVector<WorldLineSegment> segments;
+        if (!m_rootCell || !m_rootCell->collectOutlineSegmentsByObjectId(objectId, segments)) {
+            return false;
         }
 
-        return items;
-    }
-
-    RenderDetailLevel currentDetailLevel() const {
-        if (m_zoom < 0.30) {
-            return RenderDetailLevel::Coarse;
-        }
-        if (m_zoom < 1.0) {
-            return RenderDetailLevel::Simplified;
+        PrimitiveRenderBackend::OverlayItem item;
+        item.color = color;
+        item.dashed = dashed;
+        item.lineWidth = 2;
+        item.segments.reserve(segments.size());
+        for (const WorldLineSegment& segment : segments) {
+            item.segments.push_back(QLineF(worldToScreen(segment.x1, segment.y1),
+                                           worldToScreen(segment.x2, segment.y2)));
         }
-        return RenderDetailLevel::Detailed;
+        outItems.push_back(std::move(item));
+        return true;
     }
 
-    QBrush brushForFillColor(const QColor& fillColor, const QString& pattern) {
-        const QString cacheKey = QString("%1|%2").arg(fillColor.name(QColor::HexArgb), pattern);
-        const auto it = m_fillBrushCache.constFind(cacheKey);
-        if (it != m_fillBrushCache.cend()) {
-            return it.value();
+    // All selected outlines share one overlay item so the backend draws them
+    // in a single batch; only objects in the visible window are visited.
+    void appendSelectionOverlay(QVector<PrimitiveRenderBackend::OverlayItem>& outItems) const {
+        if (!m_rootCell || m_selection.isEmpty()) {
+            return;
         }
 
-        const QBrush brush = patternBrushFor(fillColor, pattern);
-        m_fillBrushCache.insert(cacheKey, brush);
-        return brush;
-    }
-
-    void drawHoverOutline(QPainter& painter, const QVector<WorldLineSegment>& segments) {
-        painter.setPen(QPen(QColor("#ffd400"), 2, Qt::DashLine));
-        painter.setBrush(Qt::NoBrush);
+        qint64 minX = 0;
+        qint64 minY = 0;
+        qint64 maxX = 0;
+        qint64 maxY = 0;
+        visibleWorldBounds(minX, minY, maxX, maxY);
+
+        QVector<WorldLineSegment> segments;
+        m_rootCell->queryRegion(
+            minX, minY, maxX, maxY, RegionQueryMode::Touch,
+            [this](quint32 layerNameId, quint32 layerTypeId) {
+                return isSelectableLayer(layerNameId, layerTypeId);
+            },
+            [this, &segments](const LayoutObjectModel& object) {
+                if (m_selection.contains(object.objectId())) {
+                    object.appendOutlineSegments(segments);
+                }
+                return true;
+            });
+        if (segments.isEmpty()) {
+            return;
+        }
 
+        PrimitiveRenderBackend::OverlayItem item;
+        item.color = QColor("#ffffff");
+        item.dashed = false;
+        item.lineWidth = 2;
+        item.segments.reserve(segments.size());
         for (const WorldLineSegment& segment : segments) {
-            const QPointF p1 = worldToScreen(segment.x1, segment.y1);
-            const QPointF p2 = worldToScreen(segment.x2, segment.y2);
-            painter.drawLine(p1, p2);
+            item.segments.push_back(QLineF(worldToScreen(segment.x1, segment.y1),
+                                           worldToScreen(segment.x2, segment.y2)));
         }
+        outItems.push_back(std::move(item));
     }
 
-    const LayerDefinition* layerForPrimitive(const SceneRenderPrimitive& primitive) const {
-        const auto it = m_layerIndexByCode.constFind(layerCodeKey(primitive.layerNameId, primitive.layerTypeId));
-        if (it == m_layerIndexByCode.cend()) {
-            return nullptr;
-        }
+    void appendRubberBandOverlay(QVector<PrimitiveRenderBackend::OverlayItem>& outItems) const {
+        const QRectF band = QRectF(m_selectPressScreenPoint, m_rubberBandCurrentScreenPoint).normalized();
 
-        const int index = it.value();
-        if (index < 0 || index >= m_layers.size()) {
-            return nullptr;
-        }
-
-        return &m_layers[index];
+        PrimitiveRenderBackend::OverlayItem item;
+        item.color = QColor("#ffffff");
+        item.dashed = true;
+        item.lineWidth = 1;
+        item.segments = {QLineF(band.topLeft(), band.topRight()),
+                         QLineF(band.topRight(), band.bottomRight()),
+                         QLineF(band.bottomRight(), band.bottomLeft()),
+                         QLineF(band.bottomLeft(), band.topLeft())};
+        outItems.push_back(std::move(item));
     }
 
-    const LayerDefinition* layerForRectangle(const DrawnRectangle& rectangle) const {
-        const auto it = m_layerIndexByCode.constFind(layerCodeKey(rectangle.layerNameId, rectangle.layerTypeId));
-        if (it == m_layerIndexByCode.cend()) {
-            return nullptr;
+    QVector<PrimitiveRenderBackend::OverlayItem> buildOverlayItems() const {
+        QVector<PrimitiveRenderBackend::OverlayItem> items;
+        appendSelectionOverlay(items);
+
+        if (m_activeTool == "select" && m_hoveredObjectId != 0) {
+            appendObjectOverlay(m_hoveredObjectId, QColor("#ffd400"), true, items);
         }
 
-        const int index = it.value();
-        if (index < 0 || index >= m_layers.size()) {
-            return nullptr;
+        if (m_rubberBandActive) {
+            appendRubberBandOverlay(items);
         }
 
-        return &m_layers[index];
+        return items;
     }
 
-    void rebuildLayerLookup() {
-        m_layerIndexByCode.clear();
+    const LayerDefinition* layerForCode(quint32 layerNameId, quint32 layerTypeId) const {
+        return m_renderItemBuilder.layerForCode(layerNameId, layerTypeId);
+    }
 
-        // Lookup index is independent of palette order and optimized for ID-based queries.
-        for (int i = 0; i < m_layers.size(); ++i) {
-            m_layerIndexByCode.insert(layerCodeKey(m_layers[i].nameId, m_layers[i].typeId), i);
-        }
+    bool isVisibleLayer(quint32 layerNameId, quint32 layerTypeId) const {
+        const LayerDefinition* layer = layerForCode(layerNameId, layerTypeId);
+        return layer && layer->visible;
     }
 
-    bool isSelectableRectangle(const DrawnRectangle& rectangle) const {
-        const LayerDefinition* layer = layerForRectangle(rectangle);
+    bool isSelectableLayer(quint32 layerNameId, quint32 layerTypeId) const {
+        const LayerDefinition* layer = layerForCode(layerNameId, layerTypeId);
         return layer && layer->visible && layer->selectable;
     }
 
+    // Shapes follow their layer. Instances have no layer of their own and
+    // are picked by their placed geometry, whatever layers it is on.
+    bool isSelectableObject(const LayoutObjectModel& object) const {
+        quint32 layerNameId = 0;
+        quint32 layerTypeId = 0;
+        return !object.tryGetLayer(layerNameId, layerTypeId) || isSelectableLayer(layerNameId, layerTypeId);
+    }
+
     bool isSelectableObjectId(quint64 objectId) const {
         if (!m_rootCell || objectId == 0) {
             return false;
         }
 
         const LayoutObjectModel* object = m_rootCell->findObjectById(objectId);
-        if (!object) {
-            return false;
-        }
-
-        const DrawnRectangle* rectangle = object->asRectangle();
-        return rectangle && isSelectableRectangle(*rectangle);
+        return object && isSelectableObject(*object);
     }
 
     QVector<SceneRenderPrimitive> flattenedRenderPrimitives() const {
@@ -1036,7 +1312,13 @@ private:
             qint64 maxX = 0;
             qint64 maxY = 0;
             visibleWorldBounds(minX, minY, maxX, maxY);
-            m_rootCell->collectRenderPrimitivesInRect(minX, minY, maxX, maxY, primitives);
+            // Hidden layers are masked at the index level, so their shapes
+            // are never extracted.
+            m_rootCell->collectRenderPrimitivesInRect(
+                minX, minY, maxX, maxY, primitives,
+                [this](quint32 layerNameId, quint32 layerTypeId) {
+                    return isVisibleLayer(layerNameId, layerTypeId);
+                });
         }
 
         if (m_editPreviewEnabled) {
@@ -1046,6 +1328,19 @@ private:
         return primitives;
     }
 
+    bool isWorldRectVisible(const LayoutObjectModel::Bounds& bounds) const {
+        qint64 minX = 0;
+        qint64 minY = 0;
+        qint64 maxX = 0;
+        qint64 maxY = 0;
+        visibleWorldBounds(minX, minY, maxX, maxY);
+        // Outlines are stroked a few pixels wide, so shapes just off screen
+        // can still touch it.
+        const qint64 margin = m_zoom > 0.0 ? static_cast<qint64>(std::ceil(kOutlineMarginPixels / m_zoom)) : 0;
+        return bounds.maxX >= minX - margin && bounds.minX <= maxX + margin &&
+               bounds.maxY >= minY - margin && bounds.minY <= maxY + margin;
+    }
+
     void visibleWorldBounds(qint64& minX, qint64& minY, qint64& maxX, qint64& maxY) const {
         const QPointF topLeftWorld = screenToWorld(QPointF(0.0, 0.0));
         const QPointF bottomRightWorld = screenToWorld(QPointF(width(), height()));
@@ -1066,8 +1361,10 @@ private:
             x,
             y,
             [this](const LayoutObjectModel& object) {
-                const DrawnRectangle* rectangle = object.asRectangle();
-                return rectangle && isSelectableRectangle(*rectangle);
+                return isSelectableObject(object);
+            },
+            [this](quint32 layerNameId, quint32 layerTypeId) {
+                return isSelectableLayer(layerNameId, layerTypeId);
             });
         if (objectMatches.isEmpty()) {
             return candidates;
@@ -1085,11 +1382,25 @@ private:
         return candidates.isEmpty() ? 0 : candidates.front();
     }
 
-    void handleSelectionClick(qint64 x, qint64 y) {
+    // Plain clicks replace the selection and cycle through stacked objects on
+    // repeated clicks at the same point; toggle clicks flip the topmost object.
+    void handleSelectionClick(qint64 x, qint64 y, bool toggle) {
 
         const QVector<quint64> candidates = selectableObjectCandidatesAt(x, y);
+        if (toggle) {
+            if (!candidates.isEmpty()) {
+                m_selection.toggle(candidates.front());
+            }
+            m_cycleSelectedObjectId = 0;
+            m_lastSelectionCandidateIds.clear();
+            m_hasSelectionPoint = false;
+            update();
+            return;
+        }
+
         if (candidates.isEmpty()) {
-            m_selectedObjectId = 0;
+            m_selection.clear();
+            m_cycleSelectedObjectId = 0;
             m_hoveredObjectId = 0;
             m_lastSelectionCandidateIds.clear();
             m_lastSelectionPoint = QPointF();
@@ -1102,28 +1413,45 @@ private:
         const bool sameCandidates = samePoint && (candidates == m_lastSelectionCandidateIds);
 
         if (!sameCandidates) {
-            m_selectedObjectId = candidates.front();
+            m_cycleSelectedObjectId = candidates.front();
             m_hoveredObjectId = candidates.size() > 1 ? candidates[1] : candidates.front();
         } else {
-            int currentCandidate = candidates.indexOf(m_selectedObjectId);
+            int currentCandidate = candidates.indexOf(m_cycleSelectedObjectId);
             if (currentCandidate < 0) {
                 currentCandidate = 0;
             }
 
             const int nextSelectedCandidate = (currentCandidate + 1) % candidates.size();
-            m_selectedObjectId = candidates[nextSelectedCandidate];
+            m_cycleSelectedObjectId = candidates[nextSelectedCandidate];
             m_hoveredObjectId = candidates[(nextSelectedCandidate + 1) % candidates.size()];
         }
 
+        m_selection.clear();
+        m_selection.insert(m_cycleSelectedObjectId);
         m_lastSelectionCandidateIds = candidates;
         m_lastSelectionPoint = selectionPoint;
         m_hasSelectionPoint = true;
         update();
     }
 
+    // Drops IDs that are gone or now sit on hidden/unselectable layers.
     void validateSelection() {
-        if (!isSelectableObjectId(m_selectedObjectId)) {
-            m_selectedObjectId = 0;
+        if (m_selection.isEmpty()) {
+            return;
+        }
+
+        QVector<quint64> staleObjectIds;
+        m_selection.forEach([this, &staleObjectIds](quint64 objectId) {
+            if (!isSelectableObjectId(objectId)) {
+                staleObjectIds.push_back(objectId);
+            }
+            return true;
+        });
+        for (quint64 objectId : staleObjectIds) {
+            m_selection.remove(objectId);
+        }
+        if (!m_selection.contains(m_cycleSelectedObjectId)) {
+            m_cycleSelectedObjectId = 0;
         }
     }
 
@@ -1143,72 +1471,64 @@ private:
         const double minimumPixelSpacing = 10.0;
         const double basePixelSpacing = m_gridSize * m_zoom;
         const double multiplier = std::max(1.0, std::ceil(minimumPixelSpacing / basePixelSpacing));
-        const double visibleStep = m_gridSize * multiplier;
 
-        const QPointF topLeftWorld = screenToWorld(QPointF(0.0, 0.0));
-        const QPointF bottomRightWorld = screenToWorld(QPointF(width(), height()));
-
-        const double worldMinX = std::min(topLeftWorld.x(), bottomRightWorld.x());
-        const double worldMaxX = std::max(topLeftWorld.x(), bottomRightWorld.x());
-        const double worldMinY = std::min(topLeftWorld.y(), bottomRightWorld.y());
-        const double worldMaxY = std::max(topLeftWorld.y(), bottomRightWorld.y());
-
-        const double firstGridX = std::floor(worldMinX / visibleStep) * visibleStep;
-        const double firstGridY = std::floor(worldMinY / visibleStep) * visibleStep;
-
-        painter.setPen(QPen(QColor("#5a5a5a"), 1));
-        for (double worldX = firstGridX; worldX <= worldMaxX; worldX += visibleStep) {
-            const double screenX = (worldX * m_zoom) + m_panX;
-            for (double worldY = firstGridY; worldY <= worldMaxY; worldY += visibleStep) {
-                const double screenY = m_panY - (worldY * m_zoom);
-                painter.drawPoint(QPointF(screenX, screenY));
-            }
-        }
-
-        painter.setPen(QPen(QColor("#5a5a5a"), 1));
-        const double originScreenX = m_panX;
-        const double originScreenY = m_panY;
-
-        if (originScreenX >= 0.0 && originScreenX <= width()) {
-            painter.drawLine(QPointF(originScreenX, 0.0), QPointF(originScreenX, height()));
-        }
-
-        if (originScreenY >= 0.0 && originScreenY <= height()) {
-            painter.drawLine(QPointF(0.0, originScreenY), QPointF(width(), originScreenY));
-        }
+        // Grid points sit at pan + k * step on screen; keep the offsets
+        // reduced into [0, step) in double precision so the backend never
+        // sees large pan values.
+        PrimitiveRenderBackend::GridParams grid;
+        grid.stepPixels = basePixelSpacing * multiplier;
+        grid.offsetX = m_panX - (std::floor(m_panX / grid.stepPixels) * grid.stepPixels);
+        grid.offsetY = m_panY - (std::floor(m_panY / grid.stepPixels) * grid.stepPixels);
+        grid.originX = m_panX;
+        grid.originY = m_panY;
+        grid.color = QColor("#5a5a5a");
+        m_renderBackend->drawGrid(painter, grid, size());
     }
 
     const LayoutSceneNode* m_rootCell{nullptr};
-    QVector<LayerDefinition> m_layers;
-    QHash<quint64, int> m_layerIndexByCode;
-    QHash<QString, QBrush> m_fillBrushCache;
+    RenderItemBuilder m_renderItemBuilder;
     CanvasRenderBackendType m_backendType{CanvasRenderBackendType::Raster};
     std::unique_ptr<PrimitiveRenderBackend> m_renderBackend;
     SceneRenderPrimitive m_editPreview;
     QString m_activeTool{"none"};
 
-    quint64 m_selectedObjectId{0};
+    static constexpr double kRubberBandStartPixels = 4.0;
+    static constexpr double kOutlineMarginPixels = 4.0;
+
+    LayoutSelectionSet m_selection;
+    quint64 m_cycleSelectedObjectId{0};
     quint64 m_hoveredObjectId{0};
     QVector<quint64> m_lastSelectionCandidateIds;
     QPointF m_lastSelectionPoint;
     bool m_hasSelectionPoint{false};
+    bool m_selectPressPending{false};
+    bool m_rubberBandActive{false};
+    QPointF m_selectPressScreenPoint;
+    QPointF m_rubberBandCurrentScreenPoint;
 
     bool m_editPreviewEnabled{false};
     bool m_middlePanning{false};
 
     QPointF m_lastPanPoint;
+
+    // Latest mouse move not yet dispatched (see dispatchPendingMove).
+    QTimer m_moveDispatchTimer;
+    QElapsedTimer m_lastMoveDispatch;
+    QPointF m_pendingMovePoint;
+    Qt::MouseButtons m_pendingMoveButtons;
+    bool m_movePending{false};
     double m_zoom{1.0};
     double m_panX{0.0};
     double m_panY{0.0};
     double m_gridSize{40.0};
 };
 
-LayoutEditorWindow::LayoutEditorWindow(QWidget* parent)
+LayoutEditorWindow::LayoutEditorWindow(std::shared_ptr<LayoutDocument> document, QWidget* parent)
     : QMainWindow(parent),
       m_layerTable(new QTableWidget()),
       m_canvas(new LayoutCanvas()),
       m_statusLabel(new QLabel()),
-      m_rootCell(std::make_unique<LayoutSceneNode>()) {
+      m_document(std::move(document)) {
     refreshWindowTitle();
     resize(1100, 700);
 
@@ -1266,14 +1586,23 @@ LayoutEditorWindow::LayoutEditorWindow(QWidget* parent)
     connect(m_layerTable, &QTableWidget::currentCellChanged,
             this, [this](int currentRow, int, int previousRow, int) { onCurrentRowChanged(currentRow, previousRow); });
     connect(m_canvas, &LayoutCanvas::commandRequested, this, &LayoutEditorWindow::commandRequested);
-    connect(m_canvas, &LayoutCanvas::objectDeletionRequested,
-            this, &LayoutEditorWindow::onObjectDeletionRequested);
+    connect(m_canvas, &LayoutCanvas::canvasEventRequested, this, &LayoutEditorWindow::canvasEventRequested);
+    connect(m_canvas, &LayoutCanvas::selectionDeletionRequested,
+            this, [this]() { deleteSelection(); });
     connect(m_canvas, &LayoutCanvas::mouseWorldPositionChanged,
             this, &LayoutEditorWindow::onMouseWorldPositionChanged);
 
+    // Document edits may come from any window viewing it.
+    connect(m_document.get(), &LayoutDocument::objectsChanged, m_canvas, &LayoutCanvas::onObjectsChanged);
+    connect(m_document.get(), &LayoutDocument::rootCellReplaced,
+            this, [this]() {
+                m_canvas->clearSelection();
+                m_canvas->setRootCell(m_document->rootCell());
+            });
+
     qApp->installEventFilter(this);
 
-    m_canvas->setRootCell(m_rootCell.get());
+    m_canvas->setRootCell(m_document->rootCell());
     refreshStatusLabel();
 }
 
@@ -1285,6 +1614,34 @@ QSize LayoutEditorWindow::canvasViewportSize() const {
     return m_canvas->size();
 }
 
+qint64 LayoutEditorWindow::selectionCount() const {
+    return m_canvas->selectionCount();
+}
+
+qint64 LayoutEditorWindow::clearSelection() {
+    return m_canvas->clearSelection();
+}
+
+qint64 LayoutEditorWindow::selectInRect(qint64 x1,
+                                        qint64 y1,
+                                        qint64 x2,
+                                        qint64 y2,
+                                        RegionQueryMode mode,
+                                        bool additive) {
+    return m_canvas->selectInRect(std::min(x1, x2), std::min(y1, y2),
+                                  std::max(x1, x2), std::max(y1, y2),
+                                  mode,
+                                  additive);
+}
+
+qint64 LayoutEditorWindow::selectAll() {
+    return m_canvas->selectAll();
+}
+
+qint64 LayoutEditorWindow::deleteSelection() {
+    return m_document->removeObjects(m_canvas->selectedObjectIds());
+}
+
 void LayoutEditorWindow::setEditorIdentity(const int editorId, const bool isActive) {
     m_editorId = editorId;
     m_isActiveEditor = isActive;
@@ -1477,21 +1834,9 @@ void LayoutEditorWindow::onPrimitiveCommitted(const SceneRenderPrimitive& primit
         return;
     }
 
-    m_rootCell->addObject(object);
-    m_canvas->setRootCell(m_rootCell.get());
+    m_document->addObjects({object});
 }
 
-void LayoutEditorWindow::onObjectDeletionRequested(quint64 objectId) {
-    if (objectId == 0) {
-        return;
-    }
-
-    if (!m_rootCell->removeObjectById(objectId)) {
-        return;
-    }
-
-    m_canvas->setRootCell(m_rootCell.get());
-}
 
 void LayoutEditorWindow::onCellChanged(int row, int column) {
     if (m_internalUpdate || row < 0 || row >= m_layers.size()) {
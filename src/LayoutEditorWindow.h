@@ -12,7 +12,27 @@
 
 class QLabel;
 class LayoutCanvas;
-class LayoutSceneNode;
+class LayoutDocument;
+
+// Pointer and wheel events routed to Tcl as values instead of command text,
+// so the console can evaluate them without formatting and reparsing a string
+// per event. Each kind stands for the Tcl command in its comment.
+struct CanvasEventCommand {
+    enum class Kind {
+        CanvasPress,   // canvas press <x> <y> <button>
+        CanvasMove,    // canvas move <x> <y> <leftDown>
+        CanvasRelease, // canvas release <x> <y> <button>
+        ViewPan,       // view pan <dx> <dy>
+        ViewZoom,      // view zoom <wheelDelta> <anchorX> <anchorY>
+    };
+    static constexpr int kKindCount = 5;
+    static constexpr int kMaxArguments = 3;
+
+    Kind kind{Kind::CanvasMove};
+    // Arguments in command order. World coordinates, buttons and the wheel
+    // delta are whole numbers.
+    double arguments[kMaxArguments]{};
+};
 
 // LayoutEditorWindow is the visual editor child window.
 //
@@ -21,16 +41,27 @@ class LayoutSceneNode;
 //  - right drawing canvas widget
 //  - status line for active layer/tool info
 //
+// Committed geometry lives in a LayoutDocument that other windows may share;
+// the window holds only view state and repaints on the document's signals.
+//
 // The window itself does not apply business logic directly; user interactions
 // are forwarded as Tcl command strings through commandRequested().
 class LayoutEditorWindow : public QMainWindow {
     Q_OBJECT
 public:
-    explicit LayoutEditorWindow(QWidget* parent = nullptr);
+    explicit LayoutEditorWindow(std::shared_ptr<LayoutDocument> document, QWidget* parent = nullptr);
     ~LayoutEditorWindow() override;
 
     QSize canvasViewportSize() const;
 
+    // Selection operations; each returns the number of objects affected.
+    qint64 selectionCount() const;
+    qint64 clearSelection();
+    qint64 selectInRect(qint64 x1, qint64 y1, qint64 x2, qint64 y2, RegionQueryMode mode, bool additive);
+    qint64 selectAll();
+    // Removes the selected objects from the document.
+    qint64 deleteSelection();
+
 public slots:
     void setEditorIdentity(int editorId, bool isActive);
 
@@ -50,13 +81,14 @@ public slots:
 signals:
     // Single dispatch point for UI->Tcl command routing.
     void commandRequested(const QString& command, bool requestActivation);
+    // Fast path for high-frequency pointer events; same routing semantics.
+    void canvasEventRequested(const CanvasEventCommand& event, bool requestActivation);
     void activationRequested();
 
 private slots:
     // Table interaction handlers.
     void onCellChanged(int row, int column);
     void onCurrentRowChanged(int currentRow, int previousRow);
-    void onObjectDeletionRequested(quint64 objectId);
     void onMouseWorldPositionChanged(qint64 worldX, qint64 worldY, bool insideCanvas);
 
 protected:
@@ -85,6 +117,6 @@ private:
     int m_editorId{0};
     bool m_isActiveEditor{false};
 
-    // Root scene container for committed geometry.
-    std::unique_ptr<LayoutSceneNode> m_rootCell;
+    // Shared with every other window viewing the same layout.
+    std::shared_ptr<LayoutDocument> m_document;
 };
@@ -0,0 +1,310 @@
+#include "LayoutFileLoader.h"
+
+#include "GdsStreamReader.h"
+#include "LayoutSnapshot.h"
+#include "OasisStreamReader.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum LinkState { kUnlinked = 0, kLinking = 1, kLinked = 2 };
+
+int loadWorkerCount(const int taskCount) {
+    int workers = qEnvironmentVariableIntValue("LAYOUT2_LOAD_THREADS");
+    if (workers <= 0) {
+        workers = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    return std::max(1, std::min(workers, taskCount));
+}
+
+// Helper threads for runParallel, started on first use and kept until exit.
+// One job runs at a time; a caller that finds the pool busy (another
+// thread's job, or a task calling runParallel) runs its tasks itself.
+class LoadWorkerPool {
+public:
+    static LoadWorkerPool& instance() {
+        static LoadWorkerPool pool;
+        return pool;
+    }
+
+    ~LoadWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void run(const int taskCount, const std::function<bool(int)>& task) {
+        const int helpers = std::min(static_cast<int>(m_threads.size()), taskCount - 1);
+        bool idle = false;
+        if (helpers <= 0 || !m_busy.compare_exchange_strong(idle, true)) {
+            std::atomic<int> nextTask{0};
+            std::atomic<bool> failed{false};
+            claimTasks(task, taskCount, nextTask, failed);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_taskCount = taskCount;
+            m_nextTask.store(0, std::memory_order_relaxed);
+            m_failed.store(false, std::memory_order_relaxed);
+            m_openSlots = helpers;
+            m_busyHelpers = helpers;
+        }
+        m_wake.notify_all();
+
+        claimTasks(task, taskCount, m_nextTask, m_failed);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_busyHelpers == 0; });
+        m_task = nullptr;
+        m_busy.store(false);
+    }
+
+private:
+    LoadWorkerPool() {
+        const int helpers = loadWorkerCount(std::numeric_limits<int>::max()) - 1;
+        m_threads.reserve(helpers);
+        for (int i = 0; i < helpers; ++i) {
+            m_threads.emplace_back(&LoadWorkerPool::workerLoop, this);
+        }
+    }
+
+    static void claimTasks(const std::function<bool(int)>& task,
+                           const int taskCount,
+                           std::atomic<int>& nextTask,
+                           std::atomic<bool>& failed) {
+        while (!failed.load(std::memory_order_relaxed)) {
+            const int taskIndex = nextTask.fetch_add(1, std::memory_order_relaxed);
+            if (taskIndex >= taskCount) {
+                return;
+            }
+            if (!task(taskIndex)) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this]() { return m_stopping || m_openSlots > 0; });
+            if (m_stopping) {
+                return;
+            }
+
+            --m_openSlots;
+            const std::function<bool(int)>& task = *m_task;
+            const int taskCount = m_taskCount;
+            lock.unlock();
+            claimTasks(task, taskCount, m_nextTask, m_failed);
+            lock.lock();
+            if (--m_busyHelpers == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    // Set by the caller for the whole job.
+    std::atomic<bool> m_busy{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<bool(int)>* m_task{nullptr};
+    int m_taskCount{0};
+    // Helpers still to join the job, and helpers that have not left it.
+    int m_openSlots{0};
+    int m_busyHelpers{0};
+    bool m_stopping{false};
+    std::atomic<int> m_nextTask{0};
+    std::atomic<bool> m_failed{false};
+};
+
+void uniteBounds(LayoutObjectModel::Bounds& bounds, bool& hasBounds, const LayoutObjectModel::Bounds& other) {
+    if (!hasBounds) {
+        bounds = other;
+        hasBounds = true;
+        return;
+    }
+
+    bounds.minX = std::min(bounds.minX, other.minX);
+    bounds.minY = std::min(bounds.minY, other.minY);
+    bounds.maxX = std::max(bounds.maxX, other.maxX);
+    bounds.maxY = std::max(bounds.maxY, other.maxY);
+}
+
+// Turns a measured cell into a lazy node once its masters are linked.
+// Returns false for a cell without any extent, which stays a regular node.
+bool makeLazyCell(const int cellIndex,
+                  LayoutDecodedCell& cell,
+                  const QVector<std::shared_ptr<LayoutSceneNode>>& masters,
+                  const std::shared_ptr<LayoutLazyCellSource>& lazySource) {
+    LayoutObjectModel::Bounds bounds = cell.shapeBounds;
+    bool hasBounds = cell.hasShapeBounds;
+    QSet<const LayoutSceneNode*> seenMasters;
+    QVector<std::shared_ptr<const LayoutSceneNode>> distinctMasters;
+    for (int i = 0; i < cell.placements.size(); ++i) {
+        const LayoutPendingPlacement& placement = cell.placements[i];
+        LayoutObjectModel::Bounds masterBounds;
+        if (masters[i]->tryGetBounds(masterBounds)) {
+            uniteBounds(bounds, hasBounds, InstanceObjectModel::placementBounds(masterBounds,
+                                                                                placement.transform,
+                                                                                placement.columns,
+                                                                                placement.rows,
+                                                                                placement.columnStep,
+                                                                                placement.rowStep));
+        }
+        if (!seenMasters.contains(masters[i].get())) {
+            seenMasters.insert(masters[i].get());
+            distinctMasters.push_back(masters[i]);
+        }
+    }
+
+    if (!hasBounds) {
+        return false;
+    }
+
+    cell.node->setLazyContent(lazySource, cellIndex, bounds, cell.shapeCount + cell.placements.size(),
+                              std::move(distinctMasters));
+    return true;
+}
+
+bool linkCell(const int cellIndex,
+              QVector<LayoutDecodedCell>& cells,
+              const QHash<QString, int>& cellIndexByName,
+              const std::shared_ptr<LayoutLazyCellSource>& lazySource,
+              QVector<int>& linkState,
+              QVector<bool>& referenced,
+              QString& error) {
+    linkState[cellIndex] = kLinking;
+
+    LayoutDecodedCell& cell = cells[cellIndex];
+    QVector<std::shared_ptr<LayoutSceneNode>> masters;
+    masters.reserve(cell.placements.size());
+    for (const LayoutPendingPlacement& placement : cell.placements) {
+        const auto masterIt = cellIndexByName.constFind(placement.masterName);
+        if (masterIt == cellIndexByName.cend()) {
+            error = QString("cell '%1' places undefined cell '%2'").arg(cell.node->name(), placement.masterName);
+            return false;
+        }
+
+        const int masterIndex = masterIt.value();
+        if (linkState[masterIndex] == kLinking) {
+            error = QString("recursive placement of cell '%1'").arg(placement.masterName);
+            return false;
+        }
+        if (linkState[masterIndex] == kUnlinked
+            && !linkCell(masterIndex, cells, cellIndexByName, lazySource, linkState, referenced, error)) {
+            return false;
+        }
+
+        referenced[masterIndex] = true;
+        masters.push_back(cells[masterIndex].node);
+    }
+
+    if (!lazySource || !makeLazyCell(cellIndex, cell, masters, lazySource)) {
+        QVector<std::shared_ptr<LayoutObjectModel>> instances;
+        instances.reserve(cell.placements.size());
+        for (int i = 0; i < cell.placements.size(); ++i) {
+            const LayoutPendingPlacement& placement = cell.placements[i];
+            instances.push_back(std::make_shared<InstanceObjectModel>(masters[i],
+                                                                      placement.transform,
+                                                                      placement.columns,
+                                                                      placement.rows,
+                                                                      placement.columnStep,
+                                                                      placement.rowStep));
+        }
+        cell.node->addObjects(std::move(instances));
+    }
+    cell.placements.clear();
+    linkState[cellIndex] = kLinked;
+    return true;
+}
+
+}
+
+namespace LayoutFileLoader {
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, const bool lazyCells) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    const QByteArray magic = file.read(std::max(OasisStreamReader::kMagicLength, LayoutSnapshot::kMagicLength));
+    file.close();
+
+    if (magic.startsWith(QByteArray(LayoutSnapshot::kMagic, LayoutSnapshot::kMagicLength))) {
+        return LayoutSnapshot::loadFile(filePath, outResult, error, lazyCells);
+    }
+    if (magic.startsWith(QByteArray(OasisStreamReader::kMagic, OasisStreamReader::kMagicLength))) {
+        return OasisStreamReader::loadFile(filePath, outResult, error);
+    }
+    return GdsStreamReader::loadFile(filePath, outResult, error, lazyCells);
+}
+
+void runParallel(const int taskCount, const std::function<bool(int)>& task) {
+    if (taskCount <= 0) {
+        return;
+    }
+    LoadWorkerPool::instance().run(taskCount, task);
+}
+
+bool linkCells(QVector<LayoutDecodedCell>& cells,
+               LayoutLoadResult& outResult,
+               QString& error,
+               const std::shared_ptr<LayoutLazyCellSource>& lazySource) {
+    QHash<QString, int> cellIndexByName;
+    cellIndexByName.reserve(cells.size());
+    for (int i = 0; i < cells.size(); ++i) {
+        const QString name = cells[i].node->name();
+        if (cellIndexByName.contains(name)) {
+            error = QString("duplicate cell '%1'").arg(name);
+            return false;
+        }
+
+        cellIndexByName.insert(name, i);
+        outResult.objectCount += lazySource ? cells[i].shapeCount : cells[i].node->objectCount();
+        outResult.skippedElementCount += cells[i].skippedElements;
+    }
+
+    QVector<int> linkState(cells.size(), kUnlinked);
+    QVector<bool> referenced(cells.size(), false);
+    for (int i = 0; i < cells.size(); ++i) {
+        if (linkState[i] == kUnlinked
+            && !linkCell(i, cells, cellIndexByName, lazySource, linkState, referenced, error)) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < cells.size(); ++i) {
+        if (!referenced[i]) {
+            outResult.topCells.push_back(cells[i].node);
+        }
+    }
+    outResult.cellCount = cells.size();
+    outResult.lazyCells = lazySource != nullptr;
+    return true;
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+#include "LayoutGeometry.h"
+#include "LayoutSceneModel.h"
+
+// LayoutFileLoader holds the pieces shared by the layout stream readers
+// (GdsStreamReader, OasisStreamReader, LayoutSnapshot): the load result, the decode worker
+// pool, and the final link step that turns cell placements into instances.
+//
+// loadFile() picks the reader from the file's magic bytes.
+
+// Summary and top cells of one loaded layout file.
+struct LayoutLoadResult {
+    QString formatName;
+    QString libraryName;
+    double userUnitsPerDatabaseUnit{0.001};
+    double metersPerDatabaseUnit{1e-9};
+    // Cells that no other cell places, in file order.
+    QVector<std::shared_ptr<LayoutSceneNode>> topCells;
+    int cellCount{0};
+    qint64 objectCount{0};
+    qint64 skippedElementCount{0};
+    // Set when cells below the top level load on demand.
+    bool lazyCells{false};
+};
+
+// A cell placement whose master may not have been decoded yet.
+struct LayoutPendingPlacement {
+    QString masterName;
+    LayoutTransform transform;
+    int columns{1};
+    int rows{1};
+    WorldPoint columnStep{0, 0};
+    WorldPoint rowStep{0, 0};
+};
+
+// One decoded cell: its shapes are already in node, placements wait for
+// linkCells().
+struct LayoutDecodedCell {
+    std::shared_ptr<LayoutSceneNode> node;
+    QVector<LayoutPendingPlacement> placements;
+    qint64 skippedElements{0};
+    // Lazy directory pass only: the cell's shapes are measured, not kept.
+    LayoutObjectModel::Bounds shapeBounds;
+    bool hasShapeBounds{false};
+    int shapeCount{0};
+};
+
+namespace LayoutFileLoader {
+
+// lazyCells asks for on-demand cell loading; readers that cannot load cells
+// independently ignore it and load everything.
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, bool lazyCells = false);
+
+// Runs task(i) for every i in [0, taskCount) on the load worker pool; the
+// calling thread takes part. Tasks are claimed in index order, and no new
+// task starts once one has returned false. The pool's threads start on the
+// first call and are reused by every later one, so per-call cost is a
+// wakeup. It has the hardware thread count (LAYOUT2_LOAD_THREADS
+// overrides it) minus the caller. The pool runs one call at a time; a
+// concurrent or nested call runs its tasks on the calling thread alone.
+void runParallel(int taskCount, const std::function<bool(int)>& task);
+
+// Resolves placements by cell name, attaching instances bottom-up so every
+// master's bounds are final before an instance of it is indexed. Fills the
+// cell/object counters and top cells of outResult. Duplicate names,
+// undefined masters and recursive placements are errors.
+//
+// With a lazySource the cells are measured directory entries instead: each
+// becomes a lazy node (cell index = position in cells) whose bounds come
+// from its shape bounds and its placements.
+bool linkCells(QVector<LayoutDecodedCell>& cells,
+               LayoutLoadResult& outResult,
+               QString& error,
+               const std::shared_ptr<LayoutLazyCellSource>& lazySource = nullptr);
+
+}
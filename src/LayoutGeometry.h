@@ -28,6 +28,16 @@ struct WorldPoint {
     qint64 y;
 };
 
+// RegionQueryMode selects how an object's extent is compared to a query rect.
+//  - Inside:  object lies entirely within the rect (edges may coincide).
+//  - Overlap: object and rect share a region of positive area.
+//  - Touch:   object and rect share at least one point, including edges.
+enum class RegionQueryMode {
+    Inside,
+    Overlap,
+    Touch
+};
+
 // SceneRenderPrimitive describes one drawable scene primitive in world space.
 struct SceneRenderPrimitive {
     quint64 objectId;
@@ -0,0 +1,107 @@
+#include "LayoutImageExporter.h"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QPainter>
+#include <QSize>
+
+#include <algorithm>
+#include <cmath>
+
+#include "LayoutSceneModel.h"
+#include "PrimitiveRenderBackend.h"
+
+namespace LayoutImageExporter {
+
+bool exportPng(const LayoutSceneNode& root,
+               const QVector<LayerDefinition>& layers,
+               const QString& filePath,
+               const int width,
+               const int height,
+               const Region* region,
+               Stats& outStats,
+               QString& error) {
+    outStats = Stats{};
+    if (width < 1 || height < 1 || width > kMaxImageSide || height > kMaxImageSide) {
+        error = QString("image size must be between 1 and %1 pixels per side").arg(kMaxImageSide);
+        return false;
+    }
+
+    Region target;
+    double margin = 1.0;
+    if (region) {
+        target.minX = std::min(region->minX, region->maxX);
+        target.minY = std::min(region->minY, region->maxY);
+        target.maxX = std::max(region->minX, region->maxX);
+        target.maxY = std::max(region->minY, region->maxY);
+    } else {
+        LayoutObjectModel::Bounds bounds;
+        if (!root.tryGetBounds(bounds)) {
+            error = "layout is empty; give a region to export";
+            return false;
+        }
+        target = Region{bounds.minX, bounds.minY, bounds.maxX, bounds.maxY};
+        // Same 5% margin as `view fit`.
+        margin = 0.9;
+    }
+
+    // Fit and centre the region; the screen transform is the canvas one,
+    // screen = (x * zoom + panX, panY - y * zoom).
+    const double regionWidth = std::max<double>(1.0, static_cast<double>(target.maxX - target.minX));
+    const double regionHeight = std::max<double>(1.0, static_cast<double>(target.maxY - target.minY));
+    const double zoom = margin * std::min(width / regionWidth, height / regionHeight);
+    const double centerX = (static_cast<double>(target.minX) + static_cast<double>(target.maxX)) / 2.0;
+    const double centerY = (static_cast<double>(target.minY) + static_cast<double>(target.maxY)) / 2.0;
+    const double panX = (width / 2.0) - (centerX * zoom);
+    const double panY = (height / 2.0) + (centerY * zoom);
+
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull()) {
+        error = QString("cannot allocate a %1x%2 image").arg(width).arg(height);
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderItemBuilder builder;
+    builder.setLayers(layers);
+
+    // Query the whole image, not just the region: the aspect ratio or
+    // margin may show more of the layout around it.
+    QVector<SceneRenderPrimitive> primitives;
+    root.collectRenderPrimitivesInRect(
+        static_cast<qint64>(std::floor(-panX / zoom)),
+        static_cast<qint64>(std::floor((panY - height) / zoom)),
+        static_cast<qint64>(std::ceil((width - panX) / zoom)),
+        static_cast<qint64>(std::ceil(panY / zoom)),
+        primitives,
+        [&builder](quint32 layerNameId, quint32 layerTypeId) {
+            const LayerDefinition* layer = builder.layerForCode(layerNameId, layerTypeId);
+            return layer && layer->visible;
+        });
+
+    const QSize viewportSize(width, height);
+    const QVector<PrimitiveRenderBackend::RenderItem> items =
+        builder.build(primitives, zoom, panX, panY, RenderItemBuilder::detailLevelForZoom(zoom));
+
+    RasterPrimitiveRenderBackend backend;
+    QPainter painter(&image);
+    backend.beginFrame(painter, QColor("#000000"), viewportSize);
+    backend.drawPrimitives(painter, items, viewportSize);
+    backend.endFrame(painter, viewportSize);
+    painter.end();
+
+    outStats.primitiveCount = items.size();
+    outStats.renderMs = timer.nsecsElapsed() / 1.0e6;
+
+    timer.restart();
+    if (!image.save(filePath, "PNG")) {
+        error = QString("cannot write %1").arg(filePath);
+        return false;
+    }
+    outStats.encodeMs = timer.nsecsElapsed() / 1.0e6;
+    return true;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "LayerManager.h"
+
+class LayoutSceneNode;
+
+// LayoutImageExporter renders a world region of a scene to a PNG without a
+// window. Geometry goes through the canvas pipeline (RenderItemBuilder and
+// RasterPrimitiveRenderBackend) onto a QImage, so the output matches the
+// canvas at the same zoom and needs neither a display nor a GL context.
+// Grid and selection overlays are not drawn.
+namespace LayoutImageExporter {
+
+struct Region {
+    qint64 minX{0};
+    qint64 minY{0};
+    qint64 maxX{0};
+    qint64 maxY{0};
+};
+
+struct Stats {
+    int primitiveCount{0};
+    double renderMs{0.0};
+    double encodeMs{0.0};
+};
+
+constexpr int kMaxImageSide = 32767;
+
+// Renders region (or, when region is null, the layout extent with a 5%
+// margin) scaled to fit width x height, centred, on layers visible in
+// layers. Fails on an empty layout without a region, an invalid size or an
+// unwritable file.
+bool exportPng(const LayoutSceneNode& root,
+               const QVector<LayerDefinition>& layers,
+               const QString& filePath,
+               int width,
+               int height,
+               const Region* region,
+               Stats& outStats,
+               QString& error);
+
+}
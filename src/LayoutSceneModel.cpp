@@ -1,11 +1,164 @@
 #include "LayoutSceneModel.h"
 
+#include <QtGlobal>
+
 #include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
 #include <utility>
 
 namespace {
 std::atomic<quint64> g_nextObjectId{1};
+constexpr double kRadiansPerDegree = 3.14159265358979323846 / 180.0;
+
+// Fixed part of estimateObjectBytes(), used for lazy cells and undo history.
+constexpr qint64 kObjectOverheadBytes = 256;
+constexpr qint64 kDefaultLazyCellMemoryLimitMb = 1024;
+
+// Loaded lazy cells and their memory estimate, shared by every thread that
+// queries the scene; all fields except queryEpoch are guarded by mutex.
+// Cells decode under their own lock, not this one.
+struct LazyCellRegistry {
+    LazyCellRegistry() {
+        const int megabytes = qEnvironmentVariableIntValue("LAYOUT2_CELL_CACHE_MB");
+        memoryLimit = (megabytes > 0 ? megabytes : kDefaultLazyCellMemoryLimitMb) * 1024 * 1024;
+    }
+
+    std::mutex mutex;
+    QSet<LayoutSceneNode*> loadedCells;
+    qint64 memoryUsage{0};
+    qint64 memoryLimit{0};
+    // Advanced when a query starts while no other is running; cells used
+    // by running queries carry the current epoch and are never evicted.
+    // Written under mutex, read without it by ensureLoaded().
+    std::atomic<quint64> queryEpoch{0};
+    // Outermost query scopes open across all threads.
+    int activeQueries{0};
+    // Cells whose source failed to decode; they stay empty until evicted.
+    int failedLoads{0};
+    QString lastLoadError;
+};
+
+LazyCellRegistry& lazyCellRegistry() {
+    static LazyCellRegistry registry;
+    return registry;
+}
+
+// Nesting depth of query scopes on this thread; only the outermost one
+// takes the registry lock.
+thread_local int t_queryDepth = 0;
+
+// Returns the rotation in quarter turns when the transform is exact in
+// integer arithmetic (multiple of 90 degrees, unit magnification), else -1.
+int exactQuarterTurns(const LayoutTransform& transform) {
+    if (transform.magnification != 1.0) {
+        return -1;
+    }
+
+    const double quarters = transform.angleDegrees / 90.0;
+    const double rounded = std::round(quarters);
+    if (std::abs(quarters - rounded) > 1e-9) {
+        return -1;
+    }
+
+    return ((static_cast<int>(static_cast<qint64>(rounded) % 4)) + 4) % 4;
+}
+
+WorldPoint rotateQuarterTurns(const qint64 x, const qint64 y, const int quarterTurns) {
+    switch (quarterTurns) {
+    case 1:
+        return WorldPoint{-y, x};
+    case 2:
+        return WorldPoint{-x, -y};
+    case 3:
+        return WorldPoint{y, -x};
+    default:
+        return WorldPoint{x, y};
+    }
+}
+
+LayoutObjectModel::Bounds boundsOfPoints(const QVector<WorldPoint>& points) {
+    LayoutObjectModel::Bounds bounds;
+    if (points.isEmpty()) {
+        return bounds;
+    }
+
+    bounds.minX = bounds.maxX = points.front().x;
+    bounds.minY = bounds.maxY = points.front().y;
+    for (const WorldPoint& point : points) {
+        bounds.minX = std::min(bounds.minX, point.x);
+        bounds.maxX = std::max(bounds.maxX, point.x);
+        bounds.minY = std::min(bounds.minY, point.y);
+        bounds.maxY = std::max(bounds.maxY, point.y);
+    }
+    return bounds;
+}
+
+// Even-odd crossing test along +X. Shared by polygons and path segments so
+// hit tests never construct (and number) temporary objects.
+bool polygonContainsPoint(const QVector<WorldPoint>& vertices, const qint64 x, const qint64 y) {
+    if (vertices.size() < 3) {
+        return false;
+    }
+
+    bool inside = false;
+    for (int i = 0, j = vertices.size() - 1; i < vertices.size(); j = i++) {
+        const WorldPoint& a = vertices[i];
+        const WorldPoint& b = vertices[j];
+        if ((a.y > y) != (b.y > y)) {
+            const double crossX = static_cast<double>(a.x)
+                                  + (static_cast<double>(y - a.y) * static_cast<double>(b.x - a.x))
+                                        / static_cast<double>(b.y - a.y);
+            if (static_cast<double>(x) <= crossX) {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+void appendBoundsOutline(const LayoutObjectModel::Bounds& bounds, QVector<WorldLineSegment>& outSegments) {
+    outSegments.push_back(WorldLineSegment{bounds.minX, bounds.minY, bounds.maxX, bounds.minY});
+    outSegments.push_back(WorldLineSegment{bounds.maxX, bounds.minY, bounds.maxX, bounds.maxY});
+    outSegments.push_back(WorldLineSegment{bounds.maxX, bounds.maxY, bounds.minX, bounds.maxY});
+    outSegments.push_back(WorldLineSegment{bounds.minX, bounds.maxY, bounds.minX, bounds.minY});
+}
+
+// Clamps the element index range [first, last] along one array axis to
+// elements whose extent [baseMin + i * step, baseMax + i * step] can touch
+// [queryMin, queryMax].
+void clampArrayAxis(const qint64 step,
+                    const qint64 baseMin,
+                    const qint64 baseMax,
+                    const qint64 queryMin,
+                    const qint64 queryMax,
+                    int& first,
+                    int& last) {
+    if (step == 0) {
+        return;
+    }
+
+    double lower = static_cast<double>(queryMin - baseMax) / static_cast<double>(step);
+    double upper = static_cast<double>(queryMax - baseMin) / static_cast<double>(step);
+    if (step < 0) {
+        std::swap(lower, upper);
+    }
+
+    first = std::max(first, static_cast<int>(std::max(-1.0, std::floor(lower))));
+    last = std::min(last, static_cast<int>(std::min(static_cast<double>(last) + 1.0, std::ceil(upper))));
+}
+}
+
+qint64 estimateObjectBytes(const LayoutObjectModel& object) {
+    qint64 bytes = kObjectOverheadBytes;
+    if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(&object)) {
+        bytes += polygon->vertices().size() * static_cast<qint64>(sizeof(WorldPoint));
+    } else if (const auto* path = dynamic_cast<const PathObjectModel*>(&object)) {
+        bytes += path->points().size() * static_cast<qint64>(sizeof(WorldPoint));
+    }
+    return bytes;
 }
 
 LayoutObjectModel::LayoutObjectModel()
@@ -15,6 +168,19 @@ quint64 LayoutObjectModel::objectId() const {
     return m_objectId;
 }
 
+bool LayoutObjectModel::tryGetLayer(quint32&, quint32&) const {
+    return false;
+}
+
+void LayoutObjectModel::appendRenderPrimitivesInRect(qint64,
+                                                     qint64,
+                                                     qint64,
+                                                     qint64,
+                                                     const LayoutLayerFilter&,
+                                                     QVector<SceneRenderPrimitive>& outPrimitives) const {
+    appendRenderPrimitives(outPrimitives);
+}
+
 RectangleObjectModel::RectangleObjectModel(const DrawnRectangle& rectangle)
     : m_rectangle(rectangle) {}
 
@@ -30,6 +196,12 @@ const DrawnRectangle* RectangleObjectModel::asRectangle() const {
     return &m_rectangle;
 }
 
+bool RectangleObjectModel::tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const {
+    outLayerNameId = m_rectangle.layerNameId;
+    outLayerTypeId = m_rectangle.layerTypeId;
+    return true;
+}
+
 bool RectangleObjectModel::tryGetBounds(Bounds& outBounds) const {
     outBounds.minX = std::min(m_rectangle.x1, m_rectangle.x2);
     outBounds.maxX = std::max(m_rectangle.x1, m_rectangle.x2);
@@ -70,22 +242,794 @@ void RectangleObjectModel::appendRenderPrimitives(QVector<SceneRenderPrimitive>&
     outPrimitives.push_back(std::move(primitive));
 }
 
+PolygonObjectModel::PolygonObjectModel(const quint32 layerNameId,
+                                       const quint32 layerTypeId,
+                                       QVector<WorldPoint> vertices)
+    : m_layerNameId(layerNameId),
+      m_layerTypeId(layerTypeId),
+      m_vertices(std::move(vertices)),
+      m_bounds(boundsOfPoints(m_vertices)) {}
+
+const QVector<WorldPoint>& PolygonObjectModel::vertices() const {
+    return m_vertices;
+}
+
+bool PolygonObjectModel::containsPoint(const qint64 x, const qint64 y) const {
+    if (x < m_bounds.minX || x > m_bounds.maxX || y < m_bounds.minY || y > m_bounds.maxY) {
+        return false;
+    }
+    return polygonContainsPoint(m_vertices, x, y);
+}
+
+bool PolygonObjectModel::tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const {
+    outLayerNameId = m_layerNameId;
+    outLayerTypeId = m_layerTypeId;
+    return true;
+}
+
+bool PolygonObjectModel::tryGetBounds(Bounds& outBounds) const {
+    if (m_vertices.isEmpty()) {
+        return false;
+    }
+
+    outBounds = m_bounds;
+    return true;
+}
+
+void PolygonObjectModel::appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const {
+    for (int i = 0; i < m_vertices.size(); ++i) {
+        const WorldPoint& a = m_vertices[i];
+        const WorldPoint& b = m_vertices[(i + 1) % m_vertices.size()];
+        outSegments.push_back(WorldLineSegment{a.x, a.y, b.x, b.y});
+    }
+}
+
+void PolygonObjectModel::appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const {
+    SceneRenderPrimitive primitive;
+    primitive.objectId = objectId();
+    primitive.layerNameId = m_layerNameId;
+    primitive.layerTypeId = m_layerTypeId;
+    primitive.preview = false;
+    primitive.polygonVertices = m_vertices;
+    outPrimitives.push_back(std::move(primitive));
+}
+
+PathObjectModel::PathObjectModel(const quint32 layerNameId,
+                                 const quint32 layerTypeId,
+                                 QVector<WorldPoint> points,
+                                 const qint64 width,
+                                 const qint64 beginExtension,
+                                 const qint64 endExtension)
+    : m_layerNameId(layerNameId),
+      m_layerTypeId(layerTypeId),
+      m_points(std::move(points)),
+      m_halfWidth(std::abs(width) / 2),
+      m_beginExtension(beginExtension),
+      m_endExtension(endExtension) {
+    // Conservative: every quad lies within the centerline box grown by the
+    // half width plus the larger end extension.
+    m_bounds = boundsOfPoints(m_points);
+    const qint64 margin = m_halfWidth + std::max<qint64>(0, std::max(m_beginExtension, m_endExtension));
+    m_bounds.minX -= margin;
+    m_bounds.minY -= margin;
+    m_bounds.maxX += margin;
+    m_bounds.maxY += margin;
+}
+
+const QVector<WorldPoint>& PathObjectModel::points() const {
+    return m_points;
+}
+
+qint64 PathObjectModel::width() const {
+    return m_halfWidth * 2;
+}
+
+qint64 PathObjectModel::beginExtension() const {
+    return m_beginExtension;
+}
+
+qint64 PathObjectModel::endExtension() const {
+    return m_endExtension;
+}
+
+QVector<WorldPoint> PathObjectModel::segmentQuad(const int segmentIndex) const {
+    const WorldPoint& a = m_points[segmentIndex];
+    const WorldPoint& b = m_points[segmentIndex + 1];
+    const double dx = static_cast<double>(b.x - a.x);
+    const double dy = static_cast<double>(b.y - a.y);
+    const double length = std::sqrt((dx * dx) + (dy * dy));
+    if (length <= 0.0) {
+        return {};
+    }
+
+    const double ux = dx / length;
+    const double uy = dy / length;
+    const double startExtension = segmentIndex == 0 ? static_cast<double>(m_beginExtension) : 0.0;
+    const double endExtension = segmentIndex + 2 == m_points.size() ? static_cast<double>(m_endExtension) : 0.0;
+    const double ax = static_cast<double>(a.x) - (ux * startExtension);
+    const double ay = static_cast<double>(a.y) - (uy * startExtension);
+    const double bx = static_cast<double>(b.x) + (ux * endExtension);
+    const double by = static_cast<double>(b.y) + (uy * endExtension);
+    const double nx = -uy * static_cast<double>(m_halfWidth);
+    const double ny = ux * static_cast<double>(m_halfWidth);
+
+    return {
+        WorldPoint{std::llround(ax + nx), std::llround(ay + ny)},
+        WorldPoint{std::llround(ax - nx), std::llround(ay - ny)},
+        WorldPoint{std::llround(bx - nx), std::llround(by - ny)},
+        WorldPoint{std::llround(bx + nx), std::llround(by + ny)}
+    };
+}
+
+bool PathObjectModel::containsPoint(const qint64 x, const qint64 y) const {
+    if (x < m_bounds.minX || x > m_bounds.maxX || y < m_bounds.minY || y > m_bounds.maxY) {
+        return false;
+    }
+
+    for (int i = 0; i + 1 < m_points.size(); ++i) {
+        if (polygonContainsPoint(segmentQuad(i), x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PathObjectModel::tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const {
+    outLayerNameId = m_layerNameId;
+    outLayerTypeId = m_layerTypeId;
+    return true;
+}
+
+bool PathObjectModel::tryGetBounds(Bounds& outBounds) const {
+    if (m_points.isEmpty()) {
+        return false;
+    }
+
+    outBounds = m_bounds;
+    return true;
+}
+
+void PathObjectModel::appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const {
+    for (int i = 0; i + 1 < m_points.size(); ++i) {
+        const QVector<WorldPoint> quad = segmentQuad(i);
+        for (int k = 0; k < quad.size(); ++k) {
+            const WorldPoint& a = quad[k];
+            const WorldPoint& b = quad[(k + 1) % quad.size()];
+            outSegments.push_back(WorldLineSegment{a.x, a.y, b.x, b.y});
+        }
+    }
+}
+
+void PathObjectModel::appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const {
+    for (int i = 0; i + 1 < m_points.size(); ++i) {
+        SceneRenderPrimitive primitive;
+        primitive.objectId = objectId();
+        primitive.layerNameId = m_layerNameId;
+        primitive.layerTypeId = m_layerTypeId;
+        primitive.preview = false;
+        primitive.polygonVertices = segmentQuad(i);
+        if (!primitive.polygonVertices.isEmpty()) {
+            outPrimitives.push_back(std::move(primitive));
+        }
+    }
+}
+
+WorldPoint LayoutTransform::apply(qint64 x, qint64 y) const {
+    if (mirrorX) {
+        y = -y;
+    }
+
+    const int quarterTurns = exactQuarterTurns(*this);
+    if (quarterTurns >= 0) {
+        const WorldPoint rotated = rotateQuarterTurns(x, y, quarterTurns);
+        return WorldPoint{originX + rotated.x, originY + rotated.y};
+    }
+
+    const double radians = angleDegrees * kRadiansPerDegree;
+    const double c = std::cos(radians);
+    const double s = std::sin(radians);
+    const double sx = static_cast<double>(x) * magnification;
+    const double sy = static_cast<double>(y) * magnification;
+    return WorldPoint{originX + std::llround((sx * c) - (sy * s)),
+                      originY + std::llround((sx * s) + (sy * c))};
+}
+
+WorldPoint LayoutTransform::applyInverse(const qint64 x, const qint64 y) const {
+    const qint64 dx = x - originX;
+    const qint64 dy = y - originY;
+
+    WorldPoint local{0, 0};
+    const int quarterTurns = exactQuarterTurns(*this);
+    if (quarterTurns >= 0) {
+        local = rotateQuarterTurns(dx, dy, (4 - quarterTurns) % 4);
+    } else {
+        const double radians = angleDegrees * kRadiansPerDegree;
+        const double c = std::cos(radians);
+        const double s = std::sin(radians);
+        const double scale = magnification != 0.0 ? 1.0 / magnification : 1.0;
+        local = WorldPoint{std::llround(((static_cast<double>(dx) * c) + (static_cast<double>(dy) * s)) * scale),
+                           std::llround(((static_cast<double>(dy) * c) - (static_cast<double>(dx) * s)) * scale)};
+    }
+
+    if (mirrorX) {
+        local.y = -local.y;
+    }
+    return local;
+}
+
+LayoutObjectModel::Bounds LayoutTransform::applyToBounds(const LayoutObjectModel::Bounds& bounds) const {
+    LayoutObjectModel::Bounds result = boundsOfPoints({apply(bounds.minX, bounds.minY),
+                                                      apply(bounds.maxX, bounds.minY),
+                                                      apply(bounds.maxX, bounds.maxY),
+                                                      apply(bounds.minX, bounds.maxY)});
+    if (exactQuarterTurns(*this) < 0) {
+        // Absorb rounding of the non-orthogonal path.
+        result.minX -= 1;
+        result.minY -= 1;
+        result.maxX += 1;
+        result.maxY += 1;
+    }
+    return result;
+}
+
+LayoutObjectModel::Bounds LayoutTransform::applyInverseToBounds(const LayoutObjectModel::Bounds& bounds) const {
+    LayoutObjectModel::Bounds result = boundsOfPoints({applyInverse(bounds.minX, bounds.minY),
+                                                      applyInverse(bounds.maxX, bounds.minY),
+                                                      applyInverse(bounds.maxX, bounds.maxY),
+                                                      applyInverse(bounds.minX, bounds.maxY)});
+    if (exactQuarterTurns(*this) < 0) {
+        result.minX -= 1;
+        result.minY -= 1;
+        result.maxX += 1;
+        result.maxY += 1;
+    }
+    return result;
+}
+
+InstanceObjectModel::InstanceObjectModel(std::shared_ptr<const LayoutSceneNode> master,
+                                         const LayoutTransform& transform,
+                                         const int columns,
+                                         const int rows,
+                                         const WorldPoint columnStep,
+                                         const WorldPoint rowStep)
+    : m_master(std::move(master)),
+      m_transform(transform),
+      m_columns(std::max(1, columns)),
+      m_rows(std::max(1, rows)),
+      m_columnStep(columnStep),
+      m_rowStep(rowStep) {}
+
+const LayoutSceneNode* InstanceObjectModel::master() const {
+    return m_master.get();
+}
+
+std::shared_ptr<const LayoutSceneNode> InstanceObjectModel::sharedMaster() const {
+    return m_master;
+}
+
+const LayoutTransform& InstanceObjectModel::transform() const {
+    return m_transform;
+}
+
+int InstanceObjectModel::columns() const {
+    return m_columns;
+}
+
+int InstanceObjectModel::rows() const {
+    return m_rows;
+}
+
+WorldPoint InstanceObjectModel::columnStep() const {
+    return m_columnStep;
+}
+
+WorldPoint InstanceObjectModel::rowStep() const {
+    return m_rowStep;
+}
+
+LayoutTransform InstanceObjectModel::elementTransform(const int column, const int row) const {
+    LayoutTransform transform = m_transform;
+    transform.originX += (static_cast<qint64>(column) * m_columnStep.x) + (static_cast<qint64>(row) * m_rowStep.x);
+    transform.originY += (static_cast<qint64>(column) * m_columnStep.y) + (static_cast<qint64>(row) * m_rowStep.y);
+    return transform;
+}
+
+void InstanceObjectModel::elementRangeForRect(const qint64 minX,
+                                              const qint64 minY,
+                                              const qint64 maxX,
+                                              const qint64 maxY,
+                                              int& outFirstColumn,
+                                              int& outLastColumn,
+                                              int& outFirstRow,
+                                              int& outLastRow) const {
+    outFirstColumn = 0;
+    outLastColumn = m_columns - 1;
+    outFirstRow = 0;
+    outLastRow = m_rows - 1;
+
+    LayoutObjectModel::Bounds masterBounds;
+    if (!m_master || !m_master->tryGetBounds(masterBounds)) {
+        return;
+    }
+
+    const LayoutObjectModel::Bounds base = m_transform.applyToBounds(masterBounds);
+    if (m_columnStep.y == 0 && m_rowStep.x == 0) {
+        clampArrayAxis(m_columnStep.x, base.minX, base.maxX, minX, maxX, outFirstColumn, outLastColumn);
+        clampArrayAxis(m_rowStep.y, base.minY, base.maxY, minY, maxY, outFirstRow, outLastRow);
+    } else if (m_columnStep.x == 0 && m_rowStep.y == 0) {
+        clampArrayAxis(m_columnStep.y, base.minY, base.maxY, minY, maxY, outFirstColumn, outLastColumn);
+        clampArrayAxis(m_rowStep.x, base.minX, base.maxX, minX, maxX, outFirstRow, outLastRow);
+    }
+}
+
+bool InstanceObjectModel::containsPoint(const qint64 x, const qint64 y) const {
+    if (!m_master) {
+        return false;
+    }
+
+    int firstColumn = 0;
+    int lastColumn = 0;
+    int firstRow = 0;
+    int lastRow = 0;
+    elementRangeForRect(x, y, x, y, firstColumn, lastColumn, firstRow, lastRow);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const WorldPoint local = elementTransform(column, row).applyInverse(x, y);
+            const QVector<quint64> hits = m_master->matchingObjectIdsAt(
+                local.x, local.y, [](const LayoutObjectModel&) { return true; });
+            if (!hits.isEmpty()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+LayoutObjectModel::Bounds InstanceObjectModel::placementBounds(const LayoutObjectModel::Bounds& masterBounds,
+                                                               const LayoutTransform& transform,
+                                                               const int columns,
+                                                               const int rows,
+                                                               const WorldPoint columnStep,
+                                                               const WorldPoint rowStep) {
+    // Element (0, 0) grown by the extreme column/row offsets.
+    LayoutObjectModel::Bounds bounds = transform.applyToBounds(masterBounds);
+    const qint64 lastColumnX = static_cast<qint64>(columns - 1) * columnStep.x;
+    const qint64 lastColumnY = static_cast<qint64>(columns - 1) * columnStep.y;
+    const qint64 lastRowX = static_cast<qint64>(rows - 1) * rowStep.x;
+    const qint64 lastRowY = static_cast<qint64>(rows - 1) * rowStep.y;
+    bounds.minX += std::min<qint64>(0, lastColumnX) + std::min<qint64>(0, lastRowX);
+    bounds.maxX += std::max<qint64>(0, lastColumnX) + std::max<qint64>(0, lastRowX);
+    bounds.minY += std::min<qint64>(0, lastColumnY) + std::min<qint64>(0, lastRowY);
+    bounds.maxY += std::max<qint64>(0, lastColumnY) + std::max<qint64>(0, lastRowY);
+    return bounds;
+}
+
+bool InstanceObjectModel::tryGetBounds(Bounds& outBounds) const {
+    LayoutObjectModel::Bounds masterBounds;
+    if (!m_master || !m_master->tryGetBounds(masterBounds)) {
+        return false;
+    }
+
+    outBounds = placementBounds(masterBounds, m_transform, m_columns, m_rows, m_columnStep, m_rowStep);
+    return true;
+}
+
+void InstanceObjectModel::appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const {
+    Bounds bounds;
+    if (tryGetBounds(bounds)) {
+        appendBoundsOutline(bounds, outSegments);
+    }
+}
+
+void InstanceObjectModel::appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const {
+    Bounds bounds;
+    if (tryGetBounds(bounds)) {
+        appendRenderPrimitivesInRect(bounds.minX, bounds.minY, bounds.maxX, bounds.maxY, LayoutLayerFilter(), outPrimitives);
+    }
+}
+
+void InstanceObjectModel::appendRenderPrimitivesInRect(const qint64 minX,
+                                                       const qint64 minY,
+                                                       const qint64 maxX,
+                                                       const qint64 maxY,
+                                                       const LayoutLayerFilter& layerFilter,
+                                                       QVector<SceneRenderPrimitive>& outPrimitives) const {
+    LayoutObjectModel::Bounds masterBounds;
+    if (!m_master || !m_master->tryGetBounds(masterBounds)) {
+        return;
+    }
+
+    int firstColumn = 0;
+    int lastColumn = 0;
+    int firstRow = 0;
+    int lastRow = 0;
+    elementRangeForRect(minX, minY, maxX, maxY, firstColumn, lastColumn, firstRow, lastRow);
+
+    const LayoutObjectModel::Bounds queryBounds{minX, minY, maxX, maxY};
+    QVector<SceneRenderPrimitive> localPrimitives;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const LayoutTransform transform = elementTransform(column, row);
+            const LayoutObjectModel::Bounds elementBounds = transform.applyToBounds(masterBounds);
+            if (elementBounds.maxX < minX || elementBounds.minX > maxX
+                || elementBounds.maxY < minY || elementBounds.minY > maxY) {
+                continue;
+            }
+
+            // Query the master's own index with the rect mapped into master
+            // space, so only the visible part of each element is expanded.
+            const LayoutObjectModel::Bounds localQuery = transform.applyInverseToBounds(queryBounds);
+            localPrimitives.clear();
+            m_master->collectRenderPrimitivesInRect(localQuery.minX, localQuery.minY, localQuery.maxX, localQuery.maxY,
+                                                    localPrimitives, layerFilter);
+            for (SceneRenderPrimitive& primitive : localPrimitives) {
+                for (WorldPoint& vertex : primitive.polygonVertices) {
+                    vertex = transform.apply(vertex.x, vertex.y);
+                }
+                primitive.objectId = objectId();
+                outPrimitives.push_back(std::move(primitive));
+            }
+        }
+    }
+}
+
+struct LayoutSceneNode::LazyContent {
+    std::shared_ptr<LayoutLazyCellSource> source;
+    int cellIndex{0};
+    LayoutObjectModel::Bounds bounds;
+    int objectCount{0};
+    QVector<std::shared_ptr<const LayoutSceneNode>> masters;
+    // Held while this cell decodes, so two threads reaching it load it
+    // once while other cells load in parallel. Eviction skips a cell whose
+    // lock is taken rather than wait on it under the registry lock.
+    std::mutex loadMutex;
+    // Changed only with loadMutex and the registry lock both held.
+    std::atomic<bool> loaded{false};
+    qint64 estimatedBytes{0};
+    std::atomic<quint64> lastUseEpoch{0};
+};
+
+LayoutSceneNode::QueryScope::QueryScope() {
+    if (t_queryDepth++ > 0) {
+        return;
+    }
+
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.activeQueries++ == 0) {
+        ++registry.queryEpoch;
+    }
+}
+
+LayoutSceneNode::QueryScope::~QueryScope() {
+    if (--t_queryDepth > 0) {
+        return;
+    }
+
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (--registry.activeQueries == 0) {
+        trimLazyCells();
+    }
+}
+
+LayoutSceneNode::LayoutSceneNode() = default;
+
+LayoutSceneNode::~LayoutSceneNode() {
+    if (m_lazy && m_lazy->loaded) {
+        LazyCellRegistry& registry = lazyCellRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.loadedCells.remove(this);
+        registry.memoryUsage -= m_lazy->estimatedBytes;
+    }
+}
+
+void LayoutSceneNode::setLazyContent(std::shared_ptr<LayoutLazyCellSource> source,
+                                     const int cellIndex,
+                                     const LayoutObjectModel::Bounds& bounds,
+                                     const int objectCount,
+                                     QVector<std::shared_ptr<const LayoutSceneNode>> masters) {
+    m_lazy = std::make_unique<LazyContent>();
+    m_lazy->source = std::move(source);
+    m_lazy->cellIndex = cellIndex;
+    m_lazy->bounds = bounds;
+    m_lazy->objectCount = objectCount;
+    m_lazy->masters = std::move(masters);
+}
+
+bool LayoutSceneNode::isLazy() const {
+    return m_lazy != nullptr;
+}
+
+bool LayoutSceneNode::isLoaded() const {
+    if (!m_lazy) {
+        return true;
+    }
+
+    return m_lazy->loaded.load(std::memory_order_acquire);
+}
+
+void LayoutSceneNode::setLazyCellMemoryLimit(const qint64 bytes) {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.memoryLimit = std::max<qint64>(0, bytes);
+    if (registry.activeQueries == 0) {
+        trimLazyCells();
+    }
+}
+
+qint64 LayoutSceneNode::lazyCellMemoryLimit() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.memoryLimit;
+}
+
+qint64 LayoutSceneNode::lazyCellMemoryUsage() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.memoryUsage;
+}
+
+int LayoutSceneNode::loadedLazyCellCount() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.loadedCells.size();
+}
+
+int LayoutSceneNode::failedLazyCellLoadCount() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.failedLoads;
+}
+
+QString LayoutSceneNode::lastLazyCellLoadError() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.lastLoadError;
+}
+
+void LayoutSceneNode::ensureLoaded() const {
+    if (!m_lazy) {
+        return;
+    }
+
+    // Unloading only happens with no query running anywhere, so a loaded
+    // cell can be used without taking any lock.
+    LazyCellRegistry& registry = lazyCellRegistry();
+    m_lazy->lastUseEpoch.store(registry.queryEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (m_lazy->loaded.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> loadLock(m_lazy->loadMutex);
+    if (m_lazy->loaded.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // Loading only fills in content the directory already promised, so it
+    // is allowed behind the const query API.
+    LayoutSceneNode* self = const_cast<LayoutSceneNode*>(this);
+    QVector<std::shared_ptr<LayoutObjectModel>> objects;
+    QString error;
+    const bool decoded = m_lazy->source->loadCell(m_lazy->cellIndex, m_lazy->masters, objects, error);
+    if (!decoded) {
+        // The cell decoded fine when the directory was built, so this only
+        // happens if the file changed on disk; it stays empty until evicted
+        // and the failure is kept for `layout cache`.
+        objects.clear();
+    }
+
+    qint64 estimatedBytes = 0;
+    for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+        if (object) {
+            estimatedBytes += estimateObjectBytes(*object);
+        }
+    }
+
+    self->appendObjects(std::move(objects));
+    m_lazy->estimatedBytes = estimatedBytes;
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.loadedCells.insert(self);
+    registry.memoryUsage += estimatedBytes;
+    if (!decoded) {
+        ++registry.failedLoads;
+        registry.lastLoadError = QString("cell %1: %2").arg(m_name, error);
+    }
+    m_lazy->loaded.store(true, std::memory_order_release);
+}
+
+void LayoutSceneNode::unload() {
+    m_objects.clear();
+    m_objectById.clear();
+    m_objectOrderById.clear();
+    m_objectBoundsById.clear();
+    m_partitions.clear();
+    m_objectPartitionKeys.clear();
+    m_objectTileKeys.clear();
+    m_objectTileLevels.clear();
+    m_lazy->loaded.store(false, std::memory_order_release);
+    m_hasCachedBounds = false;
+}
+
+void LayoutSceneNode::materialize() {
+    if (!m_lazy) {
+        return;
+    }
+
+    ensureLoaded();
+    LazyCellRegistry& registry = lazyCellRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.loadedCells.remove(this);
+    registry.memoryUsage -= m_lazy->estimatedBytes;
+    m_lazy.reset();
+}
+
+// Called with the registry lock held.
+void LayoutSceneNode::trimLazyCells() {
+    LazyCellRegistry& registry = lazyCellRegistry();
+    if (registry.memoryUsage <= registry.memoryLimit) {
+        return;
+    }
+
+    QVector<LayoutSceneNode*> candidates;
+    for (LayoutSceneNode* node : registry.loadedCells) {
+        if (node->m_lazy->lastUseEpoch.load(std::memory_order_relaxed) < registry.queryEpoch.load(std::memory_order_relaxed)) {
+            candidates.push_back(node);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const LayoutSceneNode* lhs, const LayoutSceneNode* rhs) {
+        return lhs->m_lazy->lastUseEpoch.load(std::memory_order_relaxed) < rhs->m_lazy->lastUseEpoch.load(std::memory_order_relaxed);
+    });
+
+    for (LayoutSceneNode* node : candidates) {
+        if (registry.memoryUsage <= registry.memoryLimit) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> loadLock(node->m_lazy->loadMutex, std::try_to_lock);
+        if (!loadLock.owns_lock()) {
+            continue;
+        }
+
+        registry.loadedCells.remove(node);
+        registry.memoryUsage -= node->m_lazy->estimatedBytes;
+        node->unload();
+    }
+}
+
 void LayoutSceneNode::addObject(std::shared_ptr<LayoutObjectModel> object) {
     if (!object) {
         return;
     }
 
+    materialize();
+
     m_objectById.insert(object->objectId(), object);
     indexObject(object);
     m_objectOrderById.insert(object->objectId(), m_objects.size());
     m_objects.push_back(std::move(object));
 }
 
+void LayoutSceneNode::addObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects) {
+    materialize();
+    appendObjects(std::move(objects));
+}
+
+void LayoutSceneNode::appendObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects) {
+    // The ID tables grow shard by shard; only the paint order is reserved.
+    m_objects.reserve(m_objects.size() + objects.size());
+
+    for (std::shared_ptr<LayoutObjectModel>& object : objects) {
+        if (!object) {
+            continue;
+        }
+
+        m_objectById.insert(object->objectId(), object);
+        indexObject(object);
+        m_objectOrderById.insert(object->objectId(), m_objects.size());
+        m_objects.push_back(std::move(object));
+    }
+}
+
 void LayoutSceneNode::addChild(std::shared_ptr<LayoutSceneNode> child) {
+    materialize();
+    // Children are not edited once attached except through this node's
+    // removal calls, so their bounds are final here.
+    LayoutObjectModel::Bounds childBounds;
+    if (child && child->tryGetBounds(childBounds)) {
+        growBounds(childBounds);
+    }
     m_children.push_back(std::move(child));
 }
 
+const QString& LayoutSceneNode::name() const {
+    return m_name;
+}
+
+void LayoutSceneNode::setName(const QString& name) {
+    m_name = name;
+}
+
+int LayoutSceneNode::objectCount() const {
+    return m_lazy ? m_lazy->objectCount : m_objects.size();
+}
+
+const LayoutObjectList& LayoutSceneNode::objects() const {
+    ensureLoaded();
+    return m_objects;
+}
+
+std::shared_ptr<const LayoutSceneNode> LayoutSceneNode::snapshot() const {
+    return detachedCopy();
+}
+
+std::unique_ptr<LayoutSceneNode> LayoutSceneNode::detachedCopy() const {
+    QueryScope scope;
+    ensureLoaded();
+    auto copy = std::make_unique<LayoutSceneNode>();
+    copy->m_cachedBounds = m_cachedBounds;
+    copy->m_hasCachedBounds = m_hasCachedBounds;
+    copy->m_name = m_name;
+    copy->m_objects = m_objects;
+    copy->m_children = m_children;
+    copy->m_objectById = m_objectById;
+    copy->m_objectOrderById = m_objectOrderById;
+    copy->m_objectBoundsById = m_objectBoundsById;
+    copy->m_partitions = m_partitions;
+    copy->m_objectPartitionKeys = m_objectPartitionKeys;
+    copy->m_objectTileKeys = m_objectTileKeys;
+    copy->m_objectTileLevels = m_objectTileLevels;
+    return copy;
+}
+
+bool LayoutSceneNode::tryGetBounds(LayoutObjectModel::Bounds& outBounds) const {
+    if (m_lazy) {
+        outBounds = m_lazy->bounds;
+        return true;
+    }
+
+    if (m_hasCachedBounds) {
+        outBounds = m_cachedBounds;
+    }
+    return m_hasCachedBounds;
+}
+
+void LayoutSceneNode::growBounds(const LayoutObjectModel::Bounds& bounds) {
+    if (!m_hasCachedBounds) {
+        m_cachedBounds = bounds;
+        m_hasCachedBounds = true;
+        return;
+    }
+
+    m_cachedBounds.minX = std::min(m_cachedBounds.minX, bounds.minX);
+    m_cachedBounds.minY = std::min(m_cachedBounds.minY, bounds.minY);
+    m_cachedBounds.maxX = std::max(m_cachedBounds.maxX, bounds.maxX);
+    m_cachedBounds.maxY = std::max(m_cachedBounds.maxY, bounds.maxY);
+}
+
+bool LayoutSceneNode::touchesBoundsEdge(const LayoutObjectModel::Bounds& bounds) const {
+    return bounds.minX <= m_cachedBounds.minX || bounds.minY <= m_cachedBounds.minY
+        || bounds.maxX >= m_cachedBounds.maxX || bounds.maxY >= m_cachedBounds.maxY;
+}
+
+void LayoutSceneNode::recomputeBounds() {
+    m_hasCachedBounds = false;
+    m_objectBoundsById.forEach([this](quint64, const LayoutObjectModel::Bounds& bounds) {
+        growBounds(bounds);
+        return true;
+    });
+
+    for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
+        LayoutObjectModel::Bounds childBounds;
+        if (child->tryGetBounds(childBounds)) {
+            growBounds(childBounds);
+        }
+    }
+}
+
 void LayoutSceneNode::collectRectangles(QVector<const DrawnRectangle*>& outRectangles) const {
+    ensureLoaded();
     QVector<const LayoutObjectModel*> objects;
     collectObjects(objects);
 
@@ -97,6 +1041,8 @@ void LayoutSceneNode::collectRectangles(QVector<const DrawnRectangle*>& outRecta
 }
 
 void LayoutSceneNode::collectRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const {
+    QueryScope scope;
+    ensureLoaded();
     for (const std::shared_ptr<LayoutObjectModel>& object : m_objects) {
         if (object) {
             object->appendRenderPrimitives(outPrimitives);
@@ -112,46 +1058,39 @@ void LayoutSceneNode::collectRenderPrimitivesInRect(const qint64 minX,
                                                     const qint64 minY,
                                                     const qint64 maxX,
                                                     const qint64 maxY,
-                                                    QVector<SceneRenderPrimitive>& outPrimitives) const {
-    QSet<quint64> candidateObjectIds;
-    collectCandidateObjectIdsInRect(minX, minY, maxX, maxY, candidateObjectIds);
-
+                                                    QVector<SceneRenderPrimitive>& outPrimitives,
+                                                    const LayerFilter& layerFilter) const {
+    QueryScope scope;
+    ensureLoaded();
     QVector<QPair<int, quint64>> orderedCandidateIds;
-    orderedCandidateIds.reserve(candidateObjectIds.size());
-    for (quint64 objectId : candidateObjectIds) {
-        const auto orderIt = m_objectOrderById.constFind(objectId);
-        if (orderIt == m_objectOrderById.cend()) {
-            continue;
-        }
-        orderedCandidateIds.push_back(qMakePair(orderIt.value(), objectId));
-    }
+    visitIndexedObjectsInRect(minX, minY, maxX, maxY, RegionQueryMode::Touch, layerFilter,
+                              [this, &orderedCandidateIds](const quint64 objectId) {
+                                  if (const int* order = m_objectOrderById.find(objectId)) {
+                                      orderedCandidateIds.push_back(qMakePair(*order, objectId));
+                                  }
+                                  return true;
+                              });
     std::sort(orderedCandidateIds.begin(), orderedCandidateIds.end(),
               [](const QPair<int, quint64>& lhs, const QPair<int, quint64>& rhs) {
                   return lhs.first < rhs.first;
               });
 
     for (const auto& orderedCandidate : orderedCandidateIds) {
-        const quint64 objectId = orderedCandidate.second;
-        const auto objectIt = m_objectById.constFind(objectId);
-        if (objectIt == m_objectById.cend() || !objectIt.value()) {
-            continue;
-        }
-
-        const auto boundsIt = m_objectBoundsById.constFind(objectId);
-        if (boundsIt != m_objectBoundsById.cend()
-            && !boundsIntersectRect(boundsIt.value(), minX, minY, maxX, maxY)) {
+        const std::shared_ptr<LayoutObjectModel>* object = m_objectById.find(orderedCandidate.second);
+        if (!object || !*object) {
             continue;
         }
 
-        objectIt.value()->appendRenderPrimitives(outPrimitives);
+        (*object)->appendRenderPrimitivesInRect(minX, minY, maxX, maxY, layerFilter, outPrimitives);
     }
 
     for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
-        child->collectRenderPrimitivesInRect(minX, minY, maxX, maxY, outPrimitives);
+        child->collectRenderPrimitivesInRect(minX, minY, maxX, maxY, outPrimitives, layerFilter);
     }
 }
 
 void LayoutSceneNode::collectObjects(QVector<const LayoutObjectModel*>& outObjects) const {
+    ensureLoaded();
     for (const std::shared_ptr<LayoutObjectModel>& object : m_objects) {
         outObjects.push_back(object.get());
     }
@@ -161,40 +1100,215 @@ void LayoutSceneNode::collectObjects(QVector<const LayoutObjectModel*>& outObjec
     }
 }
 
+template <typename TileVisitor>
+bool LayoutSceneNode::visitTilesInRange(const TileObjectIds& tileObjectIds,
+                                        const qint64 minTileX,
+                                        const qint64 minTileY,
+                                        const qint64 maxTileX,
+                                        const qint64 maxTileY,
+                                        TileVisitor&& visitor) {
+    // Very large ranges (zoomed-out views, select-all boxes) would probe far
+    // more empty tiles than exist; walk the occupied tiles instead.
+    const double rangeTileCount = (static_cast<double>(maxTileX - minTileX) + 1.0)
+                                  * (static_cast<double>(maxTileY - minTileY) + 1.0);
+    if (rangeTileCount > static_cast<double>(tileObjectIds.size())) {
+        return tileObjectIds.forEach([&](const quint64 key, const QVector<quint64>& objectIds) {
+            const qint64 tileX = static_cast<qint32>(static_cast<quint32>(key >> 32));
+            const qint64 tileY = static_cast<qint32>(static_cast<quint32>(key & 0xffffffffULL));
+            if (tileX < minTileX || tileX > maxTileX || tileY < minTileY || tileY > maxTileY) {
+                return true;
+            }
+            return visitor(tileX, tileY, objectIds);
+        });
+    }
+
+    for (qint64 tileX = minTileX; tileX <= maxTileX; ++tileX) {
+        for (qint64 tileY = minTileY; tileY <= maxTileY; ++tileY) {
+            const QVector<quint64>* objectIds = tileObjectIds.find(tileKey(tileX, tileY));
+            if (!objectIds) {
+                continue;
+            }
+
+            if (!visitor(tileX, tileY, *objectIds)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <typename ObjectIdVisitor>
+bool LayoutSceneNode::visitIndexedObjectsInRect(const qint64 minX,
+                                                const qint64 minY,
+                                                const qint64 maxX,
+                                                const qint64 maxY,
+                                                const RegionQueryMode mode,
+                                                const LayerFilter& layerFilter,
+                                                ObjectIdVisitor&& visitor) const {
+    for (auto partitionIt = m_partitions.cbegin(); partitionIt != m_partitions.cend(); ++partitionIt) {
+        // The layer mask is decided once per partition; masked-off layers
+        // never have their tiles or objects touched.
+        const LayerPartition& partition = partitionIt.value();
+        if (layerFilter && partition.hasLayer && !layerFilter(partition.layerNameId, partition.layerTypeId)) {
+            continue;
+        }
+
+        for (int level = 0; level < kTileLevelCount; ++level) {
+            const TileObjectIds& tileObjectIds = partition.tileObjectIds[level];
+            if (tileObjectIds.isEmpty()) {
+                continue;
+            }
+
+            const qint64 minTileX = tileCoordFor(minX, level);
+            const qint64 maxTileX = tileCoordFor(maxX, level);
+            const qint64 minTileY = tileCoordFor(minY, level);
+            const qint64 maxTileY = tileCoordFor(maxY, level);
+            const bool completed = visitTilesInRange(
+                tileObjectIds, minTileX, minTileY, maxTileX, maxTileY,
+                [&](const qint64 tileX, const qint64 tileY, const QVector<quint64>& objectIds) {
+                    for (quint64 objectId : objectIds) {
+                        const LayoutObjectModel::Bounds* objectBounds = m_objectBoundsById.find(objectId);
+                        if (!objectBounds) {
+                            continue;
+                        }
+
+                        // An object spanning several tiles is reported only
+                        // from the first tile of the query range it
+                        // occupies, so no seen-set is needed to deduplicate.
+                        const LayoutObjectModel::Bounds& bounds = *objectBounds;
+                        if (std::max(minTileX, tileCoordFor(bounds.minX, level)) != tileX
+                            || std::max(minTileY, tileCoordFor(bounds.minY, level)) != tileY
+                            || !boundsMatchRegion(bounds, minX, minY, maxX, maxY, mode)) {
+                            continue;
+                        }
+
+                        if (!visitor(objectId)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                });
+            if (!completed) {
+                return false;
+            }
+        }
+
+        for (quint64 objectId : partition.oversizedObjectIds) {
+            const LayoutObjectModel::Bounds* objectBounds = m_objectBoundsById.find(objectId);
+            if (objectBounds && boundsMatchRegion(*objectBounds, minX, minY, maxX, maxY, mode) && !visitor(objectId)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool LayoutSceneNode::visitObjectsInRect(const qint64 minX,
+                                         const qint64 minY,
+                                         const qint64 maxX,
+                                         const qint64 maxY,
+                                         const ObjectVisitor& visitor) const {
+    bool stopped = false;
+    queryRegion(minX, minY, maxX, maxY, RegionQueryMode::Touch, LayerFilter(),
+                [&visitor, &stopped](const LayoutObjectModel& object) {
+                    stopped = !visitor(object);
+                    return !stopped;
+                });
+    return !stopped;
+}
+
+qint64 LayoutSceneNode::queryRegion(const qint64 minX,
+                                    const qint64 minY,
+                                    const qint64 maxX,
+                                    const qint64 maxY,
+                                    const RegionQueryMode mode,
+                                    const LayerFilter& layerFilter,
+                                    const ObjectVisitor& visitor,
+                                    const qint64 limit) const {
+    qint64 matchCount = 0;
+    if (limit == 0 || minX > maxX || minY > maxY) {
+        return matchCount;
+    }
+
+    QueryScope scope;
+    ensureLoaded();
+    queryRegionRecursive(minX, minY, maxX, maxY, mode, layerFilter, visitor, limit, matchCount);
+    return matchCount;
+}
+
+bool LayoutSceneNode::hasObjectInRegion(const qint64 minX,
+                                        const qint64 minY,
+                                        const qint64 maxX,
+                                        const qint64 maxY,
+                                        const RegionQueryMode mode,
+                                        const LayerFilter& layerFilter) const {
+    return queryRegion(minX, minY, maxX, maxY, mode, layerFilter,
+                       [](const LayoutObjectModel&) { return true; },
+                       1) > 0;
+}
+
+bool LayoutSceneNode::queryRegionRecursive(const qint64 minX,
+                                           const qint64 minY,
+                                           const qint64 maxX,
+                                           const qint64 maxY,
+                                           const RegionQueryMode mode,
+                                           const LayerFilter& layerFilter,
+                                           const ObjectVisitor& visitor,
+                                           const qint64 limit,
+                                           qint64& matchCount) const {
+    const bool completed = visitIndexedObjectsInRect(
+        minX, minY, maxX, maxY, mode, layerFilter,
+        [&](const quint64 objectId) {
+            const std::shared_ptr<LayoutObjectModel>* object = m_objectById.find(objectId);
+            if (!object || !*object) {
+                return true;
+            }
+
+            ++matchCount;
+            return visitor(**object) && (limit < 0 || matchCount < limit);
+        });
+    if (!completed) {
+        return false;
+    }
+
+    for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
+        if (!child->queryRegionRecursive(minX, minY, maxX, maxY, mode, layerFilter, visitor, limit, matchCount)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 QVector<quint64> LayoutSceneNode::matchingObjectIdsAt(
     qint64 x,
     qint64 y,
-    const std::function<bool(const LayoutObjectModel&)>& predicate) const {
+    const std::function<bool(const LayoutObjectModel&)>& predicate,
+    const LayerFilter& layerFilter) const {
+    QueryScope scope;
+    ensureLoaded();
     QVector<quint64> matches;
-    QSet<quint64> candidateObjectIds;
-    collectCandidateObjectIdsInRect(x, y, x, y, candidateObjectIds);
-
     QVector<QPair<int, quint64>> orderedCandidateIds;
-    orderedCandidateIds.reserve(candidateObjectIds.size());
-    for (quint64 objectId : candidateObjectIds) {
-        const auto orderIt = m_objectOrderById.constFind(objectId);
-        if (orderIt == m_objectOrderById.cend()) {
-            continue;
-        }
-        orderedCandidateIds.push_back(qMakePair(orderIt.value(), objectId));
-    }
+    visitIndexedObjectsInRect(x, y, x, y, RegionQueryMode::Touch, layerFilter,
+                              [this, &orderedCandidateIds](const quint64 objectId) {
+                                  if (const int* order = m_objectOrderById.find(objectId)) {
+                                      orderedCandidateIds.push_back(qMakePair(*order, objectId));
+                                  }
+                                  return true;
+                              });
     std::sort(orderedCandidateIds.begin(), orderedCandidateIds.end(),
               [](const QPair<int, quint64>& lhs, const QPair<int, quint64>& rhs) {
                   return lhs.first > rhs.first;
               });
 
     for (const auto& orderedCandidate : orderedCandidateIds) {
-        const quint64 objectId = orderedCandidate.second;
-        const auto objectIt = m_objectById.constFind(objectId);
-        if (objectIt == m_objectById.cend() || !objectIt.value()) {
-            continue;
-        }
-        const std::shared_ptr<LayoutObjectModel>& object = objectIt.value();
-
-        const auto boundsIt = m_objectBoundsById.constFind(objectId);
-        if (boundsIt != m_objectBoundsById.cend() && !boundsContainPoint(boundsIt.value(), x, y)) {
+        const std::shared_ptr<LayoutObjectModel>* found = m_objectById.find(orderedCandidate.second);
+        if (!found || !*found) {
             continue;
         }
+        const std::shared_ptr<LayoutObjectModel>& object = *found;
 
         if (!predicate(*object)) {
             continue;
@@ -206,7 +1320,7 @@ QVector<quint64> LayoutSceneNode::matchingObjectIdsAt(
     }
 
     for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
-        const QVector<quint64> childMatches = child->matchingObjectIdsAt(x, y, predicate);
+        const QVector<quint64> childMatches = child->matchingObjectIdsAt(x, y, predicate, layerFilter);
         for (quint64 objectId : childMatches) {
             matches.push_back(objectId);
         }
@@ -218,18 +1332,17 @@ QVector<quint64> LayoutSceneNode::matchingObjectIdsAt(
 bool LayoutSceneNode::collectOutlineSegmentsByObjectId(
     quint64 objectId,
     QVector<WorldLineSegment>& outSegments) const {
+    QueryScope scope;
+    ensureLoaded();
     return collectOutlineSegmentsByObjectIdRecursive(objectId, outSegments);
 }
 
 bool LayoutSceneNode::collectOutlineSegmentsByObjectIdRecursive(
     quint64 objectId,
     QVector<WorldLineSegment>& outSegments) const {
-    for (const std::shared_ptr<LayoutObjectModel>& object : m_objects) {
-        if (!object || object->objectId() != objectId) {
-            continue;
-        }
-
-        object->appendOutlineSegments(outSegments);
+    const std::shared_ptr<LayoutObjectModel>* object = m_objectById.find(objectId);
+    if (object && *object) {
+        (*object)->appendOutlineSegments(outSegments);
         return true;
     }
 
@@ -243,9 +1356,10 @@ bool LayoutSceneNode::collectOutlineSegmentsByObjectIdRecursive(
 }
 
 const LayoutObjectModel* LayoutSceneNode::findObjectById(quint64 objectId) const {
-    const auto it = m_objectById.constFind(objectId);
-    if (it != m_objectById.cend() && it.value()) {
-        return it.value().get();
+    ensureLoaded();
+    const std::shared_ptr<LayoutObjectModel>* object = m_objectById.find(objectId);
+    if (object && *object) {
+        return object->get();
     }
 
     for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
@@ -258,27 +1372,32 @@ const LayoutObjectModel* LayoutSceneNode::findObjectById(quint64 objectId) const
 }
 
 bool LayoutSceneNode::removeObjectById(quint64 objectId) {
+    materialize();
     return removeObjectByIdRecursive(objectId);
 }
 
 bool LayoutSceneNode::removeObjectByIdRecursive(quint64 objectId) {
     for (int i = 0; i < m_objects.size(); ++i) {
         if (m_objects[i] && m_objects[i]->objectId() == objectId) {
-            deindexObject(objectId);
+            const bool shrinks = deindexObject(objectId);
             m_objectById.remove(objectId);
             m_objectOrderById.remove(objectId);
             m_objects.removeAt(i);
             for (int j = i; j < m_objects.size(); ++j) {
                 if (m_objects[j]) {
-                    m_objectOrderById[m_objects[j]->objectId()] = j;
+                    m_objectOrderById.insert(m_objects[j]->objectId(), j);
                 }
             }
+            if (shrinks) {
+                recomputeBounds();
+            }
             return true;
         }
     }
 
     for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
         if (child->removeObjectByIdRecursive(objectId)) {
+            recomputeBounds();
             return true;
         }
     }
@@ -286,8 +1405,91 @@ bool LayoutSceneNode::removeObjectByIdRecursive(quint64 objectId) {
     return false;
 }
 
-bool LayoutSceneNode::boundsContainPoint(const LayoutObjectModel::Bounds& bounds, const qint64 x, const qint64 y) {
-    return x >= bounds.minX && x <= bounds.maxX && y >= bounds.minY && y <= bounds.maxY;
+int LayoutSceneNode::removeObjectsByIds(const QVector<quint64>& objectIds,
+                                        QVector<std::shared_ptr<LayoutObjectModel>>* outRemoved) {
+    materialize();
+    QSet<quint64> pendingObjectIds;
+    pendingObjectIds.reserve(objectIds.size());
+    for (quint64 objectId : objectIds) {
+        pendingObjectIds.insert(objectId);
+    }
+
+    return removeObjectsByIdsRecursive(pendingObjectIds, outRemoved);
+}
+
+int LayoutSceneNode::removeObjectsByIdsRecursive(QSet<quint64>& pendingObjectIds,
+                                                 QVector<std::shared_ptr<LayoutObjectModel>>* outRemoved) {
+    QSet<quint64> localObjectIds;
+    for (quint64 objectId : pendingObjectIds) {
+        if (m_objectById.contains(objectId)) {
+            localObjectIds.insert(objectId);
+        }
+    }
+
+    bool shrinks = false;
+    if (!localObjectIds.isEmpty()) {
+        shrinks = deindexObjects(localObjectIds);
+        for (quint64 objectId : localObjectIds) {
+            m_objectById.remove(objectId);
+            m_objectOrderById.remove(objectId);
+            pendingObjectIds.remove(objectId);
+        }
+
+        // Single compaction pass; only survivors that actually move get their
+        // paint order rewritten.
+        int writeIndex = 0;
+        for (int readIndex = 0; readIndex < m_objects.size(); ++readIndex) {
+            if (m_objects[readIndex] && localObjectIds.contains(m_objects[readIndex]->objectId())) {
+                if (outRemoved) {
+                    outRemoved->push_back(std::move(m_objects.mutableAt(readIndex)));
+                }
+                continue;
+            }
+
+            if (writeIndex != readIndex) {
+                m_objects.mutableAt(writeIndex) = std::move(m_objects.mutableAt(readIndex));
+                if (m_objects[writeIndex]) {
+                    m_objectOrderById.insert(m_objects[writeIndex]->objectId(), writeIndex);
+                }
+            }
+            ++writeIndex;
+        }
+        m_objects.truncate(writeIndex);
+    }
+
+    int removed = localObjectIds.size();
+    for (const std::shared_ptr<LayoutSceneNode>& child : m_children) {
+        if (pendingObjectIds.isEmpty()) {
+            break;
+        }
+        const int childRemoved = child->removeObjectsByIdsRecursive(pendingObjectIds, outRemoved);
+        shrinks = shrinks || childRemoved > 0;
+        removed += childRemoved;
+    }
+
+    if (shrinks) {
+        recomputeBounds();
+    }
+
+    return removed;
+}
+
+bool LayoutSceneNode::boundsMatchRegion(const LayoutObjectModel::Bounds& bounds,
+                                        const qint64 minX,
+                                        const qint64 minY,
+                                        const qint64 maxX,
+                                        const qint64 maxY,
+                                        const RegionQueryMode mode) {
+    switch (mode) {
+    case RegionQueryMode::Inside:
+        return bounds.minX >= minX && bounds.maxX <= maxX && bounds.minY >= minY && bounds.maxY <= maxY;
+    case RegionQueryMode::Overlap:
+        return bounds.minX < maxX && bounds.maxX > minX && bounds.minY < maxY && bounds.maxY > minY;
+    case RegionQueryMode::Touch:
+        return boundsIntersectRect(bounds, minX, minY, maxX, maxY);
+    }
+
+    return false;
 }
 
 bool LayoutSceneNode::boundsIntersectRect(const LayoutObjectModel::Bounds& bounds,
@@ -298,11 +1500,34 @@ bool LayoutSceneNode::boundsIntersectRect(const LayoutObjectModel::Bounds& bound
     return !(bounds.maxX < minX || bounds.minX > maxX || bounds.maxY < minY || bounds.minY > maxY);
 }
 
-qint64 LayoutSceneNode::tileCoordFor(const qint64 coordinate) {
+qint64 LayoutSceneNode::tileCoordFor(const qint64 coordinate, const int level) {
+    const qint64 tileSize = kSpatialTileSize << (level * kTileLevelShift);
     if (coordinate >= 0) {
-        return coordinate / kSpatialTileSize;
+        return coordinate / tileSize;
     }
-    return -(((-coordinate) + kSpatialTileSize - 1) / kSpatialTileSize);
+    // Written so that -coordinate cannot overflow.
+    return -1 - ((-(coordinate + 1)) / tileSize);
+}
+
+int LayoutSceneNode::tileLevelFor(const LayoutObjectModel::Bounds& bounds) {
+    for (int level = 0; level < kTileLevelCount; ++level) {
+        // Spans are tile counts minus one; each fits in 64 bits.
+        const qint64 spanX = tileCoordFor(bounds.maxX, level) - tileCoordFor(bounds.minX, level);
+        const qint64 spanY = tileCoordFor(bounds.maxY, level) - tileCoordFor(bounds.minY, level);
+        if (spanX < kMaxTilesPerAxis && spanY < kMaxTilesPerAxis) {
+            return level;
+        }
+    }
+    return kTileLevelCount;
+}
+
+bool LayoutSceneNode::LayerPartition::isEmpty() const {
+    for (const TileObjectIds& levelTiles : tileObjectIds) {
+        if (!levelTiles.isEmpty()) {
+            return false;
+        }
+    }
+    return oversizedObjectIds.isEmpty();
 }
 
 quint64 LayoutSceneNode::tileKey(const qint64 tileX, const qint64 tileY) {
@@ -310,6 +1535,20 @@ quint64 LayoutSceneNode::tileKey(const qint64 tileX, const qint64 tileY) {
            | static_cast<quint64>(static_cast<quint32>(tileY));
 }
 
+quint64 LayoutSceneNode::partitionKeyFor(const LayoutObjectModel& object,
+                                         quint32& outLayerNameId,
+                                         quint32& outLayerTypeId,
+                                         bool& outHasLayer) {
+    outLayerNameId = 0;
+    outLayerTypeId = 0;
+    outHasLayer = object.tryGetLayer(outLayerNameId, outLayerTypeId);
+    if (!outHasLayer) {
+        return kUnlayeredPartitionKey;
+    }
+
+    return (static_cast<quint64>(outLayerNameId) << 32) | static_cast<quint64>(outLayerTypeId);
+}
+
 void LayoutSceneNode::indexObject(const std::shared_ptr<LayoutObjectModel>& object) {
     if (!object) {
         return;
@@ -322,18 +1561,41 @@ void LayoutSceneNode::indexObject(const std::shared_ptr<LayoutObjectModel>& obje
 
     const quint64 objectId = object->objectId();
     m_objectBoundsById.insert(objectId, bounds);
+    growBounds(bounds);
+
+    quint32 layerNameId = 0;
+    quint32 layerTypeId = 0;
+    bool hasLayer = false;
+    const quint64 partitionKey = partitionKeyFor(*object, layerNameId, layerTypeId, hasLayer);
+    LayerPartition& partition = m_partitions[partitionKey];
+    partition.layerNameId = layerNameId;
+    partition.layerTypeId = layerTypeId;
+    partition.hasLayer = hasLayer;
+    m_objectPartitionKeys.insert(objectId, partitionKey);
+
+    const int level = tileLevelFor(bounds);
+    if (level == kTileLevelCount) {
+        partition.oversizedObjectIds.push_back(objectId);
+        m_objectTileLevels.insert(objectId, level);
+        m_objectTileKeys.insert(objectId, QVector<quint64>());
+        return;
+    }
+    if (level > 0) {
+        m_objectTileLevels.insert(objectId, level);
+    }
 
-    const qint64 minTileX = tileCoordFor(bounds.minX);
-    const qint64 maxTileX = tileCoordFor(bounds.maxX);
-    const qint64 minTileY = tileCoordFor(bounds.minY);
-    const qint64 maxTileY = tileCoordFor(bounds.maxY);
+    const qint64 minTileX = tileCoordFor(bounds.minX, level);
+    const qint64 maxTileX = tileCoordFor(bounds.maxX, level);
+    const qint64 minTileY = tileCoordFor(bounds.minY, level);
+    const qint64 maxTileY = tileCoordFor(bounds.maxY, level);
 
+    TileObjectIds& tileObjectIds = partition.tileObjectIds[level];
     QVector<quint64> tileKeys;
     tileKeys.reserve(static_cast<int>((maxTileX - minTileX + 1) * (maxTileY - minTileY + 1)));
     for (qint64 tileX = minTileX; tileX <= maxTileX; ++tileX) {
         for (qint64 tileY = minTileY; tileY <= maxTileY; ++tileY) {
             const quint64 key = tileKey(tileX, tileY);
-            m_tileObjectIds[key].push_back(objectId);
+            tileObjectIds[key].push_back(objectId);
             tileKeys.push_back(key);
         }
     }
@@ -341,50 +1603,106 @@ void LayoutSceneNode::indexObject(const std::shared_ptr<LayoutObjectModel>& obje
     m_objectTileKeys.insert(objectId, std::move(tileKeys));
 }
 
-void LayoutSceneNode::deindexObject(const quint64 objectId) {
-    const auto tileKeysIt = m_objectTileKeys.constFind(objectId);
-    if (tileKeysIt != m_objectTileKeys.cend()) {
-        for (quint64 key : tileKeysIt.value()) {
-            auto idsIt = m_tileObjectIds.find(key);
-            if (idsIt == m_tileObjectIds.end()) {
-                continue;
+bool LayoutSceneNode::deindexObject(const quint64 objectId) {
+    const LayoutObjectModel::Bounds* bounds = m_objectBoundsById.find(objectId);
+    const bool shrinks = bounds && touchesBoundsEdge(*bounds);
+    const quint64* partitionKey = m_objectPartitionKeys.find(objectId);
+    const QVector<quint64>* tileKeys = m_objectTileKeys.find(objectId);
+    if (partitionKey && tileKeys) {
+        const auto partitionIt = m_partitions.find(*partitionKey);
+        if (partitionIt != m_partitions.end()) {
+            LayerPartition& partition = partitionIt.value();
+            const int* storedLevel = m_objectTileLevels.find(objectId);
+            const int level = storedLevel ? *storedLevel : 0;
+            if (level == kTileLevelCount) {
+                partition.oversizedObjectIds.removeAll(objectId);
+            } else {
+                TileObjectIds& tileObjectIds = partition.tileObjectIds[level];
+                for (quint64 key : *tileKeys) {
+                    if (!tileObjectIds.contains(key)) {
+                        continue;
+                    }
+
+                    QVector<quint64>& ids = tileObjectIds[key];
+                    ids.removeAll(objectId);
+                    if (ids.isEmpty()) {
+                        tileObjectIds.remove(key);
+                    }
+                }
             }
 
-            QVector<quint64>& ids = idsIt.value();
-            ids.removeAll(objectId);
-            if (ids.isEmpty()) {
-                m_tileObjectIds.erase(idsIt);
+            if (partition.isEmpty()) {
+                m_partitions.erase(partitionIt);
             }
         }
-
-        m_objectTileKeys.erase(tileKeysIt);
     }
 
+    m_objectTileKeys.remove(objectId);
+    m_objectTileLevels.remove(objectId);
+    m_objectPartitionKeys.remove(objectId);
     m_objectBoundsById.remove(objectId);
+    return shrinks;
 }
 
-void LayoutSceneNode::collectCandidateObjectIdsInRect(const qint64 minX,
-                                                      const qint64 minY,
-                                                      const qint64 maxX,
-                                                      const qint64 maxY,
-                                                      QSet<quint64>& outCandidateIds) const {
-    const qint64 minTileX = tileCoordFor(minX);
-    const qint64 maxTileX = tileCoordFor(maxX);
-    const qint64 minTileY = tileCoordFor(minY);
-    const qint64 maxTileY = tileCoordFor(maxY);
+bool LayoutSceneNode::deindexObjects(const QSet<quint64>& objectIds) {
+    // Bulk variant of deindexObject(): every touched tile bucket is filtered
+    // once instead of once per removed object. Affected tiles are keyed by
+    // partition and level; kTileLevelCount stands for the oversized list.
+    QHash<quint64, QHash<int, QSet<quint64>>> affectedTileKeysByPartition;
+    bool shrinks = false;
+    for (quint64 objectId : objectIds) {
+        const LayoutObjectModel::Bounds* bounds = m_objectBoundsById.find(objectId);
+        shrinks = shrinks || (bounds && touchesBoundsEdge(*bounds));
+        const quint64* partitionKey = m_objectPartitionKeys.find(objectId);
+        const QVector<quint64>* tileKeys = m_objectTileKeys.find(objectId);
+        if (partitionKey && tileKeys) {
+            const int* storedLevel = m_objectTileLevels.find(objectId);
+            QSet<quint64>& affectedTileKeys = affectedTileKeysByPartition[*partitionKey][storedLevel ? *storedLevel : 0];
+            for (quint64 key : *tileKeys) {
+                affectedTileKeys.insert(key);
+            }
+        }
 
-    for (qint64 tileX = minTileX; tileX <= maxTileX; ++tileX) {
-        for (qint64 tileY = minTileY; tileY <= maxTileY; ++tileY) {
-            const auto idsIt = m_tileObjectIds.constFind(tileKey(tileX, tileY));
-            if (idsIt == m_tileObjectIds.cend()) {
+        m_objectPartitionKeys.remove(objectId);
+        m_objectTileKeys.remove(objectId);
+        m_objectTileLevels.remove(objectId);
+        m_objectBoundsById.remove(objectId);
+    }
+
+    const auto isRemoved = [&objectIds](const quint64 objectId) { return objectIds.contains(objectId); };
+    for (auto affectedIt = affectedTileKeysByPartition.cbegin(); affectedIt != affectedTileKeysByPartition.cend(); ++affectedIt) {
+        const auto partitionIt = m_partitions.find(affectedIt.key());
+        if (partitionIt == m_partitions.end()) {
+            continue;
+        }
+
+        LayerPartition& partition = partitionIt.value();
+        for (auto levelIt = affectedIt.value().cbegin(); levelIt != affectedIt.value().cend(); ++levelIt) {
+            if (levelIt.key() == kTileLevelCount) {
+                QVector<quint64>& ids = partition.oversizedObjectIds;
+                ids.erase(std::remove_if(ids.begin(), ids.end(), isRemoved), ids.end());
                 continue;
             }
 
-            for (quint64 objectId : idsIt.value()) {
-                outCandidateIds.insert(objectId);
+            TileObjectIds& tileObjectIds = partition.tileObjectIds[levelIt.key()];
+            for (quint64 key : levelIt.value()) {
+                if (!tileObjectIds.contains(key)) {
+                    continue;
+                }
+
+                QVector<quint64>& ids = tileObjectIds[key];
+                ids.erase(std::remove_if(ids.begin(), ids.end(), isRemoved), ids.end());
+                if (ids.isEmpty()) {
+                    tileObjectIds.remove(key);
+                }
             }
         }
+
+        if (partition.isEmpty()) {
+            m_partitions.erase(partitionIt);
+        }
     }
+    return shrinks;
 }
 
 bool LayoutEditPreviewModel::tryBuildPreviewPrimitive(const QString& activeTool,
@@ -7,8 +7,14 @@
 #include <functional>
 #include <memory>
 
+#include "LayoutCowContainers.h"
 #include "LayoutGeometry.h"
 
+class LayoutSceneNode;
+
+// Layer mask used by scene queries; returns true for layers to visit.
+using LayoutLayerFilter = std::function<bool(quint32 layerNameId, quint32 layerTypeId)>;
+
 // Base scene object. Additional object kinds (paths/instances/text) can
 // implement this interface and be inserted into a scene node.
 class LayoutObjectModel {
@@ -27,20 +33,37 @@ public:
 
     virtual bool containsPoint(qint64 x, qint64 y) const = 0;
     virtual const DrawnRectangle* asRectangle() const { return nullptr; }
+    // Objects drawn on a single layer report it here; layerless objects
+    // (instances) keep the default.
+    virtual bool tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const;
     virtual bool tryGetBounds(Bounds& outBounds) const = 0;
     virtual void appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const = 0;
     virtual void appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const = 0;
+    // Region-limited variant used by the render query. Leaf shapes ignore the
+    // rect and filter; hierarchical objects use them to expand only what is
+    // visible.
+    virtual void appendRenderPrimitivesInRect(qint64 minX,
+                                              qint64 minY,
+                                              qint64 maxX,
+                                              qint64 maxY,
+                                              const LayoutLayerFilter& layerFilter,
+                                              QVector<SceneRenderPrimitive>& outPrimitives) const;
 
 private:
     quint64 m_objectId{0};
 };
 
+// Rough memory cost of one object: the object, its control block, its
+// points and its entries in a node's lookup and tile tables.
+qint64 estimateObjectBytes(const LayoutObjectModel& object);
+
 class RectangleObjectModel final : public LayoutObjectModel {
 public:
     explicit RectangleObjectModel(const DrawnRectangle& rectangle);
 
     bool containsPoint(qint64 x, qint64 y) const override;
     const DrawnRectangle* asRectangle() const override;
+    bool tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const override;
     bool tryGetBounds(Bounds& outBounds) const override;
     void appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const override;
     void appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const override;
@@ -49,6 +72,140 @@ private:
     DrawnRectangle m_rectangle;
 };
 
+// Simple polygon (GDSII BOUNDARY). Vertices are stored open; the closing edge
+// back to the first vertex is implicit.
+class PolygonObjectModel final : public LayoutObjectModel {
+public:
+    PolygonObjectModel(quint32 layerNameId, quint32 layerTypeId, QVector<WorldPoint> vertices);
+
+    const QVector<WorldPoint>& vertices() const;
+
+    bool containsPoint(qint64 x, qint64 y) const override;
+    bool tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const override;
+    bool tryGetBounds(Bounds& outBounds) const override;
+    void appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const override;
+    void appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const override;
+
+private:
+    quint32 m_layerNameId{0};
+    quint32 m_layerTypeId{0};
+    QVector<WorldPoint> m_vertices;
+    Bounds m_bounds;
+};
+
+// Wire along a centerline (GDSII PATH). Each segment renders as its own
+// quad; round ends (path type 1) are approximated with square extensions.
+class PathObjectModel final : public LayoutObjectModel {
+public:
+    PathObjectModel(quint32 layerNameId,
+                    quint32 layerTypeId,
+                    QVector<WorldPoint> points,
+                    qint64 width,
+                    qint64 beginExtension,
+                    qint64 endExtension);
+
+    const QVector<WorldPoint>& points() const;
+    // Even width; odd input widths are rounded down.
+    qint64 width() const;
+    qint64 beginExtension() const;
+    qint64 endExtension() const;
+
+    bool containsPoint(qint64 x, qint64 y) const override;
+    bool tryGetLayer(quint32& outLayerNameId, quint32& outLayerTypeId) const override;
+    bool tryGetBounds(Bounds& outBounds) const override;
+    void appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const override;
+    void appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const override;
+
+private:
+    QVector<WorldPoint> segmentQuad(int segmentIndex) const;
+
+    quint32 m_layerNameId{0};
+    quint32 m_layerTypeId{0};
+    QVector<WorldPoint> m_points;
+    qint64 m_halfWidth{0};
+    qint64 m_beginExtension{0};
+    qint64 m_endExtension{0};
+    Bounds m_bounds;
+};
+
+// Placement transform applied as: mirror about X (optional), scale, rotate
+// counter-clockwise, then translate. Multiples of 90 degrees with unit
+// magnification stay in exact integer arithmetic.
+struct LayoutTransform {
+    qint64 originX{0};
+    qint64 originY{0};
+    double magnification{1.0};
+    double angleDegrees{0.0};
+    bool mirrorX{false};
+
+    WorldPoint apply(qint64 x, qint64 y) const;
+    WorldPoint applyInverse(qint64 x, qint64 y) const;
+    LayoutObjectModel::Bounds applyToBounds(const LayoutObjectModel::Bounds& bounds) const;
+    LayoutObjectModel::Bounds applyInverseToBounds(const LayoutObjectModel::Bounds& bounds) const;
+};
+
+// Placement of a master cell (GDSII SREF/AREF). Arrays keep their
+// columns x rows repetition compact instead of expanding to one object per
+// element; element (c, r) is placed at origin + c * columnStep + r * rowStep.
+class InstanceObjectModel final : public LayoutObjectModel {
+public:
+    InstanceObjectModel(std::shared_ptr<const LayoutSceneNode> master,
+                        const LayoutTransform& transform,
+                        int columns = 1,
+                        int rows = 1,
+                        WorldPoint columnStep = WorldPoint{0, 0},
+                        WorldPoint rowStep = WorldPoint{0, 0});
+
+    // Extent of a columns x rows placement of a master with masterBounds.
+    static LayoutObjectModel::Bounds placementBounds(const LayoutObjectModel::Bounds& masterBounds,
+                                                     const LayoutTransform& transform,
+                                                     int columns,
+                                                     int rows,
+                                                     WorldPoint columnStep,
+                                                     WorldPoint rowStep);
+
+    const LayoutSceneNode* master() const;
+    // Owning handle, for building further placements of the same master.
+    std::shared_ptr<const LayoutSceneNode> sharedMaster() const;
+    const LayoutTransform& transform() const;
+    int columns() const;
+    int rows() const;
+    WorldPoint columnStep() const;
+    WorldPoint rowStep() const;
+
+    bool containsPoint(qint64 x, qint64 y) const override;
+    bool tryGetBounds(Bounds& outBounds) const override;
+    void appendOutlineSegments(QVector<WorldLineSegment>& outSegments) const override;
+    void appendRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const override;
+    void appendRenderPrimitivesInRect(qint64 minX,
+                                      qint64 minY,
+                                      qint64 maxX,
+                                      qint64 maxY,
+                                      const LayoutLayerFilter& layerFilter,
+                                      QVector<SceneRenderPrimitive>& outPrimitives) const override;
+
+private:
+    // Transform of array element (column, row).
+    LayoutTransform elementTransform(int column, int row) const;
+    // Narrows the element index range to elements whose bounds can touch the
+    // rect; exact for axis-aligned steps, otherwise the full range.
+    void elementRangeForRect(qint64 minX,
+                             qint64 minY,
+                             qint64 maxX,
+                             qint64 maxY,
+                             int& outFirstColumn,
+                             int& outLastColumn,
+                             int& outFirstRow,
+                             int& outLastRow) const;
+
+    std::shared_ptr<const LayoutSceneNode> m_master;
+    LayoutTransform m_transform;
+    int m_columns{1};
+    int m_rows{1};
+    WorldPoint m_columnStep{0, 0};
+    WorldPoint m_rowStep{0, 0};
+};
+
 
 namespace LayoutEditPreviewModel {
 bool tryBuildPreviewPrimitive(const QString& activeTool,
@@ -72,55 +229,282 @@ bool tryBuildCommittedObject(const QString& activeTool,
                              std::shared_ptr<LayoutObjectModel>& outObject);
 }
 
+// Supplies the objects of lazily loaded cells (see
+// LayoutSceneNode::setLazyContent). Called from whichever thread queries the
+// scene. Calls for one cell are serialized, but different cells may load
+// concurrently, so loadCell must be thread-safe across cells.
+class LayoutLazyCellSource {
+public:
+    virtual ~LayoutLazyCellSource() = default;
+
+    // Decodes cell cellIndex. masters are the nodes given to setLazyContent;
+    // instances created here must place one of them.
+    virtual bool loadCell(int cellIndex,
+                          const QVector<std::shared_ptr<const LayoutSceneNode>>& masters,
+                          QVector<std::shared_ptr<LayoutObjectModel>>& outObjects,
+                          QString& error) = 0;
+};
+
+// Paint-order object storage of a scene node.
+using LayoutObjectList = LayoutChunkedVector<std::shared_ptr<LayoutObjectModel>>;
+
 // Hierarchical container for objects and child scene nodes.
+//
+// A node is edited from one thread at a time. Readers on other threads work
+// on a snapshot(): all of a node's storage is copy-on-write (see
+// LayoutCowContainers.h), so the snapshot shares it with the live node and
+// an edit made afterwards copies only the chunks and shards it touches.
 class LayoutSceneNode {
 public:
+    using LayerFilter = LayoutLayerFilter;
+    using ObjectVisitor = std::function<bool(const LayoutObjectModel&)>;
+
+    // Brackets every public query. Lazy cells are only evicted once no
+    // scope is open on any thread, so nothing a query is iterating can
+    // disappear. A thread walking objects() of lazy cells directly (file
+    // writers, background jobs) holds one around the walk.
+    class QueryScope {
+    public:
+        QueryScope();
+        ~QueryScope();
+        QueryScope(const QueryScope&) = delete;
+        QueryScope& operator=(const QueryScope&) = delete;
+    };
+
+    LayoutSceneNode();
+    ~LayoutSceneNode();
+    LayoutSceneNode(const LayoutSceneNode&) = delete;
+    LayoutSceneNode& operator=(const LayoutSceneNode&) = delete;
+
+    // Makes this node a lazily loaded cell. bounds and objectCount are
+    // answered from the directory; the objects themselves are requested from
+    // source on first access and dropped again when loaded lazy cells exceed
+    // the memory limit. Eviction only happens when the outermost scene query
+    // returns, and never drops a cell used by that query, so results are
+    // unaffected; references from objects(), collectObjects() or
+    // findObjectById() on a lazy cell stay valid until the next query on any
+    // thread ends, or while a QueryScope is held.
+    // Editing a lazy cell loads it for good. masters are kept alive for the
+    // instances the source creates.
+    void setLazyContent(std::shared_ptr<LayoutLazyCellSource> source,
+                        int cellIndex,
+                        const LayoutObjectModel::Bounds& bounds,
+                        int objectCount,
+                        QVector<std::shared_ptr<const LayoutSceneNode>> masters);
+    bool isLazy() const;
+    bool isLoaded() const;
+
+    // Memory budget shared by all lazy cells, in estimated bytes. Defaults
+    // to LAYOUT2_CELL_CACHE_MB megabytes (1024 when unset).
+    static void setLazyCellMemoryLimit(qint64 bytes);
+    static qint64 lazyCellMemoryLimit();
+    static qint64 lazyCellMemoryUsage();
+    static int loadedLazyCellCount();
+    // Cells whose source failed to decode since startup (they read as
+    // empty) and the message of the latest failure.
+    static int failedLazyCellLoadCount();
+    static QString lastLazyCellLoadError();
+
     void addObject(std::shared_ptr<LayoutObjectModel> object);
+    // Bulk insert used by file readers; reserves storage once for the batch.
+    void addObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects);
     void addChild(std::shared_ptr<LayoutSceneNode> child);
 
+    // Cell name (empty for the editor's root node).
+    const QString& name() const;
+    void setName(const QString& name);
+    int objectCount() const;
+    // Direct objects in paint order; children are not included.
+    const LayoutObjectList& objects() const;
+
+    // Immutable copy of this node's current content that any thread may
+    // query. O(1) once this node is loaded: the copy shares all storage,
+    // copies the bounds, and shares child nodes and instance masters by
+    // pointer (they are not edited once built). Lazily loaded masters stay
+    // lazy and load on demand from whichever thread reaches them.
+    std::shared_ptr<const LayoutSceneNode> snapshot() const;
+    // Editable copy sharing storage the same way: edits to either node copy
+    // only what they touch, so the copy can be owned and edited by another
+    // thread (background scripts build on one).
+    std::unique_ptr<LayoutSceneNode> detachedCopy() const;
+
+    // Union of all object and child bounds, kept exact by every mutation,
+    // so this is a plain read. Returns false for an empty node.
+    bool tryGetBounds(LayoutObjectModel::Bounds& outBounds) const;
+
     void collectRectangles(QVector<const DrawnRectangle*>& outRectangles) const;
     void collectRenderPrimitives(QVector<SceneRenderPrimitive>& outPrimitives) const;
     void collectRenderPrimitivesInRect(qint64 minX,
                                        qint64 minY,
                                        qint64 maxX,
                                        qint64 maxY,
-                                       QVector<SceneRenderPrimitive>& outPrimitives) const;
+                                       QVector<SceneRenderPrimitive>& outPrimitives,
+                                       const LayerFilter& layerFilter = LayerFilter()) const;
     void collectObjects(QVector<const LayoutObjectModel*>& outObjects) const;
+    // Streams every object whose bounds touch the rect to visitor (shorthand
+    // for queryRegion in Touch mode without a layer filter). Returning false
+    // from the visitor stops the traversal; the function then returns false.
+    bool visitObjectsInRect(qint64 minX,
+                            qint64 minY,
+                            qint64 maxX,
+                            qint64 maxY,
+                            const ObjectVisitor& visitor) const;
+    // Region query over the tile index. Objects are compared to the rect by
+    // their bounds (exact for rectangles) according to mode. A null
+    // layerFilter accepts everything; objects without a layer (instances)
+    // are never filtered out. Each match is streamed to visitor exactly
+    // once; the query stops when the visitor returns false or after limit
+    // matches (limit < 0 means unbounded). Returns the number of objects
+    // passed to visitor.
+    qint64 queryRegion(qint64 minX,
+                       qint64 minY,
+                       qint64 maxX,
+                       qint64 maxY,
+                       RegionQueryMode mode,
+                       const LayerFilter& layerFilter,
+                       const ObjectVisitor& visitor,
+                       qint64 limit = -1) const;
+    bool hasObjectInRegion(qint64 minX,
+                           qint64 minY,
+                           qint64 maxX,
+                           qint64 maxY,
+                           RegionQueryMode mode,
+                           const LayerFilter& layerFilter) const;
     QVector<quint64> matchingObjectIdsAt(qint64 x,
                                          qint64 y,
-                                         const std::function<bool(const LayoutObjectModel&)>& predicate) const;
+                                         const std::function<bool(const LayoutObjectModel&)>& predicate,
+                                         const LayerFilter& layerFilter = LayerFilter()) const;
     bool collectOutlineSegmentsByObjectId(quint64 objectId, QVector<WorldLineSegment>& outSegments) const;
     const LayoutObjectModel* findObjectById(quint64 objectId) const;
     bool removeObjectById(quint64 objectId);
+    // Bulk removal: index buckets and paint order are compacted once for the
+    // whole batch. Returns the number of objects removed; outRemoved, when
+    // given, receives them in paint order.
+    int removeObjectsByIds(const QVector<quint64>& objectIds,
+                           QVector<std::shared_ptr<LayoutObjectModel>>* outRemoved = nullptr);
 private:
+    struct LazyContent;
+
     static constexpr qint64 kSpatialTileSize = 2048;
+    // Each index level's tiles are 16 x 16 tiles of the level below. An
+    // object goes to the lowest level where it spans at most
+    // kMaxTilesPerAxis tiles on each axis, so it has at most 16 tile
+    // entries whatever its size.
+    static constexpr int kTileLevelCount = 6;
+    static constexpr int kTileLevelShift = 4;
+    static constexpr qint64 kMaxTilesPerAxis = 4;
+    static constexpr quint64 kUnlayeredPartitionKey = ~0ULL;
+
+    // Groups tile keys into blocks of 16 x 16 tiles.
+    struct TileShardKey {
+        static quint64 of(const quint64 tileKey) {
+            return ((tileKey >> 36) << 32) | ((tileKey & 0xffffffffULL) >> 4);
+        }
+    };
+    using TileObjectIds = LayoutShardedHash<QVector<quint64>, TileShardKey>;
+
+    // The tile index is split per (layerNameId, layerTypeId) so a query's
+    // layer filter is evaluated once per layer instead of once per object.
+    // Objects without a layer share kUnlayeredPartitionKey; that partition is
+    // always visited and instances apply the filter inside their master.
+    struct LayerPartition {
+        quint32 layerNameId{0};
+        quint32 layerTypeId{0};
+        bool hasLayer{false};
+        TileObjectIds tileObjectIds[kTileLevelCount];
+        // Objects too large even for the top level; checked on every query.
+        QVector<quint64> oversizedObjectIds;
+
+        bool isEmpty() const;
+    };
 
-    static bool boundsContainPoint(const LayoutObjectModel::Bounds& bounds, qint64 x, qint64 y);
+    static bool boundsMatchRegion(const LayoutObjectModel::Bounds& bounds,
+                                  qint64 minX,
+                                  qint64 minY,
+                                  qint64 maxX,
+                                  qint64 maxY,
+                                  RegionQueryMode mode);
     static bool boundsIntersectRect(const LayoutObjectModel::Bounds& bounds,
                                     qint64 minX,
                                     qint64 minY,
                                     qint64 maxX,
                                     qint64 maxY);
-    static qint64 tileCoordFor(qint64 coordinate);
+    static qint64 tileCoordFor(qint64 coordinate, int level = 0);
+    // Lowest index level for bounds, or kTileLevelCount when oversized.
+    static int tileLevelFor(const LayoutObjectModel::Bounds& bounds);
     static quint64 tileKey(qint64 tileX, qint64 tileY);
 
+    static quint64 partitionKeyFor(const LayoutObjectModel& object,
+                                   quint32& outLayerNameId,
+                                   quint32& outLayerTypeId,
+                                   bool& outHasLayer);
+
+    template <typename TileVisitor>
+    static bool visitTilesInRange(const TileObjectIds& tileObjectIds,
+                                  qint64 minTileX,
+                                  qint64 minTileY,
+                                  qint64 maxTileX,
+                                  qint64 maxTileY,
+                                  TileVisitor&& visitor);
+    // Visits IDs of this node's indexed objects matching the rect under mode
+    // on layers accepted by layerFilter, once each. Children are not visited.
+    template <typename ObjectIdVisitor>
+    bool visitIndexedObjectsInRect(qint64 minX,
+                                   qint64 minY,
+                                   qint64 maxX,
+                                   qint64 maxY,
+                                   RegionQueryMode mode,
+                                   const LayerFilter& layerFilter,
+                                   ObjectIdVisitor&& visitor) const;
+
     void indexObject(const std::shared_ptr<LayoutObjectModel>& object);
-    void deindexObject(quint64 objectId);
-    void collectCandidateObjectIdsInRect(qint64 minX,
-                                         qint64 minY,
-                                         qint64 maxX,
-                                         qint64 maxY,
-                                         QSet<quint64>& outCandidateIds) const;
+    // Return true when a removed object reached the edge of the node's
+    // bounds, which then need recomputeBounds().
+    bool deindexObject(quint64 objectId);
+    bool deindexObjects(const QSet<quint64>& objectIds);
 
     bool collectOutlineSegmentsByObjectIdRecursive(quint64 objectId,
                                                    QVector<WorldLineSegment>& outSegments) const;
     bool removeObjectByIdRecursive(quint64 objectId);
+    int removeObjectsByIdsRecursive(QSet<quint64>& pendingObjectIds,
+                                    QVector<std::shared_ptr<LayoutObjectModel>>* outRemoved);
+    bool queryRegionRecursive(qint64 minX,
+                              qint64 minY,
+                              qint64 maxX,
+                              qint64 maxY,
+                              RegionQueryMode mode,
+                              const LayerFilter& layerFilter,
+                              const ObjectVisitor& visitor,
+                              qint64 limit,
+                              qint64& matchCount) const;
+
+    // The bounds are kept exact by every mutation, so const readers (also
+    // of masters shared across threads) never write them. Adds grow them in
+    // place; removals recompute only when the extent may shrink.
+    void growBounds(const LayoutObjectModel::Bounds& bounds);
+    bool touchesBoundsEdge(const LayoutObjectModel::Bounds& bounds) const;
+    void recomputeBounds();
+
+    void appendObjects(QVector<std::shared_ptr<LayoutObjectModel>> objects);
+    // Lazy cells: load on access, drop on eviction, and turn into a regular
+    // node before an edit.
+    void ensureLoaded() const;
+    void unload();
+    void materialize();
+    static void trimLazyCells();
 
-    QVector<std::shared_ptr<LayoutObjectModel>> m_objects;
+    QString m_name;
+    LayoutObjectList m_objects;
     QVector<std::shared_ptr<LayoutSceneNode>> m_children;
-    QHash<quint64, std::shared_ptr<LayoutObjectModel>> m_objectById;
-    QHash<quint64, int> m_objectOrderById;
-    QHash<quint64, LayoutObjectModel::Bounds> m_objectBoundsById;
-    QHash<quint64, QVector<quint64>> m_tileObjectIds;
-    QHash<quint64, QVector<quint64>> m_objectTileKeys;
+    LayoutShardedHash<std::shared_ptr<LayoutObjectModel>, LayoutObjectIdShardKey> m_objectById;
+    LayoutShardedHash<int, LayoutObjectIdShardKey> m_objectOrderById;
+    LayoutShardedHash<LayoutObjectModel::Bounds, LayoutObjectIdShardKey> m_objectBoundsById;
+    QHash<quint64, LayerPartition> m_partitions;
+    LayoutShardedHash<quint64, LayoutObjectIdShardKey> m_objectPartitionKeys;
+    LayoutShardedHash<QVector<quint64>, LayoutObjectIdShardKey> m_objectTileKeys;
+    // Index level of objects above level 0 (absent means level 0).
+    LayoutShardedHash<int, LayoutObjectIdShardKey> m_objectTileLevels;
+    LayoutObjectModel::Bounds m_cachedBounds;
+    bool m_hasCachedBounds{false};
+    std::unique_ptr<LazyContent> m_lazy;
 };
@@ -0,0 +1,81 @@
+#include "LayoutSelectionSet.h"
+
+#include <algorithm>
+
+bool LayoutSelectionSet::contains(const quint64 objectId) const {
+    const quint64 wordIndex = objectId >> 6;
+    if (wordIndex >= static_cast<quint64>(m_words.size())) {
+        return false;
+    }
+
+    return (m_words[static_cast<int>(wordIndex)] >> (objectId & 63)) & 0x1ULL;
+}
+
+bool LayoutSelectionSet::insert(const quint64 objectId) {
+    if (objectId == 0) {
+        return false;
+    }
+
+    const int wordIndex = static_cast<int>(objectId >> 6);
+    if (wordIndex >= m_words.size()) {
+        // Grow geometrically so sequential inserts stay amortized O(1).
+        m_words.reserve(std::max(wordIndex + 1, m_words.size() * 2));
+        m_words.resize(wordIndex + 1);
+    }
+
+    const quint64 mask = 0x1ULL << (objectId & 63);
+    quint64& word = m_words[wordIndex];
+    if (word & mask) {
+        return false;
+    }
+
+    word |= mask;
+    ++m_count;
+    return true;
+}
+
+bool LayoutSelectionSet::remove(const quint64 objectId) {
+    const quint64 wordIndex = objectId >> 6;
+    if (wordIndex >= static_cast<quint64>(m_words.size())) {
+        return false;
+    }
+
+    const quint64 mask = 0x1ULL << (objectId & 63);
+    quint64& word = m_words[static_cast<int>(wordIndex)];
+    if (!(word & mask)) {
+        return false;
+    }
+
+    word &= ~mask;
+    --m_count;
+    return true;
+}
+
+bool LayoutSelectionSet::toggle(const quint64 objectId) {
+    if (remove(objectId)) {
+        return false;
+    }
+
+    return insert(objectId);
+}
+
+void LayoutSelectionSet::clear() {
+    m_words.clear();
+    m_count = 0;
+}
+
+bool LayoutSelectionSet::isEmpty() const {
+    return m_count == 0;
+}
+
+qint64 LayoutSelectionSet::count() const {
+    return m_count;
+}
+
+void LayoutSelectionSet::appendObjectIds(QVector<quint64>& outObjectIds) const {
+    outObjectIds.reserve(outObjectIds.size() + static_cast<int>(m_count));
+    forEach([&outObjectIds](const quint64 objectId) {
+        outObjectIds.push_back(objectId);
+        return true;
+    });
+}
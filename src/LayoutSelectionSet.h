@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+// LayoutSelectionSet stores selected object IDs as a bitset.
+//
+// Object IDs are allocated densely from a process-wide counter, so the ID can
+// be used directly as the bit slot. Membership tests are O(1) without hashing,
+// and storage is one bit per allocated object ID (128 KiB per million IDs).
+class LayoutSelectionSet {
+public:
+    bool contains(quint64 objectId) const;
+
+    // Returns true when the object was not selected before.
+    bool insert(quint64 objectId);
+
+    // Returns true when the object was selected before.
+    bool remove(quint64 objectId);
+
+    // Returns true when the object is selected after the call.
+    bool toggle(quint64 objectId);
+
+    void clear();
+    bool isEmpty() const;
+    qint64 count() const;
+
+    // Appends selected IDs in ascending order.
+    void appendObjectIds(QVector<quint64>& outObjectIds) const;
+
+    // Visits selected IDs in ascending order; stop early by returning false.
+    template <typename Visitor>
+    void forEach(Visitor&& visitor) const {
+        for (int wordIndex = 0; wordIndex < m_words.size(); ++wordIndex) {
+            quint64 word = m_words[wordIndex];
+            while (word != 0) {
+                const uint bit = qCountTrailingZeroBits(word);
+                word &= word - 1;
+                if (!visitor((static_cast<quint64>(wordIndex) << 6) | static_cast<quint64>(bit))) {
+                    return;
+                }
+            }
+        }
+    }
+
+private:
+    QVector<quint64> m_words;
+    qint64 m_count{0};
+};
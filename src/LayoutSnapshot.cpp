@@ -0,0 +1,754 @@
+#include "LayoutSnapshot.h"
+
+#include "LayoutFileLoader.h"
+#include "LayoutSceneModel.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr quint32 kFormatVersion = 2;
+// Written in host order; a mismatch on load means the file came from a
+// big-endian host.
+constexpr quint32 kByteOrderMark = 0x01020304;
+
+enum SnapshotSectionId {
+    kSectionCells = 0,
+    kSectionObjects,
+    kSectionRectangles,
+    kSectionPolygons,
+    kSectionPaths,
+    kSectionPoints,
+    kSectionInstances,
+    kSectionNames,
+    kSectionMasters,
+    kSectionCount
+};
+
+// Objects table entries: kind in the top byte, index into the kind's table
+// in the low 56 bits.
+enum SnapshotObjectKind : quint64 {
+    kKindRectangle = 1,
+    kKindPolygon = 2,
+    kKindPath = 3,
+    kKindInstance = 4
+};
+
+constexpr int kKindShift = 56;
+constexpr quint64 kIndexMask = (1ULL << kKindShift) - 1;
+
+struct SnapshotSection {
+    quint64 offset;
+    // Records for table sections, bytes for the names section.
+    quint64 count;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint64 rootCell;
+    SnapshotSection sections[kSectionCount];
+};
+
+struct SnapshotCell {
+    quint64 firstObject;
+    quint64 objectCount;
+    quint64 nameOffset;
+    quint32 nameLength;
+    // 0 for cells without instances, otherwise 1 + the deepest master level.
+    quint32 level;
+    // Distinct cells this one places, in order of first placement.
+    quint64 firstMaster;
+    quint64 masterCount;
+    // Extent of the cell and everything it places; minX > maxX when empty.
+    // Lazy loads answer bounds from here without reading the objects.
+    qint64 minX;
+    qint64 minY;
+    qint64 maxX;
+    qint64 maxY;
+};
+
+struct SnapshotRectangle {
+    quint32 layerNameId;
+    quint32 layerTypeId;
+    qint64 x1;
+    qint64 y1;
+    qint64 x2;
+    qint64 y2;
+};
+
+struct SnapshotPolygon {
+    quint32 layerNameId;
+    quint32 layerTypeId;
+    quint64 firstPoint;
+    quint64 pointCount;
+};
+
+struct SnapshotPath {
+    quint32 layerNameId;
+    quint32 layerTypeId;
+    qint64 width;
+    qint64 beginExtension;
+    qint64 endExtension;
+    quint64 firstPoint;
+    quint64 pointCount;
+};
+
+struct SnapshotPoint {
+    qint64 x;
+    qint64 y;
+};
+
+struct SnapshotInstance {
+    quint64 masterCell;
+    qint64 originX;
+    qint64 originY;
+    double magnification;
+    double angleDegrees;
+    quint32 mirrorX;
+    qint32 columns;
+    qint32 rows;
+    quint32 reserved;
+    qint64 columnStepX;
+    qint64 columnStepY;
+    qint64 rowStepX;
+    qint64 rowStepY;
+};
+
+// The layout is fixed; these guard against accidental padding changes.
+static_assert(sizeof(SnapshotHeader) == 24 + 16 * kSectionCount, "snapshot header layout");
+static_assert(sizeof(SnapshotCell) == 80, "snapshot cell layout");
+static_assert(sizeof(SnapshotRectangle) == 40, "snapshot rectangle layout");
+static_assert(sizeof(SnapshotPolygon) == 24, "snapshot polygon layout");
+static_assert(sizeof(SnapshotPath) == 48, "snapshot path layout");
+static_assert(sizeof(SnapshotPoint) == 16, "snapshot point layout");
+static_assert(sizeof(SnapshotInstance) == 88, "snapshot instance layout");
+static_assert(sizeof(WorldPoint) == sizeof(SnapshotPoint), "points are copied as a block");
+
+quint64 alignTo8(const quint64 value) {
+    return (value + 7) & ~quint64(7);
+}
+
+// Flattens a cell hierarchy into the snapshot tables. Cells are numbered in
+// post-order so every master precedes the cells that place it.
+class SnapshotWriter {
+public:
+    bool addCell(const LayoutSceneNode& node, quint64& outIndex, QString& error);
+    bool writeTo(QSaveFile& file, quint64 rootCell, QString& error) const;
+
+    quint64 objectCount() const { return static_cast<quint64>(m_objects.size()); }
+
+private:
+    // Pads the file from position up to offset, then writes size bytes.
+    static bool writeSection(QSaveFile& file, quint64& position, quint64 offset, const char* data, quint64 size);
+    template <typename Record>
+    static bool writeRecords(QSaveFile& file,
+                             quint64& position,
+                             const SnapshotSection& section,
+                             const std::vector<Record>& records);
+
+    QHash<const LayoutSceneNode*, quint64> m_cellIndexByNode;
+    std::vector<SnapshotCell> m_cells;
+    std::vector<quint64> m_objects;
+    std::vector<SnapshotRectangle> m_rectangles;
+    std::vector<SnapshotPolygon> m_polygons;
+    std::vector<SnapshotPath> m_paths;
+    std::vector<SnapshotPoint> m_points;
+    std::vector<SnapshotInstance> m_instances;
+    QByteArray m_names;
+    std::vector<quint64> m_masters;
+};
+
+bool SnapshotWriter::addCell(const LayoutSceneNode& node, quint64& outIndex, QString& error) {
+    const auto existing = m_cellIndexByNode.constFind(&node);
+    if (existing != m_cellIndexByNode.cend()) {
+        outIndex = existing.value();
+        return true;
+    }
+
+    // Masters first, so this cell's objects stay contiguous in the table.
+    quint32 level = 0;
+    QHash<const LayoutSceneNode*, quint64> masterIndexByNode;
+    std::vector<quint64> masters;
+    for (const std::shared_ptr<LayoutObjectModel>& object : node.objects()) {
+        const auto* instance = dynamic_cast<const InstanceObjectModel*>(object.get());
+        if (!instance || masterIndexByNode.contains(instance->master())) {
+            continue;
+        }
+
+        quint64 masterIndex = 0;
+        if (!addCell(*instance->master(), masterIndex, error)) {
+            return false;
+        }
+        masterIndexByNode.insert(instance->master(), masterIndex);
+        masters.push_back(masterIndex);
+        level = std::max(level, m_cells[masterIndex].level + 1);
+    }
+
+    SnapshotCell cell{};
+    cell.firstObject = m_objects.size();
+    cell.objectCount = static_cast<quint64>(node.objectCount());
+    const QByteArray name = node.name().toUtf8();
+    cell.nameOffset = static_cast<quint64>(m_names.size());
+    cell.nameLength = static_cast<quint32>(name.size());
+    cell.level = level;
+    m_names.append(name);
+    cell.firstMaster = m_masters.size();
+    cell.masterCount = masters.size();
+    m_masters.insert(m_masters.end(), masters.begin(), masters.end());
+    LayoutObjectModel::Bounds bounds;
+    if (node.tryGetBounds(bounds)) {
+        cell.minX = bounds.minX;
+        cell.minY = bounds.minY;
+        cell.maxX = bounds.maxX;
+        cell.maxY = bounds.maxY;
+    } else {
+        cell.minX = 1;
+        cell.maxX = 0;
+    }
+
+    for (const std::shared_ptr<LayoutObjectModel>& object : node.objects()) {
+        const LayoutObjectModel* model = object.get();
+        if (const DrawnRectangle* rectangle = model->asRectangle()) {
+            m_objects.push_back((quint64(kKindRectangle) << kKindShift) | m_rectangles.size());
+            m_rectangles.push_back(SnapshotRectangle{rectangle->layerNameId,
+                                                     rectangle->layerTypeId,
+                                                     rectangle->x1,
+                                                     rectangle->y1,
+                                                     rectangle->x2,
+                                                     rectangle->y2});
+        } else if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(model)) {
+            SnapshotPolygon record{};
+            polygon->tryGetLayer(record.layerNameId, record.layerTypeId);
+            record.firstPoint = m_points.size();
+            record.pointCount = static_cast<quint64>(polygon->vertices().size());
+            for (const WorldPoint& vertex : polygon->vertices()) {
+                m_points.push_back(SnapshotPoint{vertex.x, vertex.y});
+            }
+            m_objects.push_back((quint64(kKindPolygon) << kKindShift) | m_polygons.size());
+            m_polygons.push_back(record);
+        } else if (const auto* path = dynamic_cast<const PathObjectModel*>(model)) {
+            SnapshotPath record{};
+            path->tryGetLayer(record.layerNameId, record.layerTypeId);
+            record.width = path->width();
+            record.beginExtension = path->beginExtension();
+            record.endExtension = path->endExtension();
+            record.firstPoint = m_points.size();
+            record.pointCount = static_cast<quint64>(path->points().size());
+            for (const WorldPoint& point : path->points()) {
+                m_points.push_back(SnapshotPoint{point.x, point.y});
+            }
+            m_objects.push_back((quint64(kKindPath) << kKindShift) | m_paths.size());
+            m_paths.push_back(record);
+        } else if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(model)) {
+            const LayoutTransform& transform = instance->transform();
+            SnapshotInstance record{};
+            record.masterCell = masterIndexByNode.value(instance->master());
+            record.originX = transform.originX;
+            record.originY = transform.originY;
+            record.magnification = transform.magnification;
+            record.angleDegrees = transform.angleDegrees;
+            record.mirrorX = transform.mirrorX ? 1 : 0;
+            record.columns = instance->columns();
+            record.rows = instance->rows();
+            record.columnStepX = instance->columnStep().x;
+            record.columnStepY = instance->columnStep().y;
+            record.rowStepX = instance->rowStep().x;
+            record.rowStepY = instance->rowStep().y;
+            m_objects.push_back((quint64(kKindInstance) << kKindShift) | m_instances.size());
+            m_instances.push_back(record);
+        } else {
+            error = QString("cell '%1' holds an object kind the snapshot format cannot store").arg(node.name());
+            return false;
+        }
+    }
+
+    outIndex = m_cells.size();
+    m_cells.push_back(cell);
+    m_cellIndexByNode.insert(&node, outIndex);
+    return true;
+}
+
+bool SnapshotWriter::writeSection(QSaveFile& file,
+                                  quint64& position,
+                                  const quint64 offset,
+                                  const char* data,
+                                  const quint64 size) {
+    static const char kPadding[8] = {};
+    const qint64 padding = static_cast<qint64>(offset - position);
+    if (file.write(kPadding, padding) != padding
+        || (size > 0 && file.write(data, static_cast<qint64>(size)) != static_cast<qint64>(size))) {
+        return false;
+    }
+    position = offset + size;
+    return true;
+}
+
+template <typename Record>
+bool SnapshotWriter::writeRecords(QSaveFile& file,
+                                  quint64& position,
+                                  const SnapshotSection& section,
+                                  const std::vector<Record>& records) {
+    static_assert(std::is_trivially_copyable<Record>::value, "snapshot records are written as bytes");
+    return writeSection(file,
+                        position,
+                        section.offset,
+                        reinterpret_cast<const char*>(records.data()),
+                        records.size() * sizeof(Record));
+}
+
+bool SnapshotWriter::writeTo(QSaveFile& file, const quint64 rootCell, QString& error) const {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, LayoutSnapshot::kMagic, LayoutSnapshot::kMagicLength);
+    header.version = kFormatVersion;
+    header.byteOrderMark = kByteOrderMark;
+    header.rootCell = rootCell;
+
+    // Lay the sections out first so the header can go out ahead of them;
+    // the tables are then streamed to the file without another copy.
+    quint64 end = sizeof(SnapshotHeader);
+    const auto placeSection = [&](const SnapshotSectionId section, const quint64 count, const quint64 recordSize) {
+        header.sections[section].offset = alignTo8(end);
+        header.sections[section].count = count;
+        end = header.sections[section].offset + count * recordSize;
+    };
+    placeSection(kSectionCells, m_cells.size(), sizeof(SnapshotCell));
+    placeSection(kSectionObjects, m_objects.size(), sizeof(quint64));
+    placeSection(kSectionRectangles, m_rectangles.size(), sizeof(SnapshotRectangle));
+    placeSection(kSectionPolygons, m_polygons.size(), sizeof(SnapshotPolygon));
+    placeSection(kSectionPaths, m_paths.size(), sizeof(SnapshotPath));
+    placeSection(kSectionPoints, m_points.size(), sizeof(SnapshotPoint));
+    placeSection(kSectionInstances, m_instances.size(), sizeof(SnapshotInstance));
+    placeSection(kSectionNames, static_cast<quint64>(m_names.size()), 1);
+    placeSection(kSectionMasters, m_masters.size(), sizeof(quint64));
+
+    quint64 position = 0;
+    const SnapshotSection* sections = header.sections;
+    const bool written =
+        writeSection(file, position, 0, reinterpret_cast<const char*>(&header), sizeof(header))
+        && writeRecords(file, position, sections[kSectionCells], m_cells)
+        && writeRecords(file, position, sections[kSectionObjects], m_objects)
+        && writeRecords(file, position, sections[kSectionRectangles], m_rectangles)
+        && writeRecords(file, position, sections[kSectionPolygons], m_polygons)
+        && writeRecords(file, position, sections[kSectionPaths], m_paths)
+        && writeRecords(file, position, sections[kSectionPoints], m_points)
+        && writeRecords(file, position, sections[kSectionInstances], m_instances)
+        && writeSection(file, position, sections[kSectionNames].offset, m_names.constData(),
+                        static_cast<quint64>(m_names.size()))
+        && writeRecords(file, position, sections[kSectionMasters], m_masters);
+    if (!written) {
+        error = QString("cannot write %1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+    return true;
+}
+
+// Read-only view of a mapped snapshot with bounds-checked section access.
+class SnapshotView {
+public:
+    SnapshotView(const uchar* data, const qint64 size)
+        : m_data(data), m_size(static_cast<quint64>(size)) {}
+
+    bool validate(QString& error);
+
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(m_data); }
+
+    template <typename Record>
+    const Record* table(const SnapshotSectionId section) const {
+        return reinterpret_cast<const Record*>(m_data + header().sections[section].offset);
+    }
+
+    quint64 count(const SnapshotSectionId section) const { return header().sections[section].count; }
+
+private:
+    bool validateSection(SnapshotSectionId section, quint64 recordSize) const;
+
+    const uchar* m_data{nullptr};
+    quint64 m_size{0};
+};
+
+bool SnapshotView::validateSection(const SnapshotSectionId section, const quint64 recordSize) const {
+    const SnapshotSection& entry = header().sections[section];
+    if (entry.offset % 8 != 0 || entry.offset < sizeof(SnapshotHeader) || entry.offset > m_size) {
+        return false;
+    }
+    return entry.count <= (m_size - entry.offset) / recordSize;
+}
+
+bool SnapshotView::validate(QString& error) {
+    if (m_size < sizeof(SnapshotHeader)
+        || std::memcmp(m_data, LayoutSnapshot::kMagic, LayoutSnapshot::kMagicLength) != 0) {
+        error = "not a layout snapshot";
+        return false;
+    }
+    if (header().byteOrderMark != kByteOrderMark) {
+        error = "snapshot was written with a different byte order";
+        return false;
+    }
+    if (header().version != kFormatVersion) {
+        error = QString("unsupported snapshot version %1").arg(header().version);
+        return false;
+    }
+
+    const bool sectionsValid = validateSection(kSectionCells, sizeof(SnapshotCell))
+                               && validateSection(kSectionObjects, sizeof(quint64))
+                               && validateSection(kSectionRectangles, sizeof(SnapshotRectangle))
+                               && validateSection(kSectionPolygons, sizeof(SnapshotPolygon))
+                               && validateSection(kSectionPaths, sizeof(SnapshotPath))
+                               && validateSection(kSectionPoints, sizeof(SnapshotPoint))
+                               && validateSection(kSectionInstances, sizeof(SnapshotInstance))
+                               && validateSection(kSectionNames, 1)
+                               && validateSection(kSectionMasters, sizeof(quint64));
+    if (!sectionsValid) {
+        error = "snapshot section table is out of range";
+        return false;
+    }
+    if (header().rootCell >= count(kSectionCells)) {
+        error = "snapshot root cell is out of range";
+        return false;
+    }
+    return true;
+}
+
+bool pointRangeValid(const SnapshotView& view, const quint64 firstPoint, const quint64 pointCount) {
+    const quint64 total = view.count(kSectionPoints);
+    return firstPoint <= total && pointCount <= total - firstPoint;
+}
+
+QVector<WorldPoint> copyPoints(const SnapshotView& view, const quint64 firstPoint, const quint64 pointCount) {
+    QVector<WorldPoint> points(static_cast<int>(pointCount));
+    std::memcpy(points.data(), view.table<SnapshotPoint>(kSectionPoints) + firstPoint, pointCount * sizeof(WorldPoint));
+    return points;
+}
+
+// Checks the table ranges of one cell record. Masters must precede the cell
+// and sit on a lower level.
+bool cellValid(const SnapshotView& view, const quint64 cellIndex, QString& error) {
+    const SnapshotCell* cells = view.table<SnapshotCell>(kSectionCells);
+    const SnapshotCell& cell = cells[cellIndex];
+    const quint64 objectTotal = view.count(kSectionObjects);
+    const quint64 nameTotal = view.count(kSectionNames);
+    const quint64 masterTotal = view.count(kSectionMasters);
+    if (cell.firstObject > objectTotal || cell.objectCount > objectTotal - cell.firstObject
+        || cell.nameOffset > nameTotal || cell.nameLength > nameTotal - cell.nameOffset
+        || cell.firstMaster > masterTotal || cell.masterCount > masterTotal - cell.firstMaster) {
+        error = QString("snapshot cell %1 is out of range").arg(cellIndex);
+        return false;
+    }
+
+    const quint64* masters = view.table<quint64>(kSectionMasters) + cell.firstMaster;
+    for (quint64 i = 0; i < cell.masterCount; ++i) {
+        if (masters[i] >= cellIndex || cells[masters[i]].level >= cell.level) {
+            error = QString("snapshot cell %1 places cell %2 out of order").arg(cellIndex).arg(masters[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<LayoutSceneNode> createNode(const SnapshotView& view, const quint64 cellIndex) {
+    const SnapshotCell& cell = view.table<SnapshotCell>(kSectionCells)[cellIndex];
+    auto node = std::make_shared<LayoutSceneNode>();
+    node->setName(QString::fromUtf8(view.table<char>(kSectionNames) + cell.nameOffset,
+                                    static_cast<int>(cell.nameLength)));
+    return node;
+}
+
+// Builds the leaf objects of a validated cell. Instances are left as null
+// placeholders in paint order; their masters may still be under
+// construction on other workers.
+bool buildObjects(const SnapshotView& view,
+                  const quint64 cellIndex,
+                  QVector<std::shared_ptr<LayoutObjectModel>>& outObjects,
+                  QString& error) {
+    const SnapshotCell* cells = view.table<SnapshotCell>(kSectionCells);
+    const SnapshotCell& cell = cells[cellIndex];
+    const quint64* objects = view.table<quint64>(kSectionObjects) + cell.firstObject;
+    outObjects.clear();
+    outObjects.reserve(static_cast<int>(cell.objectCount));
+    for (quint64 i = 0; i < cell.objectCount; ++i) {
+        const quint64 kind = objects[i] >> kKindShift;
+        const quint64 index = objects[i] & kIndexMask;
+        if (kind == kKindRectangle && index < view.count(kSectionRectangles)) {
+            const SnapshotRectangle& record = view.table<SnapshotRectangle>(kSectionRectangles)[index];
+            outObjects.push_back(std::make_shared<RectangleObjectModel>(DrawnRectangle{
+                record.layerNameId, record.layerTypeId, record.x1, record.y1, record.x2, record.y2}));
+        } else if (kind == kKindPolygon && index < view.count(kSectionPolygons)) {
+            const SnapshotPolygon& record = view.table<SnapshotPolygon>(kSectionPolygons)[index];
+            if (!pointRangeValid(view, record.firstPoint, record.pointCount)) {
+                error = QString("snapshot polygon %1 is out of range").arg(index);
+                return false;
+            }
+            outObjects.push_back(std::make_shared<PolygonObjectModel>(
+                record.layerNameId, record.layerTypeId, copyPoints(view, record.firstPoint, record.pointCount)));
+        } else if (kind == kKindPath && index < view.count(kSectionPaths)) {
+            const SnapshotPath& record = view.table<SnapshotPath>(kSectionPaths)[index];
+            if (!pointRangeValid(view, record.firstPoint, record.pointCount)) {
+                error = QString("snapshot path %1 is out of range").arg(index);
+                return false;
+            }
+            outObjects.push_back(std::make_shared<PathObjectModel>(record.layerNameId,
+                                                                   record.layerTypeId,
+                                                                   copyPoints(view, record.firstPoint, record.pointCount),
+                                                                   record.width,
+                                                                   record.beginExtension,
+                                                                   record.endExtension));
+        } else if (kind == kKindInstance && index < view.count(kSectionInstances)) {
+            const SnapshotInstance& record = view.table<SnapshotInstance>(kSectionInstances)[index];
+            if (record.masterCell >= cellIndex || cells[record.masterCell].level >= cell.level) {
+                error = QString("snapshot cell %1 places cell %2 out of order").arg(cellIndex).arg(record.masterCell);
+                return false;
+            }
+            outObjects.push_back(nullptr);
+        } else {
+            error = QString("snapshot object %1 of cell %2 is invalid").arg(i).arg(cellIndex);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fills the instance placeholders of a built cell. masterFor maps a master
+// cell index to its node, which is complete or lazy, or returns null for a
+// cell the record may not place.
+bool linkCell(const SnapshotView& view,
+              const quint64 cellIndex,
+              const std::function<std::shared_ptr<const LayoutSceneNode>(quint64)>& masterFor,
+              QVector<std::shared_ptr<LayoutObjectModel>>& objects,
+              QString& error) {
+    const SnapshotCell& cell = view.table<SnapshotCell>(kSectionCells)[cellIndex];
+    const quint64* entries = view.table<quint64>(kSectionObjects) + cell.firstObject;
+    for (int i = 0; i < objects.size(); ++i) {
+        if (objects[i]) {
+            continue;
+        }
+
+        const SnapshotInstance& record = view.table<SnapshotInstance>(kSectionInstances)[entries[i] & kIndexMask];
+        std::shared_ptr<const LayoutSceneNode> master = masterFor(record.masterCell);
+        if (!master) {
+            error = QString("snapshot cell %1 places cell %2 outside its master list").arg(cellIndex).arg(record.masterCell);
+            return false;
+        }
+
+        LayoutTransform transform;
+        transform.originX = record.originX;
+        transform.originY = record.originY;
+        transform.magnification = record.magnification;
+        transform.angleDegrees = record.angleDegrees;
+        transform.mirrorX = record.mirrorX != 0;
+        objects[i] = std::make_shared<InstanceObjectModel>(std::move(master),
+                                                           transform,
+                                                           record.columns,
+                                                           record.rows,
+                                                           WorldPoint{record.columnStepX, record.columnStepY},
+                                                           WorldPoint{record.rowStepX, record.rowStepY});
+    }
+    return true;
+}
+
+// Builds cells of a lazily opened snapshot from the mapped tables on
+// demand. Owns the read-only mapping, so evicted cells are rebuilt from
+// pages the OS shares with every process that maps the same file.
+class SnapshotLazyCellSource final : public LayoutLazyCellSource {
+public:
+    SnapshotLazyCellSource(std::unique_ptr<QFile> file, const SnapshotView& view)
+        : m_file(std::move(file)), m_view(view) {}
+
+    bool loadCell(const int cellIndex,
+                  const QVector<std::shared_ptr<const LayoutSceneNode>>& masters,
+                  QVector<std::shared_ptr<LayoutObjectModel>>& outObjects,
+                  QString& error) override {
+        const quint64 index = static_cast<quint64>(cellIndex);
+        if (!buildObjects(m_view, index, outObjects, error)) {
+            return false;
+        }
+
+        // masters follow the cell's master list (see loadFile).
+        const SnapshotCell& cell = m_view.table<SnapshotCell>(kSectionCells)[index];
+        const quint64* masterCells = m_view.table<quint64>(kSectionMasters) + cell.firstMaster;
+        QHash<quint64, std::shared_ptr<const LayoutSceneNode>> masterByCell;
+        masterByCell.reserve(masters.size());
+        for (int i = 0; i < masters.size() && static_cast<quint64>(i) < cell.masterCount; ++i) {
+            masterByCell.insert(masterCells[i], masters[i]);
+        }
+        return linkCell(m_view,
+                        index,
+                        [&masterByCell](const quint64 masterCell) { return masterByCell.value(masterCell); },
+                        outObjects,
+                        error);
+    }
+
+private:
+    std::unique_ptr<QFile> m_file;
+    SnapshotView m_view;
+};
+
+}
+
+namespace LayoutSnapshot {
+
+bool saveFile(const LayoutSceneNode& root, const QString& filePath, qint64& outObjectCount, QString& error) {
+    // Keeps the lazy cells walked by addCell() loaded until the tables are
+    // written, whatever other threads query meanwhile.
+    LayoutSceneNode::QueryScope scope;
+    SnapshotWriter writer;
+    quint64 rootCell = 0;
+    if (!writer.addCell(root, rootCell, error)) {
+        return false;
+    }
+
+    // QSaveFile only replaces the target once everything is written.
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+    if (!writer.writeTo(file, rootCell, error)) {
+        file.cancelWriting();
+        return false;
+    }
+    if (!file.commit()) {
+        error = QString("cannot write %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    outObjectCount = static_cast<qint64>(writer.objectCount());
+    return true;
+}
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, const bool lazyCells) {
+    outResult = LayoutLoadResult();
+    outResult.formatName = "L2SNAP";
+
+    // Heap-allocated so a lazy load can hand the mapping to its cell source.
+    auto file = std::make_unique<QFile>(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file->errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file->size();
+    const uchar* mapped = fileSize > 0 ? file->map(0, fileSize) : nullptr;
+    if (!mapped) {
+        error = QString("cannot map %1: %2").arg(filePath, file->errorString());
+        return false;
+    }
+
+    SnapshotView view(mapped, fileSize);
+    if (!view.validate(error)) {
+        error = QString("%1: %2").arg(filePath, error);
+        return false;
+    }
+
+    const quint64 cellCount = view.count(kSectionCells);
+    const SnapshotCell* cells = view.table<SnapshotCell>(kSectionCells);
+    std::vector<std::shared_ptr<LayoutSceneNode>> nodes(cellCount);
+    for (quint64 i = 0; i < cellCount; ++i) {
+        if (!cellValid(view, i, error)) {
+            error = QString("%1: %2").arg(filePath, error);
+            return false;
+        }
+        nodes[i] = createNode(view, i);
+    }
+    const auto masterFor = [&nodes](const quint64 masterCell) {
+        return std::shared_ptr<const LayoutSceneNode>(nodes[masterCell]);
+    };
+
+    const quint64 rootCell = view.header().rootCell;
+    outResult.topCells.push_back(nodes[rootCell]);
+    outResult.cellCount = static_cast<int>(cellCount);
+    outResult.objectCount = static_cast<qint64>(view.count(kSectionObjects));
+
+    if (lazyCells) {
+        // Cells turn into lazy nodes straight from the directory: bounds,
+        // object count and masters are stored per cell, so nothing is
+        // decoded here. The root, whose objects the document adopts, and
+        // cells without extent are built now, in table order so their
+        // masters already answer bounds.
+        auto source = std::make_shared<SnapshotLazyCellSource>(std::move(file), view);
+        for (quint64 i = 0; i < cellCount; ++i) {
+            const SnapshotCell& cell = cells[i];
+            if (i != rootCell && cell.minX <= cell.maxX) {
+                const quint64* masterCells = view.table<quint64>(kSectionMasters) + cell.firstMaster;
+                QVector<std::shared_ptr<const LayoutSceneNode>> masters;
+                masters.reserve(static_cast<int>(cell.masterCount));
+                for (quint64 m = 0; m < cell.masterCount; ++m) {
+                    masters.push_back(nodes[masterCells[m]]);
+                }
+
+                LayoutObjectModel::Bounds bounds;
+                bounds.minX = cell.minX;
+                bounds.minY = cell.minY;
+                bounds.maxX = cell.maxX;
+                bounds.maxY = cell.maxY;
+                nodes[i]->setLazyContent(source, static_cast<int>(i), bounds, static_cast<int>(cell.objectCount),
+                                         std::move(masters));
+                continue;
+            }
+
+            QVector<std::shared_ptr<LayoutObjectModel>> objects;
+            if (!buildObjects(view, i, objects, error) || !linkCell(view, i, masterFor, objects, error)) {
+                error = QString("%1: %2").arg(filePath, error);
+                return false;
+            }
+            nodes[i]->addObjects(std::move(objects));
+        }
+        outResult.lazyCells = true;
+        return true;
+    }
+
+    std::vector<QVector<std::shared_ptr<LayoutObjectModel>>> cellObjects(cellCount);
+    std::vector<QString> cellErrors(cellCount);
+
+    // Pass 1: leaf objects of every cell, independent of each other.
+    LayoutFileLoader::runParallel(static_cast<int>(cellCount), [&](const int i) {
+        return buildObjects(view, static_cast<quint64>(i), cellObjects[i], cellErrors[i]);
+    });
+    for (const QString& cellError : cellErrors) {
+        if (!cellError.isEmpty()) {
+            error = QString("%1: %2").arg(filePath, cellError);
+            return false;
+        }
+    }
+
+    // Pass 2: instances, one hierarchy level at a time. Bounds are computed
+    // while the level is built so later levels only read their masters.
+    std::map<quint32, std::vector<int>> cellsByLevel;
+    for (quint64 i = 0; i < cellCount; ++i) {
+        cellsByLevel[cells[i].level].push_back(static_cast<int>(i));
+    }
+    for (const auto& level : cellsByLevel) {
+        const std::vector<int>& levelCells = level.second;
+        LayoutFileLoader::runParallel(static_cast<int>(levelCells.size()), [&](const int i) {
+            const int cellIndex = levelCells[i];
+            if (!linkCell(view, static_cast<quint64>(cellIndex), masterFor, cellObjects[cellIndex],
+                          cellErrors[cellIndex])) {
+                return false;
+            }
+            nodes[cellIndex]->addObjects(std::move(cellObjects[cellIndex]));
+            LayoutObjectModel::Bounds bounds;
+            nodes[cellIndex]->tryGetBounds(bounds);
+            return true;
+        });
+    }
+    for (const QString& cellError : cellErrors) {
+        if (!cellError.isEmpty()) {
+            error = QString("%1: %2").arg(filePath, cellError);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+
+class LayoutSceneNode;
+struct LayoutLoadResult;
+
+// LayoutSnapshot reads and writes `.l2snap`, the editor's native layout
+// image.
+//
+// A snapshot is a header followed by flat, 8-byte aligned little-endian
+// tables that mirror the scene model one to one:
+//  - cells:      object range, name, hierarchy level (masters come first),
+//                the distinct cells it places and its bounds
+//  - objects:    per-cell paint order; kind in the top byte, table index below
+//  - rectangles, polygons, paths: fixed-size records
+//  - points:     shared vertex pool for polygons and paths
+//  - instances:  master cell index, transform and array parameters
+//  - names:      cell name bytes
+//  - masters:    per-cell master lists the cells point into
+//
+// Loading maps the file read-only and builds objects straight from the
+// tables without record parsing; cells of one hierarchy level are built in
+// parallel on the LayoutFileLoader worker pool.
+//
+// With lazyCells only the root cell is built. Every other cell becomes a
+// lazy node whose bounds, object count and masters come from its cell
+// record, so opening costs time per cell rather than per object. The file
+// stays mapped while any of these nodes is alive, and a cell's objects are
+// built from the mapped tables when a query first reaches it. Loaded cells
+// still own their geometry, and their tile index is rebuilt as the objects
+// are inserted: the index is not stored in the file.
+namespace LayoutSnapshot {
+
+constexpr char kMagic[] = "L2SNAP\r\n";
+constexpr int kMagicLength = sizeof(kMagic) - 1;
+
+// Writes root and every cell reachable through its instances.
+bool saveFile(const LayoutSceneNode& root, const QString& filePath, qint64& outObjectCount, QString& error);
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error, bool lazyCells = false);
+
+}
@@ -0,0 +1,126 @@
+#include "LayoutUndoStack.h"
+
+#include "LayoutSceneModel.h"
+
+namespace {
+
+constexpr qint64 kDefaultMemoryLimitMb = 256;
+constexpr qint64 kBytesPerMegabyte = 1024 * 1024;
+
+qint64 estimateBytes(const QVector<std::shared_ptr<LayoutObjectModel>>& objects) {
+    qint64 bytes = 0;
+    for (const std::shared_ptr<LayoutObjectModel>& object : objects) {
+        bytes += estimateObjectBytes(*object);
+    }
+    return bytes;
+}
+
+}
+
+LayoutUndoStack::LayoutUndoStack() {
+    const int megabytes = qEnvironmentVariableIntValue("LAYOUT2_UNDO_MB");
+    m_memoryLimit = (megabytes > 0 ? megabytes : kDefaultMemoryLimitMb) * kBytesPerMegabyte;
+}
+
+void LayoutUndoStack::record(QVector<std::shared_ptr<LayoutObjectModel>> added,
+                             QVector<std::shared_ptr<LayoutObjectModel>> removed) {
+    if (added.isEmpty() && removed.isEmpty()) {
+        return;
+    }
+
+    for (const Delta& delta : m_redo) {
+        m_memoryUsage -= delta.bytes;
+    }
+    m_redo.clear();
+
+    Delta delta;
+    delta.bytes = estimateBytes(added) + estimateBytes(removed);
+    delta.change.added = std::move(added);
+    delta.change.removed = std::move(removed);
+    m_memoryUsage += delta.bytes;
+    m_undo.push_back(std::move(delta));
+    trim();
+}
+
+bool LayoutUndoStack::undo(LayoutSceneNode& node, Change& outChange) {
+    if (m_undo.empty()) {
+        return false;
+    }
+
+    Delta delta = std::move(m_undo.back());
+    m_undo.pop_back();
+    apply(node, delta.change.added, delta.change.removed);
+    outChange.added = delta.change.removed;
+    outChange.removed = delta.change.added;
+    m_redo.push_back(std::move(delta));
+    return true;
+}
+
+bool LayoutUndoStack::redo(LayoutSceneNode& node, Change& outChange) {
+    if (m_redo.empty()) {
+        return false;
+    }
+
+    Delta delta = std::move(m_redo.back());
+    m_redo.pop_back();
+    apply(node, delta.change.removed, delta.change.added);
+    outChange = delta.change;
+    m_undo.push_back(std::move(delta));
+    return true;
+}
+
+void LayoutUndoStack::clear() {
+    m_undo.clear();
+    m_redo.clear();
+    m_memoryUsage = 0;
+}
+
+int LayoutUndoStack::undoCount() const {
+    return static_cast<int>(m_undo.size());
+}
+
+int LayoutUndoStack::redoCount() const {
+    return static_cast<int>(m_redo.size());
+}
+
+void LayoutUndoStack::setMemoryLimit(const qint64 bytes) {
+    m_memoryLimit = bytes;
+    trim();
+}
+
+qint64 LayoutUndoStack::memoryLimit() const {
+    return m_memoryLimit;
+}
+
+qint64 LayoutUndoStack::memoryUsage() const {
+    return m_memoryUsage;
+}
+
+void LayoutUndoStack::apply(LayoutSceneNode& node,
+                            const QVector<std::shared_ptr<LayoutObjectModel>>& toRemove,
+                            const QVector<std::shared_ptr<LayoutObjectModel>>& toAdd) {
+    if (!toRemove.isEmpty()) {
+        QVector<quint64> objectIds;
+        objectIds.reserve(toRemove.size());
+        for (const std::shared_ptr<LayoutObjectModel>& object : toRemove) {
+            objectIds.push_back(object->objectId());
+        }
+        node.removeObjectsByIds(objectIds);
+    }
+    if (!toAdd.isEmpty()) {
+        node.addObjects(toAdd);
+    }
+}
+
+void LayoutUndoStack::trim() {
+    // Undo history goes first; redo deltas only remain over budget after
+    // the limit was lowered.
+    while (m_memoryUsage > m_memoryLimit && !m_undo.empty()) {
+        m_memoryUsage -= m_undo.front().bytes;
+        m_undo.pop_front();
+    }
+    while (m_memoryUsage > m_memoryLimit && !m_redo.empty()) {
+        m_memoryUsage -= m_redo.front().bytes;
+        m_redo.pop_front();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QVector>
+#include <deque>
+#include <memory>
+
+class LayoutObjectModel;
+class LayoutSceneNode;
+
+// LayoutUndoStack keeps the edit history of one scene node as deltas: the
+// objects each operation added and the objects it removed. Scene objects are
+// immutable and shared, so a delta references them instead of copying, and
+// undoing or redoing any operation is one bulk removal plus one bulk insert
+// into the node's index. Restored objects keep their IDs but are painted
+// after the objects that stayed.
+//
+// History is bounded by a memory budget, counted with estimateObjectBytes()
+// for every object a delta references; the oldest deltas are dropped first.
+class LayoutUndoStack {
+public:
+    // Objects a node gained and lost while a delta was applied.
+    struct Change {
+        QVector<std::shared_ptr<LayoutObjectModel>> added;
+        QVector<std::shared_ptr<LayoutObjectModel>> removed;
+    };
+
+    LayoutUndoStack();
+
+    // Records an operation that has already been applied; clears the redo
+    // history. Empty operations are ignored.
+    void record(QVector<std::shared_ptr<LayoutObjectModel>> added,
+                QVector<std::shared_ptr<LayoutObjectModel>> removed);
+    // Revert or reapply the latest operation on node. Return false when
+    // there is nothing to undo or redo; outChange receives what node gained
+    // and lost.
+    bool undo(LayoutSceneNode& node, Change& outChange);
+    bool redo(LayoutSceneNode& node, Change& outChange);
+    void clear();
+
+    int undoCount() const;
+    int redoCount() const;
+
+    // Budget in estimated bytes. Defaults to LAYOUT2_UNDO_MB megabytes (256
+    // when unset).
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit() const;
+    qint64 memoryUsage() const;
+
+private:
+    struct Delta {
+        Change change;
+        qint64 bytes{0};
+    };
+
+    // Removes toRemove and inserts toAdd, each as one batch.
+    static void apply(LayoutSceneNode& node,
+                      const QVector<std::shared_ptr<LayoutObjectModel>>& toRemove,
+                      const QVector<std::shared_ptr<LayoutObjectModel>>& toAdd);
+    void trim();
+
+    // The latest operation is at the back of m_undo, the next one to redo at
+    // the back of m_redo; trimming drops from the fronts.
+    std::deque<Delta> m_undo;
+    std::deque<Delta> m_redo;
+    qint64 m_memoryUsage{0};
+    qint64 m_memoryLimit{0};
+};
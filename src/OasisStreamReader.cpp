@@ -0,0 +1,1516 @@
+#include "OasisStreamReader.h"
+
+#include "LayoutFileLoader.h"
+#include "LayoutSceneModel.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+namespace {
+
+enum OasisRecordType : quint64 {
+    kRecordPad = 0,
+    kRecordStart = 1,
+    kRecordEnd = 2,
+    kRecordCellName = 3,
+    kRecordCellNameRef = 4,
+    kRecordTextString = 5,
+    kRecordTextStringRef = 6,
+    kRecordPropName = 7,
+    kRecordPropNameRef = 8,
+    kRecordPropString = 9,
+    kRecordPropStringRef = 10,
+    kRecordLayerName = 11,
+    kRecordLayerNameText = 12,
+    kRecordCellByRef = 13,
+    kRecordCellByName = 14,
+    kRecordXyAbsolute = 15,
+    kRecordXyRelative = 16,
+    kRecordPlacement = 17,
+    kRecordPlacementTransform = 18,
+    kRecordText = 19,
+    kRecordRectangle = 20,
+    kRecordPolygon = 21,
+    kRecordPath = 22,
+    kRecordTrapezoid = 23,
+    kRecordTrapezoidA = 24,
+    kRecordTrapezoidB = 25,
+    kRecordCTrapezoid = 26,
+    kRecordCircle = 27,
+    kRecordProperty = 28,
+    kRecordPropertyRepeat = 29,
+    kRecordXName = 30,
+    kRecordXNameRef = 31,
+    kRecordXElement = 32,
+    kRecordXGeometry = 33,
+    kRecordCBlock = 34
+};
+
+constexpr quint64 kCBlockDeflate = 0;
+
+// Grid repetitions of a shape with fewer elements are expanded into
+// separate shapes; an instance and its master cost more than a few
+// rectangles and hide them from shape-level selection.
+constexpr qint64 kMinRepetitionInstanceElements = 16;
+
+// Sticky-failure reader for OASIS primitives: any read past the end or
+// malformed value clears ok() and returns zero, so record handlers can read
+// all fields first and check once.
+class OasisByteReader {
+public:
+    OasisByteReader(const uchar* begin, const uchar* end, const qint64 baseOffset)
+        : m_position(begin), m_begin(begin), m_end(end), m_baseOffset(baseOffset) {}
+
+    bool ok() const {
+        return !m_failed;
+    }
+
+    bool atEnd() const {
+        return m_position >= m_end;
+    }
+
+    qint64 offset() const {
+        return m_baseOffset + (m_position - m_begin);
+    }
+
+    const uchar* position() const {
+        return m_position;
+    }
+
+    quint8 readByte() {
+        if (m_position >= m_end) {
+            m_failed = true;
+            return 0;
+        }
+        return *m_position++;
+    }
+
+    quint64 readUnsigned() {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const quint8 byte = readByte();
+            if (m_failed) {
+                return 0;
+            }
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        m_failed = true;
+        return 0;
+    }
+
+    qint64 readSigned() {
+        const quint64 raw = readUnsigned();
+        const qint64 magnitude = static_cast<qint64>(raw >> 1);
+        return (raw & 1) ? -magnitude : magnitude;
+    }
+
+    // Element count of a list whose entries take at least one byte each.
+    int readCount() {
+        const quint64 count = readUnsigned();
+        if (count > static_cast<quint64>(m_end - m_position)) {
+            m_failed = true;
+            return 0;
+        }
+        return static_cast<int>(count);
+    }
+
+    double readReal() {
+        return readRealOfType(readUnsigned());
+    }
+
+    double readRealOfType(const quint64 type) {
+        switch (type) {
+        case 0:
+            return static_cast<double>(readUnsigned());
+        case 1:
+            return -static_cast<double>(readUnsigned());
+        case 2:
+        case 3: {
+            const quint64 denominator = readUnsigned();
+            if (denominator == 0) {
+                m_failed = true;
+                return 0.0;
+            }
+            const double value = 1.0 / static_cast<double>(denominator);
+            return type == 3 ? -value : value;
+        }
+        case 4:
+        case 5: {
+            const quint64 numerator = readUnsigned();
+            const quint64 denominator = readUnsigned();
+            if (denominator == 0) {
+                m_failed = true;
+                return 0.0;
+            }
+            const double value = static_cast<double>(numerator) / static_cast<double>(denominator);
+            return type == 5 ? -value : value;
+        }
+        case 6: {
+            const quint32 bits = static_cast<quint32>(readLittleEndian(4));
+            float value = 0.0f;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        case 7: {
+            const quint64 bits = readLittleEndian(8);
+            double value = 0.0;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        default:
+            m_failed = true;
+            return 0.0;
+        }
+    }
+
+    QByteArray readString() {
+        const int length = readCount();
+        if (m_failed) {
+            return QByteArray();
+        }
+        const QByteArray value(reinterpret_cast<const char*>(m_position), length);
+        m_position += length;
+        return value;
+    }
+
+    void skipString() {
+        const int length = readCount();
+        m_position += length;
+    }
+
+    const uchar* readBytes(const quint64 count) {
+        if (count > static_cast<quint64>(m_end - m_position)) {
+            m_failed = true;
+            return nullptr;
+        }
+        const uchar* bytes = m_position;
+        m_position += count;
+        return bytes;
+    }
+
+    // g-delta: form 1 is an octangular direction plus magnitude, form 2 an
+    // explicit (x, y) pair.
+    WorldPoint readGDelta() {
+        const quint64 raw = readUnsigned();
+        if (!(raw & 1)) {
+            return octangularDelta((raw >> 1) & 7, static_cast<qint64>(raw >> 4));
+        }
+
+        const qint64 magnitude = static_cast<qint64>(raw >> 2);
+        const qint64 dx = (raw & 2) ? -magnitude : magnitude;
+        return WorldPoint{dx, readSigned()};
+    }
+
+    static WorldPoint octangularDelta(const quint64 direction, const qint64 magnitude) {
+        switch (direction) {
+        case 0: return WorldPoint{magnitude, 0};
+        case 1: return WorldPoint{0, magnitude};
+        case 2: return WorldPoint{-magnitude, 0};
+        case 3: return WorldPoint{0, -magnitude};
+        case 4: return WorldPoint{magnitude, magnitude};
+        case 5: return WorldPoint{-magnitude, magnitude};
+        case 6: return WorldPoint{-magnitude, -magnitude};
+        default: return WorldPoint{magnitude, -magnitude};
+        }
+    }
+
+private:
+    quint64 readLittleEndian(const int byteCount) {
+        const uchar* bytes = readBytes(byteCount);
+        quint64 value = 0;
+        for (int i = byteCount - 1; bytes && i >= 0; --i) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    const uchar* m_position;
+    const uchar* m_begin;
+    const uchar* m_end;
+    qint64 m_baseOffset;
+    bool m_failed{false};
+};
+
+// A repetition is either a (possibly skewed) grid, kept compact as an
+// instance array once it is large enough, or an explicit list of offsets.
+// Offsets include (0, 0).
+struct OasisRepetition {
+    bool isGrid{true};
+    int columns{1};
+    int rows{1};
+    WorldPoint columnStep{0, 0};
+    WorldPoint rowStep{0, 0};
+    QVector<WorldPoint> offsets;
+};
+
+// Cells and placements may name a cell directly or through a CELLNAME
+// reference number; numbers are resolved once the whole file is parsed.
+struct OasisCellRef {
+    bool byName{false};
+    quint64 referenceNumber{0};
+    QString name;
+};
+
+// One contiguous piece of the logical record stream: either a run of raw
+// records in the mapped file or a CBLOCK that is inflated before parsing.
+struct OasisSegment {
+    const uchar* begin{nullptr};
+    const uchar* end{nullptr};
+    qint64 offset{0};
+    bool compressed{false};
+    quint64 uncompressedSize{0};
+    QByteArray inflated;
+};
+
+// Identity of a shape for master reuse: kind, layer and geometry. Only
+// shapes built at the origin are compared, so equal keys mean equal shapes.
+QByteArray repetitionShapeKey(const LayoutObjectModel& shape) {
+    QVector<qint64> words;
+    quint32 layerNameId = 0;
+    quint32 layerTypeId = 0;
+    shape.tryGetLayer(layerNameId, layerTypeId);
+    if (const DrawnRectangle* rectangle = shape.asRectangle()) {
+        words = {0, layerNameId, layerTypeId, rectangle->x1, rectangle->y1, rectangle->x2, rectangle->y2};
+    } else if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(&shape)) {
+        words = {1, layerNameId, layerTypeId};
+        for (const WorldPoint& vertex : polygon->vertices()) {
+            words.push_back(vertex.x);
+            words.push_back(vertex.y);
+        }
+    } else if (const auto* path = dynamic_cast<const PathObjectModel*>(&shape)) {
+        words = {2, layerNameId, layerTypeId, path->width(), path->beginExtension(), path->endExtension()};
+        for (const WorldPoint& point : path->points()) {
+            words.push_back(point.x);
+            words.push_back(point.y);
+        }
+    }
+    return QByteArray(reinterpret_cast<const char*>(words.constData()),
+                      static_cast<int>(words.size() * sizeof(qint64)));
+}
+
+bool inflateSegment(OasisSegment& segment, QString& error) {
+    if (segment.uncompressedSize > static_cast<quint64>(std::numeric_limits<int>::max())) {
+        error = QString("CBLOCK at offset %1 is too large").arg(segment.offset);
+        return false;
+    }
+
+    segment.inflated.resize(static_cast<int>(segment.uncompressedSize));
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        error = QString("cannot initialize inflate for CBLOCK at offset %1").arg(segment.offset);
+        return false;
+    }
+
+    stream.next_in = const_cast<Bytef*>(segment.begin);
+    stream.avail_in = static_cast<uInt>(segment.end - segment.begin);
+    stream.next_out = reinterpret_cast<Bytef*>(segment.inflated.data());
+    stream.avail_out = static_cast<uInt>(segment.inflated.size());
+    const int status = inflate(&stream, Z_FINISH);
+    const bool complete = status == Z_STREAM_END && stream.total_out == segment.uncompressedSize;
+    inflateEnd(&stream);
+
+    if (!complete) {
+        error = QString("corrupt CBLOCK at offset %1").arg(segment.offset);
+        return false;
+    }
+    return true;
+}
+
+// CBLOCKs ahead of the sequential build pass. Helpers inflate at most
+// kInflateWindow segments past the last one the builder finished, so only
+// that many inflated buffers exist at once; the builder inflates a segment
+// itself when no helper has claimed it yet.
+class OasisInflateQueue {
+public:
+    static constexpr int kInflateWindow = 16;
+
+    explicit OasisInflateQueue(QVector<OasisSegment>& segments) : m_segments(segments) {
+        for (int i = 0; i < segments.size(); ++i) {
+            if (segments[i].compressed) {
+                m_compressed.push_back(i);
+            }
+        }
+        m_claimed.fill(false, m_compressed.size());
+        m_ready.fill(false, m_compressed.size());
+        m_errors.resize(m_compressed.size());
+    }
+
+    int compressedCount() const {
+        return m_compressed.size();
+    }
+
+    // Helper task: inflates segments inside the window until all are
+    // claimed or the builder stops.
+    void inflateAhead() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_changed.wait(lock, [this]() {
+                return m_stopped || m_nextClaim >= m_compressed.size()
+                       || m_nextClaim < m_consumed + kInflateWindow;
+            });
+            if (m_stopped || m_nextClaim >= m_compressed.size()) {
+                return;
+            }
+            const int position = m_nextClaim++;
+            if (!m_claimed[position]) {
+                inflateClaimed(position, lock);
+            }
+        }
+    }
+
+    // Builder side: waits until the compressedIndex-th CBLOCK is inflated,
+    // inflating it here if no helper took it.
+    bool acquire(const int compressedIndex, QString& error) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_claimed[compressedIndex]) {
+            inflateClaimed(compressedIndex, lock);
+        }
+        m_changed.wait(lock, [this, compressedIndex]() { return m_ready[compressedIndex]; });
+        if (!m_errors[compressedIndex].isEmpty()) {
+            error = m_errors[compressedIndex];
+            return false;
+        }
+        return true;
+    }
+
+    // Frees the compressedIndex-th CBLOCK's data and slides the window.
+    void release(const int compressedIndex) {
+        m_segments[m_compressed[compressedIndex]].inflated = QByteArray();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_consumed = compressedIndex + 1;
+        }
+        m_changed.notify_all();
+    }
+
+    // Lets idle helpers return once the builder is done or has failed.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_changed.notify_all();
+    }
+
+private:
+    void inflateClaimed(const int position, std::unique_lock<std::mutex>& lock) {
+        m_claimed[position] = true;
+        lock.unlock();
+        QString inflateError;
+        inflateSegment(m_segments[m_compressed[position]], inflateError);
+        lock.lock();
+        m_errors[position] = inflateError;
+        m_ready[position] = true;
+        m_changed.notify_all();
+    }
+
+    QVector<OasisSegment>& m_segments;
+    // Positions in m_segments of the CBLOCKs; the vectors below are
+    // indexed like it and guarded by m_mutex.
+    QVector<int> m_compressed;
+    QVector<bool> m_claimed;
+    QVector<bool> m_ready;
+    QVector<QString> m_errors;
+    int m_nextClaim{0};
+    int m_consumed{0};
+    bool m_stopped{false};
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
+
+// Record parser shared by the scan and build passes. In scan mode records
+// are decoded only far enough to find the next one, and CBLOCKs split the
+// stream into segments; in build mode shapes and placements are created.
+class OasisParser {
+public:
+    explicit OasisParser(const bool buildObjects) : m_buildObjects(buildObjects) {}
+
+    // Parses records until the reader is exhausted or END is seen.
+    bool parse(OasisByteReader& reader, QString& error) {
+        while (!reader.atEnd() && !m_sawEnd) {
+            const qint64 recordOffset = reader.offset();
+            const uchar* recordStart = reader.position();
+            const quint64 type = reader.readUnsigned();
+            if (!parseRecord(type, recordStart, reader, error)) {
+                if (error.isEmpty()) {
+                    error = QString("malformed OASIS record %1 at offset %2").arg(type).arg(recordOffset);
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sawEnd() const {
+        return m_sawEnd;
+    }
+
+    double unitsPerMicron() const {
+        return m_unitsPerMicron;
+    }
+
+    // Scan mode: lets raw runs report their file offsets.
+    void setFileBegin(const uchar* fileBegin) {
+        m_fileBegin = fileBegin;
+    }
+
+    QVector<OasisSegment>& segments() {
+        return m_segments;
+    }
+
+    // Build mode: resolves cell reference numbers and hands the cells over.
+    bool finish(QVector<LayoutDecodedCell>& outCells, qint64& outSkipped, QString& error) {
+        flushCell();
+        for (int i = 0; i < m_cells.size(); ++i) {
+            QString name;
+            if (!resolveCellName(m_cellRefs[i], name, error)) {
+                return false;
+            }
+            m_cells[i].node->setName(name);
+
+            QVector<LayoutPendingPlacement>& placements = m_cells[i].placements;
+            for (int j = 0; j < placements.size(); ++j) {
+                if (!resolveCellName(m_placementRefs[i][j], placements[j].masterName, error)) {
+                    return false;
+                }
+            }
+        }
+
+        outSkipped = m_skippedOutsideCells;
+        outCells = std::move(m_cells);
+        return true;
+    }
+
+private:
+    // Modal variables; reset at every CELL record.
+    struct ModalState {
+        bool xyRelative{false};
+        bool hasRepetition{false};
+        OasisRepetition repetition;
+        bool hasPlacementCell{false};
+        OasisCellRef placementCell;
+        qint64 placementX{0};
+        qint64 placementY{0};
+        quint64 layer{0};
+        quint64 dataType{0};
+        qint64 textX{0};
+        qint64 textY{0};
+        qint64 geometryX{0};
+        qint64 geometryY{0};
+        quint64 geometryWidth{0};
+        quint64 geometryHeight{0};
+        bool hasPolygonPoints{false};
+        QVector<WorldPoint> polygonPoints;
+        bool hasPathPoints{false};
+        QVector<WorldPoint> pathPoints;
+        quint64 pathHalfWidth{0};
+        qint64 pathStartExtension{0};
+        qint64 pathEndExtension{0};
+    };
+
+    bool parseRecord(const quint64 type, const uchar* recordStart, OasisByteReader& reader, QString& error) {
+        switch (type) {
+        case kRecordPad:
+        case kRecordPropertyRepeat:
+            return true;
+        case kRecordStart: {
+            reader.skipString();
+            const double unit = reader.readReal();
+            if (unit > 0.0) {
+                m_unitsPerMicron = unit;
+            }
+            if (reader.readUnsigned() == 0) {
+                // Offset table stored in START: six (flag, offset) pairs.
+                for (int i = 0; i < 12; ++i) {
+                    reader.readUnsigned();
+                }
+            }
+            m_runStart = reader.position();
+            return reader.ok();
+        }
+        case kRecordEnd:
+            // The remaining END payload (offset table, padding, validation)
+            // is not needed.
+            closeRun(recordStart);
+            m_sawEnd = true;
+            return true;
+        case kRecordCellName:
+        case kRecordCellNameRef: {
+            const QByteArray name = reader.readString();
+            const quint64 referenceNumber = type == kRecordCellNameRef ? reader.readUnsigned() : m_nextCellNameReference++;
+            m_cellNames.insert(referenceNumber, QString::fromLatin1(name));
+            return reader.ok();
+        }
+        case kRecordTextString:
+        case kRecordPropName:
+        case kRecordPropString:
+            reader.skipString();
+            return reader.ok();
+        case kRecordTextStringRef:
+        case kRecordPropNameRef:
+        case kRecordPropStringRef:
+            reader.skipString();
+            reader.readUnsigned();
+            return reader.ok();
+        case kRecordLayerName:
+        case kRecordLayerNameText:
+            reader.skipString();
+            skipInterval(reader);
+            skipInterval(reader);
+            return reader.ok();
+        case kRecordCellByRef:
+        case kRecordCellByName: {
+            OasisCellRef cellRef;
+            cellRef.byName = type == kRecordCellByName;
+            if (cellRef.byName) {
+                cellRef.name = QString::fromLatin1(reader.readString());
+            } else {
+                cellRef.referenceNumber = reader.readUnsigned();
+            }
+            if (!reader.ok()) {
+                return false;
+            }
+            beginCell(cellRef);
+            return true;
+        }
+        case kRecordXyAbsolute:
+            m_modal.xyRelative = false;
+            return true;
+        case kRecordXyRelative:
+            m_modal.xyRelative = true;
+            return true;
+        case kRecordPlacement:
+        case kRecordPlacementTransform:
+            return parsePlacement(type, reader, error);
+        case kRecordText:
+            return parseText(reader, error);
+        case kRecordRectangle:
+            return parseRectangle(reader, error);
+        case kRecordPolygon:
+            return parsePolygon(reader, error);
+        case kRecordPath:
+            return parsePath(reader, error);
+        case kRecordTrapezoid:
+        case kRecordTrapezoidA:
+        case kRecordTrapezoidB:
+            return parseTrapezoid(type, reader, error);
+        case kRecordCTrapezoid:
+        case kRecordCircle:
+        case kRecordXGeometry:
+            return parseUnsupportedGeometry(type, reader, error);
+        case kRecordProperty:
+            return parseProperty(reader);
+        case kRecordXName:
+            reader.readUnsigned();
+            reader.skipString();
+            return reader.ok();
+        case kRecordXNameRef:
+            reader.readUnsigned();
+            reader.skipString();
+            reader.readUnsigned();
+            return reader.ok();
+        case kRecordXElement:
+            reader.readUnsigned();
+            reader.skipString();
+            return reader.ok();
+        case kRecordCBlock:
+            return parseCBlock(recordStart, reader, error);
+        default:
+            error = QString("unknown OASIS record %1 at offset %2").arg(type).arg(reader.offset());
+            return false;
+        }
+    }
+
+    static void skipInterval(OasisByteReader& reader) {
+        const quint64 intervalType = reader.readUnsigned();
+        if (intervalType >= 1 && intervalType <= 3) {
+            reader.readUnsigned();
+        } else if (intervalType == 4) {
+            reader.readUnsigned();
+            reader.readUnsigned();
+        }
+    }
+
+    bool parseCBlock(const uchar* recordStart, OasisByteReader& reader, QString& error) {
+        const qint64 recordOffset = reader.offset();
+        const quint64 compressionType = reader.readUnsigned();
+        const quint64 uncompressedSize = reader.readUnsigned();
+        const quint64 compressedSize = reader.readUnsigned();
+        const uchar* payload = reader.readBytes(compressedSize);
+        if (!reader.ok()) {
+            return false;
+        }
+
+        if (m_buildObjects) {
+            error = QString("nested CBLOCK at offset %1").arg(recordOffset);
+            return false;
+        }
+        if (compressionType != kCBlockDeflate) {
+            error = QString("unsupported CBLOCK compression %1 at offset %2").arg(compressionType).arg(recordOffset);
+            return false;
+        }
+
+        closeRun(recordStart);
+        OasisSegment segment;
+        segment.begin = payload;
+        segment.end = payload + compressedSize;
+        segment.offset = recordOffset;
+        segment.compressed = true;
+        segment.uncompressedSize = uncompressedSize;
+        m_segments.push_back(std::move(segment));
+        m_runStart = reader.position();
+        return true;
+    }
+
+    // Scan mode: records the raw records since the last CBLOCK as a segment.
+    void closeRun(const uchar* runEnd) {
+        if (m_buildObjects || !m_runStart || runEnd <= m_runStart) {
+            return;
+        }
+
+        OasisSegment segment;
+        segment.begin = m_runStart;
+        segment.end = runEnd;
+        segment.offset = m_runStart - m_fileBegin;
+        m_segments.push_back(std::move(segment));
+        m_runStart = nullptr;
+    }
+
+    bool readRepetition(OasisByteReader& reader, const OasisRepetition*& outRepetition, QString& error) {
+        const qint64 repetitionOffset = reader.offset();
+        const quint64 type = reader.readUnsigned();
+        if (type == 0) {
+            if (!m_modal.hasRepetition && m_buildObjects) {
+                error = QString("repetition reuse without a previous repetition at offset %1").arg(repetitionOffset);
+                return false;
+            }
+            outRepetition = &m_modal.repetition;
+            return reader.ok();
+        }
+
+        OasisRepetition repetition;
+        switch (type) {
+        case 1: {
+            const quint64 columns = reader.readUnsigned();
+            const quint64 rows = reader.readUnsigned();
+            const qint64 columnSpace = static_cast<qint64>(reader.readUnsigned());
+            const qint64 rowSpace = static_cast<qint64>(reader.readUnsigned());
+            if (!setGridCounts(repetition, columns, rows, repetitionOffset, error)) {
+                return false;
+            }
+            repetition.columnStep = WorldPoint{columnSpace, 0};
+            repetition.rowStep = WorldPoint{0, rowSpace};
+            break;
+        }
+        case 2: {
+            const quint64 columns = reader.readUnsigned();
+            const qint64 columnSpace = static_cast<qint64>(reader.readUnsigned());
+            if (!setGridCounts(repetition, columns, 0, repetitionOffset, error)) {
+                return false;
+            }
+            repetition.rows = 1;
+            repetition.columnStep = WorldPoint{columnSpace, 0};
+            break;
+        }
+        case 3: {
+            const quint64 rows = reader.readUnsigned();
+            const qint64 rowSpace = static_cast<qint64>(reader.readUnsigned());
+            if (!setGridCounts(repetition, 0, rows, repetitionOffset, error)) {
+                return false;
+            }
+            repetition.columns = 1;
+            repetition.rowStep = WorldPoint{0, rowSpace};
+            break;
+        }
+        case 4:
+        case 5:
+        case 6:
+        case 7: {
+            // Irregular spacing along one axis, optionally scaled by a grid.
+            const bool vertical = type >= 6;
+            const int count = reader.readCount();
+            const qint64 grid = (type == 5 || type == 7) ? static_cast<qint64>(reader.readUnsigned()) : 1;
+            repetition.isGrid = false;
+            repetition.offsets.reserve(count + 2);
+            repetition.offsets.push_back(WorldPoint{0, 0});
+            qint64 position = 0;
+            for (int i = 0; i <= count && reader.ok(); ++i) {
+                position += static_cast<qint64>(reader.readUnsigned()) * grid;
+                repetition.offsets.push_back(vertical ? WorldPoint{0, position} : WorldPoint{position, 0});
+            }
+            break;
+        }
+        case 8: {
+            const quint64 columns = reader.readUnsigned();
+            const quint64 rows = reader.readUnsigned();
+            repetition.columnStep = reader.readGDelta();
+            repetition.rowStep = reader.readGDelta();
+            if (!setGridCounts(repetition, columns, rows, repetitionOffset, error)) {
+                return false;
+            }
+            break;
+        }
+        case 9: {
+            const quint64 columns = reader.readUnsigned();
+            repetition.columnStep = reader.readGDelta();
+            if (!setGridCounts(repetition, columns, 0, repetitionOffset, error)) {
+                return false;
+            }
+            repetition.rows = 1;
+            break;
+        }
+        case 10:
+        case 11: {
+            // Arbitrary displacements, each relative to the previous one.
+            const int count = reader.readCount();
+            const qint64 grid = type == 11 ? static_cast<qint64>(reader.readUnsigned()) : 1;
+            repetition.isGrid = false;
+            repetition.offsets.reserve(count + 2);
+            repetition.offsets.push_back(WorldPoint{0, 0});
+            WorldPoint position{0, 0};
+            for (int i = 0; i <= count && reader.ok(); ++i) {
+                const WorldPoint delta = reader.readGDelta();
+                position.x += delta.x * grid;
+                position.y += delta.y * grid;
+                repetition.offsets.push_back(position);
+            }
+            break;
+        }
+        default:
+            error = QString("unknown repetition type %1 at offset %2").arg(type).arg(repetitionOffset);
+            return false;
+        }
+
+        if (!reader.ok()) {
+            error = QString("truncated or malformed repetition at offset %1").arg(repetitionOffset);
+            return false;
+        }
+        m_modal.repetition = std::move(repetition);
+        m_modal.hasRepetition = true;
+        outRepetition = &m_modal.repetition;
+        return true;
+    }
+
+    // Grid dimensions are stored as count - 2.
+    static bool setGridCounts(OasisRepetition& repetition,
+                              const quint64 columns,
+                              const quint64 rows,
+                              const qint64 repetitionOffset,
+                              QString& error) {
+        constexpr quint64 kMaxDimension = static_cast<quint64>(std::numeric_limits<int>::max()) - 2;
+        if (columns > kMaxDimension || rows > kMaxDimension) {
+            error = QString("repetition grid too large at offset %1").arg(repetitionOffset);
+            return false;
+        }
+        repetition.columns = static_cast<int>(columns) + 2;
+        repetition.rows = static_cast<int>(rows) + 2;
+        return true;
+    }
+
+    // Reads a point list as vertices relative to the first one at (0, 0).
+    // Manhattan lists (types 0 and 1) of polygons get their implied last
+    // vertex appended.
+    static bool readPointList(OasisByteReader& reader, const bool polygon, QVector<WorldPoint>& outPoints) {
+        const quint64 type = reader.readUnsigned();
+        const int count = reader.readCount();
+        if (!reader.ok() || type > 5) {
+            return false;
+        }
+
+        outPoints.clear();
+        outPoints.reserve(count + 2);
+        outPoints.push_back(WorldPoint{0, 0});
+        WorldPoint position{0, 0};
+        WorldPoint previousDelta{0, 0};
+        for (int i = 0; i < count && reader.ok(); ++i) {
+            WorldPoint delta{0, 0};
+            switch (type) {
+            case 0:
+            case 1: {
+                const bool horizontal = (type == 0) == (i % 2 == 0);
+                const qint64 distance = reader.readSigned();
+                delta = horizontal ? WorldPoint{distance, 0} : WorldPoint{0, distance};
+                break;
+            }
+            case 2: {
+                const quint64 raw = reader.readUnsigned();
+                delta = OasisByteReader::octangularDelta(raw & 3, static_cast<qint64>(raw >> 2));
+                break;
+            }
+            case 3: {
+                const quint64 raw = reader.readUnsigned();
+                delta = OasisByteReader::octangularDelta(raw & 7, static_cast<qint64>(raw >> 3));
+                break;
+            }
+            case 4:
+                delta = reader.readGDelta();
+                break;
+            default: {
+                // Type 5 stores differences between consecutive deltas.
+                const WorldPoint change = reader.readGDelta();
+                delta = WorldPoint{previousDelta.x + change.x, previousDelta.y + change.y};
+                break;
+            }
+            }
+
+            previousDelta = delta;
+            position.x += delta.x;
+            position.y += delta.y;
+            outPoints.push_back(position);
+        }
+
+        if (polygon && type <= 1 && reader.ok()) {
+            const bool horizontal = (type == 0) == (count % 2 == 0);
+            const WorldPoint implied = horizontal ? WorldPoint{0, position.y} : WorldPoint{position.x, 0};
+            if ((implied.x != 0 || implied.y != 0) && (implied.x != position.x || implied.y != position.y)) {
+                outPoints.push_back(implied);
+            }
+        }
+        return reader.ok();
+    }
+
+    qint64 readCoordinate(OasisByteReader& reader, qint64& modalValue) {
+        const qint64 value = reader.readSigned();
+        modalValue = m_modal.xyRelative ? modalValue + value : value;
+        return modalValue;
+    }
+
+    bool requireCell(OasisByteReader& reader, QString& error) {
+        if (!m_buildObjects || m_currentCell >= 0) {
+            return true;
+        }
+        error = QString("element outside a CELL at offset %1").arg(reader.offset());
+        return false;
+    }
+
+    // Reads the layer/datatype/x/y/repetition tail shared by geometry
+    // records, in the order given by the record layout.
+    bool readLayer(OasisByteReader& reader, const quint8 info) {
+        if (info & 0x01) {
+            m_modal.layer = reader.readUnsigned();
+        }
+        if (info & 0x02) {
+            m_modal.dataType = reader.readUnsigned();
+        }
+        return reader.ok();
+    }
+
+    bool readGeometryPosition(OasisByteReader& reader,
+                              const quint8 info,
+                              const OasisRepetition*& outRepetition,
+                              QString& error) {
+        if (info & 0x10) {
+            readCoordinate(reader, m_modal.geometryX);
+        }
+        if (info & 0x08) {
+            readCoordinate(reader, m_modal.geometryY);
+        }
+        outRepetition = nullptr;
+        if ((info & 0x04) && !readRepetition(reader, outRepetition, error)) {
+            return false;
+        }
+        return reader.ok();
+    }
+
+    // makeShape(dx, dy) builds the shape at the modal geometry position
+    // moved by (dx, dy).
+    template <typename ShapeFactory>
+    void addShape(const OasisRepetition* repetition, ShapeFactory&& makeShape) {
+        if (!m_buildObjects) {
+            return;
+        }
+
+        if (!repetition) {
+            appendObject(makeShape(0, 0));
+            return;
+        }
+
+        if (!repetition->isGrid) {
+            for (const WorldPoint& offset : repetition->offsets) {
+                appendObject(makeShape(offset.x, offset.y));
+            }
+            return;
+        }
+
+        const qint64 elementCount = static_cast<qint64>(repetition->columns) * repetition->rows;
+        if (elementCount < kMinRepetitionInstanceElements) {
+            for (int row = 0; row < repetition->rows; ++row) {
+                for (int column = 0; column < repetition->columns; ++column) {
+                    appendObject(makeShape(column * repetition->columnStep.x + row * repetition->rowStep.x,
+                                           column * repetition->columnStep.y + row * repetition->rowStep.y));
+                }
+            }
+            return;
+        }
+
+        // Large grids become a compact array of a master holding the shape
+        // at the origin, shared by every repetition of the same shape.
+        std::shared_ptr<LayoutObjectModel> shape = makeShape(-m_modal.geometryX, -m_modal.geometryY);
+        if (!shape) {
+            return;
+        }
+        std::shared_ptr<const LayoutSceneNode>& master = m_repetitionMasters[repetitionShapeKey(*shape)];
+        if (!master) {
+            auto node = std::make_shared<LayoutSceneNode>();
+            node->addObject(std::move(shape));
+            master = std::move(node);
+        }
+
+        LayoutTransform transform;
+        transform.originX = m_modal.geometryX;
+        transform.originY = m_modal.geometryY;
+        appendObject(std::make_shared<InstanceObjectModel>(master,
+                                                           transform,
+                                                           repetition->columns,
+                                                           repetition->rows,
+                                                           repetition->columnStep,
+                                                           repetition->rowStep));
+    }
+
+    void appendObject(std::shared_ptr<LayoutObjectModel> object) {
+        if (object) {
+            m_objects.push_back(std::move(object));
+        }
+    }
+
+    bool parseRectangle(OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (!readLayer(reader, info)) {
+            return false;
+        }
+        if (info & 0x40) {
+            m_modal.geometryWidth = reader.readUnsigned();
+        }
+        if (info & 0x20) {
+            m_modal.geometryHeight = reader.readUnsigned();
+        }
+        if (info & 0x80) {
+            // Square: height follows width.
+            m_modal.geometryHeight = m_modal.geometryWidth;
+        }
+
+        const OasisRepetition* repetition = nullptr;
+        if (!readGeometryPosition(reader, info, repetition, error) || !requireCell(reader, error)) {
+            return false;
+        }
+
+        const quint32 layer = static_cast<quint32>(m_modal.layer);
+        const quint32 dataType = static_cast<quint32>(m_modal.dataType);
+        const qint64 x = m_modal.geometryX;
+        const qint64 y = m_modal.geometryY;
+        const qint64 width = static_cast<qint64>(m_modal.geometryWidth);
+        const qint64 height = static_cast<qint64>(m_modal.geometryHeight);
+        addShape(repetition, [=](const qint64 dx, const qint64 dy) -> std::shared_ptr<LayoutObjectModel> {
+            const DrawnRectangle rectangle{layer, dataType, x + dx, y + dy, x + dx + width, y + dy + height};
+            return std::make_shared<RectangleObjectModel>(rectangle);
+        });
+        return true;
+    }
+
+    bool parsePolygon(OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (!readLayer(reader, info)) {
+            return false;
+        }
+        if (info & 0x20) {
+            if (!readPointList(reader, true, m_modal.polygonPoints)) {
+                return false;
+            }
+            m_modal.hasPolygonPoints = true;
+        }
+
+        const OasisRepetition* repetition = nullptr;
+        if (!readGeometryPosition(reader, info, repetition, error) || !requireCell(reader, error)) {
+            return false;
+        }
+        if (m_buildObjects && !m_modal.hasPolygonPoints) {
+            error = QString("POLYGON without a point list at offset %1").arg(reader.offset());
+            return false;
+        }
+
+        addPolygon(repetition, m_modal.polygonPoints);
+        return true;
+    }
+
+    void addPolygon(const OasisRepetition* repetition, const QVector<WorldPoint>& relativePoints) {
+        const quint32 layer = static_cast<quint32>(m_modal.layer);
+        const quint32 dataType = static_cast<quint32>(m_modal.dataType);
+        const qint64 x = m_modal.geometryX;
+        const qint64 y = m_modal.geometryY;
+        addShape(repetition, [&](const qint64 dx, const qint64 dy) -> std::shared_ptr<LayoutObjectModel> {
+            if (relativePoints.size() < 3) {
+                return nullptr;
+            }
+            QVector<WorldPoint> points = relativePoints;
+            for (WorldPoint& point : points) {
+                point.x += x + dx;
+                point.y += y + dy;
+            }
+            return std::make_shared<PolygonObjectModel>(layer, dataType, std::move(points));
+        });
+    }
+
+    bool parsePath(OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (!readLayer(reader, info)) {
+            return false;
+        }
+        if (info & 0x40) {
+            m_modal.pathHalfWidth = reader.readUnsigned();
+        }
+        if (info & 0x80) {
+            // Extension scheme 0000SSEE: 0 reuse, 1 flush, 2 half width, 3 explicit.
+            const quint64 scheme = reader.readUnsigned();
+            const quint64 startScheme = (scheme >> 2) & 3;
+            const quint64 endScheme = scheme & 3;
+            m_modal.pathStartExtension = extensionFor(reader, startScheme, m_modal.pathStartExtension);
+            m_modal.pathEndExtension = extensionFor(reader, endScheme, m_modal.pathEndExtension);
+        }
+        if (info & 0x20) {
+            if (!readPointList(reader, false, m_modal.pathPoints)) {
+                return false;
+            }
+            m_modal.hasPathPoints = true;
+        }
+
+        const OasisRepetition* repetition = nullptr;
+        if (!readGeometryPosition(reader, info, repetition, error) || !requireCell(reader, error)) {
+            return false;
+        }
+        if (m_buildObjects && !m_modal.hasPathPoints) {
+            error = QString("PATH without a point list at offset %1").arg(reader.offset());
+            return false;
+        }
+
+        const quint32 layer = static_cast<quint32>(m_modal.layer);
+        const quint32 dataType = static_cast<quint32>(m_modal.dataType);
+        const qint64 x = m_modal.geometryX;
+        const qint64 y = m_modal.geometryY;
+        const qint64 width = static_cast<qint64>(m_modal.pathHalfWidth) * 2;
+        const qint64 startExtension = m_modal.pathStartExtension;
+        const qint64 endExtension = m_modal.pathEndExtension;
+        const QVector<WorldPoint>& relativePoints = m_modal.pathPoints;
+        addShape(repetition, [&](const qint64 dx, const qint64 dy) -> std::shared_ptr<LayoutObjectModel> {
+            if (relativePoints.size() < 2) {
+                return nullptr;
+            }
+            QVector<WorldPoint> points = relativePoints;
+            for (WorldPoint& point : points) {
+                point.x += x + dx;
+                point.y += y + dy;
+            }
+            return std::make_shared<PathObjectModel>(layer, dataType, std::move(points),
+                                                     width, startExtension, endExtension);
+        });
+        return true;
+    }
+
+    qint64 extensionFor(OasisByteReader& reader, const quint64 scheme, const qint64 modalValue) const {
+        switch (scheme) {
+        case 1:
+            return 0;
+        case 2:
+            return static_cast<qint64>(m_modal.pathHalfWidth);
+        case 3:
+            return reader.readSigned();
+        default:
+            return modalValue;
+        }
+    }
+
+    bool parseTrapezoid(const quint64 type, OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (!readLayer(reader, info)) {
+            return false;
+        }
+        if (info & 0x40) {
+            m_modal.geometryWidth = reader.readUnsigned();
+        }
+        if (info & 0x20) {
+            m_modal.geometryHeight = reader.readUnsigned();
+        }
+        const qint64 deltaA = type != kRecordTrapezoidB ? reader.readSigned() : 0;
+        const qint64 deltaB = type != kRecordTrapezoidA ? reader.readSigned() : 0;
+
+        const OasisRepetition* repetition = nullptr;
+        if (!readGeometryPosition(reader, info, repetition, error) || !requireCell(reader, error)) {
+            return false;
+        }
+
+        // Corners relative to (x, y); deltas slant the two non-parallel edges.
+        const qint64 w = static_cast<qint64>(m_modal.geometryWidth);
+        const qint64 h = static_cast<qint64>(m_modal.geometryHeight);
+        QVector<WorldPoint> corners;
+        if (info & 0x80) {
+            corners = {WorldPoint{0, std::max<qint64>(deltaA, 0)},
+                       WorldPoint{0, h + std::min<qint64>(deltaB, 0)},
+                       WorldPoint{w, h - std::max<qint64>(deltaB, 0)},
+                       WorldPoint{w, -std::min<qint64>(deltaA, 0)}};
+        } else {
+            corners = {WorldPoint{std::max<qint64>(deltaA, 0), h},
+                       WorldPoint{w + std::min<qint64>(deltaB, 0), h},
+                       WorldPoint{w - std::max<qint64>(deltaB, 0), 0},
+                       WorldPoint{-std::min<qint64>(deltaA, 0), 0}};
+        }
+        addPolygon(repetition, corners);
+        return true;
+    }
+
+    // CTRAPEZOID, CIRCLE and XGEOMETRY are decoded for their modal effects
+    // only and counted as skipped.
+    bool parseUnsupportedGeometry(const quint64 type, OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (type == kRecordXGeometry) {
+            reader.readUnsigned();
+        }
+        if (!readLayer(reader, info)) {
+            return false;
+        }
+        if (type == kRecordCTrapezoid) {
+            if (info & 0x80) {
+                reader.readUnsigned();
+            }
+            if (info & 0x40) {
+                m_modal.geometryWidth = reader.readUnsigned();
+            }
+            if (info & 0x20) {
+                m_modal.geometryHeight = reader.readUnsigned();
+            }
+        } else if (type == kRecordCircle) {
+            if (info & 0x20) {
+                reader.readUnsigned();
+            }
+        } else {
+            reader.skipString();
+        }
+
+        const OasisRepetition* repetition = nullptr;
+        if (!readGeometryPosition(reader, info, repetition, error)) {
+            return false;
+        }
+        countSkipped();
+        return true;
+    }
+
+    bool parseText(OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (info & 0x40) {
+            if (info & 0x20) {
+                reader.readUnsigned();
+            } else {
+                reader.skipString();
+            }
+        }
+        if (info & 0x01) {
+            reader.readUnsigned();
+        }
+        if (info & 0x02) {
+            reader.readUnsigned();
+        }
+        if (info & 0x10) {
+            readCoordinate(reader, m_modal.textX);
+        }
+        if (info & 0x08) {
+            readCoordinate(reader, m_modal.textY);
+        }
+        const OasisRepetition* repetition = nullptr;
+        if ((info & 0x04) && !readRepetition(reader, repetition, error)) {
+            return false;
+        }
+        countSkipped();
+        return reader.ok();
+    }
+
+    bool parseProperty(OasisByteReader& reader) {
+        const quint8 info = reader.readByte();
+        if (info & 0x04) {
+            if (info & 0x02) {
+                reader.readUnsigned();
+            } else {
+                reader.skipString();
+            }
+        }
+        if (info & 0x08) {
+            // V: reuse the previous value list.
+            return reader.ok();
+        }
+
+        quint64 valueCount = info >> 4;
+        if (valueCount == 15) {
+            valueCount = reader.readUnsigned();
+        }
+        for (quint64 i = 0; i < valueCount && reader.ok(); ++i) {
+            const quint64 valueType = reader.readUnsigned();
+            if (valueType <= 7) {
+                reader.readRealOfType(valueType);
+            } else if (valueType == 8 || valueType == 9 || valueType >= 13) {
+                if (valueType > 15) {
+                    return false;
+                }
+                reader.readUnsigned();
+            } else {
+                reader.skipString();
+            }
+        }
+        return reader.ok();
+    }
+
+    bool parsePlacement(const quint64 type, OasisByteReader& reader, QString& error) {
+        const quint8 info = reader.readByte();
+        if (info & 0x80) {
+            OasisCellRef cellRef;
+            cellRef.byName = !(info & 0x40);
+            if (cellRef.byName) {
+                cellRef.name = QString::fromLatin1(reader.readString());
+            } else {
+                cellRef.referenceNumber = reader.readUnsigned();
+            }
+            m_modal.placementCell = cellRef;
+            m_modal.hasPlacementCell = true;
+        }
+
+        LayoutTransform transform;
+        transform.mirrorX = (info & 0x01) != 0;
+        if (type == kRecordPlacement) {
+            transform.angleDegrees = 90.0 * ((info >> 1) & 3);
+        } else {
+            if (info & 0x04) {
+                transform.magnification = reader.readReal();
+            }
+            if (info & 0x02) {
+                transform.angleDegrees = reader.readReal();
+            }
+        }
+        if (info & 0x20) {
+            readCoordinate(reader, m_modal.placementX);
+        }
+        if (info & 0x10) {
+            readCoordinate(reader, m_modal.placementY);
+        }
+
+        const OasisRepetition* repetition = nullptr;
+        if ((info & 0x08) && !readRepetition(reader, repetition, error)) {
+            return false;
+        }
+        if (!reader.ok() || !requireCell(reader, error)) {
+            return false;
+        }
+        if (!m_buildObjects) {
+            return true;
+        }
+        if (!m_modal.hasPlacementCell) {
+            error = QString("PLACEMENT without a cell at offset %1").arg(reader.offset());
+            return false;
+        }
+
+        transform.originX = m_modal.placementX;
+        transform.originY = m_modal.placementY;
+        LayoutPendingPlacement placement;
+        placement.transform = transform;
+        if (repetition && repetition->isGrid) {
+            placement.columns = repetition->columns;
+            placement.rows = repetition->rows;
+            placement.columnStep = repetition->columnStep;
+            placement.rowStep = repetition->rowStep;
+        }
+
+        if (!repetition || repetition->isGrid) {
+            appendPlacement(placement);
+            return true;
+        }
+        for (const WorldPoint& offset : repetition->offsets) {
+            LayoutPendingPlacement shifted = placement;
+            shifted.transform.originX += offset.x;
+            shifted.transform.originY += offset.y;
+            appendPlacement(shifted);
+        }
+        return true;
+    }
+
+    void appendPlacement(const LayoutPendingPlacement& placement) {
+        m_cells[m_currentCell].placements.push_back(placement);
+        m_placementRefs[m_currentCell].push_back(m_modal.placementCell);
+    }
+
+    void beginCell(const OasisCellRef& cellRef) {
+        m_modal = ModalState();
+        if (!m_buildObjects) {
+            return;
+        }
+
+        flushCell();
+        LayoutDecodedCell cell;
+        cell.node = std::make_shared<LayoutSceneNode>();
+        m_cells.push_back(std::move(cell));
+        m_cellRefs.push_back(cellRef);
+        m_placementRefs.push_back(QVector<OasisCellRef>());
+        m_currentCell = m_cells.size() - 1;
+    }
+
+    void flushCell() {
+        if (m_currentCell >= 0) {
+            m_cells[m_currentCell].node->addObjects(std::move(m_objects));
+            m_objects = QVector<std::shared_ptr<LayoutObjectModel>>();
+        }
+    }
+
+    void countSkipped() {
+        if (!m_buildObjects) {
+            return;
+        }
+        if (m_currentCell >= 0) {
+            ++m_cells[m_currentCell].skippedElements;
+        } else {
+            ++m_skippedOutsideCells;
+        }
+    }
+
+    bool resolveCellName(const OasisCellRef& cellRef, QString& outName, QString& error) const {
+        if (cellRef.byName) {
+            outName = cellRef.name;
+            return true;
+        }
+
+        const auto nameIt = m_cellNames.constFind(cellRef.referenceNumber);
+        if (nameIt == m_cellNames.cend()) {
+            error = QString("undefined CELLNAME reference %1").arg(cellRef.referenceNumber);
+            return false;
+        }
+        outName = nameIt.value();
+        return true;
+    }
+
+    bool m_buildObjects;
+    bool m_sawEnd{false};
+    double m_unitsPerMicron{1000.0};
+    ModalState m_modal;
+
+    // Scan mode.
+    QVector<OasisSegment> m_segments;
+    const uchar* m_runStart{nullptr};
+    const uchar* m_fileBegin{nullptr};
+
+    // Build mode.
+    QHash<quint64, QString> m_cellNames;
+    quint64 m_nextCellNameReference{0};
+    QVector<LayoutDecodedCell> m_cells;
+    QVector<OasisCellRef> m_cellRefs;
+    QVector<QVector<OasisCellRef>> m_placementRefs;
+    QVector<std::shared_ptr<LayoutObjectModel>> m_objects;
+    // Masters of grid-repeated shapes, by repetitionShapeKey().
+    QHash<QByteArray, std::shared_ptr<const LayoutSceneNode>> m_repetitionMasters;
+    int m_currentCell{-1};
+    qint64 m_skippedOutsideCells{0};
+};
+
+}
+
+namespace OasisStreamReader {
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error) {
+    outResult = LayoutLoadResult();
+    outResult.formatName = "OASIS";
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("cannot open %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const uchar* mapped = fileSize > kMagicLength ? file.map(0, fileSize) : nullptr;
+    if (!mapped || std::memcmp(mapped, kMagic, kMagicLength) != 0) {
+        error = QString("%1 is not an OASIS file").arg(filePath);
+        return false;
+    }
+
+    // Pass 1: split the top-level stream into raw runs and CBLOCKs.
+    OasisParser scanner(false);
+    scanner.setFileBegin(mapped);
+    OasisByteReader fileReader(mapped + kMagicLength, mapped + fileSize, kMagicLength);
+    if (!scanner.parse(fileReader, error)) {
+        return false;
+    }
+    if (!scanner.sawEnd()) {
+        error = QString("%1 is missing the END record").arg(filePath);
+        return false;
+    }
+
+    // Pass 2: build cells in stream order (modal state spans
+    // segments) on one task while the others inflate the CBLOCKs just
+    // ahead of it; each inflated buffer is freed once it has been built.
+    QVector<OasisSegment>& segments = scanner.segments();
+    OasisInflateQueue inflateQueue(segments);
+    OasisParser builder(true);
+    bool built = false;
+    const int helperTasks = std::min(inflateQueue.compressedCount(), OasisInflateQueue::kInflateWindow);
+    LayoutFileLoader::runParallel(1 + helperTasks, [&](const int task) {
+        if (task > 0) {
+            inflateQueue.inflateAhead();
+            return true;
+        }
+
+        // Tasks are claimed in index order, so the builder always runs.
+        int compressedIndex = 0;
+        for (OasisSegment& segment : segments) {
+            const uchar* begin = segment.begin;
+            const uchar* end = segment.end;
+            if (segment.compressed) {
+                if (!inflateQueue.acquire(compressedIndex, error)) {
+                    inflateQueue.stop();
+                    return false;
+                }
+                begin = reinterpret_cast<const uchar*>(segment.inflated.constData());
+                end = begin + segment.inflated.size();
+            }
+
+            // Offsets inside a CBLOCK are relative to its inflated data.
+            OasisByteReader reader(begin, end, segment.compressed ? 0 : segment.offset);
+            if (!builder.parse(reader, error)) {
+                if (segment.compressed) {
+                    error = QString("%1 (inside CBLOCK at offset %2)").arg(error).arg(segment.offset);
+                }
+                inflateQueue.stop();
+                return false;
+            }
+
+            if (segment.compressed) {
+                inflateQueue.release(compressedIndex++);
+            }
+        }
+        inflateQueue.stop();
+        built = true;
+        return true;
+    });
+    if (!built) {
+        return false;
+    }
+
+    QVector<LayoutDecodedCell> cells;
+    qint64 skippedOutsideCells = 0;
+    if (!builder.finish(cells, skippedOutsideCells, error)) {
+        return false;
+    }
+
+    outResult.userUnitsPerDatabaseUnit = 1.0 / scanner.unitsPerMicron();
+    outResult.metersPerDatabaseUnit = 1e-6 / scanner.unitsPerMicron();
+    outResult.skippedElementCount = skippedOutsideCells;
+    return LayoutFileLoader::linkCells(cells, outResult, error);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+
+struct LayoutLoadResult;
+
+// OasisStreamReader loads OASIS files into scene nodes.
+//
+// Loading runs in two passes over the memory-mapped file:
+//  1. Scan: top-level records are walked without building anything, and the
+//     stream is split into raw runs and CBLOCK payloads.
+//  2. Build: the runs and CBLOCKs are parsed in file order, since OASIS
+//     modal variables carry state from one record to the next. Meanwhile
+//     the LayoutFileLoader worker pool inflates (raw DEFLATE) the next few
+//     CBLOCKs; each block's data is freed once parsed.
+//
+// Repetitions stay compact: a shape or placement with a grid repetition
+// (types 1-3, 8, 9) becomes one InstanceObjectModel array; irregular
+// repetitions (types 4-7, 10, 11) are expanded per position.
+//
+// Mapping:
+//  - RECTANGLE            -> RectangleObjectModel
+//  - POLYGON / TRAPEZOID  -> PolygonObjectModel
+//  - PATH                 -> PathObjectModel
+//  - PLACEMENT            -> InstanceObjectModel (linked after the build pass)
+//  - TEXT, CTRAPEZOID, CIRCLE, XGEOMETRY -> skipped (counted)
+//
+// Layer/datatype numbers map to layerNameId/layerTypeId as for GDSII.
+namespace OasisStreamReader {
+
+constexpr char kMagic[] = "%SEMI-OASIS\r\n";
+constexpr int kMagicLength = sizeof(kMagic) - 1;
+
+bool loadFile(const QString& filePath, LayoutLoadResult& outResult, QString& error);
+
+}
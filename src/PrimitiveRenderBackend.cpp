@@ -0,0 +1,216 @@
+#include "PrimitiveRenderBackend.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QPen>
+#include <QPointF>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+quint64 layerCodeKey(quint32 nameId, quint32 typeId) {
+    return (static_cast<quint64>(nameId) << 32) | static_cast<quint64>(typeId);
+}
+
+}
+
+QBrush patternBrushFor(QColor baseColor, const QString& pattern) {
+    bool ok = false;
+    const quint64 patternValue = static_cast<quint64>(pattern.toULongLong(&ok, 0));
+    if (!ok) {
+        return QBrush(baseColor, Qt::SolidPattern);
+    }
+
+    const int patternMag = 2;
+
+    QImage tile(8 * patternMag, 8 * patternMag, QImage::Format_ARGB32_Premultiplied);
+    tile.fill(Qt::transparent);
+    QPainter painter(&tile);
+    painter.setPen(baseColor);
+
+    for (int y = 0; y < (8 * patternMag); ++y) {
+        for (int x = 0; x < (8 * patternMag); ++x) {
+            const int bitIndex = ((y / patternMag) * 8) + (x / patternMag);
+            if ((patternValue >> bitIndex) & 0x1ULL) {
+                painter.drawPoint(x, y);
+            }
+        }
+    }
+
+    painter.end();
+    return QBrush(tile);
+}
+
+void drawGridWithPainter(QPainter& painter,
+                         const PrimitiveRenderBackend::GridParams& grid,
+                         const QSize& viewportSize) {
+    if (grid.stepPixels <= 0.0) {
+        return;
+    }
+
+    const double width = viewportSize.width();
+    const double height = viewportSize.height();
+    const int columns = static_cast<int>(std::ceil((width - grid.offsetX) / grid.stepPixels)) + 1;
+    const int rows = static_cast<int>(std::ceil((height - grid.offsetY) / grid.stepPixels)) + 1;
+
+    QVector<QPointF> points;
+    points.reserve(std::max(0, columns) * std::max(0, rows));
+    for (int column = 0; column < columns; ++column) {
+        const double screenX = grid.offsetX + (column * grid.stepPixels);
+        for (int row = 0; row < rows; ++row) {
+            points.push_back(QPointF(screenX, grid.offsetY + (row * grid.stepPixels)));
+        }
+    }
+
+    painter.setPen(QPen(grid.color, 1));
+    painter.drawPoints(points.constData(), points.size());
+
+    if (grid.originX >= 0.0 && grid.originX <= width) {
+        painter.drawLine(QPointF(grid.originX, 0.0), QPointF(grid.originX, height));
+    }
+
+    if (grid.originY >= 0.0 && grid.originY <= height) {
+        painter.drawLine(QPointF(0.0, grid.originY), QPointF(width, grid.originY));
+    }
+}
+
+void drawOverlayWithPainter(QPainter& painter, const QVector<PrimitiveRenderBackend::OverlayItem>& items) {
+    painter.setBrush(Qt::NoBrush);
+    for (const PrimitiveRenderBackend::OverlayItem& item : items) {
+        painter.setPen(QPen(item.color, item.lineWidth, item.dashed ? Qt::DashLine : Qt::SolidLine));
+        painter.drawLines(item.segments);
+    }
+}
+
+void RasterPrimitiveRenderBackend::beginFrame(QPainter& painter, const QColor& clearColor, const QSize& viewportSize) {
+    Q_UNUSED(viewportSize);
+    painter.fillRect(painter.viewport(), clearColor);
+}
+
+void RasterPrimitiveRenderBackend::drawGrid(QPainter& painter, const GridParams& grid, const QSize& viewportSize) {
+    drawGridWithPainter(painter, grid, viewportSize);
+}
+
+void RasterPrimitiveRenderBackend::drawPrimitives(QPainter& painter,
+                                                  const QVector<RenderItem>& items,
+                                                  const QSize& viewportSize) {
+    Q_UNUSED(viewportSize);
+    for (const RenderItem& item : items) {
+        if (item.detailLevel == 2 && item.tinyOnScreen) {
+            continue;
+        }
+
+        if (item.detailLevel == 0) {
+            painter.setPen(QPen(item.outlineColor, 1, item.preview ? Qt::DashLine : Qt::SolidLine));
+            painter.setBrush(item.patternBrush);
+        } else if (item.detailLevel == 1) {
+            painter.setPen(QPen(item.outlineColor, 0, Qt::NoPen));
+            painter.setBrush(QBrush(item.fillColor, Qt::SolidPattern));
+        } else {
+            painter.setPen(QPen(item.outlineColor, 0, Qt::NoPen));
+            QColor coarseFill = item.fillColor;
+            coarseFill.setAlpha(std::min(255, item.fillColor.alpha() + 50));
+            painter.setBrush(QBrush(coarseFill, Qt::SolidPattern));
+        }
+
+        painter.drawPolygon(item.polygon);
+    }
+}
+
+void RasterPrimitiveRenderBackend::drawOverlay(QPainter& painter,
+                                               const QVector<OverlayItem>& items,
+                                               const QSize& viewportSize) {
+    Q_UNUSED(viewportSize);
+    drawOverlayWithPainter(painter, items);
+}
+
+void RasterPrimitiveRenderBackend::endFrame(QPainter& painter, const QSize& viewportSize) {
+    Q_UNUSED(painter);
+    Q_UNUSED(viewportSize);
+}
+
+RenderItemBuilder::DetailLevel RenderItemBuilder::detailLevelForZoom(const double zoom) {
+    if (zoom < 0.30) {
+        return DetailLevel::Coarse;
+    }
+    if (zoom < 1.0) {
+        return DetailLevel::Simplified;
+    }
+    return DetailLevel::Detailed;
+}
+
+void RenderItemBuilder::setLayers(const QVector<LayerDefinition>& layers) {
+    m_layers = layers;
+    m_layerIndexByCode.clear();
+    m_fillBrushCache.clear();
+
+    // Lookup index is independent of palette order and optimized for ID-based queries.
+    for (int i = 0; i < m_layers.size(); ++i) {
+        m_layerIndexByCode.insert(layerCodeKey(m_layers[i].nameId, m_layers[i].typeId), i);
+    }
+}
+
+const LayerDefinition* RenderItemBuilder::layerForCode(const quint32 layerNameId, const quint32 layerTypeId) const {
+    const auto it = m_layerIndexByCode.constFind(layerCodeKey(layerNameId, layerTypeId));
+    if (it == m_layerIndexByCode.cend() || it.value() < 0 || it.value() >= m_layers.size()) {
+        return nullptr;
+    }
+
+    return &m_layers[it.value()];
+}
+
+QVector<PrimitiveRenderBackend::RenderItem> RenderItemBuilder::build(const QVector<SceneRenderPrimitive>& primitives,
+                                                                     const double zoom,
+                                                                     const double panX,
+                                                                     const double panY,
+                                                                     const DetailLevel detailLevel) {
+    QVector<PrimitiveRenderBackend::RenderItem> items;
+    items.reserve(primitives.size());
+
+    for (const SceneRenderPrimitive& primitive : primitives) {
+        const LayerDefinition* layer = layerForCode(primitive.layerNameId, primitive.layerTypeId);
+        if (!layer || !layer->visible || primitive.polygonVertices.isEmpty()) {
+            continue;
+        }
+
+        PrimitiveRenderBackend::RenderItem item;
+        item.polygon.reserve(primitive.polygonVertices.size());
+        for (const WorldPoint& vertex : primitive.polygonVertices) {
+            item.polygon.push_back(QPointF((static_cast<double>(vertex.x) * zoom) + panX,
+                                           panY - (static_cast<double>(vertex.y) * zoom)));
+        }
+
+        item.preview = primitive.preview;
+        item.detailLevel = detailLevel == DetailLevel::Detailed
+                               ? 0
+                               : detailLevel == DetailLevel::Simplified ? 1 : 2;
+        item.tinyOnScreen = item.polygon.boundingRect().width() < 1.0
+                            && item.polygon.boundingRect().height() < 1.0;
+
+        item.fillColor = layer->color;
+        item.fillColor.setAlpha(item.preview ? 90 : 140);
+
+        item.outlineColor = layer->color;
+        item.outlineColor.setAlpha(item.preview ? 180 : 220);
+
+        item.pattern = layer->pattern;
+        item.patternBrush = brushForFillColor(item.fillColor, layer->pattern);
+        items.push_back(std::move(item));
+    }
+
+    return items;
+}
+
+QBrush RenderItemBuilder::brushForFillColor(const QColor& fillColor, const QString& pattern) {
+    const QString cacheKey = QString("%1|%2").arg(fillColor.name(QColor::HexArgb), pattern);
+    const auto it = m_fillBrushCache.constFind(cacheKey);
+    if (it != m_fillBrushCache.cend()) {
+        return it.value();
+    }
+
+    const QBrush brush = patternBrushFor(fillColor, pattern);
+    m_fillBrushCache.insert(cacheKey, brush);
+    return brush;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <QBrush>
+#include <QColor>
+#include <QHash>
+#include <QLineF>
+#include <QPolygonF>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "LayerManager.h"
+#include "LayoutGeometry.h"
+
+class QPainter;
+
+// Fill brush for a layer swatch or shape: baseColor, stippled with the
+// layer's 64-bit pattern token when it parses. The stipple tile is a QImage,
+// so brushes can be built without a GUI application (batch export).
+QBrush patternBrushFor(QColor baseColor, const QString& pattern);
+
+// PrimitiveRenderBackend draws one frame of screen-space items. The canvas
+// picks the OpenGL or raster implementation; offscreen export
+// (LayoutImageExporter) always uses the raster one on a QImage.
+class PrimitiveRenderBackend {
+public:
+    virtual ~PrimitiveRenderBackend() = default;
+
+    struct RenderItem {
+        QPolygonF polygon;
+        QColor fillColor;
+        QColor outlineColor;
+        QBrush patternBrush;
+        QString pattern;
+        bool preview{false};
+        bool tinyOnScreen{false};
+        int detailLevel{0};
+    };
+
+    // World-anchored dot grid expressed in screen space. Grid points sit at
+    // offset + k * step on each axis; the axes pass through origin.
+    struct GridParams {
+        double stepPixels{0.0};
+        double offsetX{0.0};
+        double offsetY{0.0};
+        double originX{0.0};
+        double originY{0.0};
+        QColor color;
+    };
+
+    virtual void beginFrame(QPainter& painter, const QColor& clearColor, const QSize& viewportSize) = 0;
+
+    virtual void drawGrid(QPainter& painter, const GridParams& grid, const QSize& viewportSize) = 0;
+
+    // Lightweight per-frame decoration (selection/hover outlines) drawn on
+    // top of the geometry pass. Overlay changes never touch cached geometry.
+    struct OverlayItem {
+        QVector<QLineF> segments;
+        QColor color;
+        bool dashed{false};
+        int lineWidth{1};
+    };
+
+    virtual void drawPrimitives(QPainter& painter,
+                                const QVector<RenderItem>& items,
+                                const QSize& viewportSize) = 0;
+
+    virtual void drawOverlay(QPainter& painter,
+                             const QVector<OverlayItem>& items,
+                             const QSize& viewportSize) = 0;
+
+    virtual void endFrame(QPainter& painter, const QSize& viewportSize) = 0;
+};
+
+// Painter grid path shared by the raster backend and the GL fallback. All
+// points are submitted in a single drawPoints() call.
+void drawGridWithPainter(QPainter& painter,
+                         const PrimitiveRenderBackend::GridParams& grid,
+                         const QSize& viewportSize);
+
+void drawOverlayWithPainter(QPainter& painter, const QVector<PrimitiveRenderBackend::OverlayItem>& items);
+
+class RasterPrimitiveRenderBackend final : public PrimitiveRenderBackend {
+public:
+    void beginFrame(QPainter& painter, const QColor& clearColor, const QSize& viewportSize) override;
+    void drawGrid(QPainter& painter, const GridParams& grid, const QSize& viewportSize) override;
+    void drawPrimitives(QPainter& painter,
+                        const QVector<RenderItem>& items,
+                        const QSize& viewportSize) override;
+    void drawOverlay(QPainter& painter,
+                     const QVector<OverlayItem>& items,
+                     const QSize& viewportSize) override;
+    void endFrame(QPainter& painter, const QSize& viewportSize) override;
+};
+
+// RenderItemBuilder turns scene primitives into the items a backend draws:
+// palette lookup by layer code, fill and outline colors, detail level and
+// cached stipple brushes. The canvas and offscreen export share it, so an
+// exported image matches the canvas at the same zoom.
+class RenderItemBuilder {
+public:
+    enum class DetailLevel {
+        Detailed,
+        Simplified,
+        Coarse
+    };
+
+    // Detail level the canvas uses at zoom screen pixels per database unit.
+    static DetailLevel detailLevelForZoom(double zoom);
+
+    void setLayers(const QVector<LayerDefinition>& layers);
+    // Palette entry for a layer code, or null when the palette has none.
+    const LayerDefinition* layerForCode(quint32 layerNameId, quint32 layerTypeId) const;
+
+    // Maps world (x, y) to screen (x * zoom + panX, panY - y * zoom).
+    // Primitives on hidden or unknown layers are skipped.
+    QVector<PrimitiveRenderBackend::RenderItem> build(const QVector<SceneRenderPrimitive>& primitives,
+                                                      double zoom,
+                                                      double panX,
+                                                      double panY,
+                                                      DetailLevel detailLevel);
+
+private:
+    QBrush brushForFillColor(const QColor& fillColor, const QString& pattern);
+
+    QVector<LayerDefinition> m_layers;
+    QHash<quint64, int> m_layerIndexByCode;
+    QHash<QString, QBrush> m_fillBrushCache;
+};
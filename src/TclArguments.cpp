@@ -0,0 +1,18 @@
+#include "TclArguments.h"
+
+#include <QString>
+
+namespace TclArguments {
+
+bool parseInt64(Tcl_Interp* interp, Tcl_Obj* obj, qint64& value, const char* fieldName) {
+    Tcl_WideInt raw = 0;
+    if (Tcl_GetWideIntFromObj(interp, obj, &raw) != TCL_OK) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(QString("invalid %1").arg(fieldName).toUtf8().constData(), -1));
+        return false;
+    }
+
+    value = static_cast<qint64>(raw);
+    return true;
+}
+
+}
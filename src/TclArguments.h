@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QtGlobal>
+#include <tcl.h>
+
+// Argument parsing shared by the Tcl command modules. On failure the
+// interpreter result is set to "invalid <fieldName>".
+namespace TclArguments {
+
+bool parseInt64(Tcl_Interp* interp, Tcl_Obj* obj, qint64& value, const char* fieldName);
+
+}
@@ -0,0 +1,168 @@
+#include "TclBatchRunner.h"
+
+#include "TclDocumentCommands.h"
+#include "TclLayerCommands.h"
+#include "TclSceneCommands.h"
+
+#include <cstdio>
+
+TclBatchRunner::TclBatchRunner()
+    : m_interp(Tcl_CreateInterp()) {
+    Tcl_CreateObjCommand(m_interp, "layer", &TclBatchRunner::LayerCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "layout", &TclBatchRunner::LayoutCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "edit", &TclBatchRunner::EditCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "transaction", &TclBatchRunner::TransactionCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "shape", &TclBatchRunner::ShapeCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "query", &TclBatchRunner::QueryCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "view", &TclBatchRunner::ViewCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "app", &TclBatchRunner::AppCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "exit", &TclBatchRunner::ExitCommandBridge, this, nullptr);
+
+    // The null view: GUI configuration is ignored, interaction has nothing
+    // to act on.
+    for (const char* name : {"tool", "bindkey", "transcript"}) {
+        Tcl_CreateObjCommand(m_interp, name, &TclBatchRunner::IgnoredCommandBridge, this, nullptr);
+    }
+    for (const char* name : {"canvas", "select"}) {
+        Tcl_CreateObjCommand(m_interp, name, &TclBatchRunner::NoViewCommandBridge, this, nullptr);
+    }
+}
+
+TclBatchRunner::~TclBatchRunner() {
+    if (m_interp) {
+        Tcl_DeleteInterp(m_interp);
+        m_interp = nullptr;
+    }
+}
+
+int TclBatchRunner::run(const QString& scriptPath, const QStringList& arguments) {
+    Tcl_Obj* argv = Tcl_NewListObj(0, nullptr);
+    for (const QString& argument : arguments) {
+        Tcl_ListObjAppendElement(m_interp, argv, Tcl_NewStringObj(argument.toUtf8().constData(), -1));
+    }
+    const QByteArray path = scriptPath.toUtf8();
+    Tcl_SetVar2Ex(m_interp, "argv0", nullptr, Tcl_NewStringObj(path.constData(), -1), TCL_GLOBAL_ONLY);
+    Tcl_SetVar2Ex(m_interp, "argv", nullptr, argv, TCL_GLOBAL_ONLY);
+    Tcl_SetVar2Ex(m_interp, "argc", nullptr, Tcl_NewIntObj(arguments.size()), TCL_GLOBAL_ONLY);
+
+    const int rc = Tcl_EvalFile(m_interp, path.constData());
+    if (m_exitRequested) {
+        return m_exitCode;
+    }
+    if (rc != TCL_OK && rc != TCL_RETURN) {
+        const char* errorInfo = Tcl_GetVar(m_interp, "errorInfo", TCL_GLOBAL_ONLY);
+        std::fprintf(stderr, "%s\n", errorInfo ? errorInfo : Tcl_GetStringResult(m_interp));
+        return 1;
+    }
+    return 0;
+}
+
+int TclBatchRunner::LayerCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclBatchRunner*>(clientData)->handleLayerCommand(interp, objc, objv);
+}
+
+int TclBatchRunner::LayoutCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return TclDocumentCommands::evaluateLayout(interp, objc, objv, &static_cast<TclBatchRunner*>(clientData)->m_document);
+}
+
+int TclBatchRunner::EditCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return TclDocumentCommands::evaluateEdit(interp, objc, objv, &static_cast<TclBatchRunner*>(clientData)->m_document);
+}
+
+int TclBatchRunner::TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return TclDocumentCommands::evaluateTransaction(interp, objc, objv, &static_cast<TclBatchRunner*>(clientData)->m_document);
+}
+
+int TclBatchRunner::ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclBatchRunner*>(clientData)->handleShapeCommand(interp, objc, objv);
+}
+
+int TclBatchRunner::QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    auto* runner = static_cast<TclBatchRunner*>(clientData);
+    const TclSceneCommands::Context context{runner->m_document.rootCell(), &runner->m_layers};
+    return TclSceneCommands::evaluateQuery(interp, objc, objv, context);
+}
+
+// Only `view export`, which renders offscreen; the rest needs a view.
+int TclBatchRunner::ViewCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    if (objc < 2 || QString::fromUtf8(Tcl_GetString(objv[1])) != "export") {
+        return NoViewCommandBridge(clientData, interp, objc, objv);
+    }
+
+    auto* runner = static_cast<TclBatchRunner*>(clientData);
+    const TclSceneCommands::Context context{runner->m_document.rootCell(), &runner->m_layers};
+    return TclSceneCommands::evaluateViewExport(interp, objc, objv, context);
+}
+
+int TclBatchRunner::AppCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclBatchRunner*>(clientData)->handleAppCommand(interp, objc, objv);
+}
+
+int TclBatchRunner::ExitCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclBatchRunner*>(clientData)->requestExit(interp, objc, objv);
+}
+
+int TclBatchRunner::IgnoredCommandBridge(ClientData, Tcl_Interp* interp, int, Tcl_Obj* const[]) {
+    Tcl_ResetResult(interp);
+    return TCL_OK;
+}
+
+int TclBatchRunner::NoViewCommandBridge(ClientData, Tcl_Interp* interp, int, Tcl_Obj* const objv[]) {
+    Tcl_SetObjResult(interp,
+                     Tcl_NewStringObj(QString("%1: no view in batch mode").arg(Tcl_GetString(objv[0])).toUtf8().constData(), -1));
+    return TCL_ERROR;
+}
+
+int TclBatchRunner::handleLayerCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    TclLayerCommands::Context context;
+    context.layerManager = &m_layerManager;
+    context.layers = &m_layers;
+    context.activeLayerName = &m_activeLayerName;
+    context.activeLayerType = &m_activeLayerType;
+    context.layersLoaded = [this]() {
+        m_layers = m_layerManager.layers();
+        m_activeLayerName = m_layerManager.activeLayerName();
+        m_activeLayerType = m_layerManager.activeLayerType();
+    };
+    return TclLayerCommands::evaluateLayer(interp, objc, objv, context);
+}
+
+int TclBatchRunner::handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    const TclSceneCommands::Context context{m_document.rootCell(), &m_layers};
+    QVector<std::shared_ptr<LayoutObjectModel>> created;
+    if (TclSceneCommands::evaluateShape(interp, objc, objv, context, created) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    m_document.addObjects(std::move(created));
+    return TCL_OK;
+}
+
+int TclBatchRunner::handleAppCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    if (objc < 2 || QString::fromUtf8(Tcl_GetString(objv[1])) != "exit") {
+        Tcl_SetResult(interp, const_cast<char*>("usage: app exit ?<code>?"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return requestExit(interp, objc - 1, objv + 1);
+}
+
+int TclBatchRunner::requestExit(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    int code = 0;
+    if (objc == 2) {
+        if (Tcl_GetIntFromObj(interp, objv[1], &code) != TCL_OK) {
+            Tcl_SetResult(interp, const_cast<char*>("invalid code"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+    } else if (objc != 1) {
+        Tcl_SetResult(interp, const_cast<char*>("usage: exit ?<code>?"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    // Unlike Tcl's own `exit`, this returns through run(), so the document
+    // and its autosave journal are torn down normally. Unwinding cannot be
+    // caught by the script.
+    m_exitRequested = true;
+    m_exitCode = code;
+    Tcl_CancelEval(interp, nullptr, nullptr, TCL_CANCEL_UNWIND);
+    Tcl_SetResult(interp, const_cast<char*>("exit"), TCL_STATIC);
+    return TCL_ERROR;
+}
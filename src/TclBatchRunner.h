@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <tcl.h>
+
+#include "LayerManager.h"
+#include "LayoutDocument.h"
+
+// TclBatchRunner evaluates one Tcl script against a single document with no
+// windows, widgets or GL context: `layout2 -batch <script> ?<arg> ...?`, for
+// CI, regression and export jobs on servers without a display.
+//
+// The script gets the document-level command families of the console
+// (`layout`, `edit`, `transaction`, `shape`, `query`) through the same
+// implementations, plus `layer` on the runner's own palette. There is no
+// view: `tool`, `bindkey` and `transcript` only configure the GUI and are
+// accepted and ignored, so shared setup scripts can be sourced, while
+// `canvas`, `select` and every `view` subcommand but `export` (rendered
+// offscreen) fail. `exit ?<code>?` and `app exit` end the
+// script and set the exit status.
+class TclBatchRunner {
+public:
+    TclBatchRunner();
+    ~TclBatchRunner();
+    TclBatchRunner(const TclBatchRunner&) = delete;
+    TclBatchRunner& operator=(const TclBatchRunner&) = delete;
+
+    // Evaluates scriptPath with argv0, argv and argc set as tclsh does.
+    // Returns the process exit status: 0 on success, the code given to
+    // `app exit`, or 1 after an error, whose trace is written to stderr.
+    int run(const QString& scriptPath, const QStringList& arguments);
+
+private:
+    static int LayerCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int LayoutCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int EditCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ViewCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int AppCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ExitCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int IgnoredCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int NoViewCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+
+    int handleLayerCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleAppCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    // `exit ?<code>?`, also reached as `app exit`.
+    int requestExit(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+
+    Tcl_Interp* m_interp;
+    // Parses `layer load` files; commands use the runner's palette below,
+    // as the console uses an editor's.
+    LayerManager m_layerManager;
+    QVector<LayerDefinition> m_layers;
+    QString m_activeLayerName;
+    QString m_activeLayerType;
+    LayoutDocument m_document;
+    // Set by `exit`, which unwinds the script with Tcl_CancelEval.
+    bool m_exitRequested{false};
+    int m_exitCode{0};
+};
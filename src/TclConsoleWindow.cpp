@@ -1,23 +1,48 @@
 #include "TclConsoleWindow.h"
 
 #include "LayoutSceneModel.h"
+#include "TclArguments.h"
+#include "TclDocumentCommands.h"
+#include "TclLayerCommands.h"
+#include "TclSceneCommands.h"
+#include "TclScriptWorker.h"
 
-#include <QCoreApplication>
 #include <QAction>
 #include <QCloseEvent>
-#include <QDir>
 #include <QEvent>
 #include <QFontDatabase>
 #include <QKeyEvent>
 #include <QLineEdit>
 #include <QMenuBar>
 #include <QPlainTextEdit>
-#include <QRegularExpression>
+#include <QStatusBar>
 #include <QVBoxLayout>
 #include <QWidget>
 
+#include <algorithm>
 #include <limits>
 
+namespace {
+
+// Tcl command each CanvasEventCommand::Kind stands for.
+struct CanvasEventSpec {
+    const char* command;
+    const char* subCommand;
+    int argumentCount;
+    // Bit i is set when argument i is passed as an integer.
+    unsigned integerArguments;
+};
+
+constexpr CanvasEventSpec kCanvasEventSpecs[CanvasEventCommand::kKindCount] = {
+    {"canvas", "press", 3, 0x7},
+    {"canvas", "move", 3, 0x7},
+    {"canvas", "release", 3, 0x7},
+    {"view", "pan", 2, 0x0},
+    {"view", "zoom", 3, 0x1},
+};
+
+}
+
 TclConsoleWindow::TclConsoleWindow(QWidget* parent)
     : QMainWindow(parent),
       m_output(new QPlainTextEdit(this)),
@@ -49,6 +74,28 @@ TclConsoleWindow::TclConsoleWindow(QWidget* parent)
     Tcl_CreateObjCommand(m_interp, "bindkey", &TclConsoleWindow::BindKeyCommandBridge, this, nullptr);
     Tcl_CreateObjCommand(m_interp, "transcript", &TclConsoleWindow::TranscriptCommandBridge, this, nullptr);
     Tcl_CreateObjCommand(m_interp, "app", &TclConsoleWindow::AppCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "select", &TclConsoleWindow::SelectCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "layout", &TclConsoleWindow::LayoutCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "edit", &TclConsoleWindow::EditCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "transaction", &TclConsoleWindow::TransactionCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "shape", &TclConsoleWindow::ShapeCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "query", &TclConsoleWindow::QueryCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(m_interp, "script", &TclConsoleWindow::ScriptCommandBridge, this, nullptr);
+
+    // Canvas events reuse these words, so Tcl resolves each command once and
+    // caches it on the word.
+    for (int kind = 0; kind < CanvasEventCommand::kKindCount; ++kind) {
+        for (int word = 0; word < 2; ++word) {
+            const CanvasEventSpec& spec = kCanvasEventSpecs[kind];
+            m_canvasEventWords[kind][word] = Tcl_NewStringObj(word == 0 ? spec.command : spec.subCommand, -1);
+            Tcl_IncrRefCount(m_canvasEventWords[kind][word]);
+        }
+    }
+    for (Tcl_Obj*& argument : m_canvasEventArguments) {
+        argument = Tcl_NewObj();
+        Tcl_IncrRefCount(argument);
+    }
+    m_canvasEventSuppression.fill(-1);
 
     auto* fileMenu = menuBar()->addMenu("File");
     auto* exitAction = fileMenu->addAction("Exit");
@@ -78,6 +125,18 @@ TclConsoleWindow::TclConsoleWindow(QWidget* parent)
 }
 
 TclConsoleWindow::~TclConsoleWindow() {
+    // Stops a running script; its unapplied shapes are dropped.
+    m_scriptWorker.reset();
+
+    for (auto& words : m_canvasEventWords) {
+        for (Tcl_Obj* word : words) {
+            Tcl_DecrRefCount(word);
+        }
+    }
+    for (Tcl_Obj* argument : m_canvasEventArguments) {
+        Tcl_DecrRefCount(argument);
+    }
+
     if (m_interp) {
         Tcl_DeleteInterp(m_interp);
         m_interp = nullptr;
@@ -212,6 +271,77 @@ void TclConsoleWindow::executeEditorCommand(const int editorId, const QString& c
     (void)evaluateCommandForEditor(command, true, true, true, editorId, requestActivation);
 }
 
+void TclConsoleWindow::executeEditorCanvasEvent(const int editorId,
+                                                const CanvasEventCommand& event,
+                                                const bool requestActivation) {
+    const int previousCommandEditorId = m_sessionController.commandEditorId();
+    m_sessionController.setCommandEditorId(editorId);
+    if (requestActivation && editorId > 0) {
+        const QString activateCommand = QString("app editor active %1").arg(editorId);
+        (void)evaluateCommand(activateCommand, true, false, false);
+    }
+
+    (void)evaluateCanvasEvent(event);
+    m_sessionController.setCommandEditorId(previousCommandEditorId);
+}
+
+int TclConsoleWindow::evaluateCanvasEvent(const CanvasEventCommand& event) {
+    const int kind = static_cast<int>(event.kind);
+    const CanvasEventSpec& spec = kCanvasEventSpecs[kind];
+
+    Tcl_Obj* objv[2 + CanvasEventCommand::kMaxArguments];
+    objv[0] = m_canvasEventWords[kind][0];
+    objv[1] = m_canvasEventWords[kind][1];
+    for (int i = 0; i < spec.argumentCount; ++i) {
+        Tcl_Obj*& argument = m_canvasEventArguments[i];
+        if (Tcl_IsShared(argument)) {
+            // A script kept the previous value; leave that object to it.
+            Tcl_DecrRefCount(argument);
+            argument = Tcl_NewObj();
+            Tcl_IncrRefCount(argument);
+        }
+        if (spec.integerArguments & (1u << i)) {
+            Tcl_SetWideIntObj(argument, static_cast<Tcl_WideInt>(event.arguments[i]));
+        } else {
+            Tcl_SetDoubleObj(argument, event.arguments[i]);
+        }
+        objv[2 + i] = argument;
+    }
+    const int objc = 2 + spec.argumentCount;
+
+    // The command text is only built when it may reach the transcript; the
+    // default filters suppress every canvas event.
+    if (m_canvasEventSuppression[kind] < 0) {
+        const QString prefix = QString("%1 %2 ").arg(spec.command, spec.subCommand);
+        m_canvasEventSuppression[kind] = m_transcriptFilters.matchesAllWithPrefix(prefix) ? 1 : 0;
+    }
+    bool suppressEcho = m_canvasEventSuppression[kind] == 1;
+    if (!suppressEcho) {
+        QStringList words;
+        for (int i = 0; i < objc; ++i) {
+            words.push_back(QString::fromUtf8(Tcl_GetString(objv[i])));
+        }
+        const QString command = words.join(' ');
+        suppressEcho = shouldSuppressTranscriptCommand(command);
+        if (!suppressEcho) {
+            appendTranscript(QString("> %1").arg(command));
+        }
+    }
+
+    const int rc = Tcl_EvalObjv(m_interp, objc, objv, 0);
+    if (!suppressEcho || rc != TCL_OK) {
+        const QString result = QString::fromUtf8(Tcl_GetStringResult(m_interp));
+        if (!result.isEmpty()) {
+            appendTranscript(result);
+        }
+    }
+    if (rc != TCL_OK) {
+        appendTranscript(QString("ERROR (%1)").arg(rc));
+    }
+
+    return rc;
+}
+
 EditorSession* TclConsoleWindow::sessionById(const int editorId) {
     return m_sessionController.sessionById(editorId);
 }
@@ -240,11 +370,14 @@ void TclConsoleWindow::applySessionToWindow(EditorSession& session) {
     m_sessionController.applySessionToWindow(session);
 }
 
-int TclConsoleWindow::createEditorSession(const bool activate) {
-    auto* window = new LayoutEditorWindow(this);
+int TclConsoleWindow::createEditorSession(const bool activate, std::shared_ptr<LayoutDocument> document) {
+    if (!document) {
+        document = std::make_shared<LayoutDocument>();
+    }
+    auto* window = new LayoutEditorWindow(document, this);
     window->setAttribute(Qt::WA_DeleteOnClose, true);
 
-    const int editorId = m_sessionController.createSession(window);
+    const int editorId = m_sessionController.createSession(window, std::move(document));
     EditorSession* session = sessionById(editorId);
     if (!session) {
         return 0;
@@ -258,6 +391,11 @@ int TclConsoleWindow::createEditorSession(const bool activate) {
                 executeEditorCommand(editorId, command, requestActivation);
             });
 
+    connect(window, &LayoutEditorWindow::canvasEventRequested,
+            this, [this, editorId](const CanvasEventCommand& event, const bool requestActivation) {
+                executeEditorCanvasEvent(editorId, event, requestActivation);
+            });
+
     connect(window, &LayoutEditorWindow::activationRequested,
             this, [this, editorId]() {
                 setActiveEditor(editorId);
@@ -299,16 +437,7 @@ void TclConsoleWindow::refreshEditorWindowTitles() {
 }
 
 bool TclConsoleWindow::shouldSuppressTranscriptCommand(const QString& command) const {
-    for (const QString& pattern : m_transcriptFilters) {
-        const QRegularExpression regex(
-            QRegularExpression::wildcardToRegularExpression(pattern),
-            QRegularExpression::CaseInsensitiveOption);
-        if (regex.match(command).hasMatch()) {
-            return true;
-        }
-    }
-
-    return false;
+    return m_transcriptFilters.matches(command);
 }
 
 int TclConsoleWindow::LayerCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
@@ -339,15 +468,32 @@ int TclConsoleWindow::AppCommandBridge(ClientData clientData, Tcl_Interp* interp
     return static_cast<TclConsoleWindow*>(clientData)->handleAppCommand(interp, objc, objv);
 }
 
-bool TclConsoleWindow::parseInt64(Tcl_Interp* interp, Tcl_Obj* obj, qint64& value, const char* fieldName) {
-    Tcl_WideInt raw = 0;
-    if (Tcl_GetWideIntFromObj(interp, obj, &raw) != TCL_OK) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(QString("invalid %1").arg(fieldName).toUtf8().constData(), -1));
-        return false;
-    }
+int TclConsoleWindow::SelectCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleSelectCommand(interp, objc, objv);
+}
 
-    value = static_cast<qint64>(raw);
-    return true;
+int TclConsoleWindow::LayoutCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleLayoutCommand(interp, objc, objv);
+}
+
+int TclConsoleWindow::EditCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleEditCommand(interp, objc, objv);
+}
+
+int TclConsoleWindow::TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleTransactionCommand(interp, objc, objv);
+}
+
+int TclConsoleWindow::ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleShapeCommand(interp, objc, objv);
+}
+
+int TclConsoleWindow::QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleQueryCommand(interp, objc, objv);
+}
+
+int TclConsoleWindow::ScriptCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclConsoleWindow*>(clientData)->handleScriptCommand(interp, objc, objv);
 }
 
 bool TclConsoleWindow::parseDouble(Tcl_Interp* interp, Tcl_Obj* obj, double& value, const char* fieldName) {
@@ -379,8 +525,8 @@ int TclConsoleWindow::handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_
             return TCL_ERROR;
         }
 
-        if (!m_transcriptFilters.contains(pattern, Qt::CaseInsensitive)) {
-            m_transcriptFilters.push_back(pattern);
+        if (m_transcriptFilters.add(pattern)) {
+            m_canvasEventSuppression.fill(-1);
         }
 
         Tcl_SetObjResult(interp, Tcl_NewStringObj(QString("added transcript filter: %1").arg(pattern).toUtf8().constData(), -1));
@@ -394,7 +540,8 @@ int TclConsoleWindow::handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_
         }
 
         const QString pattern = QString::fromUtf8(Tcl_GetString(objv[3]));
-        const int removed = m_transcriptFilters.removeAll(pattern);
+        const int removed = m_transcriptFilters.remove(pattern);
+        m_canvasEventSuppression.fill(-1);
         Tcl_SetObjResult(interp, Tcl_NewIntObj(removed));
         return TCL_OK;
     }
@@ -406,7 +553,7 @@ int TclConsoleWindow::handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_
         }
 
         Tcl_Obj* list = Tcl_NewListObj(0, nullptr);
-        for (const QString& pattern : m_transcriptFilters) {
+        for (const QString& pattern : m_transcriptFilters.patterns()) {
             Tcl_ListObjAppendElement(interp, list, Tcl_NewStringObj(pattern.toUtf8().constData(), -1));
         }
         Tcl_SetObjResult(interp, list);
@@ -420,6 +567,7 @@ int TclConsoleWindow::handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_
         }
 
         m_transcriptFilters.clear();
+        m_canvasEventSuppression.fill(-1);
         return TCL_OK;
     }
 
@@ -429,7 +577,7 @@ int TclConsoleWindow::handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_
 
 int TclConsoleWindow::handleAppCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
     if (objc < 2) {
-        Tcl_SetResult(interp, const_cast<char*>("usage: app <exit|layout_editor|editor ...>"), TCL_STATIC);
+        Tcl_SetResult(interp, const_cast<char*>("usage: app <exit|layout_editor ?-share <editorId>?|editor ...>"), TCL_STATIC);
         return TCL_ERROR;
     }
 
@@ -442,12 +590,26 @@ int TclConsoleWindow::handleAppCommand(Tcl_Interp* interp, int objc, Tcl_Obj* co
     }
 
     if (subCommand == "layout_editor") {
-        if (objc != 2) {
-            Tcl_SetResult(interp, const_cast<char*>("usage: app layout_editor"), TCL_STATIC);
+        static const char* const kLayoutEditorUsage = "usage: app layout_editor ?-share <editorId>?";
+        std::shared_ptr<LayoutDocument> document;
+        if (objc == 4 && QString::fromUtf8(Tcl_GetString(objv[2])) == "-share") {
+            int sharedEditorId = 0;
+            if (Tcl_GetIntFromObj(interp, objv[3], &sharedEditorId) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            const EditorSession* sharedSession = sessionById(sharedEditorId);
+            if (!sharedSession) {
+                Tcl_SetObjResult(interp,
+                                 Tcl_NewStringObj(QString("unknown editorId: %1").arg(sharedEditorId).toUtf8().constData(), -1));
+                return TCL_ERROR;
+            }
+            document = sharedSession->document;
+        } else if (objc != 2) {
+            Tcl_SetResult(interp, const_cast<char*>(kLayoutEditorUsage), TCL_STATIC);
             return TCL_ERROR;
         }
 
-        const int editorId = createEditorSession(true);
+        const int editorId = createEditorSession(true, std::move(document));
         EditorSession* session = sessionById(editorId);
         if (session && session->window) {
             // Center the world origin in the canvas whenever an editor is opened.
@@ -582,167 +744,28 @@ int TclConsoleWindow::handleBindKeyCommand(Tcl_Interp* interp, int objc, Tcl_Obj
 }
 
 int TclConsoleWindow::handleLayerCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
-    if (objc < 2) {
-        Tcl_SetResult(interp, const_cast<char*>("usage: layer <list|load|configure|active> ..."), TCL_STATIC);
-        return TCL_ERROR;
-    }
-
-    const QString subCommand = QString::fromUtf8(Tcl_GetString(objv[1]));
     EditorSession* session = effectiveSession();
-
-    if (subCommand == "list") {
-        if (!session) {
-            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        QString out;
-        for (const LayerDefinition& layer : session->layers) {
-            const bool isActive = layer.name.compare(session->activeLayerName, Qt::CaseInsensitive) == 0
-                                  && layer.type.compare(session->activeLayerType, Qt::CaseInsensitive) == 0;
-            out += QString("%1 {%2} %3/%4 %5 %6 %7 %8\n")
-                       .arg(layer.name, layer.type)
-                       .arg(layer.nameId)
-                       .arg(layer.typeId)
-                       .arg(layer.color.name(), layer.pattern)
-                       .arg(layer.visible ? "visible" : "hidden")
-                       .arg(layer.selectable ? "selectable" : "locked")
-                       .arg(isActive ? "active" : "inactive");
-        }
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(out.trimmed().toUtf8().constData(), -1));
-        return TCL_OK;
-    }
-
-    if (subCommand == "load") {
-        if (objc != 3) {
-            Tcl_SetResult(interp, const_cast<char*>("usage: layer load <filePath>"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        const QString rawPath = QString::fromUtf8(Tcl_GetString(objv[2]));
-        const QString path = QDir::isAbsolutePath(rawPath)
-                                 ? rawPath
-                                 : QDir(QCoreApplication::applicationDirPath()).filePath(rawPath);
-
-        QString error;
-        if (!m_layerManager.loadLayersFromFile(path, error)) {
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
-            return TCL_ERROR;
-        }
-
+    TclLayerCommands::Context context;
+    context.layerManager = &m_layerManager;
+    // A new file resets every editor's palette, not just the active one.
+    context.layersLoaded = [this]() {
         for (auto it = m_sessionController.sessions().begin(); it != m_sessionController.sessions().end(); ++it) {
             initializeSessionLayers(it.value());
             applySessionToWindow(it.value());
         }
-
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(
-            QString("loaded %1 layers from %2").arg(m_layerManager.layers().size()).arg(path).toUtf8().constData(), -1));
-        return TCL_OK;
-    }
-
-    if (subCommand == "active") {
-        if (!session) {
-            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        if (objc == 2) {
-            Tcl_Obj* pair = Tcl_NewListObj(0, nullptr);
-            Tcl_ListObjAppendElement(interp, pair, Tcl_NewStringObj(session->activeLayerName.toUtf8().constData(), -1));
-            Tcl_ListObjAppendElement(interp, pair, Tcl_NewStringObj(session->activeLayerType.toUtf8().constData(), -1));
-            Tcl_SetObjResult(interp, pair);
-            return TCL_OK;
-        }
-        if (objc != 4) {
-            Tcl_SetResult(interp, const_cast<char*>("usage: layer active ?name type?"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        const QString layerName = QString::fromUtf8(Tcl_GetString(objv[2]));
-        const QString layerType = QString::fromUtf8(Tcl_GetString(objv[3]));
-        const int foundIndex = std::find_if(session->layers.cbegin(), session->layers.cend(),
-                                            [&layerName, &layerType](const LayerDefinition& layer) {
-                                                return layer.name.compare(layerName, Qt::CaseInsensitive) == 0
-                                                       && layer.type.compare(layerType, Qt::CaseInsensitive) == 0;
-                                            })
-                               - session->layers.cbegin();
-        if (foundIndex < 0 || foundIndex >= session->layers.size()) {
-            const QString error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
-            return TCL_ERROR;
-        }
-
-        session->activeLayerName = session->layers[foundIndex].name;
-        session->activeLayerType = session->layers[foundIndex].type;
-        session->window->onActiveLayerChanged(session->activeLayerName, session->activeLayerType);
-
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(
-            QString("active layer: %1 (%2)").arg(session->activeLayerName, session->activeLayerType)
-                .toUtf8()
-                .constData(), -1));
-        return TCL_OK;
-    }
-
-    if (subCommand == "configure") {
-        if (objc != 6) {
-            Tcl_SetResult(interp,
-                          const_cast<char*>("usage: layer configure <name> <type> <-visible|-selectable> <0|1>"),
-                          TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        const QString layerName = QString::fromUtf8(Tcl_GetString(objv[2]));
-        const QString layerType = QString::fromUtf8(Tcl_GetString(objv[3]));
-        const QString option = QString::fromUtf8(Tcl_GetString(objv[4]));
-        const QString valueRaw = QString::fromUtf8(Tcl_GetString(objv[5]));
-
-        bool ok = false;
-        const int numeric = valueRaw.toInt(&ok);
-        if (!ok || (numeric != 0 && numeric != 1)) {
-            Tcl_SetResult(interp, const_cast<char*>("value must be 0 or 1"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        if (!session) {
-            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
-            return TCL_ERROR;
-        }
-
-        int index = -1;
-        for (int i = 0; i < session->layers.size(); ++i) {
-            if (session->layers[i].name.compare(layerName, Qt::CaseInsensitive) == 0
-                && session->layers[i].type.compare(layerType, Qt::CaseInsensitive) == 0) {
-                index = i;
-                break;
-            }
-        }
-
-        if (index < 0) {
-            const QString error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
-            return TCL_ERROR;
-        }
-
-        LayerDefinition& layer = session->layers[index];
-        if (option == "-visible") {
-            layer.visible = numeric == 1;
-        } else if (option == "-selectable") {
-            layer.selectable = numeric == 1;
-        } else {
-            const QString error = QString("Unknown option '%1' (expected -visible or -selectable)").arg(option);
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
-            return TCL_ERROR;
-        }
-
-        session->window->onLayerChanged(index, layer);
-
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(
-            QString("layer %1 (%2) updated: %3=%4").arg(layerName, layerType, option).arg(numeric).toUtf8().constData(), -1));
-        return TCL_OK;
+    };
+    if (session) {
+        context.layers = &session->layers;
+        context.activeLayerName = &session->activeLayerName;
+        context.activeLayerType = &session->activeLayerType;
+        context.activeLayerChanged = [session]() {
+            session->window->onActiveLayerChanged(session->activeLayerName, session->activeLayerType);
+        };
+        context.layerChanged = [session](const int index) {
+            session->window->onLayerChanged(index, session->layers[index]);
+        };
     }
-
-    Tcl_SetResult(interp, const_cast<char*>("unknown layer subcommand"), TCL_STATIC);
-    return TCL_ERROR;
+    return TclLayerCommands::evaluateLayer(interp, objc, objv, context);
 }
 
 int TclConsoleWindow::handleToolCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
@@ -784,7 +807,8 @@ int TclConsoleWindow::handleCanvasCommand(Tcl_Interp* interp, int objc, Tcl_Obj*
 
     qint64 x = 0;
     qint64 y = 0;
-    if (!parseInt64(interp, objv[2], x, "x") || !parseInt64(interp, objv[3], y, "y")) {
+    if (!TclArguments::parseInt64(interp, objv[2], x, "x")
+        || !TclArguments::parseInt64(interp, objv[3], y, "y")) {
         return TCL_ERROR;
     }
 
@@ -886,9 +910,266 @@ int TclConsoleWindow::handleCanvasCommand(Tcl_Interp* interp, int objc, Tcl_Obj*
     return TCL_ERROR;
 }
 
+int TclConsoleWindow::handleSelectCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    if (objc < 2) {
+        Tcl_SetResult(interp, const_cast<char*>("usage: select <count|clear|all|box|delete> ..."), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    EditorSession* session = effectiveSession();
+    if (!session) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    // Every subcommand returns an object count so scripts can chain on it.
+    qint64 count = 0;
+    if (sub == "count" && objc == 2) {
+        count = session->window->selectionCount();
+    } else if (sub == "clear" && objc == 2) {
+        count = session->window->clearSelection();
+    } else if (sub == "all" && objc == 2) {
+        count = session->window->selectAll();
+    } else if (sub == "delete" && objc == 2) {
+        count = session->window->deleteSelection();
+    } else if (sub == "box") {
+        static const char* const kBoxUsage = "usage: select box <x1> <y1> <x2> <y2> ?-inside|-overlap|-touch? ?-add?";
+        if (objc < 6) {
+            Tcl_SetResult(interp, const_cast<char*>(kBoxUsage), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        RegionQueryMode mode = RegionQueryMode::Touch;
+        bool additive = false;
+        for (int i = 6; i < objc; ++i) {
+            const QString option = QString::fromUtf8(Tcl_GetString(objv[i]));
+            if (option == "-add") {
+                additive = true;
+            } else if (option == "-inside") {
+                mode = RegionQueryMode::Inside;
+            } else if (option == "-overlap") {
+                mode = RegionQueryMode::Overlap;
+            } else if (option == "-touch") {
+                mode = RegionQueryMode::Touch;
+            } else {
+                Tcl_SetResult(interp, const_cast<char*>(kBoxUsage), TCL_STATIC);
+                return TCL_ERROR;
+            }
+        }
+
+        qint64 x1 = 0;
+        qint64 y1 = 0;
+        qint64 x2 = 0;
+        qint64 y2 = 0;
+        if (!TclArguments::parseInt64(interp, objv[2], x1, "x1")
+            || !TclArguments::parseInt64(interp, objv[3], y1, "y1")
+            || !TclArguments::parseInt64(interp, objv[4], x2, "x2")
+            || !TclArguments::parseInt64(interp, objv[5], y2, "y2")) {
+            return TCL_ERROR;
+        }
+
+        count = session->window->selectInRect(x1, y1, x2, y2, mode, additive);
+    } else {
+        Tcl_SetResult(interp, const_cast<char*>("usage: select <count|clear|all|box|delete> ..."), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(count)));
+    return TCL_OK;
+}
+
+int TclConsoleWindow::handleLayoutCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    EditorSession* session = effectiveSession();
+    const int rc = TclDocumentCommands::evaluateLayout(interp, objc, objv, session ? session->document.get() : nullptr);
+    if (rc == TCL_OK && session && objc >= 2) {
+        // A freshly opened or recovered layout fills the editor's view.
+        const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+        if (sub == "open" || sub == "recover") {
+            fitSessionView(*session);
+        }
+    }
+    return rc;
+}
+
+int TclConsoleWindow::handleEditCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    EditorSession* session = effectiveSession();
+    return TclDocumentCommands::evaluateEdit(interp, objc, objv, session ? session->document.get() : nullptr);
+}
+
+int TclConsoleWindow::handleTransactionCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    EditorSession* session = effectiveSession();
+    return TclDocumentCommands::evaluateTransaction(interp, objc, objv, session ? session->document.get() : nullptr);
+}
+
+int TclConsoleWindow::handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    EditorSession* session = effectiveSession();
+    if (!session) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const TclSceneCommands::Context context{session->document->rootCell(), &session->layers};
+    QVector<std::shared_ptr<LayoutObjectModel>> created;
+    if (TclSceneCommands::evaluateShape(interp, objc, objv, context, created) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    // One bulk insert: one undo step, one journal batch and one repaint per
+    // view.
+    session->document->addObjects(std::move(created));
+    return TCL_OK;
+}
+
+int TclConsoleWindow::handleQueryCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    EditorSession* session = effectiveSession();
+    if (!session) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const TclSceneCommands::Context context{session->document->rootCell(), &session->layers};
+    return TclSceneCommands::evaluateQuery(interp, objc, objv, context);
+}
+
+int TclConsoleWindow::handleScriptCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    static const char* const kScriptUsage = "usage: script <run <file>|status|cancel>";
+    const QString sub = objc >= 2 ? QString::fromUtf8(Tcl_GetString(objv[1])) : QString();
+
+    if (sub == "run" && objc == 3) {
+        EditorSession* session = effectiveSession();
+        if (!session) {
+            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+        if (m_scriptWorker) {
+            Tcl_SetResult(interp, const_cast<char*>("a script is already running"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        // The worker queries its own copy of the document; the copy shares
+        // storage with the live root until either side edits it.
+        m_scriptDocument = session->document;
+        m_scriptWorker = std::make_unique<TclScriptWorker>(m_scriptDocument->rootCell()->detachedCopy(),
+                                                           session->layers);
+        connect(m_scriptWorker.get(), &TclScriptWorker::batchesReady,
+                this, &TclConsoleWindow::applyScriptBatches, Qt::QueuedConnection);
+        connect(m_scriptWorker.get(), &TclScriptWorker::progressChanged,
+                this, &TclConsoleWindow::showScriptProgress, Qt::QueuedConnection);
+        connect(m_scriptWorker.get(), &TclScriptWorker::finished,
+                this, &TclConsoleWindow::finishScript, Qt::QueuedConnection);
+        m_scriptWorker->start(QString::fromUtf8(Tcl_GetString(objv[2])));
+        statusBar()->showMessage(QString("script %1: running").arg(m_scriptWorker->scriptPath()));
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("started", -1));
+        return TCL_OK;
+    }
+
+    if (sub == "status" && objc == 2) {
+        Tcl_Obj* result = Tcl_NewListObj(0, nullptr);
+        const auto appendField = [result](const char* key, Tcl_Obj* value) {
+            Tcl_ListObjAppendElement(nullptr, result, Tcl_NewStringObj(key, -1));
+            Tcl_ListObjAppendElement(nullptr, result, value);
+        };
+        appendField("running", Tcl_NewBooleanObj(m_scriptWorker != nullptr));
+        if (m_scriptWorker) {
+            const TclScriptWorker::Progress progress = m_scriptWorker->progress();
+            appendField("script", Tcl_NewStringObj(m_scriptWorker->scriptPath().toUtf8().constData(), -1));
+            appendField("progress", Tcl_NewDoubleObj(progress.fraction));
+            appendField("message", Tcl_NewStringObj(progress.message.toUtf8().constData(), -1));
+            appendField("objects", Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(progress.createdObjectCount)));
+        }
+        Tcl_SetObjResult(interp, result);
+        return TCL_OK;
+    }
+
+    if (sub == "cancel" && objc == 2) {
+        if (m_scriptWorker) {
+            m_scriptWorker->cancel();
+        }
+        Tcl_SetObjResult(interp, Tcl_NewBooleanObj(m_scriptWorker != nullptr));
+        return TCL_OK;
+    }
+
+    Tcl_SetResult(interp, const_cast<char*>(kScriptUsage), TCL_STATIC);
+    return TCL_ERROR;
+}
+
+void TclConsoleWindow::applyScriptBatches() {
+    // Signals already queued by a finished worker find nothing to do.
+    if (!m_scriptWorker) {
+        return;
+    }
+
+    for (QVector<std::shared_ptr<LayoutObjectModel>>& batch : m_scriptWorker->takeBatches()) {
+        m_scriptDocument->addObjects(std::move(batch));
+    }
+}
+
+void TclConsoleWindow::showScriptProgress() {
+    if (!m_scriptWorker) {
+        return;
+    }
+
+    const TclScriptWorker::Progress progress = m_scriptWorker->progress();
+    QString message = QString("script %1: %2%, %3 objects")
+                          .arg(m_scriptWorker->scriptPath())
+                          .arg(qRound(progress.fraction * 100.0))
+                          .arg(progress.createdObjectCount);
+    if (!progress.message.isEmpty()) {
+        message += QString(" - %1").arg(progress.message);
+    }
+    statusBar()->showMessage(message);
+}
+
+void TclConsoleWindow::finishScript() {
+    if (!m_scriptWorker || m_scriptWorker->isRunning()) {
+        return;
+    }
+
+    applyScriptBatches();
+    const int rc = m_scriptWorker->resultCode();
+    const QString text = m_scriptWorker->resultText();
+    const QString scriptPath = m_scriptWorker->scriptPath();
+    const qint64 objectCount = m_scriptWorker->progress().createdObjectCount;
+    m_scriptWorker.reset();
+    m_scriptDocument.reset();
+
+    appendTranscript(QString("script %1 finished: %2 objects").arg(scriptPath).arg(objectCount));
+    if (!text.isEmpty()) {
+        appendTranscript(text);
+    }
+    if (rc != TCL_OK) {
+        appendTranscript(QString("ERROR (%1)").arg(rc));
+    }
+    statusBar()->clearMessage();
+}
+
+bool TclConsoleWindow::fitSessionView(EditorSession& session) {
+    qint64 minX = 0;
+    qint64 minY = 0;
+    qint64 maxX = 0;
+    qint64 maxY = 0;
+    const QSize viewport = session.window->canvasViewportSize();
+    if (viewport.isEmpty() || !session.document->tryGetLayoutBounds(minX, minY, maxX, maxY)) {
+        return false;
+    }
+
+    // Leave a 5% margin on each side; degenerate extents keep the zoom cap.
+    const double width = std::max<double>(1.0, static_cast<double>(maxX - minX));
+    const double height = std::max<double>(1.0, static_cast<double>(maxY - minY));
+    session.zoom = std::min(200.0, 0.9 * std::min(viewport.width() / width, viewport.height() / height));
+
+    const double centerX = (static_cast<double>(minX) + static_cast<double>(maxX)) / 2.0;
+    const double centerY = (static_cast<double>(minY) + static_cast<double>(maxY)) / 2.0;
+    session.panX = (viewport.width() / 2.0) - (centerX * session.zoom);
+    session.panY = (viewport.height() / 2.0) + (centerY * session.zoom);
+    session.window->onViewChanged(session.zoom, session.panX, session.panY, session.gridSize);
+    return true;
+}
+
 int TclConsoleWindow::handleViewCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
     if (objc < 2) {
-        Tcl_SetResult(interp, const_cast<char*>("usage: view <zoom|pan|grid> ..."), TCL_STATIC);
+        Tcl_SetResult(interp, const_cast<char*>("usage: view <zoom|pan|grid|fit|export> ..."), TCL_STATIC);
         return TCL_ERROR;
     }
 
@@ -899,6 +1180,13 @@ int TclConsoleWindow::handleViewCommand(Tcl_Interp* interp, int objc, Tcl_Obj* c
         return TCL_ERROR;
     }
 
+    if (sub == "export") {
+        // Rendered offscreen with this editor's layer visibility; the
+        // window and its view are left alone.
+        const TclSceneCommands::Context context{session->document->rootCell(), &session->layers};
+        return TclSceneCommands::evaluateViewExport(interp, objc, objv, context);
+    }
+
     if (sub == "pan") {
         if (objc != 4) {
             Tcl_SetResult(interp, const_cast<char*>("usage: view pan <dx> <dy>"), TCL_STATIC);
@@ -982,6 +1270,16 @@ int TclConsoleWindow::handleViewCommand(Tcl_Interp* interp, int objc, Tcl_Obj* c
         return TCL_OK;
     }
 
+    if (sub == "fit" && objc == 2) {
+        if (!fitSessionView(*session)) {
+            Tcl_SetResult(interp, const_cast<char*>("nothing to fit"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("ok", -1));
+        return TCL_OK;
+    }
+
     Tcl_SetResult(interp, const_cast<char*>("unknown view subcommand"), TCL_STATIC);
     return TCL_ERROR;
 }
@@ -3,6 +3,8 @@
 #include <QHash>
 #include <QMainWindow>
 #include <QStringList>
+#include <array>
+#include <memory>
 #include <tcl.h>
 
 class QEvent;
@@ -10,10 +12,12 @@ class QCloseEvent;
 class QObject;
 class QLineEdit;
 class QPlainTextEdit;
+class TclScriptWorker;
 
 #include "LayerManager.h"
 #include "LayoutEditorWindow.h"
 #include "EditorSessionController.h"
+#include "TranscriptFilterSet.h"
 
 // TclConsoleWindow hosts the primary Tcl interpreter UI.
 //
@@ -32,6 +36,9 @@ public slots:
     // Evaluates a Tcl command and appends result/error text to transcript.
     void executeCommand(const QString& command);
     void executeEditorCommand(int editorId, const QString& command, bool requestActivation);
+    // Evaluates a canvas event as its Tcl command through Tcl_EvalObjv,
+    // without building or parsing command text unless it is echoed.
+    void executeEditorCanvasEvent(int editorId, const CanvasEventCommand& event, bool requestActivation);
 
 private:
     void closeEvent(QCloseEvent* event) override;
@@ -45,6 +52,13 @@ private:
     static int BindKeyCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
     static int TranscriptCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
     static int AppCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int SelectCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int LayoutCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int EditCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ScriptCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
 
     // Per-command-family handlers.
     int handleLayerCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
@@ -54,14 +68,21 @@ private:
     int handleBindKeyCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
     int handleTranscriptCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
     int handleAppCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleSelectCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleLayoutCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleEditCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleTransactionCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleQueryCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleScriptCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
 
     // Common argument parsing helpers.
-    bool parseInt64(Tcl_Interp* interp, Tcl_Obj* obj, qint64& value, const char* fieldName);
     bool parseDouble(Tcl_Interp* interp, Tcl_Obj* obj, double& value, const char* fieldName);
 
     // Console transcript helper.
     void appendTranscript(const QString& line);
     bool shouldSuppressTranscriptCommand(const QString& command) const;
+    int evaluateCanvasEvent(const CanvasEventCommand& event);
     int evaluateCommand(const QString& command,
                         bool echoCommand,
                         bool echoResult,
@@ -81,12 +102,21 @@ private:
     EditorSession* sessionById(int editorId);
     const EditorSession* sessionById(int editorId) const;
     EditorSession* effectiveSession();
+    // Zooms and pans so the session's whole layout fills the canvas.
+    bool fitSessionView(EditorSession& session);
     void initializeSessionLayers(EditorSession& session);
     void applySessionToWindow(EditorSession& session);
-    int createEditorSession(bool activate);
+    // Opens an editor on document, or on a new empty document when null.
+    int createEditorSession(bool activate, std::shared_ptr<LayoutDocument> document = nullptr);
     void setActiveEditor(int editorId);
     void refreshEditorWindowTitles();
 
+    // Background script hand-off, run on the GUI thread for the worker's
+    // signals: each shape batch becomes one edit of the script's document.
+    void applyScriptBatches();
+    void showScriptProgress();
+    void finishScript();
+
     QPlainTextEdit* m_output;
     QLineEdit* m_input;
     Tcl_Interp* m_interp;
@@ -109,5 +139,19 @@ private:
     QString m_defaultTool{"none"};
 
     // Glob patterns for commands that should not be echoed to the transcript.
-    QStringList m_transcriptFilters;
+    TranscriptFilterSet m_transcriptFilters;
+
+    // Canvas event fast path: the command and subcommand words of each
+    // event kind and reusable argument objects, all held for the window's
+    // lifetime.
+    Tcl_Obj* m_canvasEventWords[CanvasEventCommand::kKindCount][2]{};
+    Tcl_Obj* m_canvasEventArguments[CanvasEventCommand::kMaxArguments]{};
+    // Per event kind: 1 when the filters suppress every event, 0 when each
+    // one must be matched, -1 until computed after a filter change.
+    std::array<int, CanvasEventCommand::kKindCount> m_canvasEventSuppression{};
+
+    // The background script started by `script run`, if any, and the
+    // document its shapes go to.
+    std::unique_ptr<TclScriptWorker> m_scriptWorker;
+    std::shared_ptr<LayoutDocument> m_scriptDocument;
 };
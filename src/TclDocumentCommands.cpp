@@ -0,0 +1,283 @@
+#include "TclDocumentCommands.h"
+
+#include "LayoutEditJournal.h"
+#include "LayoutSceneModel.h"
+#include "LayoutUndoStack.h"
+#include "TclArguments.h"
+
+#include <QString>
+
+#include <algorithm>
+#include <limits>
+
+int TclDocumentCommands::evaluateLayout(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document) {
+    if (objc < 2) {
+        Tcl_SetResult(interp, const_cast<char*>("usage: layout <open|save|cache|autosave|recover> ..."), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    if (sub == "cache") {
+        // The lazy cell budget is shared by all editors.
+        if (objc == 3) {
+            qint64 megabytes = 0;
+            if (!TclArguments::parseInt64(interp, objv[2], megabytes, "megabytes")) {
+                return TCL_ERROR;
+            }
+            if (megabytes < 0) {
+                Tcl_SetResult(interp, const_cast<char*>("megabytes must be >= 0"), TCL_STATIC);
+                return TCL_ERROR;
+            }
+            LayoutSceneNode::setLazyCellMemoryLimit(megabytes * 1024 * 1024);
+        } else if (objc != 2) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: layout cache ?<megabytes>?"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        constexpr qint64 kBytesPerMegabyte = 1024 * 1024;
+        Tcl_Obj* const items[] = {
+            Tcl_NewStringObj("limit_mb", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(LayoutSceneNode::lazyCellMemoryLimit() / kBytesPerMegabyte)),
+            Tcl_NewStringObj("used_mb", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(LayoutSceneNode::lazyCellMemoryUsage() / kBytesPerMegabyte)),
+            Tcl_NewStringObj("loaded_cells", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(LayoutSceneNode::loadedLazyCellCount())),
+            Tcl_NewStringObj("load_errors", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(LayoutSceneNode::failedLazyCellLoadCount())),
+            Tcl_NewStringObj("last_error", -1),
+            Tcl_NewStringObj(LayoutSceneNode::lastLazyCellLoadError().toUtf8().constData(), -1)};
+        Tcl_SetObjResult(interp, Tcl_NewListObj(10, items));
+        return TCL_OK;
+    }
+
+    if (!document) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (sub == "open") {
+        static const char* const kOpenUsage = "usage: layout open <file> ?-lazy?";
+        bool lazyCells = false;
+        if (objc == 4 && QString::fromUtf8(Tcl_GetString(objv[3])) == "-lazy") {
+            lazyCells = true;
+        } else if (objc != 3) {
+            Tcl_SetResult(interp, const_cast<char*>(kOpenUsage), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString filePath = QString::fromUtf8(Tcl_GetString(objv[2]));
+        QString summary;
+        QString error;
+        if (!document->openLayout(filePath, lazyCells, summary, error)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(summary.toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    if (sub == "save") {
+        if (objc != 3) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: layout save <file>"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString filePath = QString::fromUtf8(Tcl_GetString(objv[2]));
+        QString summary;
+        QString error;
+        if (!document->saveLayout(filePath, summary, error)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(summary.toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    if (sub == "autosave") {
+        static const char* const kAutosaveUsage = "usage: layout autosave ?<base>|-off?";
+        if (objc == 3) {
+            const QString argument = QString::fromUtf8(Tcl_GetString(objv[2]));
+            QString error;
+            if (argument == "-off") {
+                document->stopAutosave();
+            } else if (!document->startAutosave(argument, error)) {
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+                return TCL_ERROR;
+            }
+        } else if (objc != 2) {
+            Tcl_SetResult(interp, const_cast<char*>(kAutosaveUsage), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const LayoutEditJournal* journal = document->autosaveJournal();
+        if (!journal) {
+            Tcl_SetObjResult(interp, Tcl_NewListObj(0, nullptr));
+            return TCL_OK;
+        }
+
+        const LayoutEditJournal::Status status = journal->status();
+        Tcl_Obj* const items[] = {
+            Tcl_NewStringObj("base", -1),
+            Tcl_NewStringObj(status.basePath.toUtf8().constData(), -1),
+            Tcl_NewStringObj("generation", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(status.generation)),
+            Tcl_NewStringObj("journal_bytes", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(status.journalBytes)),
+            Tcl_NewStringObj("records", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(status.recordCount)),
+            Tcl_NewStringObj("error", -1),
+            Tcl_NewStringObj(status.lastError.toUtf8().constData(), -1)};
+        Tcl_SetObjResult(interp, Tcl_NewListObj(10, items));
+        return TCL_OK;
+    }
+
+    if (sub == "recover") {
+        if (objc != 3) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: layout recover <base>"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString basePath = QString::fromUtf8(Tcl_GetString(objv[2]));
+        QString summary;
+        QString error;
+        if (!document->recoverLayout(basePath, summary, error)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(summary.toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    Tcl_SetResult(interp, const_cast<char*>("unknown layout subcommand"), TCL_STATIC);
+    return TCL_ERROR;
+}
+
+int TclDocumentCommands::evaluateEdit(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document) {
+    static const char* const kEditUsage = "usage: edit <undo|redo|history> ...";
+    if (objc < 2) {
+        Tcl_SetResult(interp, const_cast<char*>(kEditUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    if (!document) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (sub == "undo" || sub == "redo") {
+        qint64 count = 1;
+        if (objc == 3) {
+            if (!TclArguments::parseInt64(interp, objv[2], count, "count")) {
+                return TCL_ERROR;
+            }
+            if (count < 1) {
+                Tcl_SetResult(interp, const_cast<char*>("count must be >= 1"), TCL_STATIC);
+                return TCL_ERROR;
+            }
+        } else if (objc != 2) {
+            Tcl_SetResult(interp,
+                          const_cast<char*>(sub == "undo" ? "usage: edit undo ?<count>?" : "usage: edit redo ?<count>?"),
+                          TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        if (document->inTransaction()) {
+            Tcl_SetResult(interp, const_cast<char*>("transaction in progress; commit or abort it first"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const int boundedCount = static_cast<int>(std::min<qint64>(count, std::numeric_limits<int>::max()));
+        const int applied = sub == "undo" ? document->undoEdits(boundedCount)
+                                          : document->redoEdits(boundedCount);
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(applied)));
+        return TCL_OK;
+    }
+
+    if (sub == "history") {
+        LayoutUndoStack& undoStack = document->undoStack();
+        constexpr qint64 kBytesPerMegabyte = 1024 * 1024;
+        if (objc == 3) {
+            qint64 megabytes = 0;
+            if (!TclArguments::parseInt64(interp, objv[2], megabytes, "megabytes")) {
+                return TCL_ERROR;
+            }
+            if (megabytes < 0) {
+                Tcl_SetResult(interp, const_cast<char*>("megabytes must be >= 0"), TCL_STATIC);
+                return TCL_ERROR;
+            }
+            undoStack.setMemoryLimit(megabytes * kBytesPerMegabyte);
+        } else if (objc != 2) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: edit history ?<megabytes>?"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        Tcl_Obj* const items[] = {
+            Tcl_NewStringObj("undo", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(undoStack.undoCount())),
+            Tcl_NewStringObj("redo", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(undoStack.redoCount())),
+            Tcl_NewStringObj("limit_mb", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(undoStack.memoryLimit() / kBytesPerMegabyte)),
+            Tcl_NewStringObj("used_mb", -1),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(undoStack.memoryUsage() / kBytesPerMegabyte))};
+        Tcl_SetObjResult(interp, Tcl_NewListObj(8, items));
+        return TCL_OK;
+    }
+
+    Tcl_SetResult(interp, const_cast<char*>(kEditUsage), TCL_STATIC);
+    return TCL_ERROR;
+}
+
+int TclDocumentCommands::evaluateTransaction(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document) {
+    static const char* const kTransactionUsage = "usage: transaction <begin|commit|abort|status>";
+    if (objc != 2) {
+        Tcl_SetResult(interp, const_cast<char*>(kTransactionUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    if (!document) {
+        Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    if (sub == "begin") {
+        if (!document->beginTransaction()) {
+            Tcl_SetResult(interp, const_cast<char*>("transaction already in progress"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+        Tcl_ResetResult(interp);
+        return TCL_OK;
+    }
+
+    if (sub != "commit" && sub != "abort" && sub != "status") {
+        Tcl_SetResult(interp, const_cast<char*>(kTransactionUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    const bool open = document->inTransaction();
+    if (sub != "status" && !open) {
+        Tcl_SetResult(interp, const_cast<char*>("no transaction in progress"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    // commit and abort report what they applied or dropped; status what is
+    // buffered so far.
+    const LayoutDocument::TransactionCounts counts = sub == "commit"  ? document->commitTransaction()
+                                                     : sub == "abort" ? document->abortTransaction()
+                                                                      : document->transactionCounts();
+    Tcl_Obj* result = Tcl_NewListObj(0, nullptr);
+    if (sub == "status") {
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewStringObj("open", -1));
+        Tcl_ListObjAppendElement(interp, result, Tcl_NewBooleanObj(open));
+    }
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewStringObj("added", -1));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(counts.added)));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewStringObj("removed", -1));
+    Tcl_ListObjAppendElement(interp, result, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(counts.removed)));
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
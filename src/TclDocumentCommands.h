@@ -0,0 +1,18 @@
+#pragma once
+
+#include <tcl.h>
+
+#include "LayoutDocument.h"
+
+// TclDocumentCommands implements the `layout`, `edit` and `transaction`
+// command families on a LayoutDocument, so the console and headless batch
+// mode (TclBatchRunner) share one implementation. View updates, such as
+// fitting an editor to a freshly opened layout, are left to the caller.
+class TclDocumentCommands {
+public:
+    // document is the command's target; null reports "no active editor",
+    // except for `layout cache`, whose budget is process-wide.
+    static int evaluateLayout(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document);
+    static int evaluateEdit(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document);
+    static int evaluateTransaction(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], LayoutDocument* document);
+};
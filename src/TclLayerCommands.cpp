@@ -0,0 +1,168 @@
+#include "TclLayerCommands.h"
+
+#include <QCoreApplication>
+#include <QDir>
+
+int TclLayerCommands::evaluateLayer(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], const Context& context) {
+    if (objc < 2) {
+        Tcl_SetResult(interp, const_cast<char*>("usage: layer <list|load|configure|active> ..."), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString subCommand = QString::fromUtf8(Tcl_GetString(objv[1]));
+    const bool hasPalette = context.layers && context.activeLayerName && context.activeLayerType;
+
+    if (subCommand == "list") {
+        if (!hasPalette) {
+            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        QString out;
+        for (const LayerDefinition& layer : *context.layers) {
+            const bool isActive = layer.name.compare(*context.activeLayerName, Qt::CaseInsensitive) == 0
+                                  && layer.type.compare(*context.activeLayerType, Qt::CaseInsensitive) == 0;
+            out += QString("%1 {%2} %3/%4 %5 %6 %7 %8 %9\n")
+                       .arg(layer.name, layer.type)
+                       .arg(layer.nameId)
+                       .arg(layer.typeId)
+                       .arg(layer.color.name(), layer.pattern)
+                       .arg(layer.visible ? "visible" : "hidden")
+                       .arg(layer.selectable ? "selectable" : "locked")
+                       .arg(isActive ? "active" : "inactive");
+        }
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(out.trimmed().toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    if (subCommand == "load") {
+        if (objc != 3) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: layer load <filePath>"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString rawPath = QString::fromUtf8(Tcl_GetString(objv[2]));
+        const QString path = QDir::isAbsolutePath(rawPath)
+                                 ? rawPath
+                                 : QDir(QCoreApplication::applicationDirPath()).filePath(rawPath);
+
+        QString error;
+        if (!context.layerManager->loadLayersFromFile(path, error)) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+        if (context.layersLoaded) {
+            context.layersLoaded();
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            QString("loaded %1 layers from %2").arg(context.layerManager->layers().size()).arg(path).toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    if (subCommand == "active") {
+        if (!hasPalette) {
+            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        if (objc == 2) {
+            Tcl_Obj* pair = Tcl_NewListObj(0, nullptr);
+            Tcl_ListObjAppendElement(interp, pair, Tcl_NewStringObj(context.activeLayerName->toUtf8().constData(), -1));
+            Tcl_ListObjAppendElement(interp, pair, Tcl_NewStringObj(context.activeLayerType->toUtf8().constData(), -1));
+            Tcl_SetObjResult(interp, pair);
+            return TCL_OK;
+        }
+        if (objc != 4) {
+            Tcl_SetResult(interp, const_cast<char*>("usage: layer active ?name type?"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString layerName = QString::fromUtf8(Tcl_GetString(objv[2]));
+        const QString layerType = QString::fromUtf8(Tcl_GetString(objv[3]));
+        const int index = findLayerIndex(*context.layers, layerName, layerType);
+        if (index < 0) {
+            const QString error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+
+        *context.activeLayerName = (*context.layers)[index].name;
+        *context.activeLayerType = (*context.layers)[index].type;
+        if (context.activeLayerChanged) {
+            context.activeLayerChanged();
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            QString("active layer: %1 (%2)").arg(*context.activeLayerName, *context.activeLayerType)
+                .toUtf8()
+                .constData(), -1));
+        return TCL_OK;
+    }
+
+    if (subCommand == "configure") {
+        if (objc != 6) {
+            Tcl_SetResult(interp,
+                          const_cast<char*>("usage: layer configure <name> <type> <-visible|-selectable> <0|1>"),
+                          TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const QString layerName = QString::fromUtf8(Tcl_GetString(objv[2]));
+        const QString layerType = QString::fromUtf8(Tcl_GetString(objv[3]));
+        const QString option = QString::fromUtf8(Tcl_GetString(objv[4]));
+        const QString valueRaw = QString::fromUtf8(Tcl_GetString(objv[5]));
+
+        bool ok = false;
+        const int numeric = valueRaw.toInt(&ok);
+        if (!ok || (numeric != 0 && numeric != 1)) {
+            Tcl_SetResult(interp, const_cast<char*>("value must be 0 or 1"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        if (!hasPalette) {
+            Tcl_SetResult(interp, const_cast<char*>("no active editor"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+
+        const int index = findLayerIndex(*context.layers, layerName, layerType);
+        if (index < 0) {
+            const QString error = QString("Unknown layer '%1' of type '%2'").arg(layerName, layerType);
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+
+        LayerDefinition& layer = (*context.layers)[index];
+        if (option == "-visible") {
+            layer.visible = numeric == 1;
+        } else if (option == "-selectable") {
+            layer.selectable = numeric == 1;
+        } else {
+            const QString error = QString("Unknown option '%1' (expected -visible or -selectable)").arg(option);
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+        if (context.layerChanged) {
+            context.layerChanged(index);
+        }
+
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            QString("layer %1 (%2) updated: %3=%4").arg(layerName, layerType, option).arg(numeric).toUtf8().constData(), -1));
+        return TCL_OK;
+    }
+
+    Tcl_SetResult(interp, const_cast<char*>("unknown layer subcommand"), TCL_STATIC);
+    return TCL_ERROR;
+}
+
+int TclLayerCommands::findLayerIndex(const QVector<LayerDefinition>& layers,
+                                     const QString& layerName,
+                                     const QString& layerType) {
+    for (int i = 0; i < layers.size(); ++i) {
+        if (layers[i].name.compare(layerName, Qt::CaseInsensitive) == 0
+            && layers[i].type.compare(layerType, Qt::CaseInsensitive) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <tcl.h>
+
+#include "LayerManager.h"
+
+// TclLayerCommands implements the `layer` command family on a layer palette,
+// so the console (one palette per editor) and headless batch mode
+// (TclBatchRunner) share one implementation. `layer load` parses the file
+// into a LayerManager; the caller decides which palettes it resets and
+// updates its views through the Context callbacks.
+class TclLayerCommands {
+public:
+    struct Context {
+        // Parses `layer load` files.
+        LayerManager* layerManager{nullptr};
+        // The palette `list`, `active` and `configure` act on, with its
+        // active layer. A null palette reports "no active editor".
+        QVector<LayerDefinition>* layers{nullptr};
+        QString* activeLayerName{nullptr};
+        QString* activeLayerType{nullptr};
+        // Optional. Called after the manager loaded a new palette, after the
+        // active layer changed, and after layer index was reconfigured.
+        std::function<void()> layersLoaded;
+        std::function<void()> activeLayerChanged;
+        std::function<void(int)> layerChanged;
+    };
+
+    // `layer list|load|active|configure`.
+    static int evaluateLayer(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], const Context& context);
+
+private:
+    // Index of the layer matching name and type ignoring case, or -1.
+    static int findLayerIndex(const QVector<LayerDefinition>& layers,
+                              const QString& layerName,
+                              const QString& layerType);
+};
@@ -0,0 +1,674 @@
+#include "TclSceneCommands.h"
+
+#include "LayoutImageExporter.h"
+#include "TclArguments.h"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace {
+
+// Kind word reported by `query` and `shape info` for each object class.
+const char* objectKindName(const LayoutObjectModel& object) {
+    if (object.asRectangle()) {
+        return "rect";
+    }
+    if (dynamic_cast<const PolygonObjectModel*>(&object)) {
+        return "polygon";
+    }
+    if (dynamic_cast<const PathObjectModel*>(&object)) {
+        return "path";
+    }
+    if (dynamic_cast<const InstanceObjectModel*>(&object)) {
+        return "instance";
+    }
+    return "object";
+}
+
+// Masters of `shape array -instance`, one per layer and template size, so
+// repeated arrays place the same cell and the journal's snapshot already
+// holds it. An entry lives as long as some instance places its master.
+// Shared by the console and script worker threads.
+struct ArrayMasterRegistry {
+    std::mutex mutex;
+    QHash<QString, std::weak_ptr<const LayoutSceneNode>> masters;
+};
+
+std::shared_ptr<const LayoutSceneNode> arrayMasterFor(const LayerDefinition& layer,
+                                                      const qint64 width,
+                                                      const qint64 height) {
+    static ArrayMasterRegistry registry;
+    const QString key = QString("%1/%2/%3/%4").arg(layer.nameId).arg(layer.typeId).arg(width).arg(height);
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (std::shared_ptr<const LayoutSceneNode> master = registry.masters.value(key).lock()) {
+        return master;
+    }
+
+    for (auto it = registry.masters.begin(); it != registry.masters.end();) {
+        if (it.value().expired()) {
+            it = registry.masters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    auto master = std::make_shared<LayoutSceneNode>();
+    master->setName("ARRAY");
+    master->addObject(std::make_shared<RectangleObjectModel>(
+        DrawnRectangle{layer.nameId, layer.typeId, 0, 0, width, height}));
+    registry.masters.insert(key, master);
+    return master;
+}
+
+qint64 floorDivide(const qint64 value, const qint64 divisor) {
+    const qint64 quotient = value / divisor;
+    return quotient * divisor > value ? quotient - 1 : quotient;
+}
+
+// Elements [outFirst, outLast] of one axis of a step-and-repeat array whose
+// span [low + i * pitch, high + i * pitch] overlaps (excludeLow, excludeHigh)
+// with positive length. Spans are normalized and pitch is positive.
+bool excludedElementRange(const qint64 low,
+                          const qint64 high,
+                          const qint64 pitch,
+                          const int count,
+                          const qint64 excludeLow,
+                          const qint64 excludeHigh,
+                          int& outFirst,
+                          int& outLast) {
+    if (low >= high || excludeLow >= excludeHigh) {
+        return false;
+    }
+
+    const qint64 first = std::max<qint64>(floorDivide(excludeLow - high, pitch) + 1, 0);
+    const qint64 last = std::min<qint64>(-floorDivide(low - excludeHigh, pitch) - 1, count - 1);
+    if (first > last) {
+        return false;
+    }
+
+    outFirst = static_cast<int>(first);
+    outLast = static_cast<int>(last);
+    return true;
+}
+
+Tcl_Obj* newPointListObj(const QVector<WorldPoint>& points) {
+    Tcl_Obj* list = Tcl_NewListObj(0, nullptr);
+    for (const WorldPoint& point : points) {
+        Tcl_ListObjAppendElement(nullptr, list, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(point.x)));
+        Tcl_ListObjAppendElement(nullptr, list, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(point.y)));
+    }
+    return list;
+}
+
+// Builds the {id kind layer type minX minY maxX maxY} records of a query
+// result. Kind words and layer names are created once per command and
+// shared by every record, so a large result costs one list and four
+// integers per object.
+class ObjectRecordBuilder {
+public:
+    explicit ObjectRecordBuilder(const QVector<LayerDefinition>& layers)
+        : m_layers(layers),
+          m_emptyWord(Tcl_NewObj()) {
+        Tcl_IncrRefCount(m_emptyWord);
+    }
+
+    ~ObjectRecordBuilder() {
+        Tcl_DecrRefCount(m_emptyWord);
+        for (auto it = m_kindWords.cbegin(); it != m_kindWords.cend(); ++it) {
+            Tcl_DecrRefCount(it.value());
+        }
+        for (auto it = m_layerWords.cbegin(); it != m_layerWords.cend(); ++it) {
+            Tcl_DecrRefCount(it.value().first);
+            Tcl_DecrRefCount(it.value().second);
+        }
+    }
+
+    ObjectRecordBuilder(const ObjectRecordBuilder&) = delete;
+    ObjectRecordBuilder& operator=(const ObjectRecordBuilder&) = delete;
+
+    Tcl_Obj* record(const LayoutObjectModel& object) {
+        LayoutObjectModel::Bounds bounds;
+        object.tryGetBounds(bounds);
+
+        Tcl_Obj* layerName = m_emptyWord;
+        Tcl_Obj* layerType = m_emptyWord;
+        layerWords(object, layerName, layerType);
+
+        Tcl_Obj* elements[8] = {
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(object.objectId())),
+            kindWord(object),
+            layerName,
+            layerType,
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(bounds.minX)),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(bounds.minY)),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(bounds.maxX)),
+            Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(bounds.maxY)),
+        };
+        return Tcl_NewListObj(8, elements);
+    }
+
+    Tcl_Obj* kindWord(const LayoutObjectModel& object) {
+        const char* kind = objectKindName(object);
+        Tcl_Obj*& word = m_kindWords[kind];
+        if (!word) {
+            word = Tcl_NewStringObj(kind, -1);
+            Tcl_IncrRefCount(word);
+        }
+        return word;
+    }
+
+    // Layers missing from the palette are reported by number; objects
+    // without a layer (instances) keep the empty words passed in.
+    void layerWords(const LayoutObjectModel& object, Tcl_Obj*& outName, Tcl_Obj*& outType) {
+        quint32 nameId = 0;
+        quint32 typeId = 0;
+        if (!object.tryGetLayer(nameId, typeId)) {
+            return;
+        }
+
+        const quint64 key = (static_cast<quint64>(nameId) << 32) | typeId;
+        auto it = m_layerWords.find(key);
+        if (it == m_layerWords.end()) {
+            auto layer = std::find_if(m_layers.cbegin(), m_layers.cend(), [nameId, typeId](const LayerDefinition& candidate) {
+                return candidate.nameId == nameId && candidate.typeId == typeId;
+            });
+            Tcl_Obj* name = layer != m_layers.cend() ? Tcl_NewStringObj(layer->name.toUtf8().constData(), -1)
+                                                     : Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(nameId));
+            Tcl_Obj* type = layer != m_layers.cend() ? Tcl_NewStringObj(layer->type.toUtf8().constData(), -1)
+                                                     : Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(typeId));
+            Tcl_IncrRefCount(name);
+            Tcl_IncrRefCount(type);
+            it = m_layerWords.insert(key, qMakePair(name, type));
+        }
+        outName = it.value().first;
+        outType = it.value().second;
+    }
+
+    Tcl_Obj* emptyWord() const {
+        return m_emptyWord;
+    }
+
+private:
+    const QVector<LayerDefinition>& m_layers;
+    Tcl_Obj* m_emptyWord;
+    QHash<const char*, Tcl_Obj*> m_kindWords;
+    QHash<quint64, QPair<Tcl_Obj*, Tcl_Obj*>> m_layerWords;
+};
+
+}
+
+int TclSceneCommands::evaluateShape(Tcl_Interp* interp,
+                                    const int objc,
+                                    Tcl_Obj* const objv[],
+                                    const Context& context,
+                                    QVector<std::shared_ptr<LayoutObjectModel>>& outCreated) {
+    static const char* const kShapeUsage =
+        "usage: shape create rect <LayerName> <LayerType> <coordinates> | shape array ... | shape info <id>";
+    const QString sub = objc >= 2 ? QString::fromUtf8(Tcl_GetString(objv[1])) : QString();
+    if (sub == "create" && objc == 6 && QString::fromUtf8(Tcl_GetString(objv[2])) == "rect") {
+        return createRectangles(interp, objv, context, outCreated);
+    }
+    if (sub == "array") {
+        return createArray(interp, objc, objv, context, outCreated);
+    }
+    if (sub == "info" && objc == 3) {
+        return describeShape(interp, objv, context);
+    }
+
+    Tcl_SetResult(interp, const_cast<char*>(kShapeUsage), TCL_STATIC);
+    return TCL_ERROR;
+}
+
+int TclSceneCommands::evaluateQuery(Tcl_Interp* interp, const int objc, Tcl_Obj* const objv[], const Context& context) {
+    static const char* const kQueryUsage =
+        "usage: query <rect|count> <x1> <y1> <x2> <y2> ?options? | query point <x> <y> ?options?";
+    if (objc < 2) {
+        Tcl_SetResult(interp, const_cast<char*>(kQueryUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    const bool pointQuery = sub == "point";
+    const int coordinateCount = pointQuery ? 2 : 4;
+    if ((!pointQuery && sub != "rect" && sub != "count") || objc < 2 + coordinateCount) {
+        Tcl_SetResult(interp, const_cast<char*>(kQueryUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    static const char* const kCoordinateNames[2][4] = {{"x1", "y1", "x2", "y2"}, {"x", "y"}};
+    qint64 coordinates[4] = {0, 0, 0, 0};
+    for (int i = 0; i < coordinateCount; ++i) {
+        if (!TclArguments::parseInt64(interp, objv[2 + i], coordinates[i], kCoordinateNames[pointQuery ? 1 : 0][i])) {
+            return TCL_ERROR;
+        }
+    }
+
+    RegionQueryMode mode = RegionQueryMode::Touch;
+    bool idsOnly = false;
+    qint64 limit = -1;
+    QSet<quint64> layerKeys;
+    for (int i = 2 + coordinateCount; i < objc; ++i) {
+        const QString option = QString::fromUtf8(Tcl_GetString(objv[i]));
+        if (!pointQuery && option == "-inside") {
+            mode = RegionQueryMode::Inside;
+        } else if (!pointQuery && option == "-overlap") {
+            mode = RegionQueryMode::Overlap;
+        } else if (!pointQuery && option == "-touch") {
+            mode = RegionQueryMode::Touch;
+        } else if (sub != "count" && option == "-ids") {
+            idsOnly = true;
+        } else if (option == "-limit" && i + 1 < objc) {
+            if (!TclArguments::parseInt64(interp, objv[++i], limit, "limit")) {
+                return TCL_ERROR;
+            }
+            if (limit < 0) {
+                Tcl_SetResult(interp, const_cast<char*>("limit must be non-negative"), TCL_STATIC);
+                return TCL_ERROR;
+            }
+        } else if (option == "-layer" && i + 2 < objc) {
+            LayerDefinition layer;
+            if (!resolveLayer(interp, context, objv[i + 1], objv[i + 2], layer)) {
+                return TCL_ERROR;
+            }
+            layerKeys.insert((static_cast<quint64>(layer.nameId) << 32) | layer.typeId);
+            i += 2;
+        } else {
+            Tcl_SetResult(interp, const_cast<char*>(kQueryUsage), TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+
+    // With -layer only shapes drawn on those layers match. Instances have
+    // no layer, and the index would report every one in the region, so
+    // they are left out.
+    LayoutLayerFilter layerFilter;
+    if (!layerKeys.isEmpty()) {
+        layerFilter = [&layerKeys](const quint32 layerNameId, const quint32 layerTypeId) {
+            return layerKeys.contains((static_cast<quint64>(layerNameId) << 32) | layerTypeId);
+        };
+    }
+    const bool layeredOnly = !layerKeys.isEmpty();
+    const auto matchesLayers = [layeredOnly](const LayoutObjectModel& object) {
+        quint32 layerNameId = 0;
+        quint32 layerTypeId = 0;
+        return !layeredOnly || object.tryGetLayer(layerNameId, layerTypeId);
+    };
+
+    const LayoutSceneNode& rootCell = *context.rootCell;
+    const qint64 minX = std::min(coordinates[0], coordinates[2]);
+    const qint64 minY = std::min(coordinates[1], coordinates[3]);
+    const qint64 maxX = std::max(coordinates[0], coordinates[2]);
+    const qint64 maxY = std::max(coordinates[1], coordinates[3]);
+
+    if (sub == "count") {
+        // Counted from the index without touching Tcl per object.
+        qint64 count = 0;
+        if (limit != 0) {
+            rootCell.queryRegion(minX, minY, maxX, maxY, mode, layerFilter,
+                                 [&count, &matchesLayers, limit](const LayoutObjectModel& object) {
+                                     if (matchesLayers(object)) {
+                                         ++count;
+                                     }
+                                     return limit < 0 || count < limit;
+                                 });
+        }
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(count)));
+        return TCL_OK;
+    }
+
+    // Records are appended to one list object as the index streams them;
+    // no result text exists until a script asks for the string.
+    Tcl_Obj* result = Tcl_NewListObj(0, nullptr);
+    ObjectRecordBuilder records(*context.layers);
+    qint64 appended = 0;
+    const auto appendObject = [result, idsOnly, &records, &appended](const LayoutObjectModel& object) {
+        Tcl_ListObjAppendElement(nullptr,
+                                 result,
+                                 idsOnly ? Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(object.objectId()))
+                                         : records.record(object));
+        ++appended;
+    };
+
+    if (sub == "rect") {
+        if (limit != 0) {
+            rootCell.queryRegion(minX, minY, maxX, maxY, mode, layerFilter,
+                                 [&appendObject, &appended, &matchesLayers, limit](const LayoutObjectModel& object) {
+                                     if (matchesLayers(object)) {
+                                         appendObject(object);
+                                     }
+                                     return limit < 0 || appended < limit;
+                                 });
+        }
+    } else {
+        // Topmost object first, the order a click cycles through.
+        LayoutSceneNode::QueryScope scope;
+        const QVector<quint64> objectIds = rootCell.matchingObjectIdsAt(coordinates[0],
+                                                                        coordinates[1],
+                                                                        [](const LayoutObjectModel&) { return true; },
+                                                                        layerFilter);
+        for (int i = 0; i < objectIds.size() && (limit < 0 || appended < limit); ++i) {
+            const LayoutObjectModel* object = rootCell.findObjectById(objectIds.at(i));
+            if (object && matchesLayers(*object)) {
+                appendObject(*object);
+            }
+        }
+    }
+
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+int TclSceneCommands::evaluateViewExport(Tcl_Interp* interp,
+                                         const int objc,
+                                         Tcl_Obj* const objv[],
+                                         const Context& context) {
+    if (objc != 5 && objc != 9) {
+        Tcl_SetResult(interp,
+                      const_cast<char*>("usage: view export <png> <width> <height> ?<x1> <y1> <x2> <y2>?"),
+                      TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    int width = 0;
+    int height = 0;
+    if (Tcl_GetIntFromObj(interp, objv[3], &width) != TCL_OK) {
+        Tcl_SetResult(interp, const_cast<char*>("invalid width"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp, objv[4], &height) != TCL_OK) {
+        Tcl_SetResult(interp, const_cast<char*>("invalid height"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    LayoutImageExporter::Region region;
+    if (objc == 9
+        && (!TclArguments::parseInt64(interp, objv[5], region.minX, "x1")
+            || !TclArguments::parseInt64(interp, objv[6], region.minY, "y1")
+            || !TclArguments::parseInt64(interp, objv[7], region.maxX, "x2")
+            || !TclArguments::parseInt64(interp, objv[8], region.maxY, "y2"))) {
+        return TCL_ERROR;
+    }
+
+    const QString filePath = QString::fromUtf8(Tcl_GetString(objv[2]));
+    LayoutImageExporter::Stats stats;
+    QString error;
+    if (!LayoutImageExporter::exportPng(*context.rootCell,
+                                        *context.layers,
+                                        filePath,
+                                        width,
+                                        height,
+                                        objc == 9 ? &region : nullptr,
+                                        stats,
+                                        error)) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+        return TCL_ERROR;
+    }
+
+    Tcl_Obj* const items[] = {
+        Tcl_NewStringObj("file", -1),
+        Tcl_NewStringObj(filePath.toUtf8().constData(), -1),
+        Tcl_NewStringObj("width", -1),
+        Tcl_NewIntObj(width),
+        Tcl_NewStringObj("height", -1),
+        Tcl_NewIntObj(height),
+        Tcl_NewStringObj("primitives", -1),
+        Tcl_NewIntObj(stats.primitiveCount),
+        Tcl_NewStringObj("render_ms", -1),
+        Tcl_NewDoubleObj(stats.renderMs),
+        Tcl_NewStringObj("encode_ms", -1),
+        Tcl_NewDoubleObj(stats.encodeMs)};
+    Tcl_SetObjResult(interp, Tcl_NewListObj(12, items));
+    return TCL_OK;
+}
+
+int TclSceneCommands::createRectangles(Tcl_Interp* interp,
+                                       Tcl_Obj* const objv[],
+                                       const Context& context,
+                                       QVector<std::shared_ptr<LayoutObjectModel>>& outCreated) {
+    LayerDefinition layer;
+    if (!resolveLayer(interp, context, objv[3], objv[4], layer)) {
+        return TCL_ERROR;
+    }
+
+    // The coordinates are read straight from the list's elements; each
+    // rectangle is x1 y1 x2 y2 with corners in any order.
+    int coordinateCount = 0;
+    Tcl_Obj** coordinates = nullptr;
+    if (Tcl_ListObjGetElements(interp, objv[5], &coordinateCount, &coordinates) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (coordinateCount % 4 != 0) {
+        Tcl_SetResult(interp, const_cast<char*>("coordinate count must be a multiple of 4"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    outCreated.reserve(outCreated.size() + coordinateCount / 4);
+    for (int i = 0; i < coordinateCount; i += 4) {
+        Tcl_WideInt corner[4];
+        for (int j = 0; j < 4; ++j) {
+            if (Tcl_GetWideIntFromObj(interp, coordinates[i + j], &corner[j]) != TCL_OK) {
+                Tcl_SetObjResult(interp,
+                                 Tcl_NewStringObj(QString("invalid coordinate at index %1").arg(i + j).toUtf8().constData(), -1));
+                return TCL_ERROR;
+            }
+        }
+        if (corner[0] == corner[2] || corner[1] == corner[3]) {
+            Tcl_SetObjResult(interp,
+                             Tcl_NewStringObj(QString("zero-width or zero-height rectangle at index %1").arg(i).toUtf8().constData(), -1));
+            return TCL_ERROR;
+        }
+        outCreated.push_back(std::make_shared<RectangleObjectModel>(
+            DrawnRectangle{layer.nameId, layer.typeId, corner[0], corner[1], corner[2], corner[3]}));
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(coordinateCount / 4)));
+    return TCL_OK;
+}
+
+int TclSceneCommands::createArray(Tcl_Interp* interp,
+                                  const int objc,
+                                  Tcl_Obj* const objv[],
+                                  const Context& context,
+                                  QVector<std::shared_ptr<LayoutObjectModel>>& outCreated) {
+    static const char* const kArrayUsage =
+        "usage: shape array <LayerName> <LayerType> <x1> <y1> <x2> <y2> <pitchX> <pitchY> <columns> <rows> "
+        "?-exclude <x1> <y1> <x2> <y2>? ?-instance?";
+    if (objc < 12) {
+        Tcl_SetResult(interp, const_cast<char*>(kArrayUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    LayerDefinition layer;
+    if (!resolveLayer(interp, context, objv[2], objv[3], layer)) {
+        return TCL_ERROR;
+    }
+
+    static const char* const kFieldNames[8] = {"x1", "y1", "x2", "y2", "pitchX", "pitchY", "columns", "rows"};
+    qint64 fields[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 8; ++i) {
+        if (!TclArguments::parseInt64(interp, objv[4 + i], fields[i], kFieldNames[i])) {
+            return TCL_ERROR;
+        }
+    }
+
+    bool asInstance = false;
+    bool hasExclusion = false;
+    qint64 exclusion[4] = {0, 0, 0, 0};
+    for (int i = 12; i < objc; ++i) {
+        const QString option = QString::fromUtf8(Tcl_GetString(objv[i]));
+        if (option == "-instance") {
+            asInstance = true;
+        } else if (option == "-exclude" && i + 4 < objc) {
+            for (int j = 0; j < 4; ++j) {
+                if (!TclArguments::parseInt64(interp, objv[i + 1 + j], exclusion[j], kFieldNames[j])) {
+                    return TCL_ERROR;
+                }
+            }
+            hasExclusion = true;
+            i += 4;
+        } else {
+            Tcl_SetResult(interp, const_cast<char*>(kArrayUsage), TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+
+    const qint64 pitchX = fields[4];
+    const qint64 pitchY = fields[5];
+    if (pitchX <= 0 || pitchY <= 0) {
+        Tcl_SetResult(interp, const_cast<char*>("pitch must be positive"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if (fields[6] < 1 || fields[7] < 1 || fields[6] > std::numeric_limits<int>::max()
+        || fields[7] > std::numeric_limits<int>::max()) {
+        Tcl_SetResult(interp, const_cast<char*>("columns and rows must be at least 1"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    const int columns = static_cast<int>(fields[6]);
+    const int rows = static_cast<int>(fields[7]);
+    const qint64 minX = std::min(fields[0], fields[2]);
+    const qint64 minY = std::min(fields[1], fields[3]);
+    const qint64 maxX = std::max(fields[0], fields[2]);
+    const qint64 maxY = std::max(fields[1], fields[3]);
+    if (minX == maxX || minY == maxY) {
+        Tcl_SetResult(interp, const_cast<char*>("rectangle must have nonzero width and height"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    // Excluded elements always form one block of columns x rows, so the
+    // remainder is at most four whole sub-arrays.
+    int excludedFirstColumn = 0;
+    int excludedLastColumn = -1;
+    int excludedFirstRow = 0;
+    int excludedLastRow = -1;
+    if (hasExclusion
+        && (!excludedElementRange(minX, maxX, pitchX, columns,
+                                  std::min(exclusion[0], exclusion[2]), std::max(exclusion[0], exclusion[2]),
+                                  excludedFirstColumn, excludedLastColumn)
+            || !excludedElementRange(minY, maxY, pitchY, rows,
+                                     std::min(exclusion[1], exclusion[3]), std::max(exclusion[1], exclusion[3]),
+                                     excludedFirstRow, excludedLastRow))) {
+        excludedLastColumn = -1;
+        excludedLastRow = -1;
+    }
+    const qint64 excludedCount = static_cast<qint64>(excludedLastColumn - excludedFirstColumn + 1)
+                                 * (excludedLastRow - excludedFirstRow + 1);
+    const qint64 elementCount = static_cast<qint64>(columns) * rows - excludedCount;
+
+    if (asInstance) {
+        // The template at the origin as a shared master, placed as compact
+        // arrays.
+        const std::shared_ptr<const LayoutSceneNode> master = arrayMasterFor(layer, maxX - minX, maxY - minY);
+        const auto appendArray = [&](const int firstColumn, const int firstRow, const int columnCount, const int rowCount) {
+            if (columnCount <= 0 || rowCount <= 0) {
+                return;
+            }
+            LayoutTransform transform;
+            transform.originX = minX + firstColumn * pitchX;
+            transform.originY = minY + firstRow * pitchY;
+            outCreated.push_back(std::make_shared<InstanceObjectModel>(master,
+                                                                    transform,
+                                                                    columnCount,
+                                                                    rowCount,
+                                                                    WorldPoint{pitchX, 0},
+                                                                    WorldPoint{0, pitchY}));
+        };
+        if (excludedCount == 0) {
+            appendArray(0, 0, columns, rows);
+        } else {
+            const int bandRows = excludedLastRow - excludedFirstRow + 1;
+            appendArray(0, 0, columns, excludedFirstRow);
+            appendArray(0, excludedLastRow + 1, columns, rows - excludedLastRow - 1);
+            appendArray(0, excludedFirstRow, excludedFirstColumn, bandRows);
+            appendArray(excludedLastColumn + 1, excludedFirstRow, columns - excludedLastColumn - 1, bandRows);
+        }
+    } else {
+        if (elementCount > std::numeric_limits<int>::max()) {
+            Tcl_SetResult(interp, const_cast<char*>("array too large to expand; use -instance"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+        outCreated.reserve(outCreated.size() + static_cast<int>(elementCount));
+        for (int row = 0; row < rows; ++row) {
+            const bool rowExcluded = row >= excludedFirstRow && row <= excludedLastRow;
+            for (int column = 0; column < columns; ++column) {
+                if (rowExcluded && column >= excludedFirstColumn && column <= excludedLastColumn) {
+                    continue;
+                }
+                const qint64 dx = column * pitchX;
+                const qint64 dy = row * pitchY;
+                outCreated.push_back(std::make_shared<RectangleObjectModel>(
+                    DrawnRectangle{layer.nameId, layer.typeId, minX + dx, minY + dy, maxX + dx, maxY + dy}));
+            }
+        }
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(elementCount)));
+    return TCL_OK;
+}
+
+int TclSceneCommands::describeShape(Tcl_Interp* interp, Tcl_Obj* const objv[], const Context& context) {
+    qint64 objectId = 0;
+    if (!TclArguments::parseInt64(interp, objv[2], objectId, "id")) {
+        return TCL_ERROR;
+    }
+
+    LayoutSceneNode::QueryScope scope;
+    const LayoutObjectModel* object = context.rootCell->findObjectById(static_cast<quint64>(objectId));
+    if (!object) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(QString("unknown object id: %1").arg(objectId).toUtf8().constData(), -1));
+        return TCL_ERROR;
+    }
+
+    ObjectRecordBuilder records(*context.layers);
+    Tcl_Obj* layerName = records.emptyWord();
+    Tcl_Obj* layerType = records.emptyWord();
+    records.layerWords(*object, layerName, layerType);
+    LayoutObjectModel::Bounds bounds;
+    object->tryGetBounds(bounds);
+
+    Tcl_Obj* result = Tcl_NewListObj(0, nullptr);
+    const auto appendField = [result](const char* key, Tcl_Obj* value) {
+        Tcl_ListObjAppendElement(nullptr, result, Tcl_NewStringObj(key, -1));
+        Tcl_ListObjAppendElement(nullptr, result, value);
+    };
+    appendField("id", Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(object->objectId())));
+    appendField("kind", records.kindWord(*object));
+    appendField("layer", layerName);
+    appendField("type", layerType);
+    appendField("bounds", newPointListObj({{bounds.minX, bounds.minY}, {bounds.maxX, bounds.maxY}}));
+    if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(object)) {
+        appendField("vertices", newPointListObj(polygon->vertices()));
+    } else if (const auto* path = dynamic_cast<const PathObjectModel*>(object)) {
+        appendField("points", newPointListObj(path->points()));
+        appendField("width", Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(path->width())));
+    } else if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(object)) {
+        const LayoutTransform& transform = instance->transform();
+        appendField("master", Tcl_NewStringObj(instance->master()->name().toUtf8().constData(), -1));
+        appendField("origin", newPointListObj({{transform.originX, transform.originY}}));
+        appendField("columns", Tcl_NewIntObj(instance->columns()));
+        appendField("rows", Tcl_NewIntObj(instance->rows()));
+    }
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+bool TclSceneCommands::resolveLayer(Tcl_Interp* interp,
+                                    const Context& context,
+                                    Tcl_Obj* layerName,
+                                    Tcl_Obj* layerType,
+                                    LayerDefinition& outLayer) {
+    QString error;
+    if (!LayerManager::findLayer(*context.layers,
+                                 QString::fromUtf8(Tcl_GetString(layerName)),
+                                 QString::fromUtf8(Tcl_GetString(layerType)),
+                                 outLayer,
+                                 error)) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(error.toUtf8().constData(), -1));
+        return false;
+    }
+    return true;
+}
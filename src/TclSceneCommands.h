@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QVector>
+#include <memory>
+#include <tcl.h>
+
+#include "LayerManager.h"
+#include "LayoutSceneModel.h"
+
+// TclSceneCommands implements the `shape` and `query` command families and
+// `view export` on a plain scene and layer palette, so the console's
+// interpreter and background script interpreters (TclScriptWorker) share
+// one implementation. Nothing here touches widgets or documents: shapes
+// that a command creates are handed back for the caller to insert as one
+// edit.
+class TclSceneCommands {
+public:
+    // The scene a command reads and the palette that resolves layer names.
+    struct Context {
+        const LayoutSceneNode* rootCell{nullptr};
+        const QVector<LayerDefinition>* layers{nullptr};
+    };
+
+    // `shape create rect`, `shape array` and `shape info`. Objects created
+    // by the first two are appended to outCreated in paint order and the
+    // result is their element count.
+    static int evaluateShape(Tcl_Interp* interp,
+                             int objc,
+                             Tcl_Obj* const objv[],
+                             const Context& context,
+                             QVector<std::shared_ptr<LayoutObjectModel>>& outCreated);
+    // `query rect`, `query point` and `query count`.
+    static int evaluateQuery(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], const Context& context);
+    // `view export <png> <width> <height> ?<x1> <y1> <x2> <y2>?`, rendered
+    // offscreen by LayoutImageExporter on the layers visible in the palette.
+    static int evaluateViewExport(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[], const Context& context);
+
+private:
+    static int createRectangles(Tcl_Interp* interp,
+                                Tcl_Obj* const objv[],
+                                const Context& context,
+                                QVector<std::shared_ptr<LayoutObjectModel>>& outCreated);
+    static int createArray(Tcl_Interp* interp,
+                           int objc,
+                           Tcl_Obj* const objv[],
+                           const Context& context,
+                           QVector<std::shared_ptr<LayoutObjectModel>>& outCreated);
+    static int describeShape(Tcl_Interp* interp, Tcl_Obj* const objv[], const Context& context);
+
+    static bool resolveLayer(Tcl_Interp* interp,
+                             const Context& context,
+                             Tcl_Obj* layerName,
+                             Tcl_Obj* layerType,
+                             LayerDefinition& outLayer);
+};
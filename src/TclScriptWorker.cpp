@@ -0,0 +1,267 @@
+#include "TclScriptWorker.h"
+
+#include "TclSceneCommands.h"
+
+#include <algorithm>
+
+TclScriptWorker::TclScriptWorker(std::unique_ptr<LayoutSceneNode> scene,
+                                 QVector<LayerDefinition> layers,
+                                 QObject* parent)
+    : QObject(parent),
+      m_scene(std::move(scene)),
+      m_layers(std::move(layers)) {}
+
+TclScriptWorker::~TclScriptWorker() {
+    cancel();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void TclScriptWorker::start(const QString& scriptPath) {
+    m_scriptPath = scriptPath;
+    m_running = true;
+    m_thread = std::thread(&TclScriptWorker::run, this);
+}
+
+void TclScriptWorker::cancel() {
+    m_cancelRequested = true;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_interp) {
+        // Thread-safe by contract; the interpreter stays alive until run()
+        // clears m_interp under the same lock.
+        Tcl_CancelEval(m_interp, nullptr, nullptr, TCL_CANCEL_UNWIND);
+    }
+}
+
+bool TclScriptWorker::isRunning() const {
+    return m_running;
+}
+
+const QString& TclScriptWorker::scriptPath() const {
+    return m_scriptPath;
+}
+
+TclScriptWorker::Progress TclScriptWorker::progress() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_progressSignalPending = false;
+    return m_progress;
+}
+
+QVector<QVector<std::shared_ptr<LayoutObjectModel>>> TclScriptWorker::takeBatches() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    QVector<QVector<std::shared_ptr<LayoutObjectModel>>> batches;
+    batches.swap(m_batches);
+    return batches;
+}
+
+int TclScriptWorker::resultCode() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_resultCode;
+}
+
+QString TclScriptWorker::resultText() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_resultText;
+}
+
+int TclScriptWorker::ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclScriptWorker*>(clientData)->handleShapeCommand(interp, objc, objv);
+}
+
+int TclScriptWorker::QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclScriptWorker*>(clientData)->handleQueryCommand(interp, objc, objv);
+}
+
+int TclScriptWorker::ProgressCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclScriptWorker*>(clientData)->handleProgressCommand(interp, objc, objv);
+}
+
+int TclScriptWorker::TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    return static_cast<TclScriptWorker*>(clientData)->handleTransactionCommand(interp, objc, objv);
+}
+
+int TclScriptWorker::handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    const TclSceneCommands::Context context{m_scene.get(), &m_layers};
+    QVector<std::shared_ptr<LayoutObjectModel>> created;
+    if (TclSceneCommands::evaluateShape(interp, objc, objv, context, created) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (created.isEmpty()) {
+        return TCL_OK;
+    }
+
+    // The copy gets the shapes too, so the script's later queries see them.
+    m_scene->addObjects(created);
+    m_pending += created;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress.createdObjectCount += created.size();
+    }
+    flushPending(false);
+    return TCL_OK;
+}
+
+int TclScriptWorker::handleQueryCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    const TclSceneCommands::Context context{m_scene.get(), &m_layers};
+    return TclSceneCommands::evaluateQuery(interp, objc, objv, context);
+}
+
+int TclScriptWorker::handleProgressCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    double fraction = 0.0;
+    if (objc < 2 || objc > 3) {
+        Tcl_SetResult(interp, const_cast<char*>("usage: progress <fraction> ?<message>?"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if (Tcl_GetDoubleFromObj(interp, objv[1], &fraction) != TCL_OK) {
+        Tcl_SetResult(interp, const_cast<char*>("invalid fraction"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress.fraction = std::clamp(fraction, 0.0, 1.0);
+        if (objc == 3) {
+            m_progress.message = QString::fromUtf8(Tcl_GetString(objv[2]));
+        }
+        // One signal until the owner reads the progress, however often the
+        // script reports.
+        notify = !m_progressSignalPending;
+        m_progressSignalPending = true;
+    }
+    if (notify) {
+        emit progressChanged();
+    }
+    flushPending(false);
+    return TCL_OK;
+}
+
+int TclScriptWorker::handleTransactionCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]) {
+    static const char* const kTransactionUsage = "usage: transaction <begin|commit|abort>";
+    if (objc != 2) {
+        Tcl_SetResult(interp, const_cast<char*>(kTransactionUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    const QString sub = QString::fromUtf8(Tcl_GetString(objv[1]));
+    if (sub == "begin") {
+        if (m_inTransaction) {
+            Tcl_SetResult(interp, const_cast<char*>("transaction already in progress"), TCL_STATIC);
+            return TCL_ERROR;
+        }
+        // Shapes from before the transaction go out on their own.
+        flushPending(true);
+        m_inTransaction = true;
+        Tcl_ResetResult(interp);
+        return TCL_OK;
+    }
+
+    if (sub != "commit" && sub != "abort") {
+        Tcl_SetResult(interp, const_cast<char*>(kTransactionUsage), TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if (!m_inTransaction) {
+        Tcl_SetResult(interp, const_cast<char*>("no transaction in progress"), TCL_STATIC);
+        return TCL_ERROR;
+    }
+
+    int count = 0;
+    if (sub == "commit") {
+        count = m_pending.size();
+        m_inTransaction = false;
+        flushPending(true);
+    } else {
+        count = abortTransaction();
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(count)));
+    return TCL_OK;
+}
+
+void TclScriptWorker::run() {
+    // A Tcl interpreter is bound to the thread that created it.
+    Tcl_Interp* interp = Tcl_CreateInterp();
+    Tcl_CreateObjCommand(interp, "shape", &TclScriptWorker::ShapeCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(interp, "query", &TclScriptWorker::QueryCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(interp, "progress", &TclScriptWorker::ProgressCommandBridge, this, nullptr);
+    Tcl_CreateObjCommand(interp, "transaction", &TclScriptWorker::TransactionCommandBridge, this, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interp = interp;
+    }
+
+    m_lastFlush = std::chrono::steady_clock::now();
+    int rc = TCL_ERROR;
+    QString text = "script cancelled";
+    if (!m_cancelRequested) {
+        const QByteArray path = m_scriptPath.toUtf8();
+        rc = Tcl_EvalFile(interp, path.constData());
+        if (rc == TCL_OK) {
+            text = QString::fromUtf8(Tcl_GetStringResult(interp));
+        } else {
+            const char* errorInfo = Tcl_GetVar(interp, "errorInfo", TCL_GLOBAL_ONLY);
+            text = QString::fromUtf8(errorInfo ? errorInfo : Tcl_GetStringResult(interp));
+        }
+    }
+    // Shapes created before a failure or cancellation are kept, unless they
+    // belong to an unfinished transaction.
+    if (m_inTransaction) {
+        abortTransaction();
+    }
+    flushPending(true);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_interp = nullptr;
+        m_resultCode = rc;
+        m_resultText = text;
+    }
+    Tcl_DeleteInterp(interp);
+    Tcl_FinalizeThread();
+    m_running = false;
+    emit finished();
+}
+
+void TclScriptWorker::flushPending(const bool force) {
+    if (m_inTransaction) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const bool due = m_pending.size() >= kBatchObjectCount
+                     || now - m_lastFlush >= std::chrono::milliseconds(kBatchIntervalMs);
+    if (m_pending.isEmpty() || (!force && !due)) {
+        return;
+    }
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Only the first batch the owner has not collected yet signals.
+        notify = m_batches.isEmpty();
+        m_batches.push_back(std::move(m_pending));
+    }
+    m_pending = {};
+    m_lastFlush = now;
+    if (notify) {
+        emit batchesReady();
+    }
+}
+
+int TclScriptWorker::abortTransaction() {
+    QVector<quint64> objectIds;
+    objectIds.reserve(m_pending.size());
+    for (const std::shared_ptr<LayoutObjectModel>& object : m_pending) {
+        objectIds.push_back(object->objectId());
+    }
+    m_scene->removeObjectsByIds(objectIds);
+
+    const int count = m_pending.size();
+    m_pending = {};
+    m_inTransaction = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress.createdObjectCount -= count;
+    }
+    return count;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tcl.h>
+
+#include "LayerManager.h"
+#include "LayoutSceneModel.h"
+
+// TclScriptWorker runs one Tcl script file on its own thread, in a private
+// interpreter, so long generator or batch-query scripts leave every editor
+// responsive. Interactive commands keep using the console's interpreter.
+//
+// The script sees the scene-level `shape` and `query` commands (see
+// TclSceneCommands) plus `progress <fraction> ?<message>?`. Queries read the
+// copy of the document taken at start, with the script's own shapes added;
+// edits made in the editors meanwhile are not visible to it. Created shapes
+// are queued in batches of up to kBatchObjectCount objects or
+// kBatchIntervalMs worth of work. The owner drains them with takeBatches()
+// and applies each one to the document as one edit.
+//
+// `transaction begin|commit|abort` groups a script's shapes: between begin
+// and commit nothing is handed over, commit queues them as a single batch
+// and abort drops them from the copy again. A transaction still open when
+// the script ends is aborted.
+//
+// Signals are emitted from the worker thread and carry no data; receivers
+// read the state through the accessors, which any thread may call.
+class TclScriptWorker : public QObject {
+    Q_OBJECT
+public:
+    struct Progress {
+        double fraction{0.0};
+        QString message;
+        qint64 createdObjectCount{0};
+    };
+
+    static constexpr int kBatchObjectCount = 65536;
+    static constexpr int kBatchIntervalMs = 100;
+
+    // scene becomes the worker's own copy of the document
+    // (LayoutSceneNode::detachedCopy()); layers resolves layer names.
+    TclScriptWorker(std::unique_ptr<LayoutSceneNode> scene,
+                    QVector<LayerDefinition> layers,
+                    QObject* parent = nullptr);
+    // Cancels a running script and waits for the thread.
+    ~TclScriptWorker() override;
+    TclScriptWorker(const TclScriptWorker&) = delete;
+    TclScriptWorker& operator=(const TclScriptWorker&) = delete;
+
+    // Evaluates scriptPath on the worker thread. Call once.
+    void start(const QString& scriptPath);
+    // Unwinds the script at its next command (Tcl_CancelEval).
+    void cancel();
+    bool isRunning() const;
+    const QString& scriptPath() const;
+    Progress progress() const;
+    // Shape batches created since the last call, oldest first.
+    QVector<QVector<std::shared_ptr<LayoutObjectModel>>> takeBatches();
+    // Once finished: the script's Tcl return code, and its result or error
+    // trace.
+    int resultCode() const;
+    QString resultText() const;
+
+signals:
+    void batchesReady();
+    void progressChanged();
+    void finished();
+
+private:
+    static int ShapeCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int QueryCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int ProgressCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    static int TransactionCommandBridge(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+
+    int handleShapeCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleQueryCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleProgressCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+    int handleTransactionCommand(Tcl_Interp* interp, int objc, Tcl_Obj* const objv[]);
+
+    void run();
+    // Hands the pending shapes to the owner once a batch is due, or always
+    // when force is set; held back while a transaction is open.
+    void flushPending(bool force);
+    // Removes the open transaction's shapes from the copy and drops them.
+    int abortTransaction();
+
+    // Worker thread only.
+    std::unique_ptr<LayoutSceneNode> m_scene;
+    const QVector<LayerDefinition> m_layers;
+    QVector<std::shared_ptr<LayoutObjectModel>> m_pending;
+    std::chrono::steady_clock::time_point m_lastFlush;
+    bool m_inTransaction{false};
+
+    QString m_scriptPath;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_cancelRequested{false};
+
+    // Guards everything below.
+    mutable std::mutex m_mutex;
+    Tcl_Interp* m_interp{nullptr};
+    QVector<QVector<std::shared_ptr<LayoutObjectModel>>> m_batches;
+    Progress m_progress;
+    // Set while a progressChanged() is unanswered by progress().
+    mutable bool m_progressSignalPending{false};
+    int m_resultCode{TCL_OK};
+    QString m_resultText;
+};
@@ -0,0 +1,167 @@
+#include "TranscriptFilterSet.h"
+
+bool TranscriptFilterSet::add(const QString& pattern) {
+    if (m_patterns.contains(pattern, Qt::CaseInsensitive)) {
+        return false;
+    }
+
+    m_patterns.push_back(pattern);
+    m_compiled.push_back(compile(pattern));
+    return true;
+}
+
+int TranscriptFilterSet::remove(const QString& pattern) {
+    int removed = 0;
+    for (int i = m_patterns.size() - 1; i >= 0; --i) {
+        if (m_patterns.at(i) == pattern) {
+            m_patterns.removeAt(i);
+            m_compiled.removeAt(i);
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+void TranscriptFilterSet::clear() {
+    m_patterns.clear();
+    m_compiled.clear();
+}
+
+const QStringList& TranscriptFilterSet::patterns() const {
+    return m_patterns;
+}
+
+bool TranscriptFilterSet::matches(const QString& command) const {
+    for (const CompiledPattern& pattern : m_compiled) {
+        if (matchesPattern(pattern, command)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TranscriptFilterSet::matchesAllWithPrefix(const QString& prefix) const {
+    // A pattern qualifies when its leading single-character tokens match the
+    // start of prefix one to one and only stars follow.
+    for (const CompiledPattern& pattern : m_compiled) {
+        const int tokenCount = pattern.tokens.size();
+        int consumed = 0;
+        while (consumed < tokenCount && consumed < prefix.size() &&
+               pattern.tokens.at(consumed).kind != Token::Kind::AnyRun &&
+               matchesToken(pattern, pattern.tokens.at(consumed), prefix.at(consumed).toCaseFolded())) {
+            ++consumed;
+        }
+        if (consumed == tokenCount) {
+            continue;
+        }
+
+        bool onlyStars = true;
+        for (int i = consumed; i < tokenCount && onlyStars; ++i) {
+            onlyStars = pattern.tokens.at(i).kind == Token::Kind::AnyRun;
+        }
+        if (onlyStars) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TranscriptFilterSet::CompiledPattern TranscriptFilterSet::compile(const QString& pattern) {
+    CompiledPattern compiled;
+    const int length = pattern.size();
+    for (int i = 0; i < length; ++i) {
+        const QChar ch = pattern.at(i);
+        Token token;
+        if (ch == '*') {
+            // Runs of stars match the same as one.
+            if (!compiled.tokens.isEmpty() && compiled.tokens.last().kind == Token::Kind::AnyRun) {
+                continue;
+            }
+            token.kind = Token::Kind::AnyRun;
+        } else if (ch == '?') {
+            token.kind = Token::Kind::AnyChar;
+        } else if (ch == '[') {
+            int position = i + 1;
+            const bool negated = position < length && (pattern.at(position) == '!' || pattern.at(position) == '^');
+            if (negated) {
+                ++position;
+            }
+            // The first class character may be ], so "[]]" matches a bracket.
+            const int close = position < length ? pattern.indexOf(']', position + 1) : -1;
+            if (close < 0) {
+                token.literal = ch.toCaseFolded();
+            } else {
+                token.kind = Token::Kind::Class;
+                token.negated = negated;
+                token.firstRange = compiled.ranges.size();
+                while (position < close) {
+                    const QChar low = pattern.at(position).toCaseFolded();
+                    QChar high = low;
+                    if (position + 2 < close && pattern.at(position + 1) == '-') {
+                        high = pattern.at(position + 2).toCaseFolded();
+                        position += 3;
+                    } else {
+                        ++position;
+                    }
+                    compiled.ranges.push_back(qMakePair(low, high));
+                }
+                token.endRange = compiled.ranges.size();
+                i = close;
+            }
+        } else {
+            token.literal = ch.toCaseFolded();
+        }
+        compiled.tokens.push_back(token);
+    }
+    return compiled;
+}
+
+bool TranscriptFilterSet::matchesToken(const CompiledPattern& pattern, const Token& token, const QChar folded) {
+    switch (token.kind) {
+    case Token::Kind::Literal:
+        return folded == token.literal;
+    case Token::Kind::AnyChar:
+        return true;
+    case Token::Kind::Class: {
+        bool inClass = false;
+        for (int i = token.firstRange; i < token.endRange && !inClass; ++i) {
+            const QPair<QChar, QChar>& range = pattern.ranges.at(i);
+            inClass = folded.unicode() >= range.first.unicode() && folded.unicode() <= range.second.unicode();
+        }
+        return inClass != token.negated;
+    }
+    case Token::Kind::AnyRun:
+        break;
+    }
+    return false;
+}
+
+bool TranscriptFilterSet::matchesPattern(const CompiledPattern& pattern, const QString& command) {
+    // Greedy glob match that backtracks only to the most recent star; every
+    // other token consumes exactly one character, so this is exact.
+    const int tokenCount = pattern.tokens.size();
+    const int length = command.size();
+    int token = 0;
+    int position = 0;
+    int starToken = -1;
+    int starPosition = 0;
+    while (position < length) {
+        if (token < tokenCount && pattern.tokens.at(token).kind == Token::Kind::AnyRun) {
+            starToken = token++;
+            starPosition = position;
+        } else if (token < tokenCount &&
+                   matchesToken(pattern, pattern.tokens.at(token), command.at(position).toCaseFolded())) {
+            ++token;
+            ++position;
+        } else if (starToken >= 0) {
+            token = starToken + 1;
+            position = ++starPosition;
+        } else {
+            return false;
+        }
+    }
+    while (token < tokenCount && pattern.tokens.at(token).kind == Token::Kind::AnyRun) {
+        ++token;
+    }
+    return token == tokenCount;
+}
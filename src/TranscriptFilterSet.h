@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QChar>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// TranscriptFilterSet holds the glob patterns of commands that are not
+// echoed to the console transcript. Patterns are compiled when the set
+// changes, so matching a command allocates nothing.
+//
+// Globs match the whole command and ignore case: * matches any run of
+// characters, ? any one character, and [abc], [a-z] or [!abc] one character
+// of a class. A [ without a closing ] is literal.
+class TranscriptFilterSet {
+public:
+    // Returns false when the pattern (ignoring case) is already present.
+    bool add(const QString& pattern);
+    // Returns the number of patterns equal to pattern that were removed.
+    int remove(const QString& pattern);
+    void clear();
+    const QStringList& patterns() const;
+
+    bool matches(const QString& command) const;
+    // True when every command starting with prefix matches some pattern,
+    // decided from the patterns alone (e.g. "canvas *" for "canvas move ").
+    bool matchesAllWithPrefix(const QString& prefix) const;
+
+private:
+    struct Token {
+        enum class Kind { Literal, AnyChar, AnyRun, Class };
+        Kind kind{Kind::Literal};
+        QChar literal;      // Case-folded; Literal only.
+        bool negated{false};
+        int firstRange{0};  // Class only: ranges [firstRange, endRange).
+        int endRange{0};
+    };
+
+    struct CompiledPattern {
+        QVector<Token> tokens;
+        // Case-folded inclusive character ranges of every class.
+        QVector<QPair<QChar, QChar>> ranges;
+    };
+
+    static CompiledPattern compile(const QString& pattern);
+    static bool matchesToken(const CompiledPattern& pattern, const Token& token, QChar folded);
+    static bool matchesPattern(const CompiledPattern& pattern, const QString& command);
+
+    QStringList m_patterns;
+    QVector<CompiledPattern> m_compiled;
+};
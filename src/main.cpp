@@ -1,12 +1,36 @@
 #include <QApplication>
+#include <QCoreApplication>
+#include <QStringList>
 
+#include <cstdio>
+#include <cstring>
+
+#include "TclBatchRunner.h"
 #include "TclConsoleWindow.h"
 
 // Application entry point.
 //
 // This binary launches a Qt event loop and creates the Tcl interpreter window,
-// which in turn opens the child layout editor window.
+// which in turn opens the child layout editor window. `-batch <script>`
+// instead runs the script headless and exits with its status.
 int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strcmp(argv[1], "-batch") == 0) {
+        if (argc < 3) {
+            std::fprintf(stderr, "usage: %s -batch <script> ?<arg> ...?\n", argv[0]);
+            return 2;
+        }
+
+        // No QApplication: no display connection, widgets or GL context.
+        QCoreApplication app(argc, argv);
+        Tcl_FindExecutable(argv[0]);
+        QStringList arguments;
+        for (int i = 3; i < argc; ++i) {
+            arguments.push_back(QString::fromLocal8Bit(argv[i]));
+        }
+        TclBatchRunner runner;
+        return runner.run(QString::fromLocal8Bit(argv[2]), arguments);
+    }
+
     QApplication app(argc, argv);
 
     // The interpreter window owns the primary command/control surface.
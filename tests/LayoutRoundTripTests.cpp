@@ -0,0 +1,408 @@
+// Round-trip checks for the layout file formats and the autosave journal:
+// .l2snap save and eager/lazy reopen, GDSII save and reopen, OASIS loading
+// with and without CBLOCKs, and journal replay after edits. Runs headless
+// (Qt Core only); exits non-zero when a check fails.
+
+#include "LayoutDocument.h"
+#include "LayoutSceneModel.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+int g_failures = 0;
+
+void check(const bool condition, const QString& what) {
+    if (!condition) {
+        ++g_failures;
+        std::fprintf(stderr, "FAIL: %s\n", what.toUtf8().constData());
+    }
+}
+
+QString describeNode(const LayoutSceneNode& node);
+
+QString describePoints(const QVector<WorldPoint>& points) {
+    QStringList out;
+    for (const WorldPoint& point : points) {
+        out << QString("%1,%2").arg(point.x).arg(point.y);
+    }
+    return out.join(' ');
+}
+
+// One line per object with its kind, layer and geometry; instances expand
+// their master, so equal descriptions mean equal hierarchies.
+QString describeObject(const LayoutObjectModel& object) {
+    quint32 layerNameId = 0;
+    quint32 layerTypeId = 0;
+    object.tryGetLayer(layerNameId, layerTypeId);
+    const QString layer = QString("%1/%2").arg(layerNameId).arg(layerTypeId);
+    if (const DrawnRectangle* rectangle = object.asRectangle()) {
+        return QString("rect %1 %2 %3 %4 %5")
+            .arg(layer)
+            .arg(rectangle->x1)
+            .arg(rectangle->y1)
+            .arg(rectangle->x2)
+            .arg(rectangle->y2);
+    }
+    if (const auto* polygon = dynamic_cast<const PolygonObjectModel*>(&object)) {
+        return QString("polygon %1 %2").arg(layer, describePoints(polygon->vertices()));
+    }
+    if (const auto* path = dynamic_cast<const PathObjectModel*>(&object)) {
+        return QString("path %1 w%2 e%3,%4 %5")
+            .arg(layer)
+            .arg(path->width())
+            .arg(path->beginExtension())
+            .arg(path->endExtension())
+            .arg(describePoints(path->points()));
+    }
+    if (const auto* instance = dynamic_cast<const InstanceObjectModel*>(&object)) {
+        const LayoutTransform& transform = instance->transform();
+        return QString("instance %1,%2 m%3 a%4 %5 %6x%7 %8,%9 %10,%11 [%12]")
+            .arg(transform.originX)
+            .arg(transform.originY)
+            .arg(transform.magnification)
+            .arg(transform.angleDegrees)
+            .arg(transform.mirrorX ? "mirror" : "plain")
+            .arg(instance->columns())
+            .arg(instance->rows())
+            .arg(instance->columnStep().x)
+            .arg(instance->columnStep().y)
+            .arg(instance->rowStep().x)
+            .arg(instance->rowStep().y)
+            .arg(describeNode(*instance->master()));
+    }
+    return "unknown";
+}
+
+QString describeNode(const LayoutSceneNode& node) {
+    // Keeps lazy masters loaded while their objects are walked.
+    LayoutSceneNode::QueryScope scope;
+    QStringList out;
+    out << node.name();
+    for (const std::shared_ptr<LayoutObjectModel>& object : node.objects()) {
+        out << describeObject(*object);
+    }
+    return out.join("; ");
+}
+
+QVector<quint64> rootObjectIds(const LayoutDocument& document) {
+    QVector<quint64> ids;
+    for (const std::shared_ptr<LayoutObjectModel>& object : document.rootCell()->objects()) {
+        ids.push_back(object->objectId());
+    }
+    return ids;
+}
+
+QByteArray readFile(const QString& path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+bool writeFile(const QString& path, const QByteArray& data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+std::shared_ptr<LayoutObjectModel> rectangle(const quint32 layer, const qint64 x1, const qint64 y1, const qint64 x2, const qint64 y2) {
+    return std::make_shared<RectangleObjectModel>(DrawnRectangle{layer, 0, x1, y1, x2, y2});
+}
+
+// A two-level hierarchy with every object kind: a leaf cell with a
+// rectangle, polygon and path, a cell placing it rotated and as an array,
+// and root shapes and placements of both.
+QVector<std::shared_ptr<LayoutObjectModel>> buildDesign() {
+    auto leaf = std::make_shared<LayoutSceneNode>();
+    leaf->setName("LEAF");
+    leaf->addObjects({
+        rectangle(1, 0, 0, 100, 50),
+        std::make_shared<PolygonObjectModel>(2, 0, QVector<WorldPoint>{{0, 0}, {80, 0}, {80, 40}, {40, 80}, {0, 40}}),
+        std::make_shared<PathObjectModel>(3, 1, QVector<WorldPoint>{{0, 0}, {0, 200}, {150, 200}}, 20, 10, 10),
+    });
+
+    LayoutTransform rotated;
+    rotated.originX = 1000;
+    rotated.originY = 500;
+    rotated.angleDegrees = 90.0;
+    rotated.mirrorX = true;
+    auto block = std::make_shared<LayoutSceneNode>();
+    block->setName("BLOCK");
+    block->addObjects({
+        rectangle(4, -50, -50, 1200, 1200),
+        std::make_shared<InstanceObjectModel>(leaf, rotated),
+        std::make_shared<InstanceObjectModel>(leaf, LayoutTransform(), 4, 3, WorldPoint{300, 0}, WorldPoint{0, 400}),
+    });
+
+    LayoutTransform shifted;
+    shifted.originX = 5000;
+    shifted.originY = -2000;
+    return {
+        rectangle(1, -500, -500, -100, -100),
+        std::make_shared<PathObjectModel>(2, 0, QVector<WorldPoint>{{-1000, 0}, {-1000, 3000}}, 40, 0, 0),
+        std::make_shared<InstanceObjectModel>(block, shifted),
+        std::make_shared<InstanceObjectModel>(block, LayoutTransform(), 2, 2, WorldPoint{2000, 0}, WorldPoint{0, 2000}),
+        std::make_shared<InstanceObjectModel>(leaf, shifted),
+    };
+}
+
+void testSnapshotRoundTrip(const QTemporaryDir& dir) {
+    LayoutDocument original;
+    original.addObjects(buildDesign());
+    const QString expected = describeNode(*original.rootCell());
+
+    QString summary;
+    QString error;
+    const QString path = dir.filePath("design.l2snap");
+    check(original.saveLayout(path, summary, error), "snapshot save: " + error);
+
+    for (const bool lazy : {false, true}) {
+        const QString mode = lazy ? "lazy" : "eager";
+        LayoutDocument reopened;
+        check(reopened.openLayout(path, lazy, summary, error), "snapshot open " + mode + ": " + error);
+        check(summary.contains("cells load on demand") == lazy, "snapshot " + mode + " summary: " + summary);
+        check(describeNode(*reopened.rootCell()) == expected, "snapshot " + mode + " reopen differs");
+
+        // Saving the reopened design must reproduce the file exactly.
+        const QString resaved = dir.filePath(QString("design.%1.l2snap").arg(mode));
+        check(reopened.saveLayout(resaved, summary, error), "snapshot resave " + mode + ": " + error);
+        check(readFile(resaved) == readFile(path), "snapshot resave " + mode + " differs");
+    }
+
+    const QString truncated = dir.filePath("truncated.l2snap");
+    check(writeFile(truncated, readFile(path).left(200)), "write truncated snapshot");
+    LayoutDocument broken;
+    check(!broken.openLayout(truncated, false, summary, error), "truncated snapshot was accepted");
+    check(!broken.openLayout(truncated, true, summary, error), "truncated snapshot was accepted lazily");
+}
+
+void testGdsRoundTrip(const QTemporaryDir& dir) {
+    LayoutDocument original;
+    original.addObjects(buildDesign());
+    const QString expected = describeNode(*original.rootCell());
+
+    QString summary;
+    QString error;
+    const QString path = dir.filePath("design.gds");
+    check(original.saveLayout(path, summary, error), "gds save: " + error);
+
+    for (const bool lazy : {false, true}) {
+        const QString mode = lazy ? "lazy" : "eager";
+        LayoutDocument reopened;
+        check(reopened.openLayout(path, lazy, summary, error), "gds open " + mode + ": " + error);
+        check(summary.startsWith("GDSII"), "gds " + mode + " summary: " + summary);
+        check(describeNode(*reopened.rootCell()) == expected, "gds " + mode + " reopen differs");
+    }
+}
+
+// OASIS encoding helpers for the records the test files use.
+void appendUnsigned(QByteArray& out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void appendSigned(QByteArray& out, const qint64 value) {
+    const quint64 magnitude = static_cast<quint64>(value < 0 ? -value : value);
+    appendUnsigned(out, (magnitude << 1) | (value < 0 ? 1 : 0));
+}
+
+void appendString(QByteArray& out, const QByteArray& text) {
+    appendUnsigned(out, static_cast<quint64>(text.size()));
+    out.append(text);
+}
+
+QByteArray rawDeflate(const QByteArray& data) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    QByteArray out(static_cast<int>(deflateBound(&stream, static_cast<uLong>(data.size()))), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(static_cast<int>(stream.total_out));
+    deflateEnd(&stream);
+    return out;
+}
+
+// cellCount cells C<i> of 30 rectangles each, then TOP placing C0 twice.
+// Objects are counted as decoded, so placements are not included.
+// With compressed every cell is its own CBLOCK, more than the reader
+// inflates ahead of its builder at once; corruptCell damages one of them.
+QByteArray buildOasis(const int cellCount, const bool compressed, const int corruptCell = -1) {
+    QByteArray out("%SEMI-OASIS\r\n");
+    appendUnsigned(out, 1);
+    appendString(out, "1.0");
+    appendUnsigned(out, 0);
+    appendUnsigned(out, 1000);
+    appendUnsigned(out, 1);
+
+    for (int cell = 0; cell < cellCount; ++cell) {
+        QByteArray records;
+        appendUnsigned(records, 14);
+        appendString(records, QString("C%1").arg(cell).toLatin1());
+        for (int i = 0; i < 30; ++i) {
+            // RECTANGLE with width, height, x, y, datatype and layer.
+            appendUnsigned(records, 20);
+            records.append(static_cast<char>(0x7b));
+            appendUnsigned(records, static_cast<quint64>(1 + cell % 4));
+            appendUnsigned(records, 0);
+            appendUnsigned(records, 10);
+            appendUnsigned(records, 20);
+            appendSigned(records, cell * 1000 + i * 15);
+            appendSigned(records, -i * 7);
+        }
+
+        if (!compressed) {
+            out.append(records);
+            continue;
+        }
+        QByteArray payload = rawDeflate(records);
+        if (cell == corruptCell) {
+            payload.truncate(payload.size() / 2);
+            payload.append("\xff\xff\xff\xff", 4);
+        }
+        appendUnsigned(out, 34);
+        appendUnsigned(out, 0);
+        appendUnsigned(out, static_cast<quint64>(records.size()));
+        appendUnsigned(out, static_cast<quint64>(payload.size()));
+        out.append(payload);
+    }
+
+    appendUnsigned(out, 14);
+    appendString(out, "TOP");
+    for (const qint64 x : {0, 50000}) {
+        // PLACEMENT by cell name with x and y.
+        appendUnsigned(out, 17);
+        out.append(static_cast<char>(0xb0));
+        appendString(out, "C0");
+        appendSigned(out, x);
+        appendSigned(out, 3000);
+    }
+
+    // END with an empty offset table, padding string and validation.
+    appendUnsigned(out, 2);
+    for (int i = 0; i < 14; ++i) {
+        appendUnsigned(out, 0);
+    }
+    return out;
+}
+
+void testOasisLoading(const QTemporaryDir& dir) {
+    const int cellCount = 40;
+    const QString plainPath = dir.filePath("plain.oas");
+    const QString compressedPath = dir.filePath("compressed.oas");
+    const QString corruptPath = dir.filePath("corrupt.oas");
+    check(writeFile(plainPath, buildOasis(cellCount, false)), "write plain oasis");
+    check(writeFile(compressedPath, buildOasis(cellCount, true)), "write compressed oasis");
+    check(writeFile(corruptPath, buildOasis(cellCount, true, 25)), "write corrupt oasis");
+
+    QString summary;
+    QString error;
+    LayoutDocument plain;
+    check(plain.openLayout(plainPath, false, summary, error), "oasis open: " + error);
+    check(summary == QString("OASIS %1: %2 cells, %3 objects, %4 top cells, 0 skipped elements")
+                         .arg(plainPath)
+                         .arg(cellCount + 1)
+                         .arg(cellCount * 30)
+                         .arg(cellCount),
+          "oasis summary: " + summary);
+
+    qint64 minX = 0;
+    qint64 minY = 0;
+    qint64 maxX = 0;
+    qint64 maxY = 0;
+    check(plain.tryGetLayoutBounds(minX, minY, maxX, maxY), "oasis bounds");
+    check(minX == 0 && minY == -203 && maxX == 50000 + 29 * 15 + 10 && maxY == 3020,
+          QString("oasis bounds %1 %2 %3 %4").arg(minX).arg(minY).arg(maxX).arg(maxY));
+
+    LayoutDocument compressed;
+    check(compressed.openLayout(compressedPath, false, summary, error), "compressed oasis open: " + error);
+    check(describeNode(*compressed.rootCell()) == describeNode(*plain.rootCell()), "CBLOCK content differs");
+
+    LayoutDocument corrupt;
+    check(!corrupt.openLayout(corruptPath, false, summary, error) && error.contains("CBLOCK"),
+          "corrupt CBLOCK: " + error);
+}
+
+void testJournalReplay(const QTemporaryDir& dir) {
+    const QString base = dir.filePath("autosave");
+    QString summary;
+    QString error;
+
+    LayoutDocument edited;
+    edited.addObjects({rectangle(1, 0, 0, 10, 10), rectangle(1, 20, 0, 30, 10)});
+    check(edited.startAutosave(base, error), "autosave start: " + error);
+
+    edited.addObjects({rectangle(2, 0, 20, 10, 30), rectangle(2, 20, 20, 30, 30), rectangle(2, 40, 20, 50, 30)});
+    edited.removeObjects({rootObjectIds(edited).first()});
+    edited.undoEdits(1);
+    edited.redoEdits(1);
+    edited.beginTransaction();
+    edited.addObjects({std::make_shared<PolygonObjectModel>(3, 0, QVector<WorldPoint>{{0, 50}, {40, 50}, {20, 90}})});
+    edited.removeObjects({rootObjectIds(edited).last()});
+    edited.commitTransaction();
+    QString expected = describeNode(*edited.rootCell());
+    edited.stopAutosave();
+
+    LayoutDocument recovered;
+    check(recovered.recoverLayout(base, summary, error), "recover: " + error);
+    check(!summary.contains(" 0 journal records") && !summary.contains("damaged"), "recover summary: " + summary);
+    check(describeNode(*recovered.rootCell()) == expected, "recovered geometry differs");
+
+    // New masters are not in the snapshot, so adding them compacts; edits
+    // queued meanwhile are covered by the compaction or journaled after it.
+    check(edited.startAutosave(base, error), "autosave restart: " + error);
+    edited.addObjects(buildDesign());
+    edited.addObjects({rectangle(5, 100, 100, 200, 200)});
+    edited.removeObjects({rootObjectIds(edited).at(1)});
+    expected = describeNode(*edited.rootCell());
+    edited.stopAutosave();
+
+    check(recovered.recoverLayout(base, summary, error), "recover after compaction: " + error);
+    check(describeNode(*recovered.rootCell()) == expected, "recovered geometry after compaction differs");
+
+    // A torn append at the tail is ignored.
+    QFile journal(base + ".l2journal");
+    check(journal.open(QIODevice::Append) && journal.write("\x40\0\0\0torn", 8) == 8, "append torn record");
+    journal.close();
+    LayoutDocument torn;
+    check(torn.recoverLayout(base, summary, error), "recover torn: " + error);
+    check(summary.contains("damaged tail ignored"), "recover torn summary: " + summary);
+    check(describeNode(*torn.rootCell()) == expected, "recovered torn geometry differs");
+}
+
+}
+
+int main() {
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "FAIL: cannot create a temporary directory\n");
+        return 1;
+    }
+
+    testSnapshotRoundTrip(dir);
+    testGdsRoundTrip(dir);
+    testOasisLoading(dir);
+    testJournalReplay(dir);
+
+    if (g_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all layout round-trip checks passed\n");
+    return 0;
+}